@@ -66,7 +66,11 @@ public:
         Stopped = 5,
         Hibernating = 6,
         Hibernated = 7,
-        Awakening = 8
+        Awakening = 8,
+
+        // not a real state, sent when a process in the container has been
+        // killed by the OOM killer; the container may still be running
+        OomKilled = 9
     };
 
 public:
@@ -173,6 +177,13 @@ public:
 
     virtual std::list<std::pair<int32_t, std::string>> listContainers() const = 0;
 
+    // Not pure so that existing proxy implementations don't have to provide
+    // the debug metrics, the default reports them as unavailable
+    virtual std::string getPluginMetrics() const
+    {
+        return std::string();
+    }
+
 
     inline int32_t startContainerFromSpec(const std::string& id,
                                           const std::string& jsonSpec) const
@@ -24,6 +24,7 @@
 #define DOBBYCONFIG_H
 
 #include "IDobbyUtils.h"
+#include "DobbyDevNodeRegistry.h"
 #include "ContainerId.h"
 #include <IDobbyIPCUtils.h>
 #include <IDobbySettings.h>
@@ -41,6 +42,7 @@
 
 #include <sstream>
 #include <map>
+#include <set>
 #include <list>
 #include <mutex>
 #include <string>
@@ -139,27 +141,32 @@ protected:
     bool writeConfigJsonImpl(const std::string& filePath) const;
     bool updateBundleConfig(const ContainerId& id,
                             std::shared_ptr<rt_dobby_schema> cfg,
-                            const std::string& bundlePath);
+                            const std::string& bundlePath,
+                            bool writeConfig = true);
     bool setHostnameToContainerId(const ContainerId& id,
                             std::shared_ptr<rt_dobby_schema> cfg,
-                            const std::string& bundlePath);
+                            const std::string& bundlePath,
+                            bool writeConfig = true);
     bool convertToCompliant(const ContainerId& id,
                             std::shared_ptr<rt_dobby_schema> cfg,
-                            const std::string& bundlePath);
+                            const std::string& bundlePath,
+                            bool writeConfig = true);
     bool isApparmorProfileLoaded(const char *profile) const;
 
-    struct DevNode
-    {
-        std::string path;
-        dev_t major;
-        dev_t minor;
-        mode_t mode;
-    };
+    typedef DobbyDevNodeRegistry::DevNode DevNode;
 
     static std::list<DevNode> scanDevNodes(const std::list<std::string> &devNodes);
 
     mutable std::mutex mLock;
 
+private:
+    static void rebuildApparmorProfileIndex(const std::string& revision);
+
+    static std::mutex mApparmorLock;
+    static bool mApparmorIndexed;
+    static std::string mApparmorRevision;
+    static std::set<std::string> mApparmorProfiles;
+
 private:
     void addPluginLauncherHooks(std::shared_ptr<rt_dobby_schema> cfg, const std::string& bundlePath);
     void setPluginHookEntry(rt_defs_hook* entry, const std::string& name, const std::string& configPath);
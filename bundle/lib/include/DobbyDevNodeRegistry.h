@@ -0,0 +1,95 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyDevNodeRegistry.h
+ *
+ */
+#ifndef DOBBYDEVNODEREGISTRY_H
+#define DOBBYDEVNODEREGISTRY_H
+
+#include <map>
+#include <set>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class DobbyDevNodeRegistry
+ *  @brief Process wide cache of the device nodes matching sets of glob
+ *  patterns.
+ *
+ *  The first lookup of a set of patterns globs and stats the matching nodes,
+ *  subsequent lookups return the same (immutable) list without touching the
+ *  filesystem.
+ *
+ *  The directories the patterns live in are watched with inotify, if a node
+ *  matching any of the patterns is added, removed or has its attributes
+ *  changed then all the cached lists are dropped and rebuilt on their next
+ *  lookup.  The inotify fd is non-blocking and is drained at the start of
+ *  each lookup, so there is no thread behind the registry.
+ *
+ *  generation() is bumped every time the cache is dropped, callers that
+ *  derive their own cached data from the dev nodes can use it to tell when
+ *  that data is stale.
+ */
+class DobbyDevNodeRegistry
+{
+public:
+    struct DevNode
+    {
+        std::string path;
+        dev_t major;
+        dev_t minor;
+        mode_t mode;
+    };
+
+    typedef std::shared_ptr<const std::list<DevNode>> DevNodeList;
+
+public:
+    static DevNodeList devNodes(const std::list<std::string> &patterns);
+    static unsigned generation();
+
+private:
+    DobbyDevNodeRegistry();
+    ~DobbyDevNodeRegistry();
+
+    static DobbyDevNodeRegistry& instance();
+
+    void processEvents();
+    bool isRelevant(const std::string &path, bool isDir) const;
+    void addWatch(const std::string &pattern);
+
+    static std::list<DevNode> scan(const std::list<std::string> &patterns);
+
+private:
+    std::mutex mLock;
+    int mInotifyFd;
+    unsigned mGeneration;
+
+    std::map<int, std::string> mWatches;
+    std::set<std::string> mPatterns;
+    std::map<std::list<std::string>, DevNodeList> mDevNodes;
+};
+
+
+#endif // !defined(DOBBYDEVNODEREGISTRY_H)
@@ -27,6 +27,9 @@
 #include "DobbyBundle.h"
 
 #include <set>
+#include <map>
+#include <list>
+#include <mutex>
 #include <bitset>
 #include <memory>
 
@@ -112,10 +115,26 @@ public:
 public:
     const std::string& rootfsPath() const override;
 
+public:
+    static void clearCompiledSpecCache();
+
 private:
     bool parseSpec(ctemplate::TemplateDictionary* dictionary,
-                   const std::string& json,
-                   int bundleFd);
+                   const std::string& json);
+
+private:
+    struct CompiledSpec;
+
+    std::shared_ptr<const CompiledSpec> getCompiledSpec(const std::shared_ptr<const IDobbySettings>& settings,
+                                                        const std::string& specJson);
+    std::shared_ptr<const CompiledSpec> compileSpec(const std::string& specJson);
+    void restoreCompiledSpec(const CompiledSpec& compiled);
+    std::string compiledSpecKey(const std::shared_ptr<const IDobbySettings>& settings,
+                                const std::string& specJson);
+
+    std::shared_ptr<const CompiledSpec> loadCompiledSpec(const std::string& filePath) const;
+    void saveCompiledSpec(const std::string& filePath,
+                          const CompiledSpec& compiled);
 
 private:
     #define JSON_FIELD_PROCESSOR(x) \
@@ -166,6 +185,7 @@ private:
     void storeMountPoint(const std::string &type,
                          const std::string &source,
                          const std::string &destination);
+    static MountPoint::Type bindMountPointType(const std::string &source);
 
 private:
     std::string jsonToString(const Json::Value& jsonObject);
@@ -223,6 +243,7 @@ private:
 
 private:
     std::vector<MountPoint> mMountPoints;
+    std::vector<std::string> mBindMountSources;
 
 private:
     std::string mEtcHosts;
@@ -237,6 +258,48 @@ private:
 private:
     static const std::map<std::string, int> mAllowedCaps;
 
+private:
+    // the result of parsing a spec; the expanded (not yet compliant) OCI
+    // config and the values parseSpec extracted from the spec, nothing in
+    // here depends on the container id or bundle path
+    struct CompiledSpec
+    {
+        std::string configJson;
+
+        Json::Value spec;
+        SpecVersion specVersion;
+
+        uid_t userId;
+        gid_t groupId;
+        bool restartOnCrash;
+
+        IDobbyIPCUtils::BusType systemDbus;
+        IDobbyIPCUtils::BusType sessionDbus;
+        IDobbyIPCUtils::BusType debugDbus;
+
+        bool consoleDisabled;
+        std::string consolePath;
+        ssize_t consoleLimit;
+
+        std::map<std::string, Json::Value> legacyPlugins;
+        std::map<std::string, Json::Value> rdkPlugins;
+
+        std::vector<MountPoint> mountPoints;
+        // the source of each mount point if it's a bind mount, re-checked
+        // on every start as the source may have changed type
+        std::vector<std::string> bindMountSources;
+
+        std::string etcHosts;
+        std::string etcServices;
+        std::string etcPasswd;
+        std::string etcGroup;
+        std::string etcLdSoPreload;
+    };
+
+    static std::mutex mSpecCacheLock;
+    static std::map<std::string, std::shared_ptr<const CompiledSpec>> mSpecCache;
+    static std::list<std::string> mSpecCacheOrder;
+
 private:
     std::string mRootfsPath;
 
@@ -30,8 +30,9 @@
 #  include <ctemplate/template.h>
 #pragma GCC diagnostic pop
 
-#include <pthread.h>
-
+#include <map>
+#include <mutex>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <list>
@@ -45,8 +46,17 @@ class IDobbySettings;
  *  @class DobbyTemplate
  *  @brief Singleton class that returns the OCI JSON template.
  *
+ *  The template is compiled into a frozen ctemplate cache once, when the
+ *  singleton is created (the daemon does this at start-up by calling
+ *  setSettings()).  The platform wide values (extra env vars, RT sched
+ *  limits, etc) are held in a separate 'platform' dictionary that is built
+ *  once and then never modified; per-container dictionaries are created as
+ *  copies of it via newDictionary(), so only the container specific values
+ *  need to be filled in for each launch.
  *
- *
+ *  Neither the compiled template nor the platform dictionary are modified
+ *  after they're published, so apply() and applyAt() can be called from
+ *  multiple threads at once.
  */
 class DobbyTemplate
 {
@@ -65,8 +75,12 @@ private:
     void setTemplatePlatformEnvVars();
     void setTemplateCpuRtSched();
 
+    void freezePlatformDictionary();
+
     void _setSettings(const std::shared_ptr<const IDobbySettings>& settings);
 
+    ctemplate::TemplateDictionary* _newDictionary(const std::string& name) const;
+
     std::string _apply(const ctemplate::TemplateDictionaryInterface* dictionary,
                        bool prettyPrint) const;
 
@@ -77,6 +91,8 @@ private:
 public:
     static void setSettings(const std::shared_ptr<const IDobbySettings>& settings);
 
+    static ctemplate::TemplateDictionary* newDictionary(const std::string& name);
+
     static std::string apply(const ctemplate::TemplateDictionaryInterface* dictionary,
                              bool prettyPrint);
 
@@ -86,10 +102,14 @@ public:
 
 private:
     std::map<std::string, std::string> mExtraEnvVars;
+    std::map<std::string, std::string> mPlatformValues;
+
+    mutable std::mutex mPlatformLock;
+    std::shared_ptr<ctemplate::TemplateDictionary> mPlatformDictionary;
 
 private:
-    static pthread_rwlock_t mInstanceLock;
-    static DobbyTemplate* mInstance;
+    static std::mutex mInstanceLock;
+    static std::atomic<DobbyTemplate*> mInstance;
 };
 
 
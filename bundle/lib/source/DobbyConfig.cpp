@@ -34,82 +34,27 @@
 #define OCI_VERSION_CURRENT_DOBBY   "1.0.2-dobby"   // currently used version of extended OCI in bundles
 
 
+std::mutex DobbyConfig::mApparmorLock;
+bool DobbyConfig::mApparmorIndexed = false;
+std::string DobbyConfig::mApparmorRevision;
+std::set<std::string> DobbyConfig::mApparmorProfiles;
+
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Takes a list of glob patterns corresponding to dev node paths and
  *  returns a list of structs with their details.
  *
  *  If the glob pattern doesn't match a device node then it is ignored, this
- *  is not an error.
+ *  is not an error.  The details come from the DobbyDevNodeRegistry, so the
+ *  filesystem is only scanned if the nodes have changed since the last call.
  *
  *  @param[in]  devNodes    The list of dev nodes paths (or glob patterns).
  *
  */
 std::list<DobbyConfig::DevNode> DobbyConfig::scanDevNodes(const std::list<std::string> &devNodes)
 {
-    std::list<DobbyConfig::DevNode> nodes;
-
-    // sanity check any dev nodes to add
-    if (devNodes.empty())
-    {
-        return nodes;
-    }
-
-
-    // create a glob structure to hold the list of dev nodes
-    glob_t devNodeBuf;
-    int globFlags = GLOB_NOSORT;
-    for (const std::string& devNode : devNodes)
-    {
-        glob(devNode.c_str(), globFlags, nullptr, &devNodeBuf);
-        globFlags |= GLOB_APPEND;
-    }
-
-    if (devNodeBuf.gl_pathc == 0)
-    {
-        AI_LOG_ERROR("no dev nodes found despite some being listed in the "
-                    "JSON config file");
-        globfree(&devNodeBuf);
-        return nodes;
-    }
-
-    struct stat buf;
-    std::ostringstream devNodesStream;
-    std::ostringstream devNodesPermStream;
-
-    // loop through all the found dev nodes
-    for (size_t i = 0; i < devNodeBuf.gl_pathc; ++i)
-    {
-        const char *devNode = devNodeBuf.gl_pathv[i];
-        if (!devNode)
-        {
-            AI_LOG_ERROR("invalid glob string");
-            continue;
-        }
-
-        if (stat(devNode, &buf) != 0)
-        {
-            AI_LOG_SYS_WARN(errno, "failed to stat dev node @ '%s'", devNode);
-            continue;
-        }
-
-        // Dev Nodes not character special files on vSTB so don't perform check
-#if !defined(__i686__)
-        if( !S_ISCHR(buf.st_mode) )
-            continue;
-#endif
-
-        AI_LOG_INFO("found dev node '%s'", devNode);
-
-        nodes.emplace_back(DevNode{ devNode,
-                                    major(buf.st_rdev),
-                                    minor(buf.st_rdev),
-                                    (buf.st_mode & 0666) });
-    }
-
-    globfree(&devNodeBuf);
-
-    return nodes;
+    return *DobbyDevNodeRegistry::devNodes(devNodes);
 }
 
 // -----------------------------------------------------------------------------
@@ -708,8 +653,9 @@ void DobbyConfig::addPluginLauncherHooks(std::shared_ptr<rt_dobby_schema> cfg, c
  *  @param[in]  id              container identifier
  *  @param[in]  cfg             libocispec config structure instance
  *  @param[in]  bundlePath      path to the container bundle
+ *  @param[in]  writeConfig     write the updated config.json to the bundle
  */
-bool DobbyConfig::setHostnameToContainerId(const ContainerId& id, std::shared_ptr<rt_dobby_schema> cfg, const std::string& bundlePath)
+bool DobbyConfig::setHostnameToContainerId(const ContainerId& id, std::shared_ptr<rt_dobby_schema> cfg, const std::string& bundlePath, bool writeConfig)
 {
     // change hostname to container id only if necessary
     if (!strcmp(cfg->hostname, id.c_str()))
@@ -721,7 +667,7 @@ bool DobbyConfig::setHostnameToContainerId(const ContainerId& id, std::shared_pt
     cfg->hostname = strdup(id.c_str());
 
     // write the new config.json to a file
-    if (!writeConfigJsonImpl(bundlePath + "/config.json"))
+    if (writeConfig && !writeConfigJsonImpl(bundlePath + "/config.json"))
     {
         return false;
     }
@@ -737,8 +683,9 @@ bool DobbyConfig::setHostnameToContainerId(const ContainerId& id, std::shared_pt
  *  @param[in]  id              container identifier
  *  @param[in]  cfg             libocispec config structure instance
  *  @param[in]  bundlePath      path to the container bundle
+ *  @param[in]  writeConfig     write the updated config.json to the bundle
  */
-bool DobbyConfig::updateBundleConfig(const ContainerId& id, std::shared_ptr<rt_dobby_schema> cfg, const std::string& bundlePath)
+bool DobbyConfig::updateBundleConfig(const ContainerId& id, std::shared_ptr<rt_dobby_schema> cfg, const std::string& bundlePath, bool writeConfig)
 {
     // update ociVersion to latest supported OCI version
     cfg->oci_version = strdup(OCI_VERSION_CURRENT);
@@ -777,7 +724,7 @@ bool DobbyConfig::updateBundleConfig(const ContainerId& id, std::shared_ptr<rt_d
     }
 
     // write the new config.json to a file
-    if (!writeConfigJsonImpl(bundlePath + "/config.json"))
+    if (writeConfig && !writeConfigJsonImpl(bundlePath + "/config.json"))
     {
         return false;
     }
@@ -785,54 +732,108 @@ bool DobbyConfig::updateBundleConfig(const ContainerId& id, std::shared_ptr<rt_d
     return true;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Rebuilds the index of loaded apparmor profiles.
+ *
+ *  Each loaded profile has a directory named '<profile>.<N>' in the apparmorfs
+ *  policy directory, the names of all of them are stored in the index.
+ *
+ *  Must be called with mApparmorLock held.
+ *
+ *  @param[in]  revision    The policy revision the index corresponds to.
+ */
+void DobbyConfig::rebuildApparmorProfileIndex(const std::string& revision)
+{
+    mApparmorProfiles.clear();
+    mApparmorRevision = revision;
+    mApparmorIndexed = true;
+
+    DIR *d = opendir("/sys/kernel/security/apparmor/policy/profiles/");
+    if (!d)
+    {
+        AI_LOG_SYS_ERROR(errno, "opendir() failed on apparmorfs policy directory.");
+        return;
+    }
+
+    struct dirent *cur_dir = NULL;
+
+    errno = 0;
+    while ((cur_dir = readdir(d)) != NULL)
+    {
+        // strip the '.<N>' suffix to get the profile name
+        const char *dot = strrchr(cur_dir->d_name, '.');
+        if (!dot || (dot == cur_dir->d_name) || !isdigit(dot[1]))
+            continue;
+
+        mApparmorProfiles.emplace(cur_dir->d_name, dot - cur_dir->d_name);
+    }
+
+    if (!cur_dir && errno)
+    {
+        AI_LOG_SYS_ERROR(errno, "readdir() failed on apparmorfs policy directory");
+    }
+
+    closedir(d);
+
+    AI_LOG_INFO("indexed %zu AppArmor profiles (policy revision '%s')",
+                mApparmorProfiles.size(), revision.c_str());
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Check if apparmor profile is loaded
  *
+ *  Rather than scanning apparmorfs on every call, the names of the loaded
+ *  profiles are kept in an index.  The index is rebuilt whenever the policy
+ *  revision (/sys/kernel/security/apparmor/revision) changes, which the kernel
+ *  bumps on every profile load / replace / remove.  On older kernels without
+ *  the revision file the index is instead rebuilt when a profile isn't found
+ *  in it.
+ *
  *  @param[in]  profile  The name of apparmor profile.
  *
  *  @return true if the apparmor profile was loaded in kernel space, otherwise false.
  */
-
 bool DobbyConfig::isApparmorProfileLoaded(const char *profile) const
- {
-     DIR *d = NULL;
-     bool status = false;
-     struct dirent *cur_dir = NULL;
-     size_t profile_len = strlen(profile);
-
-     d = opendir("/sys/kernel/security/apparmor/policy/profiles/");
-     if(!d) {
-          AI_LOG_SYS_ERROR(errno, "opendir() failed on apparmorfs policy directory.");
-          return false;
-     }
-
-     errno = 0;
-     while((cur_dir = readdir(d)) != NULL) {
-          if(strlen(cur_dir->d_name) >= (profile_len + 2)) {
-               if(!strncmp(cur_dir->d_name, profile, profile_len) &&
-                    cur_dir->d_name[profile_len] == '.' &&
-                    isdigit(cur_dir->d_name[profile_len + 1])) {
-                    
-                    status = true;
-                    AI_LOG_INFO("AppArmor profile [%s] is loaded.", profile);
-                    break;
-               }
-          }
-     }
-
-     if(!status) {
-          AI_LOG_INFO("AppArmor profile [%s] not found.", profile);
-     }
-
-     if(!cur_dir && errno) {
-          AI_LOG_SYS_ERROR(errno, "readdir() failed on apparmorfs policy directory");
-     }
-
-     closedir(d);
-
-     return status;
- }
+{
+    std::string revision;
+    bool haveRevision = false;
+
+    FILE *fp = fopen("/sys/kernel/security/apparmor/revision", "re");
+    if (fp)
+    {
+        char buf[32];
+        if (fgets(buf, sizeof(buf), fp))
+        {
+            revision = buf;
+            haveRevision = true;
+        }
+        fclose(fp);
+    }
+
+    std::lock_guard<std::mutex> locker(mApparmorLock);
+
+    if (!mApparmorIndexed || (haveRevision && (revision != mApparmorRevision)))
+    {
+        rebuildApparmorProfileIndex(revision);
+    }
+
+    bool status = (mApparmorProfiles.count(profile) != 0);
+    if (!status && !haveRevision)
+    {
+        // can't tell if the policy has changed, so refresh on a miss
+        rebuildApparmorProfileIndex(revision);
+        status = (mApparmorProfiles.count(profile) != 0);
+    }
+
+    if (status)
+        AI_LOG_INFO("AppArmor profile [%s] is loaded.", profile);
+    else
+        AI_LOG_INFO("AppArmor profile [%s] not found.", profile);
+
+    return status;
+}
 
 // -----------------------------------------------------------------------------
 /**
@@ -908,12 +909,17 @@ void DobbyConfig::setPidsLimit(int limit)
  *  @brief Convert the input config.json into an OCI compliant bundle config
  *         that adds support for DobbyPluginLauncher to work with rdkPlugins.
  *
+ *  If @a writeConfig is false the config is only converted in memory, this is
+ *  used when the config didn't come from a file in the bundle, in which case
+ *  there is also no original config to back up.
+ *
  *  @param[in]  id              container identifier
  *  @param[in]  cfg             libocispec config structure instance
  *  @param[in]  bundlePath      path to the container bundle
+ *  @param[in]  writeConfig     write the converted config.json to the bundle
  *
  */
-bool DobbyConfig::convertToCompliant(const ContainerId& id, std::shared_ptr<rt_dobby_schema> cfg, const std::string& bundlePath)
+bool DobbyConfig::convertToCompliant(const ContainerId& id, std::shared_ptr<rt_dobby_schema> cfg, const std::string& bundlePath, bool writeConfig)
 {
     AI_LOG_FN_ENTRY();
 
@@ -930,11 +936,14 @@ bool DobbyConfig::convertToCompliant(const ContainerId& id, std::shared_ptr<rt_d
     {
         // Make a backup of the original config, useful for checking whether a new config
         // is available.
-        std::ifstream srcCfg(bundlePath + "/config.json", std::ios::binary);
-        std::ofstream dstCfg(bundlePath + "/config-dobby.json", std::ios::binary);
-        dstCfg << srcCfg.rdbuf();
+        if (writeConfig)
+        {
+            std::ifstream srcCfg(bundlePath + "/config.json", std::ios::binary);
+            std::ofstream dstCfg(bundlePath + "/config-dobby.json", std::ios::binary);
+            dstCfg << srcCfg.rdbuf();
+        }
 
-        if (!updateBundleConfig(id,std::move(cfg), bundlePath))
+        if (!updateBundleConfig(id,std::move(cfg), bundlePath, writeConfig))
         {
             return false;
         }
@@ -980,7 +989,7 @@ bool DobbyConfig::convertToCompliant(const ContainerId& id, std::shared_ptr<rt_d
             }
 
             // now, transform the config to set it up for DobbyPluginLauncher
-            if (!updateBundleConfig(id,std::move(cfg), bundlePath))
+            if (!updateBundleConfig(id,std::move(cfg), bundlePath, writeConfig))
             {
                 return false;
             }
@@ -988,7 +997,7 @@ bool DobbyConfig::convertToCompliant(const ContainerId& id, std::shared_ptr<rt_d
         else
         {
             // hooks are set up just fine, just need to update the hostname if necessary
-            if (!setHostnameToContainerId(id,std::move(cfg), bundlePath))
+            if (!setHostnameToContainerId(id,std::move(cfg), bundlePath, writeConfig))
             {
                 AI_LOG_ERROR_EXIT("Failed to set container hostname");
                 return false;
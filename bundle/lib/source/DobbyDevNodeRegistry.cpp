@@ -0,0 +1,342 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyDevNodeRegistry.cpp
+ *
+ */
+#include "DobbyDevNodeRegistry.h"
+
+#include <Logging.h>
+
+#include <glob.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/sysmacros.h>
+
+
+// the events that could mean a dev node has been added, removed or changed
+#define DEV_WATCH_EVENTS  (IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | \
+                           IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+
+DobbyDevNodeRegistry::DobbyDevNodeRegistry()
+    : mInotifyFd(-1)
+    , mGeneration(0)
+{
+    mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (mInotifyFd < 0)
+    {
+        AI_LOG_SYS_WARN(errno, "failed to create inotify fd, dev node changes "
+                        "won't be detected");
+    }
+}
+
+DobbyDevNodeRegistry::~DobbyDevNodeRegistry()
+{
+    if ((mInotifyFd >= 0) && (close(mInotifyFd) != 0))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to close inotify fd");
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the singleton instance.
+ *
+ */
+DobbyDevNodeRegistry& DobbyDevNodeRegistry::instance()
+{
+    static DobbyDevNodeRegistry registry;
+    return registry;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the details of the device nodes matching the glob patterns.
+ *
+ *  If a glob pattern doesn't match a device node then it is ignored, this
+ *  is not an error.
+ *
+ *  @param[in]  patterns    The list of dev nodes paths (or glob patterns).
+ *
+ *  @return the list of matching dev nodes, never nullptr.
+ */
+DobbyDevNodeRegistry::DevNodeList DobbyDevNodeRegistry::devNodes(const std::list<std::string> &patterns)
+{
+    if (patterns.empty())
+    {
+        return std::make_shared<const std::list<DevNode>>();
+    }
+
+    DobbyDevNodeRegistry &registry = instance();
+    std::lock_guard<std::mutex> locker(registry.mLock);
+
+    // drop the cache if anything has changed since the last lookup
+    registry.processEvents();
+
+    auto it = registry.mDevNodes.find(patterns);
+    if (it != registry.mDevNodes.end())
+    {
+        return it->second;
+    }
+
+    // add the watches before scanning so changes made while we're scanning
+    // aren't missed
+    for (const std::string &pattern : patterns)
+    {
+        registry.mPatterns.insert(pattern);
+        registry.addWatch(pattern);
+    }
+
+    DevNodeList nodes = std::make_shared<const std::list<DevNode>>(scan(patterns));
+    registry.mDevNodes.emplace(patterns, nodes);
+
+    return nodes;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns a number that changes each time the cached dev nodes are
+ *  invalidated.
+ *
+ */
+unsigned DobbyDevNodeRegistry::generation()
+{
+    DobbyDevNodeRegistry &registry = instance();
+    std::lock_guard<std::mutex> locker(registry.mLock);
+
+    registry.processEvents();
+
+    return registry.mGeneration;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Adds an inotify watch on the directory containing the pattern.
+ *
+ *  If the directory part of the pattern contains glob characters, or doesn't
+ *  exist yet, then the nearest existing parent directory is watched instead;
+ *  the directory being created will then invalidate the cache and the watch
+ *  is moved down on the next scan.
+ *
+ *  Must be called with the lock held.
+ *
+ *  @param[in]  pattern     The dev node path or glob pattern.
+ */
+void DobbyDevNodeRegistry::addWatch(const std::string &pattern)
+{
+    if (mInotifyFd < 0)
+    {
+        return;
+    }
+
+    std::string dir = pattern;
+    do
+    {
+        const size_t slash = dir.rfind('/');
+        if ((slash == std::string::npos) || (slash == 0))
+            dir = "/";
+        else
+            dir.erase(slash);
+    }
+    while ((dir != "/") &&
+           ((dir.find_first_of("*?[") != std::string::npos) ||
+            (access(dir.c_str(), F_OK) != 0)));
+
+    int wd = inotify_add_watch(mInotifyFd, dir.c_str(), DEV_WATCH_EVENTS);
+    if (wd < 0)
+    {
+        AI_LOG_SYS_WARN(errno, "failed to add inotify watch on '%s'", dir.c_str());
+        return;
+    }
+
+    mWatches[wd] = dir;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns true if a change to the given path could affect the result
+ *  of any of the registered patterns.
+ *
+ *  Must be called with the lock held.
+ *
+ *  @param[in]  path        The path that has changed.
+ *  @param[in]  isDir       true if the path is a directory.
+ */
+bool DobbyDevNodeRegistry::isRelevant(const std::string &path, bool isDir) const
+{
+    for (const std::string &pattern : mPatterns)
+    {
+        if (fnmatch(pattern.c_str(), path.c_str(), FNM_PATHNAME) == 0)
+            return true;
+
+        // a directory appearing or disappearing along the pattern's path
+        if (isDir && (pattern.compare(0, path.length() + 1, path + "/") == 0))
+            return true;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Drains the inotify fd and drops the cache if any of the events
+ *  affect a registered pattern.
+ *
+ *  Must be called with the lock held.
+ */
+void DobbyDevNodeRegistry::processEvents()
+{
+    if (mInotifyFd < 0)
+    {
+        return;
+    }
+
+    bool changed = false;
+
+    alignas(struct inotify_event) char buf[4096];
+    while (true)
+    {
+        ssize_t rd = TEMP_FAILURE_RETRY(read(mInotifyFd, buf, sizeof(buf)));
+        if (rd <= 0)
+        {
+            if ((rd < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))
+                AI_LOG_SYS_ERROR(errno, "failed to read inotify events");
+            break;
+        }
+
+        const char *ptr = buf;
+        while (ptr < (buf + rd))
+        {
+            const struct inotify_event *event =
+                reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            // lost some events, have to assume the worst
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                changed = true;
+                continue;
+            }
+
+            auto it = mWatches.find(event->wd);
+            if (it == mWatches.end())
+                continue;
+
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                if (event->mask & IN_IGNORED)
+                    mWatches.erase(it);
+                changed = true;
+                continue;
+            }
+
+            if (event->len == 0)
+                continue;
+
+            std::string path = it->second;
+            if (path != "/")
+                path += '/';
+            path += event->name;
+
+            if (isRelevant(path, (event->mask & IN_ISDIR) != 0))
+            {
+                AI_LOG_DEBUG("dev node '%s' changed", path.c_str());
+                changed = true;
+            }
+        }
+    }
+
+    if (changed)
+    {
+        AI_LOG_INFO("dev nodes changed, dropping cached details");
+
+        mDevNodes.clear();
+        mGeneration++;
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Globs the patterns and returns the details of the char device nodes
+ *  found.
+ *
+ *  @param[in]  patterns    The list of dev nodes paths (or glob patterns).
+ */
+std::list<DobbyDevNodeRegistry::DevNode> DobbyDevNodeRegistry::scan(const std::list<std::string> &patterns)
+{
+    std::list<DevNode> nodes;
+
+    // create a glob structure to hold the list of dev nodes
+    glob_t devNodeBuf;
+    int globFlags = GLOB_NOSORT;
+    for (const std::string& devNode : patterns)
+    {
+        glob(devNode.c_str(), globFlags, nullptr, &devNodeBuf);
+        globFlags |= GLOB_APPEND;
+    }
+
+    if (devNodeBuf.gl_pathc == 0)
+    {
+        AI_LOG_ERROR("no dev nodes found despite some being listed in the "
+                    "JSON config file");
+        globfree(&devNodeBuf);
+        return nodes;
+    }
+
+    struct stat buf;
+
+    // loop through all the found dev nodes
+    for (size_t i = 0; i < devNodeBuf.gl_pathc; ++i)
+    {
+        const char *devNode = devNodeBuf.gl_pathv[i];
+        if (!devNode)
+        {
+            AI_LOG_ERROR("invalid glob string");
+            continue;
+        }
+
+        if (stat(devNode, &buf) != 0)
+        {
+            AI_LOG_SYS_WARN(errno, "failed to stat dev node @ '%s'", devNode);
+            continue;
+        }
+
+        // Dev Nodes not character special files on vSTB so don't perform check
+#if !defined(__i686__)
+        if( !S_ISCHR(buf.st_mode) )
+            continue;
+#endif
+
+        AI_LOG_INFO("found dev node '%s'", devNode);
+
+        nodes.emplace_back(DevNode{ devNode,
+                                    major(buf.st_rdev),
+                                    minor(buf.st_rdev),
+                                    (buf.st_mode & 0666) });
+    }
+
+    globfree(&devNodeBuf);
+
+    return nodes;
+}
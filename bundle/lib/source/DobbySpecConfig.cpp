@@ -25,6 +25,8 @@
 #include "DobbyTemplate.h"
 #include "IDobbyUtils.h"
 
+#include <AI_MD5.h>
+
 #include <array>
 #include <atomic>
 #include <algorithm>
@@ -196,6 +198,10 @@ static const ctemplate::StaticTemplateString SECCOMP_SYSCALLS =
 
 int DobbySpecConfig::mNumCores = -1;
 
+std::mutex DobbySpecConfig::mSpecCacheLock;
+std::map<std::string, std::shared_ptr<const DobbySpecConfig::CompiledSpec>> DobbySpecConfig::mSpecCache;
+std::list<std::string> DobbySpecConfig::mSpecCacheOrder;
+
 // TODO: should we only allowed these if a network namespace is enabled ?
 const std::map<std::string, int> DobbySpecConfig::mAllowedCaps =
 {
@@ -244,31 +250,38 @@ DobbySpecConfig::DobbySpecConfig(const std::shared_ptr<IDobbyUtils> &utils,
         AI_LOG_INFO("current platform has %d cores", mNumCores);
     }
 
-    // create a dictionary object
-    mDictionary = new ctemplate::TemplateDictionary("spec");
+    // create a dictionary object, pre-populated with the platform values
+    mDictionary = DobbyTemplate::newDictionary("spec");
 
     // because jsoncpp can throw exceptions if we fail to check the json types
     // before performing conversions we wrap the whole parse operation in a
     // try / catch
     try
     {
-        // go and parse dobby spec into OCI config using a template dictionary
-        mValid = parseSpec(mDictionary, specJson, bundle->dirFd());
-
         // bundle persistence is set to default when starting from a spec,
         // so we can go ahead and finalise container config preparation!
-        if(!bundle->getPersistence())
+        if (!bundle->getPersistence())
         {
-            // deserialise config.json
+            // parse the spec and expand the template in memory (or reuse
+            // the result from a previous start of the same spec), config.json
+            // is only written once the config is complete (by DobbyManager
+            // just before the container is created)
+            std::shared_ptr<const CompiledSpec> compiled = getCompiledSpec(settings, specJson);
+            mValid = (compiled != nullptr);
+
+            // deserialise into a fresh config object, this is then patched
+            // with the container id and bundle path
             parser_error err = nullptr;
-            std::string configPath = bundle->path() + "/config.json";
-            mConf = std::shared_ptr<rt_dobby_schema>(
-                        rt_dobby_schema_parse_file(configPath.c_str(), nullptr, &err),
-                        free_rt_dobby_schema);
+            if (mValid)
+            {
+                mConf = std::shared_ptr<rt_dobby_schema>(
+                            rt_dobby_schema_parse_data(compiled->configJson.c_str(), nullptr, &err),
+                            free_rt_dobby_schema);
+            }
 
-            if (mConf.get() == nullptr || err)
+            if (mValid && (mConf.get() == nullptr || err))
             {
-                AI_LOG_ERROR_EXIT("Failed to parse bundle config, err '%s'", err);
+                AI_LOG_ERROR("Failed to parse bundle config, err '%s'", err);
                 if (err)
                 {
                     free(err);
@@ -276,10 +289,23 @@ DobbySpecConfig::DobbySpecConfig(const std::shared_ptr<IDobbyUtils> &utils,
                 }
                 mValid = false;
             }
-            else
+            else if (mValid)
             {
                 // convert OCI config to compliant using libocispec
-                mValid &= DobbyConfig::convertToCompliant(id, mConf, bundle->path());
+                mValid &= DobbyConfig::convertToCompliant(id, mConf, bundle->path(), false);
+            }
+        }
+        else
+        {
+            // go and parse dobby spec into OCI config using a template
+            // dictionary and write it into the bundle
+            mValid = parseSpec(mDictionary, specJson);
+
+            if (mValid &&
+                !DobbyTemplate::applyAt(bundle->dirFd(), "config.json", mDictionary, false))
+            {
+                AI_LOG_ERROR("Failed to apply and write dictionary to config");
+                mValid = false;
             }
         }
     }
@@ -327,8 +353,8 @@ DobbySpecConfig::DobbySpecConfig(const std::shared_ptr<IDobbyUtils> &utils,
         AI_LOG_INFO("current platform has %d cores", mNumCores);
     }
 
-    // create a dictionary object
-    mDictionary = new ctemplate::TemplateDictionary("spec");
+    // create a dictionary object, pre-populated with the platform values
+    mDictionary = DobbyTemplate::newDictionary("spec");
 
     // because jsoncpp can throw exceptions if we fail to check the json types
     // before performing conversions we wrap the whole parse operation in a
@@ -336,7 +362,15 @@ DobbySpecConfig::DobbySpecConfig(const std::shared_ptr<IDobbyUtils> &utils,
     try
     {
         // go and parse dobby spec into OCI config using a template dictionary
-        mValid = parseSpec(mDictionary, specJson, bundle->dirFd());
+        // and write it into the bundle
+        mValid = parseSpec(mDictionary, specJson);
+
+        if (mValid &&
+            !DobbyTemplate::applyAt(bundle->dirFd(), "config.json", mDictionary, false))
+        {
+            AI_LOG_ERROR("Failed to apply and write dictionary to config");
+            mValid = false;
+        }
     }
     catch (const Json::Exception& e)
     {
@@ -462,6 +496,429 @@ std::shared_ptr<rt_dobby_schema> DobbySpecConfig::config() const
     return mValid ? std::shared_ptr<rt_dobby_schema>(mConf) : nullptr;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Drops all the compiled specs held in memory.
+ *
+ *  Should be called if anything outside the spec and settings that feeds into
+ *  the generated config changes, i.e. the platform device nodes.  Entries
+ *  persisted in the workspace are keyed against the boot so are left alone.
+ */
+void DobbySpecConfig::clearCompiledSpecCache()
+{
+    std::lock_guard<std::mutex> locker(mSpecCacheLock);
+
+    AI_LOG_INFO("clearing %zu compiled specs", mSpecCache.size());
+
+    mSpecCache.clear();
+    mSpecCacheOrder.clear();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the compiled form of the spec, from the cache if possible
+ *  otherwise by parsing it.
+ *
+ *  On return the spec values (user id, mounts, etc files, ...) have been
+ *  set in this object whether they came from the cache or not.
+ *
+ *  @param[in]  settings        The daemon settings.
+ *  @param[in]  specJson        The json spec document from the client.
+ *
+ *  @return the compiled spec, or nullptr if the spec is invalid.
+ */
+std::shared_ptr<const DobbySpecConfig::CompiledSpec>
+    DobbySpecConfig::getCompiledSpec(const std::shared_ptr<const IDobbySettings>& settings,
+                                     const std::string& specJson)
+{
+    AI_LOG_FN_ENTRY();
+
+    const IDobbySettings::SpecCacheSettings cacheSettings = settings->specCacheSettings();
+    if (!cacheSettings.enabled)
+    {
+        AI_LOG_FN_EXIT();
+        return compileSpec(specJson);
+    }
+
+    const std::string key = compiledSpecKey(settings, specJson);
+
+    std::string filePath;
+    if (cacheSettings.persist)
+        filePath = settings->workspaceDir() + "/dobby/spec-cache/" + key + ".json";
+
+    // check the in-memory cache first, then the workspace
+    std::shared_ptr<const CompiledSpec> compiled;
+    {
+        std::lock_guard<std::mutex> locker(mSpecCacheLock);
+
+        auto it = mSpecCache.find(key);
+        if (it != mSpecCache.end())
+        {
+            compiled = it->second;
+
+            // move to the front of the eviction list
+            mSpecCacheOrder.remove(key);
+            mSpecCacheOrder.push_front(key);
+        }
+    }
+
+    bool store = false;
+    if (!compiled && !filePath.empty())
+    {
+        compiled = loadCompiledSpec(filePath);
+        store = (compiled != nullptr);
+    }
+
+    if (compiled)
+    {
+        AI_LOG_INFO("using cached config for spec %s", key.c_str());
+        restoreCompiledSpec(*compiled);
+    }
+    else
+    {
+        compiled = compileSpec(specJson);
+        if (compiled && !filePath.empty())
+            saveCompiledSpec(filePath, *compiled);
+
+        store = (compiled != nullptr);
+    }
+
+    if (store)
+    {
+        std::lock_guard<std::mutex> locker(mSpecCacheLock);
+
+        if (mSpecCache.emplace(key, compiled).second)
+        {
+            mSpecCacheOrder.push_front(key);
+
+            // evict the least recently used specs
+            const size_t maxEntries = std::max(cacheSettings.maxEntries, 1);
+            while (mSpecCacheOrder.size() > maxEntries)
+            {
+                mSpecCache.erase(mSpecCacheOrder.back());
+                mSpecCacheOrder.pop_back();
+            }
+        }
+    }
+
+    AI_LOG_FN_EXIT();
+    return compiled;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Parses the spec and expands the template into the OCI config.
+ *
+ *  @param[in]  specJson        The json spec document from the client.
+ *
+ *  @return the compiled spec, or nullptr if the spec is invalid.
+ */
+std::shared_ptr<const DobbySpecConfig::CompiledSpec>
+    DobbySpecConfig::compileSpec(const std::string& specJson)
+{
+    if (!parseSpec(mDictionary, specJson))
+        return nullptr;
+
+    std::shared_ptr<CompiledSpec> compiled = std::make_shared<CompiledSpec>();
+
+    compiled->configJson = DobbyTemplate::apply(mDictionary, false);
+    if (compiled->configJson.empty())
+    {
+        AI_LOG_ERROR("failed to expand the OCI config template");
+        return nullptr;
+    }
+
+    compiled->spec = mSpec;
+    compiled->specVersion = mSpecVersion;
+    compiled->userId = mUserId;
+    compiled->groupId = mGroupId;
+    compiled->restartOnCrash = mRestartOnCrash;
+    compiled->systemDbus = mSystemDbus;
+    compiled->sessionDbus = mSessionDbus;
+    compiled->debugDbus = mDebugDbus;
+    compiled->consoleDisabled = mConsoleDisabled;
+    compiled->consolePath = mConsolePath;
+    compiled->consoleLimit = mConsoleLimit;
+    compiled->legacyPlugins = mLegacyPlugins;
+    compiled->rdkPlugins = mRdkPlugins;
+    compiled->mountPoints = mMountPoints;
+    compiled->bindMountSources = mBindMountSources;
+    compiled->etcHosts = mEtcHosts;
+    compiled->etcServices = mEtcServices;
+    compiled->etcPasswd = mEtcPasswd;
+    compiled->etcGroup = mEtcGroup;
+    compiled->etcLdSoPreload = mEtcLdSoPreload;
+
+    return compiled;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Sets the spec values in this object from a compiled spec, this is
+ *  the equivalent of calling parseSpec.
+ *
+ *  The type of each bind mount point is worked out again from its source, as
+ *  a source may have been created or replaced since the spec was compiled.
+ *
+ *  @param[in]  compiled        The compiled spec.
+ */
+void DobbySpecConfig::restoreCompiledSpec(const CompiledSpec& compiled)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    mSpec = compiled.spec;
+    mSpecVersion = compiled.specVersion;
+    mUserId = compiled.userId;
+    mGroupId = compiled.groupId;
+    mRestartOnCrash = compiled.restartOnCrash;
+    mSystemDbus = compiled.systemDbus;
+    mSessionDbus = compiled.sessionDbus;
+    mDebugDbus = compiled.debugDbus;
+    mConsoleDisabled = compiled.consoleDisabled;
+    mConsolePath = compiled.consolePath;
+    mConsoleLimit = compiled.consoleLimit;
+    mLegacyPlugins = compiled.legacyPlugins;
+    mRdkPlugins = compiled.rdkPlugins;
+    mMountPoints = compiled.mountPoints;
+    mBindMountSources = compiled.bindMountSources;
+    mEtcHosts = compiled.etcHosts;
+    mEtcServices = compiled.etcServices;
+    mEtcPasswd = compiled.etcPasswd;
+    mEtcGroup = compiled.etcGroup;
+    mEtcLdSoPreload = compiled.etcLdSoPreload;
+
+    for (size_t i = 0; i < mMountPoints.size() && i < mBindMountSources.size(); i++)
+    {
+        if (!mBindMountSources[i].empty())
+            mMountPoints[i].type = bindMountPointType(mBindMountSources[i]);
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Generates the cache key for a spec.
+ *
+ *  This is the MD5 of the spec plus everything else that goes into the
+ *  generated config; the settings used by the spec processors and the
+ *  template, and the boot id (device node numbers can change across boots).
+ *
+ *  @param[in]  settings        The daemon settings.
+ *  @param[in]  specJson        The json spec document from the client.
+ *
+ *  @return the key as a hex string.
+ */
+std::string DobbySpecConfig::compiledSpecKey(const std::shared_ptr<const IDobbySettings>& settings,
+                                             const std::string& specJson)
+{
+    AI_MD5_CTX ctx;
+    AI_MD5_Init(&ctx);
+
+    // each field is null terminated so adjacent fields can't alias
+    auto update = [&ctx](const std::string& str)
+    {
+        AI_MD5_Update(&ctx, str.c_str(), str.length() + 1);
+    };
+
+    update(specJson);
+    update(mUtilities->readTextFile("/proc/sys/kernel/random/boot_id"));
+    update(jsonToString(mRdkPluginsData));
+
+    for (const std::string& plugin : mDefaultPlugins)
+        update(plugin);
+
+    for (const auto& envVar : settings->extraEnvVariables())
+    {
+        update(envVar.first);
+        update(envVar.second);
+    }
+
+    for (const auto& hwAccess : { mGpuSettings, mVpuSettings })
+    {
+        update(hwAccess ? "hw" : "none");
+        if (!hwAccess)
+            continue;
+
+        for (const std::string& devNode : hwAccess->deviceNodes)
+            update(devNode);
+        for (const DobbyConfig::DevNode& devNode : *DobbyDevNodeRegistry::devNodes(hwAccess->deviceNodes))
+        {
+            update(devNode.path);
+            update(std::to_string(devNode.major) + ":" + std::to_string(devNode.minor) +
+                   ":" + std::to_string(devNode.mode));
+        }
+        for (int groupId : hwAccess->groupIds)
+            update(std::to_string(groupId));
+        for (const auto& mount : hwAccess->extraMounts)
+        {
+            update(mount.source);
+            update(mount.target);
+            update(mount.type);
+            for (const std::string& flag : mount.flags)
+                update(flag);
+        }
+        for (const auto& envVar : hwAccess->extraEnvVariables)
+        {
+            update(envVar.first);
+            update(envVar.second);
+        }
+    }
+
+    unsigned char digest[AI_MD5_DIGEST_LENGTH];
+    AI_MD5_Final(digest, &ctx);
+
+    char hex[(AI_MD5_DIGEST_LENGTH * 2) + 1];
+    for (int i = 0; i < AI_MD5_DIGEST_LENGTH; i++)
+        sprintf(&hex[i * 2], "%02x", digest[i]);
+
+    return std::string(hex, AI_MD5_DIGEST_LENGTH * 2);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads a compiled spec previously saved in the workspace.
+ *
+ *  @param[in]  filePath        The path to the cache file.
+ *
+ *  @return the compiled spec, or nullptr if there was no (valid) file.
+ */
+std::shared_ptr<const DobbySpecConfig::CompiledSpec>
+    DobbySpecConfig::loadCompiledSpec(const std::string& filePath) const
+{
+    if (access(filePath.c_str(), R_OK) != 0)
+        return nullptr;
+
+    const std::string contents = mUtilities->readTextFile(filePath, 4 * 1024 * 1024);
+
+    Json::Value root;
+    Json::Reader reader;
+    if (contents.empty() || !reader.parse(contents, root) || !root.isObject())
+    {
+        AI_LOG_WARN("invalid compiled spec file '%s'", filePath.c_str());
+        return nullptr;
+    }
+
+    std::shared_ptr<CompiledSpec> compiled = std::make_shared<CompiledSpec>();
+
+    try
+    {
+        compiled->configJson = root["config"].asString();
+        compiled->spec = root["spec"];
+        compiled->specVersion = static_cast<SpecVersion>(root["specVersion"].asInt());
+        compiled->userId = root["userId"].asUInt();
+        compiled->groupId = root["groupId"].asUInt();
+        compiled->restartOnCrash = root["restartOnCrash"].asBool();
+        compiled->systemDbus = static_cast<IDobbyIPCUtils::BusType>(root["systemDbus"].asInt());
+        compiled->sessionDbus = static_cast<IDobbyIPCUtils::BusType>(root["sessionDbus"].asInt());
+        compiled->debugDbus = static_cast<IDobbyIPCUtils::BusType>(root["debugDbus"].asInt());
+        compiled->consoleDisabled = root["consoleDisabled"].asBool();
+        compiled->consolePath = root["consolePath"].asString();
+        compiled->consoleLimit = static_cast<ssize_t>(root["consoleLimit"].asInt64());
+
+        const Json::Value& legacyPlugins = root["legacyPlugins"];
+        for (const std::string& name : legacyPlugins.getMemberNames())
+            compiled->legacyPlugins.emplace(name, legacyPlugins[name]);
+
+        const Json::Value& rdkPlugins = root["rdkPlugins"];
+        for (const std::string& name : rdkPlugins.getMemberNames())
+            compiled->rdkPlugins.emplace(name, rdkPlugins[name]);
+
+        for (const Json::Value& mountPoint : root["mountPoints"])
+        {
+            compiled->mountPoints.emplace_back(
+                MountPoint{ static_cast<MountPoint::Type>(mountPoint["type"].asInt()),
+                            mountPoint["destination"].asString() });
+            compiled->bindMountSources.emplace_back(mountPoint["bindSource"].asString());
+        }
+
+        const Json::Value& etc = root["etc"];
+        compiled->etcHosts = etc["hosts"].asString();
+        compiled->etcServices = etc["services"].asString();
+        compiled->etcPasswd = etc["passwd"].asString();
+        compiled->etcGroup = etc["group"].asString();
+        compiled->etcLdSoPreload = etc["ld-preload"].asString();
+    }
+    catch (const Json::Exception& e)
+    {
+        AI_LOG_WARN("invalid compiled spec file '%s' - %s",
+                    filePath.c_str(), e.what());
+        return nullptr;
+    }
+
+    if (compiled->configJson.empty())
+        return nullptr;
+
+    return compiled;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Saves a compiled spec into the workspace.
+ *
+ *  The file is written to a temporary name and then renamed, so a concurrent
+ *  reader never sees a partial file.
+ *
+ *  @param[in]  filePath        The path to the cache file.
+ *  @param[in]  compiled        The compiled spec to save.
+ */
+void DobbySpecConfig::saveCompiledSpec(const std::string& filePath,
+                                       const CompiledSpec& compiled)
+{
+    const std::string dirPath = filePath.substr(0, filePath.rfind('/'));
+    if (!mUtilities->mkdirRecursive(dirPath, 0755))
+    {
+        AI_LOG_ERROR("failed to create spec cache dir '%s'", dirPath.c_str());
+        return;
+    }
+
+    Json::Value root(Json::objectValue);
+    root["config"] = compiled.configJson;
+    root["spec"] = compiled.spec;
+    root["specVersion"] = static_cast<int>(compiled.specVersion);
+    root["userId"] = static_cast<Json::UInt>(compiled.userId);
+    root["groupId"] = static_cast<Json::UInt>(compiled.groupId);
+    root["restartOnCrash"] = compiled.restartOnCrash;
+    root["systemDbus"] = static_cast<int>(compiled.systemDbus);
+    root["sessionDbus"] = static_cast<int>(compiled.sessionDbus);
+    root["debugDbus"] = static_cast<int>(compiled.debugDbus);
+    root["consoleDisabled"] = compiled.consoleDisabled;
+    root["consolePath"] = compiled.consolePath;
+    root["consoleLimit"] = static_cast<Json::Int64>(compiled.consoleLimit);
+
+    root["legacyPlugins"] = Json::Value(Json::objectValue);
+    for (const auto& plugin : compiled.legacyPlugins)
+        root["legacyPlugins"][plugin.first] = plugin.second;
+
+    root["rdkPlugins"] = Json::Value(Json::objectValue);
+    for (const auto& plugin : compiled.rdkPlugins)
+        root["rdkPlugins"][plugin.first] = plugin.second;
+
+    root["mountPoints"] = Json::Value(Json::arrayValue);
+    for (size_t i = 0; i < compiled.mountPoints.size(); i++)
+    {
+        Json::Value entry;
+        entry["type"] = static_cast<int>(compiled.mountPoints[i].type);
+        entry["destination"] = compiled.mountPoints[i].destination;
+        if (i < compiled.bindMountSources.size())
+            entry["bindSource"] = compiled.bindMountSources[i];
+        root["mountPoints"].append(entry);
+    }
+
+    root["etc"]["hosts"] = compiled.etcHosts;
+    root["etc"]["services"] = compiled.etcServices;
+    root["etc"]["passwd"] = compiled.etcPasswd;
+    root["etc"]["group"] = compiled.etcGroup;
+    root["etc"]["ld-preload"] = compiled.etcLdSoPreload;
+
+    const std::string tmpFilePath = filePath + ".tmp";
+    if (!mUtilities->writeTextFile(tmpFilePath, jsonToString(root),
+                                   O_CREAT | O_TRUNC, 0644) ||
+        (rename(tmpFilePath.c_str(), filePath.c_str()) != 0))
+    {
+        AI_LOG_ERROR("failed to save compiled spec to '%s'", filePath.c_str());
+        unlink(tmpFilePath.c_str());
+    }
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Generates the OCI
@@ -470,15 +927,16 @@ std::shared_ptr<rt_dobby_schema> DobbySpecConfig::config() const
  *  path will fail.  The function is atomic, therefore it returns true you can
  *  guarantee it suck and will be set for the lifetime of the function.
  *
+ *  The dictionary is only populated, it's up to the caller to expand it into
+ *  the OCI config.
+ *
  *  @param[in]  dictionary      Pointer to the OCI dictionary to populate
  *  @param[in]  json            The json spec document from the client
- *  @param[in]  bundleFd        File descriptor of the bundle directory
  *
  *  @return true if the path was set, otherwise false.
  */
 bool DobbySpecConfig::parseSpec(ctemplate::TemplateDictionary* dictionary,
-                                const std::string& json,
-                                int bundleFd)
+                                const std::string& json)
 {
     AI_LOG_FN_ENTRY();
 
@@ -672,14 +1130,6 @@ bool DobbySpecConfig::parseSpec(ctemplate::TemplateDictionary* dictionary,
         return false;
     }
 
-    // step 8 - write dictionary to config file so that libocispec can continue
-    // processing the config from here on out
-    if (!DobbyTemplate::applyAt(bundleFd, "config.json", mDictionary, false))
-    {
-        AI_LOG_ERROR_EXIT("Failed to apply and write dictionary to config");
-        return false;
-    }
-
     AI_LOG_FN_EXIT();
     return success;
 }
@@ -1387,37 +1837,23 @@ bool DobbySpecConfig::processSwapLimit(const Json::Value& value,
 /**
  *  @brief Adds the GPU device nodes (if any) to supplied dictionary.
  *
- *  This function gathers the dev node details from the settings and system the
- *  first time it runs, for all subsequent times it uses the initial cached
- *  details.
+ *  The dev node details come from the DobbyDevNodeRegistry, which only scans
+ *  the system again if the nodes have been added, removed or changed.
  *
  *  @param[in]  settings    The settings containing the list of dev nodes paths
- *                          or glob patterns.  Only used the first time called.
+ *                          or glob patterns.
  *  @param[in]  dictionary  The dictionary to add the details to.
  *
  */
 void DobbySpecConfig::addGpuDevNodes(const std::shared_ptr<const IDobbySettings::HardwareAccessSettings> &settings,
                                  ctemplate::TemplateDictionary *dictionary)
 {
-    // device nodes should be static, so get the details once and store for
-    // all subsequent calls
-    static std::mutex scanningLock;
-    static std::atomic<bool> scannedDevNodes(false);
-    static std::list<DobbyConfig::DevNode> devNodes;
-
-    if (!scannedDevNodes)
-    {
-        std::lock_guard<std::mutex> locker(scanningLock);
-
-        if (!scannedDevNodes)
-        {
-            devNodes = scanDevNodes(settings->deviceNodes);
-            scannedDevNodes = true;
-        }
-    }
+    // the registry only rescans if the dev nodes have changed
+    const DobbyDevNodeRegistry::DevNodeList devNodes =
+        DobbyDevNodeRegistry::devNodes(settings->deviceNodes);
 
     // add to the additional device node section
-    for (const DobbyConfig::DevNode &devNode : devNodes)
+    for (const DobbyConfig::DevNode &devNode : *devNodes)
     {
         ctemplate::TemplateDictionary *subDict = dictionary->AddSectionDictionary(ADDITIONAL_DEVICE_NODES);
         subDict->SetValue(DEVICE_PATH, devNode.path);
@@ -1431,37 +1867,23 @@ void DobbySpecConfig::addGpuDevNodes(const std::shared_ptr<const IDobbySettings:
 /**
  *  @brief Adds the VPU device nodes (if any) to supplied dictionary.
  *
- *  This function gathers the dev node details from the settings and system the
- *  first time it runs, for all subsequent times it uses the initial cached
- *  details.
+ *  The dev node details come from the DobbyDevNodeRegistry, which only scans
+ *  the system again if the nodes have been added, removed or changed.
  *
  *  @param[in]  settings    The settings containing the list of dev nodes paths
- *                          or glob patterns.  Only used the first time called.
+ *                          or glob patterns.
  *  @param[in]  dictionary  The dictionary to add the details to.
  *
  */
 void DobbySpecConfig::addVpuDevNodes(const std::shared_ptr<const IDobbySettings::HardwareAccessSettings> &settings,
                                  ctemplate::TemplateDictionary *dictionary)
 {
-    // device nodes should be static, so get the details once and store for
-    // all subsequent calls
-    static std::mutex scanningLock;
-    static std::atomic<bool> scannedDevNodes(false);
-    static std::list<DobbyConfig::DevNode> devNodes;
-
-    if (!scannedDevNodes)
-    {
-        std::lock_guard<std::mutex> locker(scanningLock);
-
-        if (!scannedDevNodes)
-        {
-            devNodes = scanDevNodes(settings->deviceNodes);
-            scannedDevNodes = true;
-        }
-    }
+    // the registry only rescans if the dev nodes have changed
+    const DobbyDevNodeRegistry::DevNodeList devNodes =
+        DobbyDevNodeRegistry::devNodes(settings->deviceNodes);
 
     // add to the additional device node section
-    for (const DobbyConfig::DevNode &devNode : devNodes)
+    for (const DobbyConfig::DevNode &devNode : *devNodes)
     {
         ctemplate::TemplateDictionary *subDict = dictionary->AddSectionDictionary(ADDITIONAL_DEVICE_NODES);
         subDict->SetValue(DEVICE_PATH, devNode.path);
@@ -1982,26 +2404,41 @@ void DobbySpecConfig::storeMountPoint(const std::string &type,
                                   const std::string &destination)
 {
     MountPoint::Type mountType = MountPoint::Directory;
+    std::string bindSource;
 
     // most mount points are directories, but if bind mounting a file then the
     // mount point should be a file
     if ((type == "bind") || (type == "rbind"))
     {
-        struct stat buf;
-        if (stat(source.c_str(), &buf) != 0)
-        {
-            AI_LOG_SYS_WARN(errno, "failed to stat source of mount '%s'",
-                            source.c_str());
-        }
-        else
-        {
-            mountType = ((buf.st_mode & S_IFMT) == S_IFDIR) ?
-                        MountPoint::Directory : MountPoint::File;
-        }
+        mountType = bindMountPointType(source);
+        bindSource = source;
     }
 
     // store the mount point internally
     mMountPoints.emplace_back(MountPoint{ mountType, destination });
+    mBindMountSources.emplace_back(std::move(bindSource));
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the type of mount point needed to bind mount the source.
+ *
+ *  @param[in]  source      The mount source.
+ *
+ *  @return File if the source is a file, otherwise Directory.
+ */
+DobbySpecConfig::MountPoint::Type DobbySpecConfig::bindMountPointType(const std::string &source)
+{
+    struct stat buf;
+    if (stat(source.c_str(), &buf) != 0)
+    {
+        AI_LOG_SYS_WARN(errno, "failed to stat source of mount '%s'",
+                        source.c_str());
+        return MountPoint::Directory;
+    }
+
+    return ((buf.st_mode & S_IFMT) == S_IFDIR) ?
+           MountPoint::Directory : MountPoint::File;
 }
 
 // -----------------------------------------------------------------------------
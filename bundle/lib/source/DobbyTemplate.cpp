@@ -48,8 +48,8 @@
 
 
 
-DobbyTemplate* DobbyTemplate::mInstance = nullptr;
-pthread_rwlock_t DobbyTemplate::mInstanceLock = PTHREAD_RWLOCK_INITIALIZER;
+std::atomic<DobbyTemplate*> DobbyTemplate::mInstance(nullptr);
+std::mutex DobbyTemplate::mInstanceLock;
 
 DobbyTemplate::DobbyTemplate()
     : mTemplateKey("oci")
@@ -77,6 +77,10 @@ DobbyTemplate::DobbyTemplate()
     // set the template enable/disable for the cpu RT sched cgroups
     setTemplateCpuRtSched();
 
+    // publish the platform values so per-container dictionaries can be
+    // created even if setSettings() is never called (ie. the bundle tool)
+    freezePlatformDictionary();
+
     AI_LOG_FN_EXIT();
 }
 
@@ -89,43 +93,40 @@ DobbyTemplate::DobbyTemplate()
  */
 void DobbyTemplate::cleanUp()
 {
-    pthread_rwlock_wrlock(&mInstanceLock);
+    std::lock_guard<std::mutex> locker(mInstanceLock);
 
-    if (mInstance != nullptr)
+    DobbyTemplate* existing = mInstance.exchange(nullptr);
+    if (existing != nullptr)
     {
-        delete mInstance;
-        mInstance = nullptr;
+        delete existing;
     }
-
-    pthread_rwlock_unlock(&mInstanceLock);
 }
 
 // -----------------------------------------------------------------------------
 /**
  *  @brief Returns / creates singleton instance.
  *
- *
+ *  Once created the instance is returned without taking any locks, so
+ *  template expansions on different threads don't serialise on it.
  */
 DobbyTemplate* DobbyTemplate::instance()
 {
-    pthread_rwlock_rdlock(&mInstanceLock);
-
-    if (mInstance == nullptr)
+    DobbyTemplate* result = mInstance.load(std::memory_order_acquire);
+    if (result != nullptr)
     {
-        // Need to upgrade to a write lock and then check the instance again
-        // to be sure that someone else hasn't jumped in and allocated it
-        // while we were unlocked.
-        pthread_rwlock_unlock(&mInstanceLock);
-        pthread_rwlock_wrlock(&mInstanceLock);
-
-        if (mInstance == nullptr)
-        {
-            mInstance = new DobbyTemplate;
-        }
+        return result;
     }
 
-    DobbyTemplate* result = mInstance;
-    pthread_rwlock_unlock(&mInstanceLock);
+    // Slow path, take the lock and check the instance again to be sure that
+    // someone else hasn't jumped in and allocated it
+    std::lock_guard<std::mutex> locker(mInstanceLock);
+
+    result = mInstance.load(std::memory_order_relaxed);
+    if (result == nullptr)
+    {
+        result = new DobbyTemplate;
+        mInstance.store(result, std::memory_order_release);
+    }
 
     return result;
 }
@@ -163,6 +164,57 @@ void DobbyTemplate::_setSettings(const std::shared_ptr<const IDobbySettings>& se
 
         setTemplateEnvVars(mExtraEnvVars);
     }
+
+    // rebuild the frozen platform dictionary with the new values
+    freezePlatformDictionary();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Builds the immutable platform dictionary from the current platform
+ *  values and publishes it.
+ *
+ *  The old dictionary (if any) is only swapped out, dictionaries already
+ *  being copied on other threads keep their reference to it.
+ */
+void DobbyTemplate::freezePlatformDictionary()
+{
+    std::shared_ptr<ctemplate::TemplateDictionary> dictionary =
+        std::make_shared<ctemplate::TemplateDictionary>("platform");
+
+    for (const auto& value : mPlatformValues)
+        dictionary->SetValue(value.first, value.second);
+
+    std::lock_guard<std::mutex> locker(mPlatformLock);
+    mPlatformDictionary = std::move(dictionary);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Creates a new dictionary for a container.
+ *
+ *  The returned dictionary is a copy of the frozen platform dictionary, the
+ *  caller just needs to add the container specific values to it and is
+ *  responsible for deleting it.
+ *
+ *  @param[in]  name        The name of the dictionary.
+ *
+ *  @return a new dictionary object.
+ */
+ctemplate::TemplateDictionary* DobbyTemplate::newDictionary(const std::string& name)
+{
+    return instance()->_newDictionary(name);
+}
+
+ctemplate::TemplateDictionary* DobbyTemplate::_newDictionary(const std::string& name) const
+{
+    std::shared_ptr<ctemplate::TemplateDictionary> platform;
+    {
+        std::lock_guard<std::mutex> locker(mPlatformLock);
+        platform = mPlatformDictionary;
+    }
+
+    return platform->MakeCopy(name);
 }
 
 #if 0
@@ -343,10 +395,8 @@ void DobbyTemplate::setTemplateDevNodes(const std::list<std::string>& devNodes)
 
 
     // and finally set the global template value
-    ctemplate::TemplateDictionary::SetGlobalValue("GPU_DEV_NODES",
-                                                  devNodesString);
-    ctemplate::TemplateDictionary::SetGlobalValue("GPU_DEV_NODES_PERMS",
-                                                  devNodesPermString);
+    mPlatformValues["GPU_DEV_NODES"] = devNodesString;
+    mPlatformValues["GPU_DEV_NODES_PERMS"] = devNodesPermString;
 
 
     AI_LOG_FN_EXIT();
@@ -370,7 +420,7 @@ void DobbyTemplate::setTemplateEnvVars(const std::map<std::string, std::string>&
     }
 
     // assign the string to the template var
-    ctemplate::TemplateDictionary::SetGlobalValue("EXTRA_ENV_VARS", envVarsStream.str());
+    mPlatformValues["EXTRA_ENV_VARS"] = envVarsStream.str();
 }
 
 // -----------------------------------------------------------------------------
@@ -521,8 +571,8 @@ void DobbyTemplate::setTemplateCpuRtSched()
     }
 
     // update the template values
-    ctemplate::TemplateDictionary::SetGlobalValue("CPU_RT_RUNTIME", cpuRtRuntimeStr);
-    ctemplate::TemplateDictionary::SetGlobalValue("CPU_RT_PERIOD", cpuRtPeriodStr);
+    mPlatformValues["CPU_RT_RUNTIME"] = cpuRtRuntimeStr;
+    mPlatformValues["CPU_RT_PERIOD"] = cpuRtPeriodStr;
 
     AI_LOG_FN_EXIT();
 }
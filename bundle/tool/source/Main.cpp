@@ -41,6 +41,10 @@
 
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <vector>
+#include <numeric>
+#include <algorithm>
 
 #define DEFAULT_SETTINGS_PATH "/etc/dobby.json"
 
@@ -48,6 +52,7 @@
 static std::string inputPath;
 static std::string outputDirectory;
 static std::string settingsPath;
+static unsigned benchmarkIterations = 0;
 
 // -----------------------------------------------------------------------------
 /**
@@ -64,6 +69,10 @@ static void displayUsage()
     printf("  -s, --settings=PATH           Path to Dobby Settings file for STB \n");
     printf("  -i, --inputpath=PATH          Path to Dobby JSON Spec for container\n");
     printf("  -o, --outputDirectory=PATH    Where to save the generated OCI bundle\n");
+    printf("  -b, --benchmark=N             Time generating the container config N times\n");
+    printf("                                the same way the daemon does, and N times\n");
+    printf("                                with the old config.json round trips, the\n");
+    printf("                                output directory is used as a scratch bundle\n");
     printf("\n");
 }
 
@@ -80,13 +89,14 @@ static void parseArgs(const int argc, char **argv)
             {"settings", required_argument, nullptr, (int)'s'},
             {"inputpath", required_argument, nullptr, (int)'i'},
             {"outputDirectory", required_argument, nullptr, (int)'o'},
+            {"benchmark", required_argument, nullptr, (int)'b'},
             {nullptr, 0, nullptr, 0}};
 
     int opt;
     int index;
 
     // Read through all the options and set variables accordingly
-    while ((opt = getopt_long(argc, argv, "+hvVi:o:s:", longopts, &index)) != -1)
+    while ((opt = getopt_long(argc, argv, "+hvVi:o:s:b:", longopts, &index)) != -1)
     {
         switch (opt)
         {
@@ -106,6 +116,9 @@ static void parseArgs(const int argc, char **argv)
         case 's':
             settingsPath = reinterpret_cast<const char *>(optarg);
             break;
+        case 'b':
+            benchmarkIterations = static_cast<unsigned>(strtoul(optarg, nullptr, 0));
+            break;
         case '?':
             if (optopt == 'c')
                 fprintf(stderr, "Warning: Option -%c requires an argument.\n", optopt);
@@ -222,6 +235,126 @@ static bool generateOciBundle(std::shared_ptr<IDobbySettings> settings,
     return true;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ * @brief Repeats the config.json round trips the daemon used to make
+ *
+ * Before configs were built in memory the template was expanded into
+ * config.json, parsed back from the file, backed up to config-dobby.json and
+ * re-written by the compliance conversion, before the final write.
+ */
+static bool legacyFileRoundTrips(const std::shared_ptr<DobbySpecConfig>& config,
+                                 const std::string& bundlePath)
+{
+    const std::string configPath = bundlePath + "/config.json";
+
+    if (!config->writeConfigJson(configPath))
+        return false;
+
+    parser_error err = nullptr;
+    rt_dobby_schema *parsed = rt_dobby_schema_parse_file(configPath.c_str(), nullptr, &err);
+    if (parsed)
+        free_rt_dobby_schema(parsed);
+    if (err)
+        free(err);
+    if (!parsed)
+        return false;
+
+    std::ifstream srcCfg(configPath, std::ios::binary);
+    std::ofstream dstCfg(bundlePath + "/config-dobby.json", std::ios::binary);
+    dstCfg << srcCfg.rdbuf();
+
+    return config->writeConfigJson(configPath);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * @brief Prints the min/median/mean/max of a set of timings
+ */
+static void printTimings(const char *title, std::vector<double> &timings)
+{
+    if (timings.empty())
+        return;
+
+    std::sort(timings.begin(), timings.end());
+    const double total = std::accumulate(timings.begin(), timings.end(), 0.0);
+
+    printf("%s over %zu iterations (usecs):\n", title, timings.size());
+    printf("  min    %.1f\n", timings.front());
+    printf("  median %.1f\n", timings[timings.size() / 2]);
+    printf("  mean   %.1f\n", total / timings.size());
+    printf("  max    %.1f\n", timings.back());
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * @brief Times generating the container config from a spec
+ *
+ * Mirrors what the daemon does when starting a container from a spec, the
+ * config is built in a transient bundle and then written out as config.json.
+ * Each iteration uses a fresh bundle which is deleted afterwards.
+ *
+ * The iterations alternate with ones that also make the file round trips of
+ * the old file based path, so a single run gives both the before and after
+ * numbers on the same device and storage.
+ */
+static bool benchmarkConfigGeneration(std::shared_ptr<IDobbySettings> settings,
+                                      std::shared_ptr<IDobbyUtils> utils,
+                                      std::string specPath,
+                                      std::string bundlePath,
+                                      unsigned iterations)
+{
+    auto jsonSpec = readSpecFromFile(specPath);
+    if (jsonSpec.empty())
+    {
+        AI_LOG_ERROR("Failed to load spec from path %s", specPath.c_str());
+        return false;
+    }
+
+    const ContainerId id = ContainerId::create("benchmark");
+
+    std::vector<double> inMemoryTimings;
+    std::vector<double> viaFileTimings;
+    inMemoryTimings.reserve(iterations);
+    viaFileTimings.reserve(iterations);
+
+    for (unsigned i = 0; i < (iterations * 2); i++)
+    {
+        const bool viaFile = (i % 2) != 0;
+
+        auto bundle = std::make_shared<DobbyBundle>(utils, bundlePath, false);
+        if (!bundle || !bundle->isValid())
+        {
+            AI_LOG_ERROR("Failed to create bundle directory %s", bundlePath.c_str());
+            return false;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        auto config = std::make_shared<DobbySpecConfig>(utils, settings, id, bundle, jsonSpec);
+        if (!config->isValid() ||
+            (viaFile && !legacyFileRoundTrips(config, bundle->path())) ||
+            !config->writeConfigJson(bundle->path() + "/config.json"))
+        {
+            AI_LOG_ERROR("Failed to generate config from spec");
+            return false;
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+        const double usecs = std::chrono::duration<double, std::micro>(end - start).count();
+
+        if (viaFile)
+            viaFileTimings.push_back(usecs);
+        else
+            inMemoryTimings.push_back(usecs);
+    }
+
+    printTimings("config generation in memory", inMemoryTimings);
+    printTimings("config generation via config.json", viaFileTimings);
+
+    return true;
+}
+
 // -----------------------------------------------------------------------------
 /**
  * @brief Entrypoint
@@ -277,7 +410,15 @@ int main(int argc, char *argv[])
         auto utils = std::make_shared<DobbyUtils>();
 
         // Now we can do some actual work
-        generateOciBundle(settings, utils, inputPath, outputDirectory);
+        if (benchmarkIterations > 0)
+        {
+            benchmarkConfigGeneration(settings, utils, inputPath, outputDirectory,
+                                      benchmarkIterations);
+        }
+        else
+        {
+            generateOciBundle(settings, utils, inputPath, outputDirectory);
+        }
 
         // And we're done
         AICommon::termLogging();
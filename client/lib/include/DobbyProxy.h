@@ -132,6 +132,8 @@ public:
 
     std::list<std::pair<int32_t, std::string>> listContainers() const override;
 
+    std::string getPluginMetrics() const override;
+
 #if (AI_BUILD_TYPE == AI_DEBUG)
 
 public:
@@ -157,6 +159,7 @@ private:
     void onContainerStoppedEvent(const AI_IPC::VariantList& args);
     void onContainerHibernatedEvent(const AI_IPC::VariantList& args);
     void onContainerAwokenEvent(const AI_IPC::VariantList& args);
+    void onContainerOOMEvent(const AI_IPC::VariantList& args);
 
 private:
     bool invokeMethod(const char *interface_, const char *method_,
@@ -173,6 +176,7 @@ private:
 private:
     std::string mContainerStartedSignal;
     std::string mContainerStoppedSignal;
+    std::string mContainerOOMSignal;
 
 private:
     std::thread mStateChangeThread;
@@ -181,7 +185,7 @@ private:
 
     struct StateChangeEvent
     {
-        enum Type { Terminate, ContainerStarted, ContainerStopped, ContainerHibernated, ContainerAwoken };
+        enum Type { Terminate, ContainerStarted, ContainerStopped, ContainerHibernated, ContainerAwoken, ContainerOOM };
 
         explicit StateChangeEvent(Type type_)
             : type(type_), descriptor(-1)
@@ -101,6 +101,10 @@ DobbyProxy::DobbyProxy(const std::shared_ptr<AI_IPC::IIpcService>& ipcService,
     const AI_IPC::SignalHandler awokenHandler(std::bind(&DobbyProxy::onContainerAwokenEvent, this, std::placeholders::_1));
     mContainerStartedSignal = mIpcService->registerSignalHandler(awokenSignal, awokenHandler);
 
+    const AI_IPC::Signal oomSignal(objectName, DOBBY_CTRL_INTERFACE, DOBBY_CTRL_EVENT_OOM);
+    const AI_IPC::SignalHandler oomHandler(std::bind(&DobbyProxy::onContainerOOMEvent, this, std::placeholders::_1));
+    mContainerOOMSignal = mIpcService->registerSignalHandler(oomSignal, oomHandler);
+
     if (mContainerStartedSignal.empty() || mContainerStoppedSignal.empty())
     {
         AI_LOG_ERROR("failed to register dbus signal listeners");
@@ -127,6 +131,9 @@ DobbyProxy::~DobbyProxy()
     if (!mContainerStoppedSignal.empty())
         mIpcService->unregisterHandler(mContainerStoppedSignal);
 
+    if (!mContainerOOMSignal.empty())
+        mIpcService->unregisterHandler(mContainerOOMSignal);
+
     // flush the ipc service to guarantee the signal handlers aren't going to
     // be called after we're done
     mIpcService->flush();
@@ -332,6 +339,47 @@ void DobbyProxy::onContainerAwokenEvent(const AI_IPC::VariantList& args)
     AI_LOG_FN_EXIT();
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Called when a org.rdk.dobby.ctrl1.ContainerOOM event is received
+ *  from the Dobby 'hypervisor' daemon
+ *
+ *  The event is sent when a process in the container is killed by the OOM
+ *  killer, it's passed on to the listeners as the OomKilled state.  The
+ *  container may still be running, if it was its init that was killed the
+ *  stopped event will follow.
+ *
+ *  @param[in]  args        The args sent with the event.
+ */
+void DobbyProxy::onContainerOOMEvent(const AI_IPC::VariantList& args)
+{
+    AI_LOG_FN_ENTRY();
+
+    // the event should contain three args; container descriptor, id and the
+    // pid of the killed process (or -1 if the daemon couldn't tell)
+    int32_t descriptor;
+    std::string id;
+    int32_t victim;
+
+    if (!AI_IPC::parseVariantList<int32_t, std::string, int32_t>(args, &descriptor, &id, &victim))
+    {
+        AI_LOG_ERROR("failed to read all args from %s.%s signal",
+                     DOBBY_CTRL_INTERFACE, DOBBY_CTRL_EVENT_OOM);
+    }
+    else
+    {
+        AI_LOG_INFO("container '%s' (%d) had pid %d OOM killed",
+                    id.c_str(), descriptor, victim);
+
+        // ping off an event
+        std::lock_guard<std::mutex> locker(mStateChangeLock);
+        mStateChangeQueue.emplace_back(StateChangeEvent::ContainerOOM, descriptor, id);
+        mStateChangeCond.notify_all();
+    }
+
+    AI_LOG_FN_EXIT();
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Invokes a dbus method on the daemon.
@@ -1251,6 +1299,52 @@ std::list<std::pair<int32_t, std::string>> DobbyProxy::listContainers() const
     return result;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the timing metrics for the plugin hooks run by the daemon
+ *
+ *  The returned string is a json object with an entry per plugin and hook
+ *  name, something like the following
+ *
+ *      {
+ *          "networking":{
+ *              "createRuntime":{
+ *                  "count":12,
+ *                  "failures":0,
+ *                  "total_us":183012,
+ *                  "max_us":40211,
+ *                  "histogram":[ { "le_ms":1, "count":0 }, ... ]
+ *              },
+ *              ...
+ *          },
+ *          ...
+ *      }
+ *
+ *  @return the json string on success, on failure an empty string.
+ */
+std::string DobbyProxy::getPluginMetrics() const
+{
+    AI_LOG_FN_ENTRY();
+
+    // send off the request
+    AI_IPC::VariantList returns;
+
+    std::string result;
+
+    if (invokeMethod(DOBBY_DEBUG_INTERFACE,
+                     DOBBY_DEBUG_METHOD_GET_PLUGIN_METRICS,
+                     { }, returns))
+    {
+        if (!AI_IPC::parseVariantList<std::string>(returns, &result))
+        {
+            result.clear();
+        }
+    }
+
+    AI_LOG_FN_EXIT();
+    return result;
+}
+
 #if (AI_BUILD_TYPE == AI_DEBUG)
 // -----------------------------------------------------------------------------
 /**
@@ -1492,6 +1586,10 @@ void DobbyProxy::containerStateChangeThread()
                 {
                     state = IDobbyProxyEvents::ContainerState::Hibernated;
                 }
+                else if (event.type == StateChangeEvent::ContainerOOM)
+                {
+                    state = IDobbyProxyEvents::ContainerState::OomKilled;
+                }
 
                 // fire off via the notifier system first (deprecated but
                 // required for backwards compatibility)
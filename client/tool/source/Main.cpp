@@ -965,6 +965,34 @@ static void infoCommand(const std::shared_ptr<IDobbyProxy>& dobbyProxy,
     }
 }
 
+// -----------------------------------------------------------------------------
+/**
+ * @brief Prints the timing metrics for the plugin hooks run by the daemon
+ *
+ * The metrics are printed as the json returned by the daemon's
+ * GetPluginMetrics debug method.
+ *
+ * @param[in]   dobbyProxy  The proxy used to query the daemon.
+ * @param[in]   readLine    The context the output is printed to.
+ * @param[in]   args        Unused, the command takes no arguments.
+ */
+static void pluginMetricsCommand(const std::shared_ptr<IDobbyProxy>& dobbyProxy,
+                                 const std::shared_ptr<const IReadLineContext>& readLine,
+                                 const std::vector<std::string>& args)
+{
+    (void) args;
+
+    const std::string metrics = dobbyProxy->getPluginMetrics();
+    if (metrics.empty())
+    {
+        readLine->printLnError("failed to get plugin metrics");
+    }
+    else
+    {
+        readLine->printLn("%s", metrics.c_str());
+    }
+}
+
 
 // -----------------------------------------------------------------------------
 /**
@@ -1419,6 +1447,12 @@ static void initCommands(const std::shared_ptr<IReadLine>& readLine,
                          "Gets the json stats for the given container\n",
                          "\n");
 
+    readLine->addCommand("plugin-metrics",
+                         std::bind(pluginMetricsCommand, dobbyProxy, std::placeholders::_1, std::placeholders::_2),
+                         "plugin-metrics",
+                         "Gets the json timing metrics for the plugin hooks run by the daemon\n",
+                         "\n");
+
     readLine->addCommand("wait",
                          std::bind(waitCommand, dobbyProxy, std::placeholders::_1, std::placeholders::_2),
                          "wait <id> <state>",
@@ -107,6 +107,8 @@ private:
     DOBBY_DBUS_METHOD(getOCIConfig);
 #endif //(AI_BUILD_TYPE == AI_DEBUG)
 
+    DOBBY_DBUS_METHOD(getPluginMetrics);
+
 #if defined(AI_ENABLE_TRACING)
     DOBBY_DBUS_METHOD(startInProcessTracing);
     DOBBY_DBUS_METHOD(stopInProcessTracing);
@@ -131,6 +133,7 @@ private:
     void onContainerStopped(int32_t cd, const ContainerId& id, int status);
     void onContainerHibernated(int32_t cd, const ContainerId& id);
     void onContainerAwoken(int32_t cd, const ContainerId& id);
+    void onContainerOOM(int32_t cd, const ContainerId& id, pid_t victim);
 
 private:
     void runWorkQueue() const;
@@ -29,6 +29,7 @@
 #include "DobbyUtils.h"
 #include "DobbyIPCUtils.h"
 #include "DobbyWorkQueue.h"
+#include "DobbyPluginMetrics.h"
 
 #if defined(LEGACY_COMPONENTS)
 #  include "DobbyTemplate.h"
@@ -55,6 +56,12 @@
     #include "breakpad_wrapper.h"
 #endif
 
+#if defined(RDK)
+#  include <json/json.h>
+#else
+#  include <jsoncpp/json.h>
+#endif
+
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -117,10 +124,21 @@ Dobby::Dobby(const std::string& dbusAddress,
         std::bind(&Dobby::onContainerAwoken, this,
                   std::placeholders::_1, std::placeholders::_2);
 
+    DobbyManager::ContainerOomFunc oomCb =
+        std::bind(&Dobby::onContainerOOM, this,
+                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+
+    // crash restarts are run on the work queue alongside the API calls
+    DobbyManager::PostWorkFunc postWorkCb =
+        [this](std::function<void()> &&work)
+        {
+            return mWorkQueue->postWork(std::move(work));
+        };
 
     // create the container manager which does all the heavy lifting
     mManager = std::make_shared<DobbyManager>(mEnvironment, mUtilities,
-                            mIPCUtilities, settings, startedCb, stoppedCb, hibernatedCb, awokenCb);
+                            mIPCUtilities, settings, startedCb, stoppedCb, hibernatedCb, awokenCb, oomCb,
+                            postWorkCb);
     if (!mManager)
     {
         AI_LOG_FATAL("failed to create manager");
@@ -667,6 +685,8 @@ void Dobby::initIpcMethods()
         {   DOBBY_DEBUG_INTERFACE,       DOBBY_DEBUG_METHOD_GET_OCI_CONFIG,         &Dobby::getOCIConfig           },
 #endif // (AI_BUILD_TYPE == AI_DEBUG)
 
+        {   DOBBY_DEBUG_INTERFACE,       DOBBY_DEBUG_METHOD_GET_PLUGIN_METRICS,     &Dobby::getPluginMetrics       },
+
 #if defined(AI_ENABLE_TRACING)
         {   DOBBY_DEBUG_INTERFACE,       DOBBY_DEBUG_START_INPROCESS_TRACING,       &Dobby::startInProcessTracing  },
         {   DOBBY_DEBUG_INTERFACE,       DOBBY_DEBUG_STOP_INPROCESS_TRACING,        &Dobby::stopInProcessTracing   },
@@ -2139,6 +2159,84 @@ void Dobby::getOCIConfig(std::shared_ptr<AI_IPC::IAsyncReplySender> replySender)
 }
 #endif // (AI_BUILD_TYPE == AI_DEBUG)
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the timing metrics for the plugin hooks run by the daemon
+ *  and the hook server.
+ *
+ *  The reply is a json formatted string with an entry per plugin, each
+ *  containing an entry per hook with the number of runs and failures, the
+ *  total and max time in microseconds and a histogram of the run times.
+ *
+ *  Hooks run by DobbyPluginLauncher processes rather than the hook server
+ *  (because it's disabled, not running or the hook runs inside the
+ *  container's namespaces) aren't included.
+ */
+void Dobby::getPluginMetrics(std::shared_ptr<AI_IPC::IAsyncReplySender> replySender)
+{
+    AI_LOG_FN_ENTRY();
+
+    // Expecting no arguments
+
+    AI_LOG_INFO(DOBBY_DEBUG_METHOD_GET_PLUGIN_METRICS "()");
+
+    // Queue the work as asking the hook server for its metrics may block
+    auto doGetMetricsLambda =
+        [manager = mManager, replySender]()
+        {
+            Json::Value metrics(Json::objectValue);
+            for (const auto &entry : manager->pluginMetrics())
+            {
+                const DobbyPluginMetrics::HookStats &stats = entry.second;
+
+                Json::Value buckets(Json::arrayValue);
+                for (size_t i = 0; i < stats.buckets.size(); i++)
+                {
+                    Json::Value bucket;
+                    if (i < DobbyPluginMetrics::BUCKET_LIMITS_MS.size())
+                        bucket["le_ms"] = DobbyPluginMetrics::BUCKET_LIMITS_MS[i];
+                    else
+                        bucket["le_ms"] = "inf";
+                    bucket["count"] = Json::UInt64(stats.buckets[i]);
+                    buckets.append(bucket);
+                }
+
+                Json::Value hook;
+                hook["count"] = Json::UInt64(stats.count);
+                hook["failures"] = Json::UInt64(stats.failures);
+                hook["total_us"] = Json::Int64(stats.total.count());
+                hook["max_us"] = Json::Int64(stats.max.count());
+                hook["histogram"] = std::move(buckets);
+
+                metrics[entry.first.first][entry.first.second] = std::move(hook);
+            }
+
+            Json::StreamWriterBuilder builder;
+            builder["indentation"] = "";
+
+            // Fire off the reply
+            if (!replySender->sendReply({ Json::writeString(builder, metrics) }))
+            {
+                AI_LOG_ERROR("failed to send reply");
+            }
+        };
+
+    // Queue the work, if successful then we're done
+    if (mWorkQueue->postWork(std::move(doGetMetricsLambda)))
+    {
+        AI_LOG_FN_EXIT();
+        return;
+    }
+
+    // Fire off an error reply
+    if (!replySender->sendReply({ std::string() }))
+    {
+        AI_LOG_ERROR("failed to send reply");
+    }
+
+    AI_LOG_FN_EXIT();
+}
+
 #if defined(AI_ENABLE_TRACING)
 // -----------------------------------------------------------------------------
 /**
@@ -2340,6 +2438,41 @@ void Dobby::onContainerAwoken(int32_t cd, const ContainerId& id)
     AI_LOG_FN_EXIT();
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Called by the DobbyManager code when a process in a container has
+ *  been killed by the OOM killer
+ *
+ *  This is sent at the time of the kill, the container may still be running
+ *  and will only send the stopped signals if its init was the victim.
+ *
+ *  This is called from the cgroup monitor thread in the DobbyManager so be
+ *  careful of any threading issues.
+ *
+ *  @param[in]  cd          The container unique descriptor.
+ *  @param[in]  id          The string id / name of the container.
+ *  @param[in]  victim      The host pid of the killed process, or -1 if it
+ *                          couldn't be determined.
+ */
+void Dobby::onContainerOOM(int32_t cd, const ContainerId& id, pid_t victim)
+{
+    AI_LOG_FN_ENTRY();
+
+    if (!mIpcService->emitSignal(AI_IPC::Signal(mObjectPath,
+                                                DOBBY_CTRL_INTERFACE,
+                                                DOBBY_CTRL_EVENT_OOM),
+                                 { cd, id.str(), int32_t(victim) }))
+    {
+        AI_LOG_ERROR("failed to emit '%s' signal",
+                     DOBBY_CTRL_EVENT_OOM);
+    }
+
+    AI_LOG_MILESTONE("container '%s'(%d) OOM killed pid %d", id.c_str(), cd,
+                     victim);
+
+    AI_LOG_FN_EXIT();
+}
+
 #if defined(RDK) && defined(USE_SYSTEMD)
 #define WATCHDOG_TIMEOUT_SEC 10L
 #define WATCHDOG_UPDATE_SEC  (WATCHDOG_TIMEOUT_SEC/2)
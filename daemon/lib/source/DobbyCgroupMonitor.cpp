@@ -0,0 +1,844 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyCgroupMonitor.cpp
+ *
+ */
+#include "DobbyCgroupMonitor.h"
+
+#include <Logging.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+
+#include <list>
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class DobbyCgroupMonitor::InotifySource
+ *  @brief Poll source wrapper that forwards inotify fd events back to the
+ *  monitor.
+ *
+ *  The poll loop holds the source by shared_ptr, this wrapper avoids having
+ *  to make the monitor itself shared.
+ */
+class DobbyCgroupMonitor::InotifySource : public AICommon::IPollSource
+{
+public:
+    explicit InotifySource(DobbyCgroupMonitor *monitor)
+        : mMonitor(monitor)
+    { }
+
+    void process(const std::shared_ptr<AICommon::IPollLoop> &pollLoop,
+                 epoll_event event) override
+    {
+        if (event.events & EPOLLIN)
+            mMonitor->onInotifyEvents();
+    }
+
+private:
+    DobbyCgroupMonitor * const mMonitor;
+};
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class DobbyCgroupMonitor::OomEventSource
+ *  @brief Poll source wrapper for a cgroup v1 OOM eventfd.
+ *
+ *  The poll loop merges events per source object, so each eventfd needs its
+ *  own source.
+ */
+class DobbyCgroupMonitor::OomEventSource : public AICommon::IPollSource
+{
+public:
+    OomEventSource(DobbyCgroupMonitor *monitor, int eventFd)
+        : mMonitor(monitor)
+        , mEventFd(eventFd)
+    { }
+
+    void process(const std::shared_ptr<AICommon::IPollLoop> &pollLoop,
+                 epoll_event event) override
+    {
+        if (event.events & EPOLLIN)
+            mMonitor->onOomEventFd(mEventFd);
+    }
+
+private:
+    DobbyCgroupMonitor * const mMonitor;
+    const int mEventFd;
+};
+
+
+DobbyCgroupMonitor::DobbyCgroupMonitor(const std::shared_ptr<IDobbyEnv> &env,
+                                       const ContainerEmptyFunc &containerEmptyCb,
+                                       const ContainerOomFunc &containerOomCb)
+    : mContainerEmptyCb(containerEmptyCb)
+    , mContainerOomCb(containerOomCb)
+    , mCgroupVersion(env->cgroupVersion())
+    , mCgroupMountPath(env->cgroupMountPath(IDobbyEnv::Cgroup::Memory))
+    , mInotifyFd(-1)
+{
+    AI_LOG_FN_ENTRY();
+
+    if (mCgroupMountPath.empty())
+    {
+        AI_LOG_WARN("no memory cgroup mount, container cgroup events won't be monitored");
+        AI_LOG_FN_EXIT();
+        return;
+    }
+
+    mPollLoop = std::make_shared<AICommon::PollLoop>("DobbyCgroupMon");
+
+    if (mCgroupVersion == IDobbyEnv::CgroupVersion::V2)
+    {
+        mInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (mInotifyFd < 0)
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to create inotify fd");
+            mPollLoop.reset();
+            AI_LOG_FN_EXIT();
+            return;
+        }
+
+        mInotifySource = std::make_shared<InotifySource>(this);
+        if (!mPollLoop->addSource(mInotifySource, mInotifyFd, EPOLLIN))
+        {
+            AI_LOG_ERROR("failed to add inotify source to the poll loop");
+            mPollLoop.reset();
+        }
+    }
+
+    if (mPollLoop && !mPollLoop->start())
+    {
+        AI_LOG_ERROR("failed to start the cgroup monitor poll loop");
+        mPollLoop.reset();
+    }
+
+    if (!mPollLoop && (mInotifyFd >= 0))
+    {
+        close(mInotifyFd);
+        mInotifyFd = -1;
+    }
+
+    AI_LOG_FN_EXIT();
+}
+
+DobbyCgroupMonitor::~DobbyCgroupMonitor()
+{
+    stop();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Stops the monitor, after this no more callbacks will be made and
+ *  add / remove calls are no-ops.
+ *
+ *  Called by the manager on shutdown so that container teardown can be done
+ *  synchronously without racing against cgroup events.
+ */
+void DobbyCgroupMonitor::stop()
+{
+    AI_LOG_FN_ENTRY();
+
+    // stop the poll loop first so we're not called back while tearing down
+    std::shared_ptr<AICommon::PollLoop> pollLoop;
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+        pollLoop.swap(mPollLoop);
+    }
+
+    if (pollLoop)
+        pollLoop->stop();
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    // closing the inotify fd also removes all the watches
+    if ((mInotifyFd >= 0) && (close(mInotifyFd) != 0))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to close inotify fd");
+    }
+
+    mInotifyFd = -1;
+    mWatches.clear();
+
+    // closing the eventfds unregisters them from the v1 memory cgroups
+    for (const auto &entry : mOomEventFds)
+    {
+        if (close(entry.first) != 0)
+            AI_LOG_SYS_ERROR(errno, "failed to close oom eventfd");
+    }
+
+    mOomEventFds.clear();
+
+    AI_LOG_FN_EXIT();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Starts watching the cgroup files of the given container.
+ *
+ *  On cgroups v2 watches are added for cgroup.events and memory.events; if
+ *  the container's cgroup is already empty then no watch is added, the
+ *  container will be cleaned up by the normal SIGCHLD path.  On cgroups v1
+ *  only an OOM eventfd is registered.
+ *
+ *  Any existing watches for the container are replaced.
+ *
+ *  @param[in]  id      The id of the container to watch.
+ *
+ *  @return true if a watch was added, otherwise false.
+ */
+bool DobbyCgroupMonitor::addContainer(const ContainerId &id)
+{
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+        if (!mPollLoop)
+            return false;
+    }
+
+    // drop any stale watches for the same container
+    removeContainer(id);
+
+    if (mCgroupVersion == IDobbyEnv::CgroupVersion::V2)
+        return addCgroupV2Watches(id);
+    else
+        return addCgroupV1OomWatch(id);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Adds the inotify watches on the container's cgroup.events and
+ *  memory.events files.
+ *
+ *  @param[in]  id      The id of the container to watch.
+ *
+ *  @return true if the exit watch was added, otherwise false.
+ */
+bool DobbyCgroupMonitor::addCgroupV2Watches(const ContainerId &id)
+{
+    const std::string cgroupDir = findCgroupDir(mCgroupMountPath, id);
+    if (cgroupDir.empty())
+    {
+        AI_LOG_WARN("failed to find the cgroup dir for container '%s'",
+                    id.c_str());
+        return false;
+    }
+
+    std::string eventsFilePath = cgroupDir + "/cgroup.events";
+    std::string memEventsFilePath = cgroupDir + "/memory.events";
+
+    // get the starting value before taking the lock
+    unsigned long oomKills = 0;
+    readOomKillCount(memEventsFilePath, &oomKills);
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (mInotifyFd < 0)
+        return false;
+
+    int wd = inotify_add_watch(mInotifyFd, eventsFilePath.c_str(), IN_MODIFY);
+    if (wd < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to add inotify watch on '%s'",
+                         eventsFilePath.c_str());
+        return false;
+    }
+
+    // check we haven't missed the transition before the watch was added
+    if (!isPopulated(eventsFilePath))
+    {
+        AI_LOG_INFO("cgroup for container '%s' is already empty", id.c_str());
+        inotify_rm_watch(mInotifyFd, wd);
+        return false;
+    }
+
+    mWatches[wd] = Watch{ id, WatchType::CgroupEvents, cgroupDir,
+                          std::move(eventsFilePath), 0 };
+
+    // the memory controller may not be enabled for the container, in which
+    // case we just don't get OOM notifications
+    int memWd = inotify_add_watch(mInotifyFd, memEventsFilePath.c_str(), IN_MODIFY);
+    if (memWd < 0)
+    {
+        AI_LOG_WARN("failed to add inotify watch on '%s' (%d - %s)",
+                    memEventsFilePath.c_str(), errno, strerror(errno));
+    }
+    else
+    {
+        mWatches[memWd] = Watch{ id, WatchType::MemoryEvents, cgroupDir,
+                                 std::move(memEventsFilePath), oomKills };
+    }
+
+    AI_LOG_DEBUG("watching cgroup events for container '%s' (wd %d)",
+                 id.c_str(), wd);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Registers an eventfd against the container's v1 memory.oom_control
+ *  file.
+ *
+ *  This is the standard v1 notification API, writing
+ *  "<event_fd> <fd of memory.oom_control>" to cgroup.event_control.  The
+ *  eventfd is signalled when the cgroup hits an OOM and when the cgroup is
+ *  removed.
+ *
+ *  @param[in]  id      The id of the container to watch.
+ *
+ *  @return true if the eventfd was registered, otherwise false.
+ */
+bool DobbyCgroupMonitor::addCgroupV1OomWatch(const ContainerId &id)
+{
+    const std::string cgroupDir = findCgroupDir(mCgroupMountPath, id);
+    if (cgroupDir.empty())
+    {
+        AI_LOG_WARN("failed to find the memory cgroup dir for container '%s'",
+                    id.c_str());
+        return false;
+    }
+
+    const std::string oomControlPath = cgroupDir + "/memory.oom_control";
+    int oomControlFd = open(oomControlPath.c_str(), O_CLOEXEC | O_RDONLY);
+    if (oomControlFd < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to open '%s'", oomControlPath.c_str());
+        return false;
+    }
+
+    int eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (eventFd < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to create oom eventfd");
+        close(oomControlFd);
+        return false;
+    }
+
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%d %d", eventFd, oomControlFd);
+
+    const std::string eventControlPath = cgroupDir + "/cgroup.event_control";
+    int eventControlFd = open(eventControlPath.c_str(), O_CLOEXEC | O_WRONLY);
+    if ((eventControlFd < 0) ||
+        (TEMP_FAILURE_RETRY(write(eventControlFd, buf, len)) != len))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to register oom eventfd with '%s'",
+                         eventControlPath.c_str());
+        if (eventControlFd >= 0)
+            close(eventControlFd);
+        close(oomControlFd);
+        close(eventFd);
+        return false;
+    }
+
+    // the registration holds its own reference to the oom_control file
+    close(eventControlFd);
+    close(oomControlFd);
+
+    unsigned long oomKills = 0;
+    readOomKillCount(oomControlPath, &oomKills);
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    std::shared_ptr<OomEventSource> source =
+        std::make_shared<OomEventSource>(this, eventFd);
+
+    if (!mPollLoop || !mPollLoop->addSource(source, eventFd, EPOLLIN))
+    {
+        AI_LOG_ERROR("failed to add oom eventfd to the poll loop");
+        close(eventFd);
+        return false;
+    }
+
+    mOomEventFds[eventFd] = OomEventFd{ id, cgroupDir, oomKills, source };
+
+    AI_LOG_DEBUG("watching oom events for container '%s' (fd %d)",
+                 id.c_str(), eventFd);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Stops watching the cgroup files of the given container.
+ *
+ *  It's safe to call this for containers that aren't being watched.
+ *
+ *  @param[in]  id      The id of the container to stop watching.
+ */
+void DobbyCgroupMonitor::removeContainer(const ContainerId &id)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    auto it = mWatches.begin();
+    while (it != mWatches.end())
+    {
+        if (it->second.id == id)
+        {
+            // the watch may have already been removed by the kernel if the
+            // cgroup was deleted, so ignore any error
+            if (mInotifyFd >= 0)
+                inotify_rm_watch(mInotifyFd, it->first);
+            it = mWatches.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    auto jt = mOomEventFds.begin();
+    while (jt != mOomEventFds.end())
+    {
+        if (jt->second.id == id)
+        {
+            if (mPollLoop)
+                mPollLoop->delSource(jt->second.source, jt->first);
+            close(jt->first);
+            jt = mOomEventFds.erase(jt);
+        }
+        else
+        {
+            ++jt;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Called on the poll loop thread when the inotify fd is readable.
+ *
+ *  Reads all the queued events.  For modified cgroup.events files checks if
+ *  the container's cgroup has become empty, for modified memory.events files
+ *  checks if the oom_kill count has gone up.  The callbacks are called
+ *  without the lock held, so they're free to call back into this object.
+ */
+void DobbyCgroupMonitor::onInotifyEvents()
+{
+    std::list<ContainerId> emptyContainers;
+    std::list<OomEvent> oomEvents;
+
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+
+        if (mInotifyFd < 0)
+            return;
+
+        alignas(struct inotify_event) char buf[4096];
+
+        ssize_t len;
+        while ((len = TEMP_FAILURE_RETRY(read(mInotifyFd, buf, sizeof(buf)))) > 0)
+        {
+            const char *ptr = buf;
+            while (ptr < (buf + len))
+            {
+                const struct inotify_event *event =
+                    reinterpret_cast<const struct inotify_event*>(ptr);
+                ptr += sizeof(struct inotify_event) + event->len;
+
+                auto it = mWatches.find(event->wd);
+                if (it == mWatches.end())
+                    continue;
+
+                Watch &watch = it->second;
+
+                if (event->mask & IN_IGNORED)
+                {
+                    // the cgroup has been removed, the kernel has already
+                    // dropped the watch
+                    mWatches.erase(it);
+                }
+                else if (!(event->mask & IN_MODIFY))
+                {
+                    continue;
+                }
+                else if (watch.type == WatchType::MemoryEvents)
+                {
+                    // memory.events is also bumped on hitting the 'high'
+                    // and 'max' limits, so only the oom_kill count going up
+                    // means a process was killed
+                    unsigned long oomKills;
+                    if (readOomKillCount(watch.filePath, &oomKills) &&
+                        (oomKills > watch.oomKills))
+                    {
+                        pid_t victim = findOomVictim(watch.cgroupDir,
+                                                     oomKills - watch.oomKills);
+
+                        AI_LOG_WARN("OOM kill in container '%s' (victim pid %d, "
+                                    "oom_kill = %lu)", watch.id.c_str(), victim,
+                                    oomKills);
+
+                        oomEvents.push_back(OomEvent{ watch.id, victim });
+                        watch.oomKills = oomKills;
+                    }
+                }
+                else if (!isPopulated(watch.filePath))
+                {
+                    AI_LOG_INFO("cgroup for container '%s' is no longer populated",
+                                watch.id.c_str());
+
+                    const ContainerId id = watch.id;
+                    emptyContainers.push_back(id);
+
+                    // the container is gone, so drop all its watches
+                    auto jt = mWatches.begin();
+                    while (jt != mWatches.end())
+                    {
+                        if (jt->second.id == id)
+                        {
+                            inotify_rm_watch(mInotifyFd, jt->first);
+                            jt = mWatches.erase(jt);
+                        }
+                        else
+                        {
+                            ++jt;
+                        }
+                    }
+                }
+            }
+        }
+
+        if ((len < 0) && (errno != EAGAIN))
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to read inotify events");
+        }
+    }
+
+    notifyContainers(emptyContainers, oomEvents);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Called on the poll loop thread when a cgroup v1 OOM eventfd is
+ *  readable.
+ *
+ *  The eventfd is also signalled when the cgroup is removed, in which case
+ *  memory.oom_control can no longer be read and the eventfd is dropped.  On
+ *  kernels that report an 'oom_kill' count in memory.oom_control the event is
+ *  only reported if the count has gone up, so OOMs handled without a kill
+ *  (i.e. with oom_kill_disable set) are ignored.
+ *
+ *  @param[in]  eventFd     The eventfd that was signalled.
+ */
+void DobbyCgroupMonitor::onOomEventFd(int eventFd)
+{
+    std::list<OomEvent> oomEvents;
+
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+
+        auto it = mOomEventFds.find(eventFd);
+        if (it == mOomEventFds.end())
+            return;
+
+        uint64_t counter;
+        if (TEMP_FAILURE_RETRY(read(eventFd, &counter, sizeof(counter))) != sizeof(counter))
+        {
+            if (errno != EAGAIN)
+                AI_LOG_SYS_ERROR(errno, "failed to read oom eventfd");
+            return;
+        }
+
+        OomEventFd &entry = it->second;
+        const std::string oomControlPath = entry.cgroupDir + "/memory.oom_control";
+
+        struct stat details;
+        if (stat(oomControlPath.c_str(), &details) != 0)
+        {
+            AI_LOG_DEBUG("memory cgroup for container '%s' has been removed",
+                         entry.id.c_str());
+
+            if (mPollLoop)
+                mPollLoop->delSource(entry.source, eventFd);
+            close(eventFd);
+            mOomEventFds.erase(it);
+            return;
+        }
+
+        // without an oom_kill count we can't tell how many processes were
+        // killed, if any, so don't guess at a victim
+        pid_t victim = -1;
+
+        unsigned long oomKills;
+        if (readOomKillCount(oomControlPath, &oomKills))
+        {
+            if (oomKills <= entry.oomKills)
+                return;
+
+            victim = findOomVictim(entry.cgroupDir, oomKills - entry.oomKills);
+            entry.oomKills = oomKills;
+        }
+
+        AI_LOG_WARN("OOM in container '%s' (victim pid %d)",
+                    entry.id.c_str(), victim);
+
+        oomEvents.push_back(OomEvent{ entry.id, victim });
+    }
+
+    notifyContainers({ }, oomEvents);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Calls the registered callbacks, must be called without the lock
+ *  held.
+ *
+ *  OOM events are reported first, as they'll have happened before the
+ *  container exited.
+ *
+ *  @param[in]  emptyContainers     The containers whose cgroup is now empty.
+ *  @param[in]  oomEvents           The OOM kills detected.
+ */
+void DobbyCgroupMonitor::notifyContainers(const std::list<ContainerId> &emptyContainers,
+                                          const std::list<OomEvent> &oomEvents) const
+{
+    if (mContainerOomCb)
+    {
+        for (const OomEvent &oomEvent : oomEvents)
+            mContainerOomCb(oomEvent.id, oomEvent.victim);
+    }
+
+    if (mContainerEmptyCb)
+    {
+        for (const ContainerId &id : emptyContainers)
+            mContainerEmptyCb(id);
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the path to the cgroup directory of the container.
+ *
+ *  Normally this is <mount>/<id>, however when the runtime is using the
+ *  systemd cgroup driver the container is placed under a scope in
+ *  system.slice.
+ *
+ *  @param[in]  mountPoint  The cgroup mount point to look under.
+ *  @param[in]  id          The id of the container.
+ *
+ *  @return the path to the cgroup directory, or an empty string if not found.
+ */
+std::string DobbyCgroupMonitor::findCgroupDir(const std::string &mountPoint,
+                                              const ContainerId &id) const
+{
+    struct stat details;
+
+    std::string path = mountPoint + "/" + id.str();
+    if ((stat(path.c_str(), &details) == 0) && S_ISDIR(details.st_mode))
+        return path;
+
+    path = mountPoint + "/system.slice/dobby-" + id.str() + ".scope";
+    if ((stat(path.c_str(), &details) == 0) && S_ISDIR(details.st_mode))
+        return path;
+
+    return std::string();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads the 'populated' field from a cgroup.events file.
+ *
+ *  The file looks like:
+ *      populated 1
+ *      frozen 0
+ *
+ *  @param[in]  eventsFilePath  The path to the cgroup.events file.
+ *
+ *  @return false if the cgroup is known to be empty, true otherwise (including
+ *  if the file couldn't be read).
+ */
+bool DobbyCgroupMonitor::isPopulated(const std::string &eventsFilePath)
+{
+    int fd = open(eventsFilePath.c_str(), O_CLOEXEC | O_RDONLY);
+    if (fd < 0)
+    {
+        // the cgroup has gone, so it can't have any processes in it
+        return (errno != ENOENT);
+    }
+
+    char buf[128];
+    ssize_t rd = TEMP_FAILURE_RETRY(read(fd, buf, sizeof(buf) - 1));
+    close(fd);
+
+    if (rd <= 0)
+        return true;
+
+    buf[rd] = '\0';
+
+    const char *populated = strstr(buf, "populated ");
+    if (!populated)
+        return true;
+
+    return (populated[10] != '0');
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads the 'oom_kill' field from either a v2 memory.events file or
+ *  a v1 memory.oom_control file.
+ *
+ *  Both files are in the "key value" format, e.g.
+ *      oom_kill_disable 0
+ *      under_oom 0
+ *      oom_kill 1
+ *
+ *  @param[in]  filePath    The path to the file to read.
+ *  @param[out] count       Set to the oom_kill count on success.
+ *
+ *  @return true if the field was found, otherwise false.
+ */
+bool DobbyCgroupMonitor::readOomKillCount(const std::string &filePath,
+                                          unsigned long *count)
+{
+    int fd = open(filePath.c_str(), O_CLOEXEC | O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    char buf[256];
+    ssize_t rd = TEMP_FAILURE_RETRY(read(fd, buf, sizeof(buf) - 1));
+    close(fd);
+
+    if (rd <= 0)
+        return false;
+
+    buf[rd] = '\0';
+
+    // the key must be at the start of a line, 'oom_kill_disable' also matches
+    const char *line = buf;
+    while (line && *line)
+    {
+        if (sscanf(line, "oom_kill %lu", count) == 1)
+            return true;
+
+        line = strchr(line, '\n');
+        if (line)
+            line++;
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads the pids listed in the cgroup.procs file of the cgroup.
+ *
+ *  @param[in]  cgroupDir   The path to the cgroup directory.
+ *
+ *  @return the set of pids, which will be empty on failure.
+ */
+std::set<pid_t> DobbyCgroupMonitor::readCgroupProcs(const std::string &cgroupDir)
+{
+    std::set<pid_t> pids;
+
+    const std::string procsPath = cgroupDir + "/cgroup.procs";
+    FILE *fp = fopen(procsPath.c_str(), "re");
+    if (!fp)
+        return pids;
+
+    int pid;
+    while (fscanf(fp, "%d", &pid) == 1)
+        pids.insert(pid);
+
+    fclose(fp);
+    return pids;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Checks if the process has a SIGKILL pending.
+ *
+ *  The OOM killer sends SIGKILL to the victim's thread group, so for a short
+ *  while after the kill the victim is still listed in cgroup.procs with the
+ *  signal queued in ShdPnd.  Zombies aren't counted, a process that exited
+ *  normally but hasn't been reaped looks just the same.
+ *
+ *  @param[in]  pid     The pid of the process to check.
+ *
+ *  @return true if the process is being killed.
+ */
+bool DobbyCgroupMonitor::isBeingKilled(pid_t pid)
+{
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+
+    FILE *fp = fopen(path, "re");
+    if (!fp)
+        return false;
+
+    static const unsigned long long sigKillMask = (1ULL << (SIGKILL - 1));
+
+    bool killed = false;
+    char line[128];
+    while (!killed && fgets(line, sizeof(line), fp))
+    {
+        unsigned long long pending;
+
+        if ((sscanf(line, "ShdPnd: %llx", &pending) == 1) ||
+            (sscanf(line, "SigPnd: %llx", &pending) == 1))
+            killed = (pending & sigKillMask);
+    }
+
+    fclose(fp);
+    return killed;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Tries to find the pid of an OOM killed process.
+ *
+ *  A pid is only returned if it can't be anything else; the cgroup's
+ *  oom_kill count must have gone up by exactly one and exactly one process
+ *  still in the cgroup must have a SIGKILL pending.  Otherwise, for example
+ *  if the victim has already exited or several processes were killed, -1
+ *  is returned rather than a guess.
+ *
+ *  @param[in]  cgroupDir   The path to the cgroup directory.
+ *  @param[in]  newKills    How much the cgroup's oom_kill count went up by.
+ *
+ *  @return the pid of the victim, or -1 if it couldn't be determined.
+ */
+pid_t DobbyCgroupMonitor::findOomVictim(const std::string &cgroupDir,
+                                        unsigned long newKills)
+{
+    if (newKills != 1)
+        return -1;
+
+    pid_t victim = -1;
+
+    for (pid_t pid : readCgroupProcs(cgroupDir))
+    {
+        if (isBeingKilled(pid))
+        {
+            // a second candidate, so can't tell which the OOM killer chose
+            if (victim > 0)
+                return -1;
+
+            victim = pid;
+        }
+    }
+
+    return victim;
+}
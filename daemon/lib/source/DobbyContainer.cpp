@@ -28,6 +28,15 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <random>
+
+
+// the restart-on-crash budget, and the backoff applied between attempts
+static const unsigned RESTART_BUDGET = 10;
+static const std::chrono::minutes RESTART_BUDGET_WINDOW(5);
+static const std::chrono::milliseconds RESTART_BACKOFF_BASE(250);
+static const std::chrono::milliseconds RESTART_BACKOFF_MAX(30000);
 
 std::mutex DobbyContainer::mIdsLock;
 std::bitset<1024> DobbyContainer::mUsedIds;
@@ -113,6 +122,7 @@ DobbyContainer::DobbyContainer(const std::shared_ptr<const DobbyBundle>& _bundle
     , hibernatingPid(0)
     , mRestartOnCrash(false)
     , mRestartCount(0)
+    , mTotalRestartCount(0)
 {
 }
 
@@ -131,6 +141,7 @@ DobbyContainer::DobbyContainer(const std::shared_ptr<const DobbyBundle>& _bundle
     , hibernatingPid(0)
     , mRestartOnCrash(false)
     , mRestartCount(0)
+    , mTotalRestartCount(0)
 {
 }
 
@@ -201,6 +212,22 @@ const std::list<int>& DobbyContainer::files() const
     return mFiles;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Checks if the container should be restarted after exiting with the
+ *  given status.
+ *
+ *  To avoid endless attempts to restart if there is some fatal error, each
+ *  container has a budget of RESTART_BUDGET restarts; the budget is refilled
+ *  if the last restart was more than RESTART_BUDGET_WINDOW ago.
+ *
+ *  If true is returned the attempt is counted, use restartBackoff() to get
+ *  how long to wait before actually restarting.
+ *
+ *  @param[in]  statusCode  The exit status of the container.
+ *
+ *  @return true if the container should be restarted.
+ */
 bool DobbyContainer::shouldRestart(int statusCode)
 {
     if (!mRestartOnCrash || (statusCode == EXIT_SUCCESS))
@@ -208,28 +235,63 @@ bool DobbyContainer::shouldRestart(int statusCode)
         return false;
     }
 
-    // to avoid endless attempts to restart if there is some fatal error, just
-    // try respawning 10 times, unless the last respawn was ages (5 minutes) ago
-
     std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
 
-    if ((now - mLastRestartAttempt) > std::chrono::minutes(5))
+    if ((now - mLastRestartAttempt) > RESTART_BUDGET_WINDOW)
     {
         mRestartCount = 0;
     }
 
-    if (++mRestartCount > 10)
+    if (++mRestartCount > RESTART_BUDGET)
     {
-        AI_LOG_ERROR("container restart has been attempted 10 times, each has "
-                     "failed within the last 5 miuntes so giving up.");
+        AI_LOG_ERROR("container restart has been attempted %u times, each has "
+                     "failed within the last %ld minutes so giving up.",
+                     RESTART_BUDGET, long(RESTART_BUDGET_WINDOW.count()));
         return false;
     }
     else
     {
-        AI_LOG_INFO("container will try and be re-started");
+        AI_LOG_INFO("container will try and be re-started (attempt %u)",
+                    mRestartCount);
         mLastRestartAttempt = now;
+        mTotalRestartCount++;
         return true;
     }
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns how long to wait before the next restart attempt.
+ *
+ *  The delay doubles with each attempt in the current budget window, starting
+ *  at RESTART_BACKOFF_BASE and capped at RESTART_BACKOFF_MAX.  A random +/-25%
+ *  jitter is applied so that containers which crashed together (e.g. because
+ *  of a shared dependency) don't all restart at the same instant.
+ *
+ *  @return the delay before the container should be restarted.
+ */
+std::chrono::milliseconds DobbyContainer::restartBackoff() const
+{
+    static thread_local std::minstd_rand randGen(
+        std::chrono::steady_clock::now().time_since_epoch().count());
+
+    const unsigned shift = std::min(std::max(mRestartCount, 1U) - 1, 16U);
+    std::chrono::milliseconds delay = std::min(RESTART_BACKOFF_BASE * (1 << shift),
+                                               RESTART_BACKOFF_MAX);
+
+    std::uniform_int_distribution<long> jitter(-(delay.count() / 4),
+                                               (delay.count() / 4));
+    return delay + std::chrono::milliseconds(jitter(randGen));
+}
+
+unsigned DobbyContainer::restartCount() const
+{
+    return mRestartCount;
+}
+
+unsigned DobbyContainer::totalRestartCount() const
+{
+    return mTotalRestartCount;
+}
+
 
@@ -0,0 +1,572 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyCpusetPlacer.cpp
+ *
+ */
+#include "DobbyCpusetPlacer.h"
+
+#include <Logging.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+#include <set>
+#include <algorithm>
+
+
+// the minimum load a container is assumed to put on the cores it's given,
+// stops idle (or just started) containers all being stacked on the same core
+static const double kMinContainerLoad = 0.05;
+
+
+DobbyCpusetPlacer::DobbyCpusetPlacer(const std::shared_ptr<IDobbyEnv> &env,
+                                     const std::shared_ptr<IDobbyUtils> &utils,
+                                     const IDobbySettings::CpusetPlacementSettings &settings)
+    : mUtilities(utils)
+    , mSettings(settings)
+    , mCgroupVersion(env->cgroupVersion())
+    , mCpusetMountPath(env->cgroupMountPath(IDobbyEnv::Cgroup::CpuSet))
+    , mCpuAcctMountPath(env->cgroupMountPath(IDobbyEnv::Cgroup::CpuAcct))
+    , mRebalanceTimerId(-1)
+{
+    AI_LOG_FN_ENTRY();
+
+    mCores = readAvailableCores();
+    if (mCores.empty())
+    {
+        AI_LOG_WARN("failed to read the available cores, cpuset placement disabled");
+    }
+    else
+    {
+        AI_LOG_INFO("cpuset placement enabled over cores '%s'",
+                    formatCpuList(mCores).c_str());
+
+        if (mSettings.rebalanceInterval > 0)
+        {
+            mRebalanceTimerId =
+                mUtilities->startTimer(std::chrono::seconds(mSettings.rebalanceInterval),
+                                       false,
+                                       std::bind(&DobbyCpusetPlacer::onRebalanceTimer, this));
+            if (mRebalanceTimerId < 0)
+                AI_LOG_ERROR("failed to start the cpuset rebalance timer");
+        }
+    }
+
+    AI_LOG_FN_EXIT();
+}
+
+DobbyCpusetPlacer::~DobbyCpusetPlacer()
+{
+    if (mRebalanceTimerId > 0)
+        mUtilities->cancelTimer(mRebalanceTimerId);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Starts managing the cores of the given container.
+ *
+ *  The container is placed straight away, which may also move other
+ *  containers (i.e. if this is a foreground app the background containers
+ *  are moved off its cores).
+ *
+ *  @param[in]  id          The id of the container.
+ *  @param[in]  appName     The app name (hostname) of the container, used to
+ *                          decide if it's a foreground app.
+ *
+ *  @return true if the container is being managed, otherwise false.
+ */
+bool DobbyCpusetPlacer::addContainer(const ContainerId &id,
+                                     const std::string &appName)
+{
+    AI_LOG_FN_ENTRY();
+
+    if (mCores.empty() || mCpusetMountPath.empty())
+    {
+        AI_LOG_FN_EXIT();
+        return false;
+    }
+
+    const std::string cpusetDir = findCgroupDir(mCpusetMountPath, id);
+    if (cpusetDir.empty())
+    {
+        AI_LOG_WARN("failed to find the cpuset cgroup dir for container '%s'",
+                    id.c_str());
+        AI_LOG_FN_EXIT();
+        return false;
+    }
+
+    Container container;
+    container.cpusetPath = cpusetDir + "/cpuset.cpus";
+    if (access(container.cpusetPath.c_str(), W_OK) != 0)
+    {
+        // on cgroups v2 the cpuset controller may not be enabled for the
+        // container
+        AI_LOG_WARN("no writable cpuset.cpus for container '%s'", id.c_str());
+        AI_LOG_FN_EXIT();
+        return false;
+    }
+
+    if (mCgroupVersion == IDobbyEnv::CgroupVersion::V2)
+    {
+        container.cpuUsagePath = cpusetDir + "/cpu.stat";
+    }
+    else if (!mCpuAcctMountPath.empty())
+    {
+        const std::string cpuAcctDir = findCgroupDir(mCpuAcctMountPath, id);
+        if (!cpuAcctDir.empty())
+            container.cpuUsagePath = cpuAcctDir + "/cpuacct.usage";
+    }
+
+    container.foreground =
+        (std::find(mSettings.foregroundApps.begin(), mSettings.foregroundApps.end(),
+                   appName) != mSettings.foregroundApps.end());
+    container.cores = parseCpuList(mUtilities->readTextFile(container.cpusetPath));
+    container.lastUsage = 0;
+    container.load = 0.0;
+
+    if (!container.cpuUsagePath.empty())
+        readCpuUsage(container.cpuUsagePath, &container.lastUsage);
+
+    // the first load is measured from here, not from the last time the
+    // other containers were sampled
+    container.lastSampleTime = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    AI_LOG_INFO("placing %s container '%s'",
+                container.foreground ? "foreground" : "background", id.c_str());
+
+    mContainers[id] = std::move(container);
+    placeContainers();
+
+    AI_LOG_FN_EXIT();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Stops managing the cores of the given container.
+ *
+ *  The remaining containers are re-placed, if a foreground app has gone
+ *  its dedicated cores are given back to the background containers.
+ *
+ *  @param[in]  id          The id of the container.
+ */
+void DobbyCpusetPlacer::removeContainer(const ContainerId &id)
+{
+    AI_LOG_FN_ENTRY();
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (mContainers.erase(id) > 0)
+        placeContainers();
+
+    AI_LOG_FN_EXIT();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Timer callback, samples the cpu usage of the containers and then
+ *  re-places them.
+ *
+ *  @return always true to keep the timer running.
+ */
+bool DobbyCpusetPlacer::onRebalanceTimer()
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (!mContainers.empty())
+    {
+        updateLoads();
+        placeContainers();
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Updates the load of each container from the change in its cpu
+ *  usage since it was last sampled.
+ *
+ *  The load is in units of cores, i.e. a container that kept two cores busy
+ *  over the period has a load of 2.0.  Each container has its own sample
+ *  time, so one added part way through a period isn't measured over the
+ *  whole of it.
+ *
+ *  This must be called with the lock held.
+ */
+void DobbyCpusetPlacer::updateLoads()
+{
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    for (auto &entry : mContainers)
+    {
+        Container &container = entry.second;
+
+        uint64_t usage;
+        if (container.cpuUsagePath.empty() ||
+            !readCpuUsage(container.cpuUsagePath, &usage))
+            continue;
+
+        const double elapsedUs =
+            std::chrono::duration<double, std::micro>(now - container.lastSampleTime).count();
+        if (elapsedUs <= 0.0)
+            continue;
+
+        if (usage >= container.lastUsage)
+            container.load = static_cast<double>(usage - container.lastUsage) / elapsedUs;
+
+        container.lastUsage = usage;
+        container.lastSampleTime = now;
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Works out the cores for every container and applies any changes.
+ *
+ *  If any foreground containers are running then the highest numbered
+ *  foregroundCores cores are given to them and removed from the pool the
+ *  background containers are placed on.  At least one core is always left
+ *  for the background containers.
+ *
+ *  The background containers are then placed heaviest first, each onto the
+ *  least loaded cores in the pool.
+ *
+ *  This must be called with the lock held.
+ */
+void DobbyCpusetPlacer::placeContainers()
+{
+    bool haveForeground = false;
+    for (const auto &entry : mContainers)
+        haveForeground |= entry.second.foreground;
+
+    size_t numReserved = 0;
+    if (haveForeground)
+        numReserved = std::min<size_t>(std::max(mSettings.foregroundCores, 0),
+                                       mCores.size() - 1);
+
+    const std::vector<unsigned> foregroundCores(mCores.end() - numReserved,
+                                                mCores.end());
+    const std::vector<unsigned> backgroundCores(mCores.begin(),
+                                                mCores.end() - numReserved);
+
+    // the foreground apps share their dedicated cores, if there are none
+    // (i.e. only one core) they just get the same as everything else
+    std::vector<const ContainerId*> background;
+    for (auto &entry : mContainers)
+    {
+        if (entry.second.foreground && !foregroundCores.empty())
+            applyCores(entry.first, entry.second, foregroundCores);
+        else
+            background.push_back(&entry.first);
+    }
+
+    size_t coresPerContainer = backgroundCores.size();
+    if ((mSettings.coresPerContainer > 0) &&
+        (static_cast<size_t>(mSettings.coresPerContainer) < coresPerContainer))
+        coresPerContainer = mSettings.coresPerContainer;
+
+    if (coresPerContainer == backgroundCores.size())
+    {
+        for (const ContainerId *id : background)
+            applyCores(*id, mContainers[*id], backgroundCores);
+        return;
+    }
+
+    // place the heaviest containers first so they get the emptiest cores
+    std::stable_sort(background.begin(), background.end(),
+                     [this](const ContainerId *a, const ContainerId *b)
+                     {
+                         return mContainers[*a].load > mContainers[*b].load;
+                     });
+
+    std::map<unsigned, double> coreLoads;
+    for (unsigned core : backgroundCores)
+        coreLoads[core] = 0.0;
+
+    for (const ContainerId *id : background)
+    {
+        Container &container = mContainers[*id];
+
+        const std::vector<unsigned> cores =
+            leastLoadedCores(backgroundCores, coresPerContainer,
+                             container.cores, coreLoads);
+
+        const double load = std::max(container.load, kMinContainerLoad);
+        for (unsigned core : cores)
+            coreLoads[core] += load / cores.size();
+
+        applyCores(*id, container, cores);
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Picks the given number of least loaded cores from the pool.
+ *
+ *  When loads are equal the cores the container is currently on are
+ *  preferred, to avoid needlessly moving it.
+ *
+ *  @param[in]  pool        The cores to choose from.
+ *  @param[in]  count       The number of cores to choose.
+ *  @param[in]  current     The cores the container is currently on.
+ *  @param[in]  coreLoads   The load already placed on each core.
+ *
+ *  @return the chosen cores in ascending order.
+ */
+std::vector<unsigned> DobbyCpusetPlacer::leastLoadedCores(const std::vector<unsigned> &pool,
+                                                          size_t count,
+                                                          const std::vector<unsigned> &current,
+                                                          const std::map<unsigned, double> &coreLoads) const
+{
+    const std::set<unsigned> currentSet(current.begin(), current.end());
+
+    std::vector<unsigned> cores(pool);
+    std::stable_sort(cores.begin(), cores.end(),
+                     [&](unsigned a, unsigned b)
+                     {
+                         const double loadA = coreLoads.at(a);
+                         const double loadB = coreLoads.at(b);
+                         if (loadA != loadB)
+                             return loadA < loadB;
+
+                         return (currentSet.count(a) > currentSet.count(b));
+                     });
+
+    cores.resize(std::min(count, cores.size()));
+    std::sort(cores.begin(), cores.end());
+
+    return cores;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Writes the cores to the container's cpuset.cpus file if they've
+ *  changed.
+ *
+ *  @param[in]  id          The id of the container.
+ *  @param[in]  container   The container details, the cores are updated on
+ *                          success.
+ *  @param[in]  cores       The cores to put the container on.
+ *
+ *  @return true if the container is on the given cores, otherwise false.
+ */
+bool DobbyCpusetPlacer::applyCores(const ContainerId &id, Container &container,
+                                   const std::vector<unsigned> &cores) const
+{
+    if (cores == container.cores)
+        return true;
+
+    const std::string cpuList = formatCpuList(cores);
+    if (!mUtilities->writeTextFile(container.cpusetPath, cpuList, O_TRUNC))
+    {
+        AI_LOG_ERROR("failed to set cpuset.cpus to '%s' for container '%s'",
+                     cpuList.c_str(), id.c_str());
+        return false;
+    }
+
+    AI_LOG_INFO("moved container '%s' onto cores '%s'",
+                id.c_str(), cpuList.c_str());
+
+    container.cores = cores;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads the total cpu time used by a container in microseconds.
+ *
+ *  On cgroups v2 this is the 'usage_usec' field of cpu.stat, on cgroups v1
+ *  it's cpuacct.usage which is in nanoseconds.
+ *
+ *  @param[in]  filePath    The path to the usage file.
+ *  @param[out] usage       Set to the usage in microseconds.
+ *
+ *  @return true on success, otherwise false.
+ */
+bool DobbyCpusetPlacer::readCpuUsage(const std::string &filePath,
+                                     uint64_t *usage) const
+{
+    const std::string contents = mUtilities->readTextFile(filePath);
+    if (contents.empty())
+        return false;
+
+    if (mCgroupVersion == IDobbyEnv::CgroupVersion::V2)
+    {
+        const char *field = strstr(contents.c_str(), "usage_usec ");
+        if (!field)
+            return false;
+
+        *usage = strtoull(field + 11, nullptr, 10);
+    }
+    else
+    {
+        *usage = strtoull(contents.c_str(), nullptr, 10) / 1000;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads the cores containers can be placed on.
+ *
+ *  These are the effective cpus of the root cpuset, falling back to the
+ *  online cpus if that can't be read.
+ *
+ *  @return the available cores in ascending order, empty on failure.
+ */
+std::vector<unsigned> DobbyCpusetPlacer::readAvailableCores() const
+{
+    std::vector<unsigned> cores;
+
+    if (!mCpusetMountPath.empty())
+    {
+        const char *fileName = (mCgroupVersion == IDobbyEnv::CgroupVersion::V2) ?
+                               "/cpuset.cpus.effective" : "/cpuset.effective_cpus";
+        cores = parseCpuList(mUtilities->readTextFile(mCpusetMountPath + fileName));
+    }
+
+    if (cores.empty())
+        cores = parseCpuList(mUtilities->readTextFile("/sys/devices/system/cpu/online"));
+
+    return cores;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Finds the cgroup directory of a container under the given mount.
+ *
+ *  @param[in]  mountPoint  The cgroup mount point.
+ *  @param[in]  id          The id of the container.
+ *
+ *  @return the path to the directory, or an empty string if not found.
+ */
+std::string DobbyCpusetPlacer::findCgroupDir(const std::string &mountPoint,
+                                             const ContainerId &id) const
+{
+    struct stat details;
+
+    std::string path = mountPoint + "/" + id.str();
+    if ((stat(path.c_str(), &details) == 0) && S_ISDIR(details.st_mode))
+        return path;
+
+    path = mountPoint + "/system.slice/dobby-" + id.str() + ".scope";
+    if ((stat(path.c_str(), &details) == 0) && S_ISDIR(details.st_mode))
+        return path;
+
+    return std::string();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Parses a kernel cpu list string, i.e. "0-2,4".
+ *
+ *  Leading and trailing whitespace (the files end with a newline) is
+ *  ignored.
+ *
+ *  @param[in]  str         The string to parse.
+ *
+ *  @return the cores in ascending order, empty if the string is invalid.
+ */
+std::vector<unsigned> DobbyCpusetPlacer::parseCpuList(const std::string &str)
+{
+    static const char whitespace[] = " \t\r\n";
+
+    const size_t start = str.find_first_not_of(whitespace);
+    if (start == std::string::npos)
+        return std::vector<unsigned>();
+
+    const size_t length = str.find_last_not_of(whitespace) - start + 1;
+    const std::string trimmed = str.substr(start, length);
+
+    std::set<unsigned> cores;
+
+    const char *ptr = trimmed.c_str();
+    while (*ptr)
+    {
+        if (!isdigit(*ptr))
+            return std::vector<unsigned>();
+
+        char *end;
+        unsigned long first = strtoul(ptr, &end, 10);
+
+        unsigned long last = first;
+        ptr = end;
+        if (*ptr == '-')
+        {
+            if (!isdigit(ptr[1]))
+                return std::vector<unsigned>();
+
+            last = strtoul(ptr + 1, &end, 10);
+            if (last < first)
+                return std::vector<unsigned>();
+            ptr = end;
+        }
+
+        for (unsigned long core = first; core <= last; core++)
+            cores.insert(static_cast<unsigned>(core));
+
+        if (*ptr == ',')
+            ptr++;
+        else if (*ptr)
+            return std::vector<unsigned>();
+    }
+
+    return std::vector<unsigned>(cores.begin(), cores.end());
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Formats cores as a kernel cpu list string, i.e. "0-2,4".
+ *
+ *  @param[in]  cores       The cores in ascending order.
+ *
+ *  @return the cpu list string.
+ */
+std::string DobbyCpusetPlacer::formatCpuList(const std::vector<unsigned> &cores)
+{
+    std::string str;
+
+    size_t i = 0;
+    while (i < cores.size())
+    {
+        size_t j = i;
+        while (((j + 1) < cores.size()) && (cores[j + 1] == (cores[j] + 1)))
+            j++;
+
+        if (!str.empty())
+            str += ',';
+
+        str += std::to_string(cores[i]);
+        if (j > i)
+            str += '-' + std::to_string(cores[j]);
+
+        i = j + 1;
+    }
+
+    return str;
+}
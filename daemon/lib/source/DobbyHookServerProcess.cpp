@@ -0,0 +1,408 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyHookServerProcess.cpp
+ *
+ */
+#include "DobbyHookServerProcess.h"
+#include "DobbyHookServerProtocol.h"
+
+#include <Logging.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+
+// how long the server is given to finish any hooks it's running when the
+// daemon shuts down before it's killed
+#define HOOK_SERVER_STOP_TIMEOUT_MS     2000
+
+// how long to wait for the server to reply to a release or metrics request
+#define HOOK_SERVER_REQUEST_TIMEOUT_MS  500
+
+
+DobbyHookServerProcess::DobbyHookServerProcess(const std::string &socketPath,
+                                               const std::string &launcherPath)
+    : mSocketPath(socketPath)
+    , mLauncherPath(launcherPath)
+    , mStop(false)
+    , mPid(-1)
+{
+    AI_LOG_FN_ENTRY();
+
+    mThread = std::thread(&DobbyHookServerProcess::run, this);
+
+    AI_LOG_FN_EXIT();
+}
+
+DobbyHookServerProcess::~DobbyHookServerProcess()
+{
+    AI_LOG_FN_ENTRY();
+
+    std::unique_lock<std::mutex> locker(mLock);
+
+    mStop = true;
+    mCond.notify_all();
+
+    // mPid is only cleared once the server has exited but before it's been
+    // reaped, so while we hold the lock the pid can't have been re-used
+    if (mPid > 0)
+    {
+        if (kill(mPid, SIGTERM) != 0)
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to send SIGTERM to hook server");
+        }
+
+        if (!mCond.wait_for(locker, std::chrono::milliseconds(HOOK_SERVER_STOP_TIMEOUT_MS),
+                            [this]() { return (mPid <= 0); }))
+        {
+            AI_LOG_WARN("hook server didn't stop, killing it");
+
+            if (kill(mPid, SIGKILL) != 0)
+            {
+                AI_LOG_SYS_ERROR(errno, "failed to send SIGKILL to hook server");
+            }
+        }
+    }
+
+    locker.unlock();
+
+    if (mThread.joinable())
+    {
+        mThread.join();
+    }
+
+    AI_LOG_FN_EXIT();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Tells the hook server to drop the config and plugins it has cached
+ *  for the container.
+ *
+ *  Normally the server drops them after the poststop hook has run, but that
+ *  won't happen if the container failed to start or the runtime was killed.
+ *  If the server isn't running there's nothing cached, so it's not an error.
+ *
+ *  @param[in]  id          The id of the container.
+ */
+void DobbyHookServerProcess::removeContainer(const ContainerId &id)
+{
+    AI_LOG_FN_ENTRY();
+
+    std::string request(HOOK_SERVER_RELEASE_REQUEST);
+    request += '\0';
+    request += '\0';
+    request += id.str();
+
+    int32_t result = HookFailure;
+    if (sendRequest(request, &result, nullptr) && (result != HookSuccess))
+    {
+        AI_LOG_WARN("hook server didn't release container '%s'", id.c_str());
+    }
+
+    AI_LOG_FN_EXIT();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the timings of the plugin hooks run by the hook server.
+ *
+ *  The server records its hooks in its own DobbyPluginMetrics, these are
+ *  what the daemon adds to its own when asked for the plugin metrics.
+ *
+ *  @param[out] snapshot    The server's metrics.
+ *
+ *  @return true if the server replied with its metrics, false if the server
+ *  isn't running or the request failed.
+ */
+bool DobbyHookServerProcess::getPluginMetrics(DobbyPluginMetrics::Snapshot *snapshot) const
+{
+    AI_LOG_FN_ENTRY();
+
+    std::string request(HOOK_SERVER_METRICS_REQUEST);
+    request += '\0';
+    request += '\0';
+
+    int32_t result = HookFailure;
+    std::string payload;
+    if (!sendRequest(request, &result, &payload))
+    {
+        AI_LOG_FN_EXIT();
+        return false;
+    }
+
+    if (result != HookSuccess)
+    {
+        AI_LOG_WARN("hook server failed to return its plugin metrics");
+        AI_LOG_FN_EXIT();
+        return false;
+    }
+
+    if (!DobbyPluginMetrics::deserialise(payload, snapshot))
+    {
+        AI_LOG_ERROR_EXIT("malformed plugin metrics from hook server");
+        return false;
+    }
+
+    AI_LOG_FN_EXIT();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Sends a single request packet to the hook server and reads the
+ *  reply.
+ *
+ *  If the server isn't running there's nobody to handle the request, so
+ *  that's only logged at debug level.
+ *
+ *  @param[in]  request     The request packet.
+ *  @param[out] result      The DobbyHookResult the server replied with.
+ *  @param[out] payload     Optional, set to whatever followed the result.
+ *
+ *  @return true if the server replied, otherwise false.
+ */
+bool DobbyHookServerProcess::sendRequest(const std::string &request,
+                                         int32_t *result, std::string *payload) const
+{
+    struct sockaddr_un addr;
+    bzero(&addr, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, mSocketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    int sockFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sockFd < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to create socket");
+        return false;
+    }
+
+    bool success = false;
+
+    if (connect(sockFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        AI_LOG_DEBUG("hook server not available (%d)", errno);
+    }
+    else
+    {
+        struct timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = HOOK_SERVER_REQUEST_TIMEOUT_MS * 1000;
+        if (setsockopt(sockFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+        {
+            AI_LOG_SYS_WARN(errno, "failed to set socket timeout");
+        }
+
+        std::vector<char> reply(sizeof(int32_t) + HOOK_SERVER_MAX_REPLY_SIZE);
+        ssize_t rd = -1;
+
+        if (TEMP_FAILURE_RETRY(send(sockFd, request.data(), request.length(), MSG_NOSIGNAL)) !=
+            static_cast<ssize_t>(request.length()))
+        {
+            AI_LOG_SYS_WARN(errno, "failed to send request to hook server");
+        }
+        else if ((rd = TEMP_FAILURE_RETRY(recv(sockFd, reply.data(), reply.size(), 0))) <
+                 static_cast<ssize_t>(sizeof(int32_t)))
+        {
+            AI_LOG_SYS_WARN(errno, "failed to read reply from hook server");
+        }
+        else
+        {
+            memcpy(result, reply.data(), sizeof(int32_t));
+            if (payload)
+            {
+                payload->assign(reply.data() + sizeof(int32_t), reply.data() + rd);
+            }
+            success = true;
+        }
+    }
+
+    if (close(sockFd) != 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to close socket");
+    }
+
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Thread function that starts the server and restarts it whenever it
+ *  exits until the object is destroyed.
+ *
+ *  The delay before a restart doubles with each failure (250ms up to 32s),
+ *  and goes back to the start once a server has stayed up for a minute.
+ */
+void DobbyHookServerProcess::run()
+{
+    pthread_setname_np(pthread_self(), "DOBBY_HOOKSRV");
+
+    unsigned failures = 0;
+
+    std::unique_lock<std::mutex> locker(mLock);
+
+    while (!mStop)
+    {
+        const pid_t pid = spawnServer();
+        if (pid > 0)
+        {
+            AI_LOG_INFO("started hook server with pid %d", pid);
+
+            mPid = pid;
+            const auto started = std::chrono::steady_clock::now();
+
+            locker.unlock();
+
+            // wait for the server to exit without reaping it, so the
+            // destructor can still safely signal the pid
+            siginfo_t info;
+            bzero(&info, sizeof(info));
+            if (TEMP_FAILURE_RETRY(waitid(P_PID, pid, &info, WEXITED | WNOWAIT)) != 0)
+            {
+                AI_LOG_SYS_ERROR(errno, "failed to wait for hook server");
+            }
+
+            locker.lock();
+
+            mPid = -1;
+            if (TEMP_FAILURE_RETRY(waitpid(pid, nullptr, 0)) != pid)
+            {
+                AI_LOG_SYS_ERROR(errno, "failed to reap hook server");
+            }
+
+            mCond.notify_all();
+
+            if (mStop)
+            {
+                break;
+            }
+
+            if (info.si_code == CLD_EXITED)
+                AI_LOG_WARN("hook server exited with status %d", info.si_status);
+            else
+                AI_LOG_WARN("hook server killed by signal %d", info.si_status);
+
+            if ((std::chrono::steady_clock::now() - started) > std::chrono::minutes(1))
+            {
+                failures = 0;
+            }
+        }
+
+        const std::chrono::milliseconds delay(250 << std::min(failures, 7u));
+        failures++;
+
+        mCond.wait_for(locker, delay, [this]() { return mStop; });
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Forks and execs 'DobbyPluginLauncher --server=<socket path>'.
+ *
+ *  stdout and stderr are left pointing at the daemon's so the server's log
+ *  output ends up in the same place.
+ *
+ *  @return the pid of the server, -1 on failure.
+ */
+pid_t DobbyHookServerProcess::spawnServer() const
+{
+    AI_LOG_FN_ENTRY();
+
+    // setup the args now as we can't safely use malloc after the fork
+    // (because we're multi-threaded)
+    const std::string serverArg = "--server=" + mSocketPath;
+
+    std::vector<char*> argv;
+    argv.push_back(strdup("DobbyPluginLauncher"));
+    argv.push_back(strdup(serverArg.c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid = vfork();
+    if (pid < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "fork failed");
+    }
+    else if (pid == 0)
+    {
+        // In child process
+
+        // Remap stdin to /dev/null
+        int devNull = open("/dev/null", O_RDWR);
+        if (devNull < 0)
+            _exit(EXIT_FAILURE);
+
+        dup2(devNull, STDIN_FILENO);
+
+        if (devNull > STDERR_FILENO)
+        {
+            close(devNull);
+            devNull = -1;
+        }
+
+        // Reset the file mode mask to defaults
+        umask(0);
+
+        // Reset the signal mask, the daemon blocks SIGCHLD and the server
+        // blocks the signals it waits for itself
+        sigset_t set;
+        sigemptyset(&set);
+        if (sigprocmask(SIG_SETMASK, &set, nullptr) != 0)
+            _exit(EXIT_FAILURE);
+
+        // Make sure the server goes away if the daemon dies without stopping
+        // it, the next daemon will start its own
+        if (prctl(PR_SET_PDEATHSIG, SIGTERM) != 0)
+            _exit(EXIT_FAILURE);
+
+        // Create a new SID for the child process
+        if (setsid() < 0)
+            _exit(EXIT_FAILURE);
+
+        // Change the current working directory
+        if ((chdir("/")) < 0)
+            _exit(EXIT_FAILURE);
+
+        execv(mLauncherPath.c_str(), argv.data());
+        _exit(EXIT_FAILURE);
+    }
+
+    // in the parent process so clean up the memory allocated for the args
+    for (char *arg : argv)
+    {
+        free(arg);
+    }
+
+    AI_LOG_FN_EXIT();
+    return pid;
+}
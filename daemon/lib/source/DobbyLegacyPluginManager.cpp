@@ -25,6 +25,7 @@
 #include "IDobbyEnv.h"
 #include "IDobbyUtils.h"
 #include "DobbyAsync.h"
+#include "DobbyPluginMetrics.h"
 
 #include <Logging.h>
 #include <Tracing.h>
@@ -283,7 +284,12 @@ std::shared_ptr<IDobbyPlugin> DobbyLegacyPluginManager::getPlugin(const std::str
  *  thread or in the calling thread.  These hints are queried before executing
  *  the supplied hook function.
  *
+ *  Every hook call is timed and recorded in DobbyPluginMetrics against the
+ *  plugin and hook name.
+ *
  *  @param[in]  plugins     A map of plugin names and their data to execute
+ *  @param[in]  hookName    The name of the hook, used for the metrics
+ *  @param[in]  id          The id of the container the hooks are run for
  *  @param[in]  hookFn      The hook method to call on the plugin
  *  @param[in]  asyncFlag   The bit flag that if the plugin has set indicates
  *                          the hook method should be called asynchronously
@@ -294,6 +300,8 @@ std::shared_ptr<IDobbyPlugin> DobbyLegacyPluginManager::getPlugin(const std::str
  *  otherwise false.
  */
 bool DobbyLegacyPluginManager::executeHooks(const std::map<std::string, Json::Value>& plugins,
+                                            const char* hookName,
+                                            const ContainerId& id,
                                             const HookFn& hookFn,
                                             const unsigned asyncFlag,
                                             const unsigned syncFlag) const
@@ -302,6 +310,17 @@ bool DobbyLegacyPluginManager::executeHooks(const std::map<std::string, Json::Va
 
     AI_LOG_FN_ENTRY();
 
+    // wrap the hook so each call is timed, on whichever thread it runs
+    const std::string hook(hookName);
+    HookFn timedHookFn =
+        [hookFn, hook, id](IDobbyPlugin *plugin, const Json::Value &data)
+        {
+            const DobbyPluginMetrics::Timer timer = DobbyPluginMetrics::startTimer();
+            const bool success = hookFn(plugin, data);
+            DobbyPluginMetrics::record(timer, plugin->name(), hook, id.str(), success);
+            return success;
+        };
+
     std::list<std::shared_ptr<DobbyAsyncResult>> hookResults;
 
     // take the lock while iterating over the plugins
@@ -333,12 +352,12 @@ bool DobbyLegacyPluginManager::executeHooks(const std::map<std::string, Json::Va
         unsigned hints = plugin->hookHints();
         if (hints & asyncFlag)
         {
-            std::shared_ptr<DobbyAsyncResult> result = DobbyAsync(pluginName, hookFn, plugin, pluginData);
+            std::shared_ptr<DobbyAsyncResult> result = DobbyAsync(pluginName, timedHookFn, plugin, pluginData);
             hookResults.emplace_back(std::move(result));
         }
         else if (hints & syncFlag)
         {
-            std::shared_ptr<DobbyAsyncResult> result = DobbyDeferred(hookFn, plugin, pluginData);
+            std::shared_ptr<DobbyAsyncResult> result = DobbyDeferred(timedHookFn, plugin, pluginData);
             hookResults.emplace_front(std::move(result));
         }
     }
@@ -399,7 +418,7 @@ bool DobbyLegacyPluginManager::executePostConstructionHooks(const std::map<std::
             return plugin->postConstruction(id, startupState, rootfsPath, data);
         };
 
-    return executeHooks(plugins, hookFn,
+    return executeHooks(plugins, "postConstruction", id, hookFn,
                         IDobbyPlugin::PostConstructionAsync,
                         IDobbyPlugin::PostConstructionSync);
 }
@@ -435,7 +454,7 @@ bool DobbyLegacyPluginManager::executePreStartHooks(const std::map<std::string,
             return plugin->preStart(id, pid, rootfsPath, data);
         };
 
-    return executeHooks(plugins, hookFn,
+    return executeHooks(plugins, "preStart", id, hookFn,
                         IDobbyPlugin::PreStartAsync,
                         IDobbyPlugin::PreStartSync);
 }
@@ -471,7 +490,7 @@ bool DobbyLegacyPluginManager::executePostStartHooks(const std::map<std::string,
             return plugin->postStart(id, pid, rootfsPath, data);
         };
 
-    return executeHooks(plugins, hookFn,
+    return executeHooks(plugins, "postStart", id, hookFn,
                         IDobbyPlugin::PostStartAsync,
                         IDobbyPlugin::PostStartSync);
 }
@@ -505,7 +524,7 @@ bool DobbyLegacyPluginManager::executePostStopHooks(const std::map<std::string,
             return plugin->postStop(id, rootfsPath, data);
         };
 
-    return executeHooks(plugins, hookFn,
+    return executeHooks(plugins, "postStop", id, hookFn,
                         IDobbyPlugin::PostStopAsync,
                         IDobbyPlugin::PostStopSync);
 }
@@ -539,7 +558,7 @@ bool DobbyLegacyPluginManager::executePreDestructionHooks(const std::map<std::st
             return plugin->preDestruction(id, rootfsPath, data);
         };
 
-    return executeHooks(plugins, hookFn,
+    return executeHooks(plugins, "preDestruction", id, hookFn,
                         IDobbyPlugin::PreDestructionAsync,
                         IDobbyPlugin::PreDestructionSync);
 }
@@ -36,6 +36,7 @@
 #include "DobbyFileAccessFixer.h"
 #include "DobbyAsync.h"
 #include "DobbyHibernate.h"
+#include "DobbyHookServerProtocol.h"
 
 #if defined(LEGACY_COMPONENTS)
 #  include "DobbySpecConfig.h"
@@ -93,25 +94,47 @@ DobbyManager::DobbyManager(const std::shared_ptr<IDobbyEnv> &env,
                            const ContainerStartedFunc &containerStartedCb,
                            const ContainerStoppedFunc &containerStoppedCb,
                            const ContainerHibernatedFunc& containerHibernatedCb,
-                           const ContainerHibernatedFunc& containerAwokenCb)
+                           const ContainerHibernatedFunc& containerAwokenCb,
+                           const ContainerOomFunc& containerOomCb,
+                           const PostWorkFunc& postWorkCb)
     : mContainerStartedCb(containerStartedCb)
     , mContainerStoppedCb(containerStoppedCb)
     , mContainerHibernatedCb(containerHibernatedCb)
     , mContainerAwokenCb(containerAwokenCb)
+    , mContainerOomCb(containerOomCb)
+    , mPostWorkCb(postWorkCb)
     , mEnvironment(env)
     , mUtilities(utils)
     , mIPCUtilities(ipcUtils)
     , mSettings(settings)
     , mLogger(std::make_unique<DobbyLogger>(settings))
     , mRunc(std::make_unique<DobbyRunC>(utils, settings))
+    , mCgroupMonitor(std::make_unique<DobbyCgroupMonitor>(env,
+                        std::bind(&DobbyManager::onContainerCgroupEmpty, this,
+                                  std::placeholders::_1),
+                        std::bind(&DobbyManager::onContainerOOM, this,
+                                  std::placeholders::_1, std::placeholders::_2)))
     , mRuncMonitorTerminate(false)
     , mCleanupTaskTimerId(0)
+    , mRestartTokenCounter(0)
 #if defined(LEGACY_COMPONENTS)
     , mLegacyPlugins(new DobbyLegacyPluginManager(env, utils))
 #endif // defined(LEGACY_COMPONENTS)
 {
     AI_LOG_FN_ENTRY();
 
+    if (settings->cpusetPlacementSettings().enabled)
+    {
+        mCpusetPlacer = std::make_unique<DobbyCpusetPlacer>(env, utils,
+                                                            settings->cpusetPlacementSettings());
+    }
+
+    if (settings->hookServerSettings().enabled)
+    {
+        mHookServer = std::make_unique<DobbyHookServerProcess>(HOOK_SERVER_SOCKET_PATH,
+                                                               PLUGINLAUNCHER_PATH);
+    }
+
     setupSystem();
 
     setupWorkspace(env);
@@ -127,8 +150,12 @@ DobbyManager::~DobbyManager()
 {
     // Intentially stop monitoring for container termination before cleaning up
     // so we can force container cleanup to be synchronous and deterministic
+    mCgroupMonitor->stop();
     stopRuncMonitorThread();
 
+    // containers waiting to be restarted are torn down below instead
+    cancelContainerRestarts();
+
     cleanupContainersShutdown();
 
     if (mCleanupTaskTimerId > 0)
@@ -456,6 +483,11 @@ void DobbyManager::cleanupContainers()
             dobbyContainer->containerPid = container.pid;
 
             mContainers.emplace(container.id, std::move(dobbyContainer));
+
+            // the stuck container's init isn't our child so we'll never get
+            // a SIGCHLD for it, on cgroups v2 we can at least get notified
+            // when its cgroup empties
+            mCgroupMonitor->addContainer(container.id);
         }
     }
 
@@ -492,7 +524,8 @@ void DobbyManager::cleanupContainersShutdown()
             (it->second->state == DobbyContainer::State::Paused) || \
             (it->second->state == DobbyContainer::State::Hibernating) || \
             (it->second->state == DobbyContainer::State::Hibernated) || \
-            (it->second->state == DobbyContainer::State::Awakening))
+            (it->second->state == DobbyContainer::State::Awakening) || \
+            (it->second->restartPending))
         {
             ContainerId id = it->first;
             int32_t descriptor = it->second->descriptor;
@@ -723,6 +756,12 @@ bool DobbyManager::createAndStartContainer(const ContainerId &id,
         AI_LOG_INFO("container '%s' started, controller process pid %d",
                     id.c_str(), container->containerPid);
 
+        // watch for the container's cgroup emptying, gives an extra exit
+        // trigger on top of SIGCHLD
+        mCgroupMonitor->addContainer(id);
+
+        placeContainerCores(id, container);
+
 #if defined(LEGACY_COMPONENTS)
         // call the postStart hook, don't care about the return code
         // for now
@@ -1219,10 +1258,16 @@ int32_t DobbyManager::startContainerFromBundle(const ContainerId &id,
     else
     {
         // plugin failure detected, postInstallation hook did not run successfully
-        // return config file to original state
-        std::ifstream src(bundlePath + "/config-dobby.json", std::ios::binary);
-        std::ofstream dst(bundlePath + "/config.json", std::ios::binary);
-        dst << src.rdbuf();
+        // return config file to original state, bundles generated from a
+        // Dobby spec have no backup as their config.json hasn't been
+        // written yet
+        const std::string backupConfigPath = bundlePath + "/config-dobby.json";
+        if (access(backupConfigPath.c_str(), F_OK) == 0)
+        {
+            std::ifstream src(backupConfigPath, std::ios::binary);
+            std::ofstream dst(bundlePath + "/config.json", std::ios::binary);
+            dst << src.rdbuf();
+        }
     }
 
     // not required, but tidy up the start state object so all the file
@@ -1243,8 +1288,10 @@ int32_t DobbyManager::startContainerFromBundle(const ContainerId &id,
 /**
  *  @brief Attempts to restart the container
  *
- *  Called internally when we've detected a container shutdown and the config
- *  has indicated we should try and auto-restart the container.
+ *  Called from the restart timer handler once the backoff delay for a
+ *  crashed container with the 'restartOnCrash' flag has expired.  The remains
+ *  of the previous run will already have been destroyed by
+ *  scheduleContainerRestart().
  *
  *  From the runc tool's POV this is start of a new container.
  *
@@ -1256,8 +1303,8 @@ int32_t DobbyManager::startContainerFromBundle(const ContainerId &id,
  *  launched will be passed in again.  The DobbyContainer object will have
  *  stored them when the container was created the first time.
  *
- *  @warning this function is called from the thread that monitors the child
- *  pids, not the main thread, however it is called with mLock held.
+ *  @warning this function is called from the work queue thread with mLock
+ *  held.
  *
  *  @param[in]  id          The id of the container to re-start.
  *  @param[in]  container   The container object storing the container details.
@@ -1272,6 +1319,44 @@ bool DobbyManager::restartContainer(const ContainerId &id,
 
     // no need to take the mLock, it should already be held
 
+    // give everything to runC to try and start the container again
+    if (!createAndStartContainer(id, container, container->files()))
+    {
+        AI_LOG_ERROR_EXIT("failed to restart container");
+        return false;
+    }
+
+    AI_LOG_FN_EXIT();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Cleans up after a crashed container and queues it to be restarted
+ *  after its backoff delay.
+ *
+ *  The runc state of the old container is destroyed straight away, the
+ *  container object stays in the Stopping state (so its id and descriptor
+ *  can't be reused) until the restart timer fires.
+ *
+ *  The timer itself is started by armContainerRestarts(), which must be
+ *  called once mLock has been released.
+ *
+ *  The container hasn't been reported as stopped at this point, the stopped
+ *  callback is only called (with @a status) if it's never restarted.
+ *
+ *  @warning must be called with mLock held.
+ *
+ *  @param[in]  id          The id of the container to re-start.
+ *  @param[in]  container   The container object storing the container details.
+ *  @param[in]  status      The exit status of the crashed container.
+ */
+void DobbyManager::scheduleContainerRestart(const ContainerId &id,
+                                            const std::unique_ptr<DobbyContainer> &container,
+                                            int status)
+{
+    AI_LOG_FN_ENTRY();
+
     std::shared_ptr<DobbyBufferStream> bufferStream =
         std::make_shared<DobbyBufferStream>();
 
@@ -1299,15 +1384,211 @@ bool DobbyManager::restartContainer(const ContainerId &id,
         }
     }
 
-    // give everything to runC to try and start the container again
-    if (!createAndStartContainer(id, container, container->files()))
+    // the old runc process has been reaped, clear the pid so the SIGCHLD
+    // handler skips the container while it's waiting
+    container->containerPid = -1;
+
+    const std::chrono::milliseconds delay = container->restartBackoff();
+
+    container->restartPending = true;
+    container->restartTime = std::chrono::steady_clock::now() + delay;
+
+    mPendingRestarts.emplace(++mRestartTokenCounter,
+                             PendingRestart{ id, container->descriptor, delay, -1, status });
+
+    AI_LOG_INFO("container '%s' will be restarted in %lldms (attempt %u)",
+                id.c_str(), static_cast<long long>(delay.count()),
+                container->restartCount());
+
+    AI_LOG_FN_EXIT();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Starts the timers for any restarts queued by
+ *  scheduleContainerRestart().
+ *
+ *  The timer queue holds its own lock while calling the handlers, and the
+ *  handlers take mLock, so the timers must be started without holding mLock.
+ *
+ *  If a timer can't be started the container is restarted immediately.
+ */
+void DobbyManager::armContainerRestarts()
+{
+    std::list<std::pair<unsigned, std::chrono::milliseconds>> toArm;
+
     {
-        AI_LOG_ERROR_EXIT("failed to restart container");
-        return false;
+        std::lock_guard<std::mutex> locker(mLock);
+
+        for (auto &entry : mPendingRestarts)
+        {
+            if (entry.second.timerId < 0)
+            {
+                // mark as being armed so we don't race another caller
+                entry.second.timerId = 0;
+                toArm.emplace_back(entry.first, entry.second.delay);
+            }
+        }
+    }
+
+    for (const auto &restart : toArm)
+    {
+        const unsigned token = restart.first;
+
+        int timerId = mUtilities->startTimer(restart.second, true,
+                                             std::bind(&DobbyManager::onContainerRestartTimer,
+                                                       this, token));
+        if (timerId < 0)
+        {
+            AI_LOG_ERROR("failed to start restart timer, restarting now");
+            restartPendingContainer(token);
+            continue;
+        }
+
+        // store the timer id so it can be cancelled, unless the timer has
+        // already fired and the entry been removed
+        std::lock_guard<std::mutex> locker(mLock);
+
+        auto it = mPendingRestarts.find(token);
+        if (it != mPendingRestarts.end())
+            it->second.timerId = timerId;
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Cancels all the pending restart timers.
+ *
+ *  Called on shutdown, the containers themselves are left in the pending
+ *  state and get torn down by cleanupContainersShutdown().
+ */
+void DobbyManager::cancelContainerRestarts()
+{
+    std::list<int> timerIds;
+
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+
+        for (const auto &entry : mPendingRestarts)
+        {
+            if (entry.second.timerId > 0)
+                timerIds.push_back(entry.second.timerId);
+        }
+
+        mPendingRestarts.clear();
+    }
+
+    for (int timerId : timerIds)
+    {
+        mUtilities->cancelTimer(timerId);
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Timer handler called when a crashed container's backoff delay has
+ *  expired.
+ *
+ *  The timer thread is shared with the rest of the daemon, so it doesn't do
+ *  the restart itself, it just posts it to the work queue the API calls are
+ *  run on.
+ *
+ *  @param[in]  token       The token identifying the pending restart.
+ *
+ *  @return always false, the restart timers are one-shot.
+ */
+bool DobbyManager::onContainerRestartTimer(unsigned token)
+{
+    if (!mPostWorkCb)
+    {
+        restartPendingContainer(token);
+    }
+    else if (!mPostWorkCb(std::bind(&DobbyManager::restartPendingContainer, this, token)))
+    {
+        AI_LOG_ERROR("failed to post restart of container, restart token %u",
+                     token);
+    }
+
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Restarts a crashed container once its backoff delay has expired.
+ *
+ *  If the restart fails the container is treated as having crashed again, so
+ *  it may be re-queued with a longer delay or, once its restart budget is
+ *  used up, torn down and reported as stopped.
+ *
+ *  Nothing is done if the restart was cancelled in the meantime, i.e. the
+ *  container was stopped while waiting.
+ *
+ *  @param[in]  token       The token identifying the pending restart.
+ */
+void DobbyManager::restartPendingContainer(unsigned token)
+{
+    AI_LOG_FN_ENTRY();
+
+    bool stopped = false;
+    int32_t stoppedCd = -1;
+    ContainerId stoppedId;
+    int stoppedStatus = EXIT_FAILURE;
+
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+
+        auto it = mPendingRestarts.find(token);
+        if (it == mPendingRestarts.end())
+        {
+            AI_LOG_FN_EXIT();
+            return;
+        }
+
+        const PendingRestart restart = it->second;
+        mPendingRestarts.erase(it);
+
+        auto containerIt = mContainers.find(restart.id);
+        if ((containerIt == mContainers.end()) ||
+            (containerIt->second->descriptor != restart.descriptor) ||
+            !containerIt->second->restartPending)
+        {
+            AI_LOG_FN_EXIT();
+            return;
+        }
+
+        const ContainerId &id = containerIt->first;
+        const std::unique_ptr<DobbyContainer> &container = containerIt->second;
+
+        container->restartPending = false;
+
+        // a failed restart is handled like another crash with the same
+        // status, so uses up more of the restart budget
+        if (!restartContainer(id, container) &&
+            !handleContainerTerminate(id, container, restart.status))
+        {
+            // out of restart attempts, so remove the container which frees
+            // all the resources associated with it
+            stopped = true;
+            stoppedCd = restart.descriptor;
+            stoppedId = id;
+            stoppedStatus = restart.status;
+
+            mContainerExecPids.erase(id);
+            mContainers.erase(containerIt);
+        }
     }
 
+    // the container wasn't reported as stopped when it crashed, so do it
+    // now it's been given up on
+    if (stopped && mContainerStoppedCb)
+    {
+        mContainerStoppedCb(stoppedCd, stoppedId, stoppedStatus);
+    }
+
+    // start the timer for the next attempt if the restart failed
+    armContainerRestarts();
+
     AI_LOG_FN_EXIT();
-    return true;
 }
 
 // -----------------------------------------------------------------------------
@@ -1365,6 +1646,48 @@ bool DobbyManager::stopContainer(int32_t cd, bool withPrejudice)
     // flag so the container doesn't auto-respawn
     container->clearRestartOnCrash();
 
+    // if the container has crashed and is waiting to be restarted there is
+    // nothing left running, so just cancel the restart and tear it down now;
+    // the crash wasn't reported, so this is the only stopped callback
+    if (container->restartPending)
+    {
+        AI_LOG_INFO("cancelling pending restart of container '%s'", id.c_str());
+
+        container->restartPending = false;
+
+        int status = EXIT_FAILURE;
+        auto restartIt = mPendingRestarts.begin();
+        while (restartIt != mPendingRestarts.end())
+        {
+            // the timer handler is a no-op once the entry is removed
+            if (restartIt->second.descriptor == cd)
+            {
+                status = restartIt->second.status;
+                restartIt = mPendingRestarts.erase(restartIt);
+            }
+            else
+            {
+                ++restartIt;
+            }
+        }
+
+        handleContainerTerminate(id, container, EXIT_SUCCESS);
+
+        const ContainerId stoppedId = id;
+        mContainerExecPids.erase(stoppedId);
+        mContainers.erase(it);
+
+        locker.unlock();
+
+        if (mContainerStoppedCb)
+        {
+            mContainerStoppedCb(cd, stoppedId, status);
+        }
+
+        AI_LOG_FN_EXIT();
+        return true;
+    }
+
     if (container->state == DobbyContainer::State::Unknown)
     {
         // Container is in an unknown (i.e. bad) state. Don't attempt to stop it
@@ -2670,9 +2993,19 @@ int32_t DobbyManager::stateOfContainer(int32_t cd) const
  *                  "failcnt":0
  *              }
  *          }
+ *          "restart":{
+ *              "count":2,
+ *              "total":5,
+ *              "pending":true,
+ *              "nextRetryMs":480
+ *          }
  *          ...
  *      }
  *
+ *  The "restart" object gives the number of crash restarts in the current
+ *  budget window and over the container's lifetime, and if the container is
+ *  currently waiting to be restarted, the time until the next attempt.
+ *
  *  @param[in]  cd      The container descriptor
  *
  *  @return Json formatted string with the info for the container, on failure an
@@ -2738,6 +3071,18 @@ std::string DobbyManager::statsOfContainer(int32_t cd) const
             jsonStats["annotations"][annotation.first] = annotation.second;
         }
 
+        Json::Value restartInfo(Json::objectValue);
+        restartInfo["count"] = container->restartCount();
+        restartInfo["total"] = container->totalRestartCount();
+        restartInfo["pending"] = container->restartPending;
+        if (container->restartPending)
+        {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                container->restartTime - std::chrono::steady_clock::now());
+            restartInfo["nextRetryMs"] = Json::Int64(std::max<int64_t>(remaining.count(), 0));
+        }
+        jsonStats["restart"] = restartInfo;
+
         // convert the json stats to a string and return
         Json::StreamWriterBuilder builder;
         builder["indentation"] = " ";
@@ -2782,6 +3127,34 @@ std::string DobbyManager::ociConfigOfContainer(int32_t cd) const
     return std::string();
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the timings of the plugin hooks run by the daemon and the
+ *  hook server.
+ *
+ *  The server keeps its own metrics in its own process, so they're fetched
+ *  over the hook socket and added to the daemon's.  If the server can't be
+ *  reached only the daemon's metrics are returned.  Hooks run by separate
+ *  DobbyPluginLauncher processes are never included.
+ *
+ *  @return the combined metrics.
+ */
+DobbyPluginMetrics::Snapshot DobbyManager::pluginMetrics() const
+{
+    AI_LOG_FN_ENTRY();
+
+    DobbyPluginMetrics::Snapshot metrics = DobbyPluginMetrics::snapshot();
+
+    DobbyPluginMetrics::Snapshot serverMetrics;
+    if (mHookServer && mHookServer->getPluginMetrics(&serverMetrics))
+    {
+        DobbyPluginMetrics::merge(&metrics, serverMetrics);
+    }
+
+    AI_LOG_FN_EXIT();
+    return metrics;
+}
+
 #if defined(LEGACY_COMPONENTS)
 // -----------------------------------------------------------------------------
 /**
@@ -3256,16 +3629,30 @@ int DobbyManager::synthesizeContainerSignalStatus(int rawStatus)
  * @brief Perform all the necessary cleanup and run plugins required when
  * a container has terminated.
  *
- * Will also delete the container so the ID can be re-used
+ * If the container has the 'restartOnCrash' flag set and still has restart
+ * budget left then a restart is scheduled instead, the caller must then
+ * call armContainerRestarts() once mLock has been released.
  *
  * @param[in]   id          ID of the container that has terminated
  * @param[in]   container   Information about the container that has terminated (rootfs, config etc)
  * @param[in]   status      Exit status of the container runtime
+ *
+ * @return true if a restart has been scheduled, in which case the container
+ * must not be removed, otherwise false.
  */
-void DobbyManager::handleContainerTerminate(const ContainerId &id, const std::unique_ptr<DobbyContainer>& container, const int status)
+bool DobbyManager::handleContainerTerminate(const ContainerId &id, const std::unique_ptr<DobbyContainer>& container, const int status)
 {
     AI_LOG_FN_ENTRY();
 
+    // no longer interested in the container's cgroup, if the container is
+    // restarted a new watch is added
+    mCgroupMonitor->removeContainer(id);
+
+    if (mCpusetPlacer)
+    {
+        mCpusetPlacer->removeContainer(id);
+    }
+
     // this function is called when the runc process dies, what this
     // boils down to is that if we're in the Running state it
     // means that the preStart hook has been called but postStop hasn't
@@ -3282,15 +3669,22 @@ void DobbyManager::handleContainerTerminate(const ContainerId &id, const std::un
         container->state = DobbyContainer::State::Stopping;
     }
 
-    // check if the container has the respawn flag, if so attempt to
-    // restart the container now, this skips the preDestruction /
-    // postConstruction hooks
-    if (!container->shouldRestart(status) || !restartContainer(id, container))
+    // check if the container has the respawn flag, if so schedule a restart
+    // of the container, this skips the preDestruction / postConstruction
+    // hooks
+    if (container->shouldRestart(status))
+    {
+        scheduleContainerRestart(id, container, status);
+
+        AI_LOG_FN_EXIT();
+        return true;
+    }
+    else
     {
 #if defined(LEGACY_COMPONENTS)
-        // either the respawn flag isn't set, or we failed to restart
-        // the container, so call any pre-destruction hooks before
-        // tearing down the roots and bundle directories
+        // either the respawn flag isn't set, or we've run out of restart
+        // attempts, so call any pre-destruction hooks before tearing down the
+        // roots and bundle directories
         onPreDestructionHook(id, container);
 #endif // defined(LEGACY_COMPONENTS)
 
@@ -3332,6 +3726,13 @@ void DobbyManager::handleContainerTerminate(const ContainerId &id, const std::un
         // remove any metadata stored for the container
         mUtilities->clearContainerMetaData(id);
 
+        // the container's OCI hooks have all run, so the hook server can
+        // unload its plugins
+        if (mHookServer)
+        {
+            mHookServer->removeContainer(id);
+        }
+
         // If the container was launched from a custom config, delete
         // the custom config
         if (!container->customConfigFilePath.empty())
@@ -3345,6 +3746,7 @@ void DobbyManager::handleContainerTerminate(const ContainerId &id, const std::un
     }
 
     AI_LOG_FN_EXIT();
+    return false;
 }
 
 // -----------------------------------------------------------------------------
@@ -3372,7 +3774,7 @@ void DobbyManager::onChildExit()
     AI_LOG_DEBUG("detected child terminated signal");
 
     // take the lock as we're being called from the signal monitor thread
-    std::lock_guard<std::mutex> locker(mLock);
+    std::unique_lock<std::mutex> locker(mLock);
     std::vector<ContainerStoppedEvent> containerStoppedEvents;
 
     // find the container which has been launched by the given runc (use pid
@@ -3450,28 +3852,31 @@ void DobbyManager::onChildExit()
             AI_LOG_INFO("runc for container '%s' has quit (pid:%d status:0x%04x)",
                         id.c_str(), containerPid, status);
 
-            handleContainerTerminate(id, container, status);
+            const bool restartPending = handleContainerTerminate(id, container, status);
 
-            // signal the higher layers that a container has died, later
-            if (mContainerStoppedCb)
+            // signal the higher layers that a container has died, later; if
+            // it's going to be restarted this is deferred until it's given
+            // up on or stopped
+            if (mContainerStoppedCb && !restartPending)
             {
                 containerStoppedEvents.push_back({container->descriptor, id, status});
             }
 
-            if (!container->shouldRestart(status) || !restartContainer(id, container))
+            if (!restartPending)
             {
                 // remove the container, this should free all the resources
                 // associated with it
-                it = mContainers.erase(it);
-
                 mContainerExecPids.erase(id);
+
+                it = mContainers.erase(it);
+            }
+            else
+            {
+                // the container stays in the list until its restart timer
+                // fires, its pid has been cleared so it's skipped above
+                ++it;
             }
 
-            // on to the next container
-            // [ nb: we do this even if the container was restarted
-            //   (i.e. mContainers.erase not called), as we also want to check
-            //   that the newly restarted container (which has the same iterator)
-            //   has not also just died. ]
             continue;
         }
 
@@ -3517,6 +3922,88 @@ void DobbyManager::onChildExit()
         }
     }
 
+    // start the timers for any containers that need restarting, this has to
+    // be done without holding the lock
+    locker.unlock();
+    armContainerRestarts();
+
+    AI_LOG_FN_EXIT();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Called from the cgroup monitor thread when a container's cgroup
+ *  no longer has any processes in it.
+ *
+ *  For containers we launched this normally happens just before the SIGCHLD
+ *  for the container init arrives, running the exit handler here means the
+ *  container is cleaned up without waiting on the signal, and it also catches
+ *  inits that died without leaving a child for us to reap (onChildExit treats
+ *  those as dead if the pid no longer exists).
+ *
+ *  Stuck containers left over from a previous daemon instance aren't our
+ *  children, so if their cgroup empties they're destroyed here rather than
+ *  waiting for the next run of the invalid container cleanup task.
+ *
+ *  @param[in]  id      The id of the container whose cgroup is now empty.
+ */
+void DobbyManager::onContainerCgroupEmpty(const ContainerId &id)
+{
+    AI_LOG_FN_ENTRY();
+
+    onChildExit();
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    auto it = mContainers.find(id);
+    if ((it != mContainers.end()) &&
+        (it->second->state == DobbyContainer::State::Unknown))
+    {
+        std::shared_ptr<DobbyDevNullStream> devNull = std::make_shared<DobbyDevNullStream>();
+        if (mRunc->destroy(id, devNull))
+        {
+            AI_LOG_INFO("Previously stuck container '%s' has been destroyed - releasing id back to the pool", id.c_str());
+            mContainers.erase(it);
+        }
+    }
+
+    AI_LOG_FN_EXIT();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Called by the cgroup monitor when a process in a container has been
+ *  killed by the OOM killer.
+ *
+ *  This is called at the time of the kill, not when the container is torn
+ *  down, so the container may still be running (the victim may not have been
+ *  the container's init).  Called on the cgroup monitor's thread.
+ *
+ *  @param[in]  id          The id of the container.
+ *  @param[in]  victim      The pid of the killed process, or -1 if unknown.
+ */
+void DobbyManager::onContainerOOM(const ContainerId &id, pid_t victim)
+{
+    AI_LOG_FN_ENTRY();
+
+    int32_t cd = -1;
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+
+        auto it = mContainers.find(id);
+        if (it != mContainers.end())
+            cd = it->second->descriptor;
+    }
+
+    if (cd < 0)
+    {
+        AI_LOG_WARN("OOM event for unknown container '%s'", id.c_str());
+    }
+    else if (mContainerOomCb)
+    {
+        mContainerOomCb(cd, id, victim);
+    }
+
     AI_LOG_FN_EXIT();
 }
 
@@ -3681,6 +4168,7 @@ bool DobbyManager::invalidContainerCleanupTask()
                 {
                     // Container destroyed successfully, stop tracking it
                     AI_LOG_INFO("Previously stuck container '%s' has  been destroyed - releasing id back to the pool", it->first.c_str());
+                    mCgroupMonitor->removeContainer(it->first);
                     it = mContainers.erase(it);
                 }
             }
@@ -3701,6 +4189,7 @@ bool DobbyManager::invalidContainerCleanupTask()
                     {
                         // Container destroyed successfully, stop tracking it
                         AI_LOG_INFO("Previously stuck container %d has been destroyed - releasing id back to the pool", it->second->descriptor);
+                        mCgroupMonitor->removeContainer(it->first);
                         it = mContainers.erase(it);
                     }
                 }
@@ -3732,3 +4221,36 @@ bool DobbyManager::shouldEnableSTrace(const std::shared_ptr<DobbyConfig> &config
     return std::find(apps.begin(), apps.end(), hostName) != apps.end();
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Hands a newly started container to the cpuset placement engine.
+ *
+ *  Does nothing if automatic placement is disabled or the container's spec
+ *  has pinned its own cores.
+ *
+ *  @param[in]  id          The id of the container.
+ *  @param[in]  container   The container that has started.
+ */
+void DobbyManager::placeContainerCores(const ContainerId &id,
+                                       const std::unique_ptr<DobbyContainer> &container)
+{
+    if (!mCpusetPlacer)
+        return;
+
+    std::shared_ptr<rt_dobby_schema> containerConfig(container->config->config());
+    if (containerConfig == nullptr)
+        return;
+
+    if (containerConfig->linux && containerConfig->linux->resources &&
+        containerConfig->linux->resources->cpu &&
+        containerConfig->linux->resources->cpu->cpus)
+    {
+        AI_LOG_INFO("container '%s' has pinned cores '%s', not placing it",
+                    id.c_str(), containerConfig->linux->resources->cpu->cpus);
+        return;
+    }
+
+    const std::string hostName{containerConfig->hostname ? containerConfig->hostname : ""};
+    mCpusetPlacer->addContainer(id, hostName);
+}
+
@@ -38,13 +38,29 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <dirent.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include <linux/net_namespace.h>
 
 #include <set>
+#include <map>
 #include <regex>
+#include <mutex>
+#include <chrono>
+#include <functional>
 
 #include <sstream>
 #include <ext/stdio_filebuf.h>
 
+// how long a dump of the link counters is reused for
+#define LINK_STATS_MAX_AGE      std::chrono::milliseconds(500)
+
+// container metadata key the name of the host end of the container's veth is
+// stored under once it's been found
+#define VETH_METADATA_KEY       "network.veth"
+
 DobbyStats::DobbyStats(const ContainerId& id,
                        const std::shared_ptr<IDobbyEnv>& env,
                        const std::shared_ptr<IDobbyUtils> &utils)
@@ -61,6 +77,330 @@ const Json::Value& DobbyStats::stats() const
     return mStats;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Converts a json microsecond value read from a cgroup v2 file to
+ *  nanoseconds, to match the units used by the v1 cpuacct files.
+ *
+ *  Null and negative (unlimited) values are passed through as is.
+ */
+static Json::Value usecToNsec(const Json::Value &usec)
+{
+    if (!usec.isUInt64())
+        return usec;
+
+    return Json::Value(static_cast<Json::LargestUInt>(usec.asUInt64() * 1000ULL));
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Parses a whitespace separated list of 'key=value' tokens into the
+ *  given json object.
+ *
+ *  This is the format used by the cgroup v2 io.stat and *.pressure files,
+ *  values containing a decimal point are stored as doubles, everything else
+ *  is stored as an unsigned integer.
+ *
+ *  @param[in]  tokens      The (mutable) string of tokens to parse.
+ *  @param[out] object      The json object to add the fields to.
+ */
+static void parseNestedKeyValues(char *tokens, Json::Value &object)
+{
+    char *saveptr = nullptr;
+    char *token = strtok_r(tokens, " \t", &saveptr);
+    while (token)
+    {
+        char *equals = strchr(token, '=');
+        if (equals && (equals != token))
+        {
+            *equals = '\0';
+            const char *value = equals + 1;
+
+            if (strchr(value, '.'))
+                object[token] = strtod(value, nullptr);
+            else
+                object[token] = static_cast<Json::LargestUInt>(strtoull(value, nullptr, 10));
+        }
+
+        token = strtok_r(nullptr, " \t", &saveptr);
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Sends a route netlink request and passes each message of the reply
+ *  to @a handler until the reply is complete.
+ *
+ *  @return false if the request failed.
+ */
+template <typename Handler>
+static bool routeRequest(const void *request, size_t length, Handler handler)
+{
+    int sockFd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sockFd < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to create route netlink socket");
+        return false;
+    }
+
+    if (TEMP_FAILURE_RETRY(send(sockFd, request, length, 0)) != static_cast<ssize_t>(length))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to send route netlink request");
+        close(sockFd);
+        return false;
+    }
+
+    const bool dump = (reinterpret_cast<const struct nlmsghdr*>(request)->nlmsg_flags & NLM_F_DUMP);
+
+    std::vector<uint8_t> reply(65536);
+    bool done = false;
+    bool success = false;
+
+    while (!done)
+    {
+        ssize_t received = TEMP_FAILURE_RETRY(recv(sockFd, reply.data(), reply.size(), 0));
+        if (received <= 0)
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to read route netlink reply");
+            break;
+        }
+
+        size_t remaining = static_cast<size_t>(received);
+        const struct nlmsghdr *header = reinterpret_cast<const struct nlmsghdr*>(reply.data());
+        for (; !done && NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining))
+        {
+            if (header->nlmsg_type == NLMSG_DONE)
+            {
+                done = success = true;
+            }
+            else if (header->nlmsg_type == NLMSG_ERROR)
+            {
+                done = true;
+            }
+            else
+            {
+                handler(header);
+
+                // a reply that isn't a dump is the one message
+                if (!dump)
+                    done = success = true;
+            }
+        }
+    }
+
+    close(sockFd);
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Parses a RTM_NEWLINK message of a link dump.
+ *
+ *  @param[in]  header      The message.
+ *  @param[out] name        The name of the link.
+ *  @param[out] link        Its IFLA_STATS64 counters and IFLA_LINK_NETNSID.
+ *
+ *  @return false if the message isn't a link with a name and counters.
+ */
+bool DobbyStats::parseLinkMessage(const struct nlmsghdr *header,
+                                  std::string *name, LinkStats *link)
+{
+    if ((header->nlmsg_type != RTM_NEWLINK) ||
+        (header->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg))))
+        return false;
+
+    const struct ifinfomsg *info =
+        reinterpret_cast<const struct ifinfomsg*>(NLMSG_DATA(header));
+    int attrsLen = static_cast<int>(IFLA_PAYLOAD(header));
+
+    name->clear();
+    link->peerNsId = NETNSA_NSID_NOT_ASSIGNED;
+    bool haveCounters = false;
+
+    for (const struct rtattr *attr = IFLA_RTA(info); RTA_OK(attr, attrsLen);
+         attr = RTA_NEXT(attr, attrsLen))
+    {
+        if (attr->rta_type == IFLA_IFNAME)
+        {
+            const char *value = reinterpret_cast<const char*>(RTA_DATA(attr));
+            name->assign(value, strnlen(value, RTA_PAYLOAD(attr)));
+        }
+        else if ((attr->rta_type == IFLA_STATS64) &&
+                 (RTA_PAYLOAD(attr) >= sizeof(link->counters)))
+        {
+            memcpy(&link->counters, RTA_DATA(attr), sizeof(link->counters));
+            haveCounters = true;
+        }
+        else if ((attr->rta_type == IFLA_LINK_NETNSID) &&
+                 (RTA_PAYLOAD(attr) >= sizeof(link->peerNsId)))
+        {
+            memcpy(&link->peerNsId, RTA_DATA(attr), sizeof(link->peerNsId));
+        }
+    }
+
+    return !name->empty() && haveCounters;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Parses the RTM_NEWNSID reply to a RTM_GETNSID request.
+ *
+ *  @param[in]  header      The message.
+ *  @param[out] nsId        The NETNSA_NSID of the reply, left unchanged if
+ *                          it has none.
+ *
+ *  @return false if the message isn't a RTM_NEWNSID with an id.
+ */
+bool DobbyStats::parseNsIdMessage(const struct nlmsghdr *header, int32_t *nsId)
+{
+    if ((header->nlmsg_type != RTM_NEWNSID) ||
+        (header->nlmsg_len < NLMSG_LENGTH(sizeof(struct rtgenmsg))))
+        return false;
+
+    const struct rtattr *attr = reinterpret_cast<const struct rtattr*>(
+        reinterpret_cast<const uint8_t*>(NLMSG_DATA(header)) + NLMSG_ALIGN(sizeof(struct rtgenmsg)));
+    int attrsLen = static_cast<int>(header->nlmsg_len - NLMSG_LENGTH(NLMSG_ALIGN(sizeof(struct rtgenmsg))));
+
+    bool found = false;
+    for (; RTA_OK(attr, attrsLen); attr = RTA_NEXT(attr, attrsLen))
+    {
+        if ((attr->rta_type == NETNSA_NSID) && (RTA_PAYLOAD(attr) >= sizeof(*nsId)))
+        {
+            memcpy(nsId, RTA_DATA(attr), sizeof(*nsId));
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Dumps the counters of every link in the daemon's network namespace
+ *  with a single RTM_GETLINK request.
+ *
+ *  @param[out] links       Map of interface name to its counters.
+ *
+ *  @return false if the dump failed.
+ */
+bool DobbyStats::dumpLinkStats(std::map<std::string, LinkStats> *links)
+{
+    struct
+    {
+        struct nlmsghdr header;
+        struct ifinfomsg message;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = sizeof(request);
+    request.header.nlmsg_type = RTM_GETLINK;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = 1;
+    request.message.ifi_family = AF_UNSPEC;
+
+    return routeRequest(&request, sizeof(request), [&](const struct nlmsghdr *header)
+    {
+        std::string name;
+        LinkStats link;
+        if (parseLinkMessage(header, &name, &link))
+        {
+            (*links)[name] = link;
+        }
+    });
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the id the daemon's network namespace has for the network
+ *  namespace of the given process.
+ *
+ *  The kernel assigns the id when a link is created with its peer in that
+ *  namespace, which is how the host end of a veth refers to the container.
+ *
+ *  @return the id, or NETNSA_NSID_NOT_ASSIGNED if the namespace has none,
+ *  e.g. because it's the daemon's own.
+ */
+int32_t DobbyStats::getNetnsId(pid_t pid)
+{
+    struct
+    {
+        struct nlmsghdr header;
+        struct rtgenmsg message;
+        char padding[3];
+        struct rtattr pidAttr;
+        uint32_t pid;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = sizeof(request);
+    request.header.nlmsg_type = RTM_GETNSID;
+    request.header.nlmsg_flags = NLM_F_REQUEST;
+    request.header.nlmsg_seq = 1;
+    request.message.rtgen_family = AF_UNSPEC;
+    request.pidAttr.rta_type = NETNSA_PID;
+    request.pidAttr.rta_len = RTA_LENGTH(sizeof(request.pid));
+    request.pid = static_cast<uint32_t>(pid);
+
+    int32_t nsId = NETNSA_NSID_NOT_ASSIGNED;
+
+    routeRequest(&request, sizeof(request), [&](const struct nlmsghdr *header)
+    {
+        parseNsIdMessage(header, &nsId);
+    });
+
+    return nsId;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the counters of the first link that @a match accepts.
+ *
+ *  A link dump covers every container, so the result is kept and reused for
+ *  the stats requests that follow within LINK_STATS_MAX_AGE, i.e. a client
+ *  sampling all the containers in turn only causes one dump per pass rather
+ *  than a netlink request (or a sysfs read per counter) for each container.
+ *  If no link matches in a dump that's being reused then the links are dumped
+ *  again, as the link may have been created since.
+ *
+ *  @param[in]  match       Called with the name and stats of each link.
+ *  @param[out] name        The name of the link found.
+ *  @param[out] counters    Its counters.
+ *
+ *  @return false if no link matched.
+ */
+bool DobbyStats::getLinkStats(const std::function<bool(const std::string&, const LinkStats&)> &match,
+                              std::string *name, struct rtnl_link_stats64 *counters)
+{
+    static std::mutex lock;
+    static std::map<std::string, LinkStats> links;
+    static std::chrono::steady_clock::time_point dumpTime;
+
+    std::lock_guard<std::mutex> locker(lock);
+
+    auto findLink = [&]()
+    {
+        for (const auto &link : links)
+        {
+            if (match(link.first, link.second))
+            {
+                *name = link.first;
+                *counters = link.second.counters;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    const auto now = std::chrono::steady_clock::now();
+    if (!links.empty() && ((now - dumpTime) <= LINK_STATS_MAX_AGE) && findLink())
+        return true;
+
+    links.clear();
+    if (!dumpLinkStats(&links))
+        return false;
+
+    dumpTime = now;
+    return findLink();
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Gets the stats for the container
@@ -99,6 +439,48 @@ const Json::Value& DobbyStats::stats() const
  *          ...
  *      }
  *
+ *  On cgroups v2 some extra fields are added, these are read straight from the
+ *  kernel's key/value files so they keep the kernel's names and units (the
+ *  pressure 'total' values are in microseconds):
+ *
+ *      {
+ *          "cpu": {
+ *              "usage": { "total":734236982, "user":..., "system":... },
+ *              "throttling": {
+ *                  "periods":1200,
+ *                  "throttledPeriods":15,
+ *                  "throttledTime":48000000
+ *              },
+ *              "pressure": {
+ *                  "some": { "avg10":0.12, "avg60":0.05, "avg300":0.01, "total":30210 },
+ *                  "full": { ... }
+ *              }
+ *          },
+ *          "memory": {
+ *              "user": { ... },
+ *              "stat": { "anon":1236992, "file":8192, "shmem":0, "slab":90112, ... },
+ *              "events": { "low":0, "high":0, "max":0, "oom":0, "oom_kill":0 },
+ *              "pressure": { ... }
+ *          },
+ *          "io": {
+ *              "devices": {
+ *                  "179:0": { "rbytes":1459200, "wbytes":0, "rios":192, "wios":0, ... }
+ *              },
+ *              "pressure": { ... }
+ *          }
+ *      }
+ *
+ *  If the container has a veth from the Networking plugin then its traffic
+ *  counters are added, from the container's point of view:
+ *
+ *      {
+ *          "network": {
+ *              "interface": "veth0",
+ *              "rx": { "bytes":48213, "packets":310, "dropped":0, "errors":0 },
+ *              "tx": { "bytes":10322, "packets":122, "dropped":0, "errors":0 }
+ *          }
+ *      }
+ *
  *  @param[in]  id      The container id, assumed to also be the name of the
  *                      cgroups.
  *  @param[in]  env     The environment setup, used to get the mount point(s)
@@ -138,15 +520,23 @@ Json::Value DobbyStats::getStats(const ContainerId& id,
         }
         else
         {
-            // on v2, cpu accounting is under cpu.stat (usage_usec field)
-            // usage_usec is in microseconds; convert to nanoseconds to match v1
-            Json::Value usec = readCgroupKeyValue(id, cpuCgroupPath, "cpu.stat", "usage_usec");
-            if (usec.isNull())
-                stats["cpu"]["usage"]["total"] = Json::Value::null;
-            else
-                stats["cpu"]["usage"]["total"] =
-                    Json::Value(static_cast<Json::LargestUInt>(usec.asUInt64() * 1000ULL));
+            // on v2, cpu accounting and throttling are all under cpu.stat, the
+            // values are in microseconds so convert to nanoseconds to match v1
+            const Json::Value cpuStat =
+                readCgroupKeyValues(id, cpuCgroupPath, "cpu.stat");
+
+            stats["cpu"]["usage"]["total"] = usecToNsec(cpuStat["usage_usec"]);
+            stats["cpu"]["usage"]["user"] = usecToNsec(cpuStat["user_usec"]);
+            stats["cpu"]["usage"]["system"] = usecToNsec(cpuStat["system_usec"]);
             stats["cpu"]["usage"]["percpu"] = Json::Value::null;
+
+            stats["cpu"]["throttling"]["periods"] = cpuStat["nr_periods"];
+            stats["cpu"]["throttling"]["throttledPeriods"] = cpuStat["nr_throttled"];
+            stats["cpu"]["throttling"]["throttledTime"] =
+                usecToNsec(cpuStat["throttled_usec"]);
+
+            stats["cpu"]["pressure"] =
+                readCgroupPressure(id, cpuCgroupPath, "cpu.pressure");
         }
     }
 
@@ -184,11 +574,50 @@ Json::Value DobbyStats::getStats(const ContainerId& id,
                 readSingleCgroupValue(id, memCgroupPath, "memory.current");
             stats["memory"]["user"]["max"] =
                 readSingleCgroupValue(id, memCgroupPath, "memory.peak");
-            // v2 has no direct failcnt; oom_kill count is in memory.events
-            stats["memory"]["user"]["failcnt"] = Json::Value::null;
+
+            // v2 has no direct failcnt, the closest equivalent is the 'max'
+            // field in memory.events which counts the number of times the
+            // usage hit the limit
+            const Json::Value memEvents =
+                readCgroupKeyValues(id, memCgroupPath, "memory.events");
+            stats["memory"]["user"]["failcnt"] = memEvents["max"];
+            stats["memory"]["events"] = memEvents;
+
+            // only pick out the fields of memory.stat that are useful for
+            // seeing where the memory is going, the file has ~40 entries
+            static const char* memStatFields[] =
+            {
+                "anon", "file", "kernel_stack", "shmem", "slab",
+                "file_mapped", "file_dirty", "file_writeback",
+                "pgfault", "pgmajfault", "workingset_refault_file"
+            };
+
+            const Json::Value memStat =
+                readCgroupKeyValues(id, memCgroupPath, "memory.stat");
+            if (memStat.isObject())
+            {
+                for (const char* field : memStatFields)
+                {
+                    if (memStat.isMember(field))
+                        stats["memory"]["stat"][field] = memStat[field];
+                }
+            }
+
+            stats["memory"]["pressure"] =
+                readCgroupPressure(id, memCgroupPath, "memory.pressure");
         }
     }
 
+    // the io controller is only a reliable source of per-container stats on
+    // v2, on v1 the blkio counters miss all the buffered writes
+    const std::string ioCgroupPath(env->cgroupMountPath(IDobbyEnv::Cgroup::Blkio));
+    if (!ioCgroupPath.empty() && (cgroupVer == IDobbyEnv::CgroupVersion::V2))
+    {
+        stats["io"]["devices"] = readCgroupIoStat(id, ioCgroupPath);
+        stats["io"]["pressure"] =
+            readCgroupPressure(id, ioCgroupPath, "io.pressure");
+    }
+
     const std::string gpuCgroupPath(env->cgroupMountPath(IDobbyEnv::Cgroup::Gpu));
     if (!gpuCgroupPath.empty())
     {
@@ -226,11 +655,105 @@ Json::Value DobbyStats::getStats(const ContainerId& id,
     }
 #endif
 
+    const Json::Value &pids = stats["pids"];
+    const pid_t pid = (pids.isArray() && !pids.empty() && pids[0].isIntegral()) ?
+                      static_cast<pid_t>(pids[0].asInt()) : -1;
+
+    const Json::Value network = getNetworkStats(id, pid, utils);
+    if (!network.isNull())
+    {
+        stats["network"] = network;
+    }
 
     AI_LOG_FN_EXIT();
     return stats;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Converts the counters of the host end of a container's veth to the
+ *  container's "network" stats.
+ *
+ *  The rx and tx counters are swapped, so they read as the traffic received
+ *  and sent by the container.
+ */
+Json::Value DobbyStats::networkStatsJson(const std::string &vethName,
+                                         const struct rtnl_link_stats64 &counters)
+{
+    Json::Value network(Json::objectValue);
+    network["interface"] = vethName;
+
+    network["rx"]["bytes"] = static_cast<Json::LargestUInt>(counters.tx_bytes);
+    network["rx"]["packets"] = static_cast<Json::LargestUInt>(counters.tx_packets);
+    network["rx"]["dropped"] = static_cast<Json::LargestUInt>(counters.tx_dropped);
+    network["rx"]["errors"] = static_cast<Json::LargestUInt>(counters.tx_errors);
+
+    network["tx"]["bytes"] = static_cast<Json::LargestUInt>(counters.rx_bytes);
+    network["tx"]["packets"] = static_cast<Json::LargestUInt>(counters.rx_packets);
+    network["tx"]["dropped"] = static_cast<Json::LargestUInt>(counters.rx_dropped);
+    network["tx"]["errors"] = static_cast<Json::LargestUInt>(counters.rx_errors);
+
+    return network;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads the traffic counters of the container's veth.
+ *
+ *  The veth is set up by the Networking plugin in the hook process, so the
+ *  daemon asks the kernel instead: the host end is the link whose peer is in
+ *  the container's network namespace.  Its name is then kept in the container
+ *  metadata, which is cleared when the container is torn down, so the lookup
+ *  is only done once per container.
+ *
+ *  @param[in]  id              The string id of the container.
+ *  @param[in]  pid             A process in the container.
+ *  @param[in]  utils           Used for the container metadata.
+ *
+ *  @return A JSON object with the counters, or null if the container has no
+ *  veth.
+ */
+Json::Value DobbyStats::getNetworkStats(const ContainerId& id, pid_t pid,
+                                        const std::shared_ptr<IDobbyUtils> &utils)
+{
+    if (!utils)
+        return Json::Value::null;
+
+    std::string vethName = utils->getStringMetaData(id, VETH_METADATA_KEY);
+    struct rtnl_link_stats64 counters;
+
+    if (!vethName.empty())
+    {
+        const std::string storedName = vethName;
+        if (!getLinkStats([&](const std::string &name, const LinkStats&)
+                          { return (name == storedName); },
+                          &vethName, &counters))
+        {
+            AI_LOG_DEBUG("no link stats for '%s'", storedName.c_str());
+            return Json::Value::null;
+        }
+    }
+    else
+    {
+        // a container sharing the daemon's namespace, or one with nothing
+        // linked to it, has no id in the daemon's namespace
+        const int32_t nsId = (pid > 0) ? getNetnsId(pid) : NETNSA_NSID_NOT_ASSIGNED;
+        if (nsId == NETNSA_NSID_NOT_ASSIGNED)
+            return Json::Value::null;
+
+        if (!getLinkStats([nsId](const std::string&, const LinkStats &link)
+                          { return (link.peerNsId == nsId); },
+                          &vethName, &counters))
+        {
+            return Json::Value::null;
+        }
+
+        utils->setStringMetaData(id, VETH_METADATA_KEY, vethName);
+    }
+
+    return networkStatsJson(vethName, counters);
+}
+
 #if defined(RDK)
 // -----------------------------------------------------------------------------
 /**
@@ -398,51 +921,146 @@ Json::Value DobbyStats::readSingleCgroupValue(const ContainerId& id,
 
 // -----------------------------------------------------------------------------
 /**
- *  @brief Reads a named value from a key-value format cgroup file.
+ *  @brief Reads all the values from a key-value format cgroup file.
  *
- *  Cgroups v2 files like cpu.stat use a key-value format with one pair per
- *  line, e.g.:
+ *  Cgroups v2 files like cpu.stat, memory.stat and memory.events use a
+ *  key-value format with one pair per line, e.g.:
  *      usage_usec 123456
  *      user_usec 100000
  *      system_usec 23456
  *
+ *  The whole file is tokenised in one pass and every entry is returned, this
+ *  avoids re-reading the file for each field we're interested in.
+ *
  *  @param[in]  id              The string id of the container.
  *  @param[in]  cgroupMntPath   The path to the cgroup mount point.
  *  @param[in]  cgroupfileName  The name of the cgroup file.
- *  @param[in]  key             The key whose value to extract.
  *
- *  @return The value as a json integer, or null if not found.
+ *  @return A json object containing all the key value pairs, or null if the
+ *  file couldn't be read.
  */
-Json::Value DobbyStats::readCgroupKeyValue(const ContainerId& id,
-                                           const std::string& cgroupMntPath,
-                                           const std::string& cgroupfileName,
-                                           const std::string& key)
+Json::Value DobbyStats::readCgroupKeyValues(const ContainerId& id,
+                                            const std::string& cgroupMntPath,
+                                            const std::string& cgroupfileName)
 {
     char buf[4096];
 
     if (readCgroupFile(id, cgroupMntPath, cgroupfileName, buf, sizeof(buf)) <= 0)
         return Json::Value::null;
 
-    // Parse line by line looking for "key value"
+    Json::Value values(Json::objectValue);
+
     char* saveptr = nullptr;
     char* line = strtok_r(buf, "\n", &saveptr);
     while (line)
     {
-        char keyBuf[64] = {};
-        unsigned long long value = 0;
-        if (sscanf(line, "%63s %llu", keyBuf, &value) == 2)
+        char* value = strchr(line, ' ');
+        if (value && (value != line))
         {
-            if (key == keyBuf)
-            {
-                if (value == ULONG_LONG_MAX)
-                    return Json::Value(-1);
-                return Json::Value(static_cast<Json::LargestUInt>(value));
-            }
+            *value++ = '\0';
+
+            unsigned long long number = strtoull(value, nullptr, 10);
+            if (number == ULONG_LONG_MAX)
+                values[line] = -1;
+            else
+                values[line] = static_cast<Json::LargestUInt>(number);
         }
+
         line = strtok_r(nullptr, "\n", &saveptr);
     }
 
-    return Json::Value::null;
+    return values;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads the per-device io stats from the cgroup v2 io.stat file.
+ *
+ *  The file contains one line per block device the container has done io
+ *  on, e.g.:
+ *      179:0 rbytes=1459200 wbytes=314773504 rios=192 wios=353 dbytes=0 dios=0
+ *
+ *  @param[in]  id              The string id of the container.
+ *  @param[in]  cgroupMntPath   The path to the cgroup mount point.
+ *
+ *  @return A json object keyed by the "major:minor" device number, or null if
+ *  the file couldn't be read.
+ */
+Json::Value DobbyStats::readCgroupIoStat(const ContainerId& id,
+                                         const std::string& cgroupMntPath)
+{
+    // io.stat can get long if the container has touched a lot of devices
+    char buf[8192];
+
+    ssize_t rd = readCgroupFile(id, cgroupMntPath, "io.stat", buf, sizeof(buf));
+    if (rd < 0)
+        return Json::Value::null;
+
+    Json::Value devices(Json::objectValue);
+    if (rd == 0)
+        return devices;
+
+    char* lineSaveptr = nullptr;
+    char* line = strtok_r(buf, "\n", &lineSaveptr);
+    while (line)
+    {
+        char* fields = strchr(line, ' ');
+        if (fields && (fields != line))
+        {
+            *fields++ = '\0';
+            parseNestedKeyValues(fields, devices[line]);
+        }
+
+        line = strtok_r(nullptr, "\n", &lineSaveptr);
+    }
+
+    return devices;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads one of the cgroup v2 pressure stall information files.
+ *
+ *  The cpu.pressure, memory.pressure and io.pressure files all have the same
+ *  format, e.g.:
+ *      some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+ *      full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+ *
+ *  The files only exist if the kernel was built with CONFIG_PSI.
+ *
+ *  @param[in]  id              The string id of the container.
+ *  @param[in]  cgroupMntPath   The path to the cgroup mount point.
+ *  @param[in]  cgroupfileName  The name of the pressure file.
+ *
+ *  @return A json object with "some" and (possibly) "full" objects, or null
+ *  if the file couldn't be read.
+ */
+Json::Value DobbyStats::readCgroupPressure(const ContainerId& id,
+                                           const std::string& cgroupMntPath,
+                                           const std::string& cgroupfileName)
+{
+    char buf[256];
+
+    if (readCgroupFile(id, cgroupMntPath, cgroupfileName, buf, sizeof(buf)) <= 0)
+        return Json::Value::null;
+
+    Json::Value pressure(Json::objectValue);
+
+    char* lineSaveptr = nullptr;
+    char* line = strtok_r(buf, "\n", &lineSaveptr);
+    while (line)
+    {
+        char* fields = strchr(line, ' ');
+        if (fields && (fields != line))
+        {
+            *fields++ = '\0';
+            parseNestedKeyValues(fields, pressure[line]);
+        }
+
+        line = strtok_r(nullptr, "\n", &lineSaveptr);
+    }
+
+    return pressure;
 }
 
 // -----------------------------------------------------------------------------
@@ -0,0 +1,153 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyCgroupMonitor.h
+ *
+ */
+#ifndef DOBBYCGROUPMONITOR_H
+#define DOBBYCGROUPMONITOR_H
+
+#include "ContainerId.h"
+#include "IDobbyEnv.h"
+#include "PollLoop.h"
+
+#include <map>
+#include <list>
+#include <set>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <functional>
+
+#include <sys/types.h>
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class DobbyCgroupMonitor
+ *  @brief Watches the cgroup files of running containers for exit and OOM
+ *  events.
+ *
+ *  On cgroups v2 the kernel flips the 'populated' field of a cgroup's
+ *  cgroup.events file to 0 the moment the last process in the cgroup exits,
+ *  and generates an inotify IN_MODIFY event on the file when it does.  This
+ *  class watches those files on its own poll loop thread and calls the
+ *  supplied callback when a container's cgroup becomes empty.
+ *
+ *  It is intended as an additional trigger alongside SIGCHLD, it catches
+ *  containers whose init isn't a child of the daemon (for example containers
+ *  left over from a previous daemon instance) and for which SIGCHLD will
+ *  never be delivered.
+ *
+ *  Each exit watch is one-shot; once the callback has been called for a
+ *  container all its watches are removed and must be re-added if the
+ *  container is restarted.
+ *
+ *  The monitor also reports OOM kills as they happen, rather than after the
+ *  container has gone.  On cgroups v2 it watches the 'oom_kill' counter in
+ *  memory.events, on cgroups v1 it registers an eventfd against
+ *  memory.oom_control.  The pid of the killed process (in the daemon's pid
+ *  namespace) is only reported when the oom_kill count went up by one and
+ *  a single process in the cgroup has a SIGKILL pending, otherwise -1 is
+ *  reported rather than a guess.
+ *
+ *  On cgroups v1 there is no equivalent of cgroup.events so only OOM events
+ *  are reported.
+ */
+class DobbyCgroupMonitor
+{
+public:
+    typedef std::function<void(const ContainerId &id)> ContainerEmptyFunc;
+    typedef std::function<void(const ContainerId &id, pid_t victim)> ContainerOomFunc;
+
+public:
+    DobbyCgroupMonitor(const std::shared_ptr<IDobbyEnv> &env,
+                       const ContainerEmptyFunc &containerEmptyCb,
+                       const ContainerOomFunc &containerOomCb);
+    ~DobbyCgroupMonitor();
+
+public:
+    void stop();
+
+    bool addContainer(const ContainerId &id);
+    void removeContainer(const ContainerId &id);
+
+private:
+    class InotifySource;
+    class OomEventSource;
+
+    struct OomEvent
+    {
+        ContainerId id;
+        pid_t victim;
+    };
+
+    void onInotifyEvents();
+    void onOomEventFd(int eventFd);
+
+    bool addCgroupV2Watches(const ContainerId &id);
+    bool addCgroupV1OomWatch(const ContainerId &id);
+
+    std::string findCgroupDir(const std::string &mountPoint,
+                              const ContainerId &id) const;
+    static bool isPopulated(const std::string &eventsFilePath);
+    static bool readOomKillCount(const std::string &filePath,
+                                 unsigned long *count);
+    static std::set<pid_t> readCgroupProcs(const std::string &cgroupDir);
+    static bool isBeingKilled(pid_t pid);
+    static pid_t findOomVictim(const std::string &cgroupDir,
+                               unsigned long newKills);
+
+    void notifyContainers(const std::list<ContainerId> &emptyContainers,
+                          const std::list<OomEvent> &oomEvents) const;
+
+private:
+    const ContainerEmptyFunc mContainerEmptyCb;
+    const ContainerOomFunc mContainerOomCb;
+    const IDobbyEnv::CgroupVersion mCgroupVersion;
+    const std::string mCgroupMountPath;
+
+    std::mutex mLock;
+    int mInotifyFd;
+
+    enum class WatchType { CgroupEvents, MemoryEvents };
+    struct Watch
+    {
+        ContainerId id;
+        WatchType type;
+        std::string cgroupDir;
+        std::string filePath;
+        unsigned long oomKills;
+    };
+    std::map<int, Watch> mWatches;
+
+    struct OomEventFd
+    {
+        ContainerId id;
+        std::string cgroupDir;
+        unsigned long oomKills;
+        std::shared_ptr<OomEventSource> source;
+    };
+    std::map<int, OomEventFd> mOomEventFds;
+
+    std::shared_ptr<AICommon::PollLoop> mPollLoop;
+    std::shared_ptr<InotifySource> mInotifySource;
+};
+
+#endif // !defined(DOBBYCGROUPMONITOR_H)
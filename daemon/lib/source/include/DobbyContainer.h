@@ -96,18 +96,29 @@ public:
     // to issue a targeted WakeupProcess only for the one in-flight PID.
     uint32_t hibernatingPid = 0;
 
+    // Set while the container has crashed and is waiting for the restart
+    // timer to fire, restartTime is when the timer is due.  Both are
+    // written under the DobbyManager mLock.
+    bool restartPending = false;
+    std::chrono::time_point<std::chrono::steady_clock> restartTime;
+
 public:
     void setRestartOnCrash(const std::list<int>& files);
     void clearRestartOnCrash();
 
     bool shouldRestart(int statusCode);
+    std::chrono::milliseconds restartBackoff() const;
     const std::list<int>& files() const;
 
+    unsigned restartCount() const;
+    unsigned totalRestartCount() const;
+
 private:
     bool mRestartOnCrash;
     std::list<int> mFiles;
 
     unsigned mRestartCount;
+    unsigned mTotalRestartCount;
     std::chrono::time_point<std::chrono::steady_clock> mLastRestartAttempt;
 
 private:
@@ -0,0 +1,121 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyCpusetPlacer.h
+ *
+ */
+#ifndef DOBBYCPUSETPLACER_H
+#define DOBBYCPUSETPLACER_H
+
+#include "ContainerId.h"
+#include "IDobbyEnv.h"
+#include "IDobbyUtils.h"
+#include "IDobbySettings.h"
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class DobbyCpusetPlacer
+ *  @brief Chooses which cores running containers are allowed to run on.
+ *
+ *  Containers that don't pin their own cores (see the 'cpu.cores' field of
+ *  the Dobby spec) are handed to this class once started.  It keeps track of
+ *  the cores assigned to each container and places them by writing the
+ *  container's cpuset.cpus file directly, which the kernel applies to the
+ *  running processes immediately.
+ *
+ *  Containers whose app name is listed in the foregroundApps setting are
+ *  isolated onto a set of dedicated cores (the highest numbered ones) while
+ *  they are running, all other containers are moved off those cores.  This
+ *  stops background services thrashing the foreground app's caches.
+ *
+ *  If the coresPerContainer setting is non-zero each background container is
+ *  limited to that many cores, chosen to be the least loaded ones.  The load
+ *  is worked out from the cpu usage of the containers over the last rebalance
+ *  period, and the placement is recalculated each period, when containers
+ *  are added or removed.  Only containers whose cores actually change have
+ *  their cpuset.cpus rewritten.
+ */
+class DobbyCpusetPlacer
+{
+public:
+    DobbyCpusetPlacer(const std::shared_ptr<IDobbyEnv> &env,
+                      const std::shared_ptr<IDobbyUtils> &utils,
+                      const IDobbySettings::CpusetPlacementSettings &settings);
+    ~DobbyCpusetPlacer();
+
+public:
+    bool addContainer(const ContainerId &id, const std::string &appName);
+    void removeContainer(const ContainerId &id);
+
+private:
+    struct Container
+    {
+        std::string cpusetPath;
+        std::string cpuUsagePath;
+        bool foreground;
+        std::vector<unsigned> cores;
+        uint64_t lastUsage;
+        std::chrono::steady_clock::time_point lastSampleTime;
+        double load;
+    };
+
+    bool onRebalanceTimer();
+
+    void updateLoads();
+    void placeContainers();
+    std::vector<unsigned> leastLoadedCores(const std::vector<unsigned> &pool,
+                                           size_t count,
+                                           const std::vector<unsigned> &current,
+                                           const std::map<unsigned, double> &coreLoads) const;
+    bool applyCores(const ContainerId &id, Container &container,
+                    const std::vector<unsigned> &cores) const;
+
+    bool readCpuUsage(const std::string &filePath, uint64_t *usage) const;
+    std::vector<unsigned> readAvailableCores() const;
+    std::string findCgroupDir(const std::string &mountPoint,
+                              const ContainerId &id) const;
+
+    static std::vector<unsigned> parseCpuList(const std::string &str);
+    static std::string formatCpuList(const std::vector<unsigned> &cores);
+
+private:
+    const std::shared_ptr<IDobbyUtils> mUtilities;
+    const IDobbySettings::CpusetPlacementSettings mSettings;
+    const IDobbyEnv::CgroupVersion mCgroupVersion;
+    const std::string mCpusetMountPath;
+    const std::string mCpuAcctMountPath;
+
+    std::vector<unsigned> mCores;
+
+    std::mutex mLock;
+    std::map<ContainerId, Container> mContainers;
+
+    int mRebalanceTimerId;
+};
+
+#endif // !defined(DOBBYCPUSETPLACER_H)
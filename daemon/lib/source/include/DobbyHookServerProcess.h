@@ -0,0 +1,83 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyHookServerProcess.h
+ *
+ */
+#ifndef DOBBYHOOKSERVERPROCESS_H
+#define DOBBYHOOKSERVERPROCESS_H
+
+#include "ContainerId.h"
+#include "DobbyPluginMetrics.h"
+
+#include <mutex>
+#include <thread>
+#include <string>
+#include <condition_variable>
+
+#include <sys/types.h>
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class DobbyHookServerProcess
+ *  @brief Spawns and supervises the hook server process.
+ *
+ *  The hook server (see DobbyHookServer in the plugin launcher) keeps the
+ *  RDK plugins loaded between OCI hooks so that the launcher doesn't have to
+ *  parse the config and dlopen the plugins for every hook.  The plugins are
+ *  still only ever loaded by a DobbyPluginLauncher process, this class just
+ *  runs a long lived 'DobbyPluginLauncher --server=PATH' instance and starts
+ *  a new one if it exits, backing off if it keeps failing.
+ *
+ *  While the server isn't running the launcher runs the hooks itself, so a
+ *  restart only costs the speed up, not the hooks.
+ */
+class DobbyHookServerProcess
+{
+public:
+    DobbyHookServerProcess(const std::string &socketPath,
+                           const std::string &launcherPath);
+    ~DobbyHookServerProcess();
+
+public:
+    void removeContainer(const ContainerId &id);
+
+    bool getPluginMetrics(DobbyPluginMetrics::Snapshot *snapshot) const;
+
+private:
+    bool sendRequest(const std::string &request,
+                     int32_t *result, std::string *payload) const;
+
+    void run();
+    pid_t spawnServer() const;
+
+private:
+    const std::string mSocketPath;
+    const std::string mLauncherPath;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    bool mStop;
+    pid_t mPid;
+
+    std::thread mThread;
+};
+
+#endif // !defined(DOBBYHOOKSERVERPROCESS_H)
@@ -100,6 +100,8 @@ private:
     typedef std::function<bool (IDobbyPlugin*, const Json::Value&)> HookFn;
 
     bool executeHooks(const std::map<std::string, Json::Value>& plugins,
+                      const char* hookName,
+                      const ContainerId& id,
                       const HookFn& hookFn,
                       unsigned asyncFlag,
                       unsigned syncFlag) const;
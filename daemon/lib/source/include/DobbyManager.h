@@ -31,6 +31,10 @@
 #include "ContainerId.h"
 #include "DobbyLogger.h"
 #include "DobbyRunC.h"
+#include "DobbyCgroupMonitor.h"
+#include "DobbyCpusetPlacer.h"
+#include "DobbyHookServerProcess.h"
+#include "DobbyPluginMetrics.h"
 #include <IIpcService.h>
 
 #include <pthread.h>
@@ -43,6 +47,7 @@
 #include <string>
 #include <memory>
 #include <future>
+#include <chrono>
 #include <functional>
 #include <netinet/in.h>
 #include <semaphore.h>
@@ -79,6 +84,8 @@ public:
     typedef std::function<void(int32_t cd, const ContainerId& id)> ContainerStartedFunc;
     typedef std::function<void(int32_t cd, const ContainerId& id, int32_t status)> ContainerStoppedFunc;
     typedef std::function<void(int32_t cd, const ContainerId& id)> ContainerHibernatedFunc;
+    typedef std::function<void(int32_t cd, const ContainerId& id, pid_t victim)> ContainerOomFunc;
+    typedef std::function<bool(std::function<void()>&& work)> PostWorkFunc;
 
 public:
     DobbyManager(const std::shared_ptr<IDobbyEnv>& env,
@@ -88,7 +95,9 @@ public:
                  const ContainerStartedFunc& containerStartedCb,
                  const ContainerStoppedFunc& containerStoppedCb,
                  const ContainerHibernatedFunc& containerHibernatedCb,
-                 const ContainerHibernatedFunc& containerAwokenCb);
+                 const ContainerHibernatedFunc& containerAwokenCb,
+                 const ContainerOomFunc& containerOomCb = nullptr,
+                 const PostWorkFunc& postWorkCb = nullptr);
     ~DobbyManager();
 
 private:
@@ -146,6 +155,9 @@ public:
 public:
     std::string ociConfigOfContainer(int32_t cd) const;
 
+public:
+    DobbyPluginMetrics::Snapshot pluginMetrics() const;
+
 #if defined(LEGACY_COMPONENTS)
 public:
     std::string specOfContainer(int32_t cd) const;
@@ -159,8 +171,10 @@ public:
     static int synthesizeContainerSignalStatus(int rawStatus);
 
 private:
-    void handleContainerTerminate(const ContainerId &id, const std::unique_ptr<DobbyContainer>& container, const int status);
+    bool handleContainerTerminate(const ContainerId &id, const std::unique_ptr<DobbyContainer>& container, const int status);
     void onChildExit();
+    void onContainerCgroupEmpty(const ContainerId &id);
+    void onContainerOOM(const ContainerId &id, pid_t victim);
 
 private:
     std::shared_ptr<IDobbyRdkLoggingPlugin>
@@ -182,6 +196,14 @@ private:
     bool restartContainer(const ContainerId& id,
                           const std::unique_ptr<DobbyContainer>& container);
 
+    void scheduleContainerRestart(const ContainerId& id,
+                                  const std::unique_ptr<DobbyContainer>& container,
+                                  int status);
+    void armContainerRestarts();
+    void cancelContainerRestarts();
+    bool onContainerRestartTimer(unsigned token);
+    void restartPendingContainer(unsigned token);
+
     bool abortContainerHibernationIfNeeded(int32_t cd);
 
 private:
@@ -189,6 +211,8 @@ private:
     ContainerStoppedFunc mContainerStoppedCb;
     ContainerHibernatedFunc mContainerHibernatedCb;
     ContainerHibernatedFunc mContainerAwokenCb;
+    ContainerOomFunc mContainerOomCb;
+    PostWorkFunc mPostWorkCb;
 
 private:
     mutable std::mutex mLock;
@@ -227,6 +251,8 @@ private:
     bool invalidContainerCleanupTask();
 
     bool shouldEnableSTrace(const std::shared_ptr<DobbyConfig> &config) const;
+    void placeContainerCores(const ContainerId &id,
+                             const std::unique_ptr<DobbyContainer> &container);
 private:
     const std::shared_ptr<IDobbyEnv> mEnvironment;
     const std::shared_ptr<IDobbyUtils> mUtilities;
@@ -236,6 +262,9 @@ private:
 private:
     std::unique_ptr<DobbyLogger> mLogger;
     std::unique_ptr<DobbyRunC> mRunc;
+    std::unique_ptr<DobbyCgroupMonitor> mCgroupMonitor;
+    std::unique_ptr<DobbyCpusetPlacer> mCpusetPlacer;
+    std::unique_ptr<DobbyHookServerProcess> mHookServer;
 
 private:
     sem_t mRuncMonitorThreadStartedSem;
@@ -243,6 +272,22 @@ private:
     std::atomic<bool> mRuncMonitorTerminate;
     int mCleanupTaskTimerId;
 
+private:
+    // Crashed containers waiting to be restarted, keyed by a unique token
+    // that is passed to the restart timer handler.  timerId is -1 until the
+    // timer has been started, which is always done without mLock held as the
+    // timer thread holds its own lock while calling handlers that take mLock.
+    struct PendingRestart
+    {
+        ContainerId id;
+        int32_t descriptor;
+        std::chrono::milliseconds delay;
+        int timerId;
+        int status;
+    };
+    std::map<unsigned, PendingRestart> mPendingRestarts;
+    unsigned mRestartTokenCounter;
+
 #if defined(LEGACY_COMPONENTS)
 private:
     std::unique_ptr<DobbyLegacyPluginManager> mLegacyPlugins;
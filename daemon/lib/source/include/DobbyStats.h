@@ -27,8 +27,12 @@
 #include <IDobbyEnv.h>
 #include "IDobbyUtils.h"
 
+#include <map>
 #include <memory>
 #include <string>
+#include <functional>
+
+#include <linux/if_link.h>
 
 #if defined(RDK)
 #include <json/json.h>
@@ -37,6 +41,7 @@
 #endif
 
 class IDobbyEnv;
+struct nlmsghdr;
 
 // -----------------------------------------------------------------------------
 /**
@@ -78,6 +83,14 @@ private:
         }
     } Process;
 
+    // the counters of a link and the id of the network namespace its peer is
+    // in, or NETNSA_NSID_NOT_ASSIGNED if it has no peer elsewhere
+    typedef struct LinkStats
+    {
+        struct rtnl_link_stats64 counters;
+        int32_t peerNsId;
+    } LinkStats;
+
 private:
     static ssize_t readCgroupFile(const ContainerId &id,
                                   const std::string &cgroupMntPath,
@@ -88,10 +101,16 @@ private:
                                              const std::string &cgroupMntPath,
                                              const std::string &cgroupfileName);
 
-    static Json::Value readCgroupKeyValue(const ContainerId &id,
+    static Json::Value readCgroupKeyValues(const ContainerId &id,
+                                           const std::string &cgroupMntPath,
+                                           const std::string &cgroupfileName);
+
+    static Json::Value readCgroupIoStat(const ContainerId &id,
+                                        const std::string &cgroupMntPath);
+
+    static Json::Value readCgroupPressure(const ContainerId &id,
                                           const std::string &cgroupMntPath,
-                                          const std::string &cgroupfileName,
-                                          const std::string &key);
+                                          const std::string &cgroupfileName);
 
     static std::vector<int64_t> readMultipleCgroupValues(const ContainerId &id,
                                                          const std::string &cgroupMntPath,
@@ -105,6 +124,24 @@ private:
                                 const std::shared_ptr<IDobbyEnv> &env,
                                 const std::shared_ptr<IDobbyUtils> &utils);
 
+    static Json::Value getNetworkStats(const ContainerId &id, pid_t pid,
+                                       const std::shared_ptr<IDobbyUtils> &utils);
+
+    static bool dumpLinkStats(std::map<std::string, LinkStats> *links);
+
+    static int32_t getNetnsId(pid_t pid);
+
+    static bool getLinkStats(const std::function<bool(const std::string&, const LinkStats&)> &match,
+                             std::string *name, struct rtnl_link_stats64 *counters);
+
+    static bool parseLinkMessage(const struct nlmsghdr *header,
+                                 std::string *name, LinkStats *link);
+
+    static bool parseNsIdMessage(const struct nlmsghdr *header, int32_t *nsId);
+
+    static Json::Value networkStatsJson(const std::string &vethName,
+                                        const struct rtnl_link_stats64 &counters);
+
     static Json::Value getProcessTree(const ContainerId &id,
                                       const std::string &cpuCgroupMntPath,
                                       const std::shared_ptr<IDobbyUtils> &utils);
@@ -0,0 +1,70 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyHookServerProtocol.h
+ *
+ *  Definitions shared between DobbyPluginLauncher and the hook server, which
+ *  is a 'DobbyPluginLauncher --server' process spawned by the daemon.
+ *
+ *  The launcher connects to the SOCK_SEQPACKET unix socket below and sends a
+ *  single request packet made up of three fields separated by '\0';
+ *
+ *      <hook name> '\0' <absolute path to config.json> '\0' <OCI state json>
+ *
+ *  The server replies with a single int32_t, one of the DobbyHookResult
+ *  values.  If the reply is HookNotHandled (or the server can't be reached)
+ *  the launcher runs the plugins itself as it always has.
+ *
+ *  The daemon uses the same packet format to tell the server a container has
+ *  gone, with HOOK_SERVER_RELEASE_REQUEST as the hook name, an empty config
+ *  path and the container id in place of the state.  It also asks for the
+ *  server's plugin hook timings with HOOK_SERVER_METRICS_REQUEST as the hook
+ *  name and the other fields empty, the HookSuccess reply is followed in the
+ *  same packet by the DobbyPluginMetrics::serialise() output.
+ */
+#ifndef DOBBYHOOKSERVERPROTOCOL_H
+#define DOBBYHOOKSERVERPROTOCOL_H
+
+#include <stdint.h>
+
+// Can override the socket path at build time by setting -DHOOK_SERVER_SOCKET_PATH=/path/to/socket
+#ifndef HOOK_SERVER_SOCKET_PATH
+    #define HOOK_SERVER_SOCKET_PATH     "/var/run/rdk/dobby-hooks.sock"
+#endif
+
+// The 'hook name' of a request to drop the plugins loaded for a container
+#define HOOK_SERVER_RELEASE_REQUEST     "release"
+
+// The 'hook name' of a request for the server's DobbyPluginMetrics
+#define HOOK_SERVER_METRICS_REQUEST     "metrics"
+
+// The maximum size of a request packet
+#define HOOK_SERVER_MAX_REQUEST_SIZE    (64 * 1024)
+
+// The maximum size of a reply packet
+#define HOOK_SERVER_MAX_REPLY_SIZE      (64 * 1024)
+
+enum DobbyHookResult : int32_t
+{
+    HookSuccess = 0,
+    HookFailure = 1,
+    HookNotHandled = 2,
+};
+
+#endif // !defined(DOBBYHOOKSERVERPROTOCOL_H)
@@ -0,0 +1,98 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2021 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyPluginMetrics.h
+ *
+ */
+#ifndef DOBBYPLUGINMETRICS_H
+#define DOBBYPLUGINMETRICS_H
+
+#include <map>
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <stdint.h>
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class DobbyPluginMetrics
+ *  @brief Process wide record of how long each plugin hook takes to run.
+ *
+ *  Both the rdk and legacy plugin managers time every hook they run and
+ *  record it here against the (plugin, hook) pair, building up a count,
+ *  failure count, total / max time and a histogram of durations.  When
+ *  Perfetto tracing is enabled each run is also emitted as a slice on the
+ *  "plugins" track.
+ *
+ *  The stats are per process.  The daemon asks the hook server for its stats
+ *  over the hook socket (serialise() / deserialise()) and merges them with
+ *  its own, hooks run by short lived DobbyPluginLauncher processes are only
+ *  ever recorded in that process and so aren't reported.
+ */
+class DobbyPluginMetrics
+{
+public:
+    // upper bounds of the histogram buckets in milliseconds, the last bucket
+    // holds everything slower
+    static constexpr size_t BUCKET_COUNT = 12;
+    static const std::array<unsigned, BUCKET_COUNT - 1> BUCKET_LIMITS_MS;
+
+    struct HookStats
+    {
+        uint64_t count;
+        uint64_t failures;
+        std::chrono::microseconds total;
+        std::chrono::microseconds max;
+        std::array<uint64_t, BUCKET_COUNT> buckets;
+    };
+
+    // keyed by (plugin name, hook name)
+    typedef std::map<std::pair<std::string, std::string>, HookStats> Snapshot;
+
+    struct Timer
+    {
+        std::chrono::steady_clock::time_point start;
+        uint64_t traceStart;
+    };
+
+public:
+    static Timer startTimer();
+    static void record(const Timer &timer,
+                       const std::string &pluginName,
+                       const std::string &hookName,
+                       const std::string &containerId,
+                       bool success);
+
+    static Snapshot snapshot();
+
+    static void merge(Snapshot *into, const Snapshot &from);
+
+    static std::string serialise(const Snapshot &snapshot);
+    static bool deserialise(const std::string &data, Snapshot *snapshot);
+
+private:
+    static std::mutex mLock;
+    static Snapshot mStats;
+};
+
+
+#endif // !defined(DOBBYPLUGINMETRICS_H)
@@ -28,10 +28,12 @@
 
 #include <sys/types.h>
 #include <map>
+#include <chrono>
 #include <string>
 #include <memory>
 #include <set>
 #include <vector>
+#include <thread>
 #include <algorithm>
 
 class DobbyRdkPluginDependencySolver;
@@ -41,7 +43,9 @@ class DobbyRdkPluginDependencySolver;
  *  @class DobbyRdkPluginManager
  *  @brief Class that manages all the RDK plugin hook libraries.
  *
- *  At creation time it loads all the plugin libraries.
+ *  At creation time it loads the plugins listed in the container config, the
+ *  plugin libraries themselves are opened once per process and shared
+ *  between managers.
  *
  */
 class DobbyRdkPluginManager
@@ -54,6 +58,16 @@ public:
     ~DobbyRdkPluginManager();
 
 public:
+    struct LoadMetrics
+    {
+        std::chrono::microseconds loadTime;
+        unsigned pluginsLoaded;
+        unsigned librariesOpened;
+        bool directoryScanned;
+    };
+
+    const LoadMetrics& loadMetrics() const;
+
     const std::vector<std::string> listLoadedPlugins() const;
     const std::vector<std::string> listLoadedLoggers() const;
     bool runPlugins(const IDobbyRdkPlugin::HintFlags &hookPoint,
@@ -78,15 +92,16 @@ private:
     bool preprocessPlugins();
     bool executeHook(const std::string &pluginName,
                      const IDobbyRdkPlugin::HintFlags hook) const;
-    bool executeHookTimeout(const std::string &pluginName,
-                            const IDobbyRdkPlugin::HintFlags hook,
-                            const uint timeoutMs) const;
+    std::vector<bool> executeHooksTimeout(const std::vector<std::string> &pluginNames,
+                                          const IDobbyRdkPlugin::HintFlags hook,
+                                          const uint timeoutMs) const;
     std::string HookPointToString(const IDobbyRdkPlugin::HintFlags &hookPoint) const;
 
     bool implementsHook(const std::string &pluginName,
                         const IDobbyRdkPlugin::HintFlags hook) const;
     bool isLoaded(const std::string &pluginName) const;
     bool isRequired(const std::string &pluginName) const;
+    bool isIsolated(const std::string &pluginName) const;
     inline std::shared_ptr<IDobbyRdkPlugin> getPlugin(const std::string &name) const;
     inline std::shared_ptr<IDobbyRdkLoggingPlugin> getLogger(const std::string &name) const;
 
@@ -99,8 +114,10 @@ private:
     const std::string mRootfsPath;
     const std::string mPluginPath;
     const std::shared_ptr<DobbyRdkPluginUtils> mUtils;
+    mutable std::vector<std::thread> mTimedOutThreads;
     std::unique_ptr<DobbyRdkPluginDependencySolver> mDependencySolver;
     std::map<std::string, std::string> mAnnotations;
+    LoadMetrics mLoadMetrics;
 };
 
 #endif // !defined(DOBBYRDKPLUGINMANAGER_H)
@@ -133,6 +133,7 @@ public:
 
     pid_t getContainerPid() const;
     std::string getContainerId() const;
+    void setState(const std::shared_ptr<const rt_state_schema> &state);
     bool getContainerNetworkInfo(ContainerNetworkInfo &networkInfo);
     bool getTakenVeths(std::vector<std::string> &takenVeths);
 
@@ -166,6 +167,14 @@ public:
         return mAnnotations;
     }
 
+    typedef std::function<bool(const std::shared_ptr<void>&)> HookObjectCommit;
+
+    std::shared_ptr<void> hookObject(const std::string &name,
+                                     const std::function<std::shared_ptr<void>()> &create,
+                                     const HookObjectCommit &commit);
+    bool commitHookObjects();
+    void discardHookObjects();
+
     int exitStatus;
 
 private:
@@ -181,6 +190,9 @@ private:
     const std::string mContainerId;
 
     std::map<std::string, std::string> mAnnotations;
+
+    // objects shared by the plugins for the hook point being run
+    std::map<std::string, std::pair<std::shared_ptr<void>, HookObjectCommit>> mHookObjects;
 };
 
 #endif // !defined(DOBBYRDKPLUGINUTILS_H)
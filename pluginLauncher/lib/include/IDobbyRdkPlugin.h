@@ -64,7 +64,11 @@ public:
     /**
      *  @brief Bit flags that should be returned by hookHints.
      *
-     *  The flags are fairly self explanatory.
+     *  The flags are fairly self explanatory, except IsolateHooksFlag which
+     *  isn't a hook; when set the plugin's hooks are run in a forked worker
+     *  process rather than on a thread when a timeout is used.  Use it for
+     *  plugins whose hooks can block in ways that mustn't be left running
+     *  after a timeout.
      */
     enum HintFlags : unsigned
     {
@@ -78,6 +82,7 @@ public:
         PostStartFlag = (1 << 5),
         PostHaltFlag = (1 << 6),
         PostStopFlag = (1 << 7),
+        IsolateHooksFlag = (1 << 16),
         Unknown = 0
     };
 
@@ -172,4 +177,22 @@ public:
         return delete _plugin;                                                                                                                                                                                                         \
     }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @define REGISTER_RDK_PLUGIN_NAME
+ *  @brief Macro for plugins (and loggers) to export their name
+ *
+ *  Lets the plugin manager find the library for a plugin named in a container
+ *  config without creating an instance of every plugin installed.  The name
+ *  must be the same as the one returned by name().  Plugins that don't use
+ *  this still load, but are instantiated just to get their name.
+ *
+ */
+#define REGISTER_RDK_PLUGIN_NAME(_name)                                 \
+    extern "C" PUBLIC_FN const char *nameIDobbyRdkPlugin();             \
+    extern "C" PUBLIC_FN const char *nameIDobbyRdkPlugin()              \
+    {                                                                   \
+        return _name;                                                   \
+    }
+
 #endif // !defined(IDobbyRdkPlugin_H)
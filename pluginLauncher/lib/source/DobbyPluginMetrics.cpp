@@ -0,0 +1,223 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2021 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyPluginMetrics.cpp
+ *
+ */
+#include "DobbyPluginMetrics.h"
+
+#if defined(AI_ENABLE_TRACING)
+    #include <PerfettoTracing.h>
+#endif
+
+#include <sstream>
+#include <algorithm>
+
+
+constexpr size_t DobbyPluginMetrics::BUCKET_COUNT;
+
+const std::array<unsigned, DobbyPluginMetrics::BUCKET_COUNT - 1> DobbyPluginMetrics::BUCKET_LIMITS_MS =
+{
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000
+};
+
+std::mutex DobbyPluginMetrics::mLock;
+DobbyPluginMetrics::Snapshot DobbyPluginMetrics::mStats;
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns a timer to pass to record() once the hook has run.
+ *
+ */
+DobbyPluginMetrics::Timer DobbyPluginMetrics::startTimer()
+{
+    Timer timer;
+    timer.start = std::chrono::steady_clock::now();
+#if defined(AI_ENABLE_TRACING)
+    timer.traceStart = PerfettoTracing::traceTime();
+#else
+    timer.traceStart = 0;
+#endif
+    return timer;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Records a run of a plugin hook that started when @a timer was
+ *  created and finished now.
+ *
+ *  @param[in]  timer           The timer returned by startTimer().
+ *  @param[in]  pluginName      The name of the plugin.
+ *  @param[in]  hookName        The name of the hook.
+ *  @param[in]  containerId     The id of the container the hook ran for.
+ *  @param[in]  success         The result of the hook.
+ */
+void DobbyPluginMetrics::record(const Timer &timer,
+                                const std::string &pluginName,
+                                const std::string &hookName,
+                                const std::string &containerId,
+                                bool success)
+{
+    const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - timer.start);
+
+#if defined(AI_ENABLE_TRACING)
+    PerfettoTracing::pluginSlice(pluginName, hookName, containerId,
+                                 timer.traceStart, PerfettoTracing::traceTime(),
+                                 success);
+#else
+    (void)containerId;
+#endif
+
+    const uint64_t durationMs = duration.count() / 1000;
+    const size_t bucket =
+        std::upper_bound(BUCKET_LIMITS_MS.begin(), BUCKET_LIMITS_MS.end(), durationMs) -
+        BUCKET_LIMITS_MS.begin();
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    auto it = mStats.find(std::make_pair(pluginName, hookName));
+    if (it == mStats.end())
+    {
+        HookStats stats = { 0, 0, std::chrono::microseconds::zero(),
+                            std::chrono::microseconds::zero(), { } };
+        it = mStats.emplace(std::make_pair(pluginName, hookName), stats).first;
+    }
+
+    HookStats &stats = it->second;
+    stats.count++;
+    if (!success)
+        stats.failures++;
+    stats.total += duration;
+    stats.max = std::max(stats.max, duration);
+    stats.buckets[bucket]++;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns a copy of the stats recorded so far.
+ *
+ */
+DobbyPluginMetrics::Snapshot DobbyPluginMetrics::snapshot()
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    return mStats;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Adds the stats in @a from to those in @a into.
+ *
+ *  @param[in,out]  into    The stats to add to.
+ *  @param[in]      from    The stats to add.
+ */
+void DobbyPluginMetrics::merge(Snapshot *into, const Snapshot &from)
+{
+    for (const auto &entry : from)
+    {
+        auto it = into->find(entry.first);
+        if (it == into->end())
+        {
+            into->emplace(entry.first, entry.second);
+            continue;
+        }
+
+        HookStats &stats = it->second;
+        stats.count += entry.second.count;
+        stats.failures += entry.second.failures;
+        stats.total += entry.second.total;
+        stats.max = std::max(stats.max, entry.second.max);
+        for (size_t i = 0; i < BUCKET_COUNT; i++)
+            stats.buckets[i] += entry.second.buckets[i];
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Converts the stats to a string that can be passed to deserialise()
+ *  in another process.
+ *
+ *  Each (plugin, hook) pair is a line of space separated fields:
+ *
+ *      <plugin> <hook> <count> <failures> <total us> <max us> <buckets...>
+ *
+ *  @param[in]  snapshot    The stats to serialise.
+ *
+ *  @return the serialised stats.
+ */
+std::string DobbyPluginMetrics::serialise(const Snapshot &snapshot)
+{
+    std::ostringstream stream;
+    for (const auto &entry : snapshot)
+    {
+        const HookStats &stats = entry.second;
+
+        stream << entry.first.first << ' ' << entry.first.second << ' '
+               << stats.count << ' ' << stats.failures << ' '
+               << stats.total.count() << ' ' << stats.max.count();
+        for (uint64_t bucket : stats.buckets)
+            stream << ' ' << bucket;
+        stream << '\n';
+    }
+
+    return stream.str();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Parses stats created by serialise().
+ *
+ *  @param[in]  data        The serialised stats.
+ *  @param[out] snapshot    Replaced with the parsed stats.
+ *
+ *  @return true if all the stats were parsed, otherwise false.
+ */
+bool DobbyPluginMetrics::deserialise(const std::string &data, Snapshot *snapshot)
+{
+    snapshot->clear();
+
+    std::istringstream stream(data);
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        std::istringstream fields(line);
+
+        std::string pluginName, hookName;
+        int64_t total, max;
+        HookStats stats;
+        fields >> pluginName >> hookName >> stats.count >> stats.failures
+               >> total >> max;
+        for (uint64_t &bucket : stats.buckets)
+            fields >> bucket;
+
+        std::string extra;
+        if (fields.fail() || (fields >> extra))
+        {
+            snapshot->clear();
+            return false;
+        }
+
+        stats.total = std::chrono::microseconds(total);
+        stats.max = std::chrono::microseconds(max);
+        (*snapshot)[std::make_pair(pluginName, hookName)] = stats;
+    }
+
+    return true;
+}
@@ -0,0 +1,469 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2021 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyRdkPluginCatalogue.cpp
+ *
+ */
+#include "DobbyRdkPluginCatalogue.h"
+
+#include <Logging.h>
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+
+DobbyRdkPluginCatalogue::Library::~Library()
+{
+    if (handle && (dlclose(handle) != 0))
+    {
+        AI_LOG_ERROR("failed to close plugin library '%s' - %s", path.c_str(), dlerror());
+    }
+}
+
+DobbyRdkPluginCatalogue::DobbyRdkPluginCatalogue()
+    : mMetrics{ 0, 0, 0 }
+{
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the singleton instance.
+ *
+ */
+DobbyRdkPluginCatalogue& DobbyRdkPluginCatalogue::instance()
+{
+    static DobbyRdkPluginCatalogue catalogue;
+    return catalogue;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the libraries for the named plugins.
+ *
+ *  If the plugin directory hasn't been scanned yet, or has changed since it
+ *  was, then it is (re)scanned first.  The container details are only used
+ *  if one of the plugins isn't provided by a library that exports its name,
+ *  in which case the libraries that don't are instantiated to get theirs.
+ *
+ *  Plugins that aren't installed are simply not added to @a libraries.
+ *
+ *  @param[in]  pluginPath      The directory containing the plugins.
+ *  @param[in]  names           The lowercase names of the plugins wanted.
+ *  @param[in]  containerConfig The container config.
+ *  @param[in]  utils           The plugin utils for the container.
+ *  @param[in]  rootfsPath      The path to the container rootfs.
+ *  @param[out] libraries       Map of plugin name to library.
+ *
+ *  @return false if the plugin directory couldn't be read, otherwise true.
+ */
+bool DobbyRdkPluginCatalogue::lookup(const std::string &pluginPath,
+                                     const std::set<std::string> &names,
+                                     std::shared_ptr<rt_dobby_schema> &containerConfig,
+                                     const std::shared_ptr<DobbyRdkPluginUtils> &utils,
+                                     const std::string &rootfsPath,
+                                     std::map<std::string, std::shared_ptr<const Library>> *libraries)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    struct stat buf;
+    if (stat(pluginPath.c_str(), &buf) != 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to open dir '%s'", pluginPath.c_str());
+        return false;
+    }
+
+    auto it = mDirectories.find(pluginPath);
+    if ((it == mDirectories.end()) ||
+        (it->second.mtime.tv_sec != buf.st_mtim.tv_sec) ||
+        (it->second.mtime.tv_nsec != buf.st_mtim.tv_nsec))
+    {
+        // take the old entry out of the map, the scan drops the catalogue's
+        // reference to any library that was removed or replaced
+        Directory previous;
+        const bool hadPrevious = (it != mDirectories.end());
+        if (hadPrevious)
+        {
+            previous = std::move(it->second);
+            mDirectories.erase(it);
+        }
+
+        Directory directory;
+        directory.mtime = buf.st_mtim;
+
+        if (!scan(pluginPath, previous, directory))
+        {
+            if (hadPrevious)
+                mDirectories[pluginPath] = std::move(previous);
+
+            return false;
+        }
+
+        it = mDirectories.emplace(pluginPath, std::move(directory)).first;
+    }
+
+    Directory &directory = it->second;
+
+    for (const std::string &name : names)
+    {
+        if (directory.plugins.count(name) == 0)
+        {
+            nameLibraries(directory, containerConfig, utils, rootfsPath);
+            break;
+        }
+    }
+
+    for (const std::string &name : names)
+    {
+        auto plugin = directory.plugins.find(name);
+        if (plugin != directory.plugins.end())
+        {
+            libraries->emplace(name, plugin->second);
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the number of scans, libraries opened and plugins created
+ *  just to get their name so far.
+ *
+ */
+DobbyRdkPluginCatalogue::Metrics DobbyRdkPluginCatalogue::metrics() const
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    return mMetrics;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Scans the given path for any shared objects that implement the
+ *  plugin entry points.
+ *
+ *  This calls dlopen() on all the regular files in the given path (although
+ *  it doesn't recurse into subdirs), if the file has symbols createIDobbyRdkPlugin
+ *  and destroyIDobbyRdkPlugin then it's deemed to be a 'rdk' plugin.  Files
+ *  that haven't changed (same inode) since the previous scan are not opened
+ *  again.
+ *
+ *  Must be called with the lock held.
+ *
+ *  @param[in]  pluginPath      The directory containing the plugins.
+ *  @param[in]  previous        The result of the last scan, the libraries
+ *                              that have changed are removed from it.
+ *  @param[out] directory       Populated with the libraries found.
+ *
+ *  @return False if unable to open the given directory, true otherwise.
+ */
+bool DobbyRdkPluginCatalogue::scan(const std::string &pluginPath,
+                                   Directory &previous,
+                                   Directory &directory)
+{
+    AI_LOG_FN_ENTRY();
+
+    int directoriesCount = 0;
+    struct dirent **namelist = nullptr;
+
+    // Need to sort directories with versionsort so lib.12 would be greater than lib.2
+    directoriesCount = scandir(pluginPath.c_str(), &namelist, 0, versionsort);
+    if (directoriesCount < 0)
+    {
+        AI_LOG_SYS_ERROR_EXIT(errno, "failed to scan directory '%s'", pluginPath.c_str());
+        return false;
+    }
+
+    // the name map is rebuilt below, only the libraries are reused
+    previous.plugins.clear();
+
+    for (int i = 0; i < directoriesCount; i++)
+    {
+        const unsigned char type = namelist[i]->d_type;
+
+        char libPath[PATH_MAX];
+        snprintf(libPath, sizeof(libPath), "%s/%s", pluginPath.c_str(), namelist[i]->d_name);
+        free(namelist[i]);
+
+        // the entry (or the thing a symlink points to) must be a file
+        if ((type != DT_REG) && (type != DT_LNK))
+        {
+            continue;
+        }
+
+        struct stat buf;
+        if (stat(libPath, &buf) != 0)
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to stat '%s'", libPath);
+            continue;
+        }
+        if (!S_ISREG(buf.st_mode))
+        {
+            continue;
+        }
+
+        // if the file hasn't changed since the last scan then just reuse it
+        auto cached = previous.libraries.find(libPath);
+
+        Entry entry;
+        if ((cached != previous.libraries.end()) &&
+            (cached->second.library->dev == buf.st_dev) &&
+            (cached->second.library->ino == buf.st_ino))
+        {
+            entry = cached->second;
+        }
+        else
+        {
+            // drop our reference to the old version before opening the new
+            // one, dlopen goes by path so would otherwise return the old one
+            std::weak_ptr<const Library> oldLibrary;
+            Entry oldEntry;
+            if (cached != previous.libraries.end())
+            {
+                oldLibrary = cached->second.library;
+                oldEntry.name = cached->second.name;
+                oldEntry.named = cached->second.named;
+                previous.libraries.erase(cached);
+            }
+
+            entry.library = openLibrary(libPath, buf, &entry.name);
+            if (!entry.library)
+            {
+                continue;
+            }
+
+            entry.named = !entry.name.empty();
+
+            // if plugins created from the old version are still around then
+            // dlopen still gives us the old one, so keep using it and scan
+            // again next time
+            oldEntry.library = oldLibrary.lock();
+            if (oldEntry.library && (oldEntry.library->handle == entry.library->handle))
+            {
+                AI_LOG_WARN("'%s' was replaced but the old version is still in "
+                            "use, will load it later", libPath);
+
+                entry = std::move(oldEntry);
+                directory.mtime = { 0, 0 };
+            }
+        }
+
+        directory.libraries[libPath] = entry;
+
+        if (entry.named && !entry.name.empty())
+        {
+            addPlugin(directory, entry.name, entry.library);
+        }
+    }
+
+    free(namelist);
+
+    mMetrics.scans++;
+
+    AI_LOG_FN_EXIT();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Opens the library and checks it has the plugin entry points.
+ *
+ *  Must be called with the lock held.
+ *
+ *  @param[in]  libPath     The path to the library.
+ *  @param[in]  buf         The stat of the library.
+ *  @param[out] name        Set to the lowercase name exported by the library,
+ *                          or an empty string if it doesn't export one.
+ *
+ *  @return the library, or nullptr if it isn't a plugin.
+ */
+std::shared_ptr<const DobbyRdkPluginCatalogue::Library> DobbyRdkPluginCatalogue::openLibrary(const std::string &libPath,
+                                                                                             const struct stat &buf,
+                                                                                             std::string *name)
+{
+    void *libHandle = dlopen(libPath.c_str(), RTLD_LAZY | RTLD_LOCAL);
+    if (libHandle == nullptr)
+    {
+        AI_LOG_ERROR("Plugin %s failed to load with error %s\n", libPath.c_str(), dlerror());
+        return nullptr;
+    }
+
+    // the library now owns the handle, so it's closed when it's dropped
+    auto library = std::make_shared<Library>();
+    library->path = libPath;
+    library->dev = buf.st_dev;
+    library->ino = buf.st_ino;
+    library->handle = libHandle;
+
+    mMetrics.librariesOpened++;
+
+    // check if it contains the register functions
+
+    // These are both the same signature, but exist so we can determine
+    // quickly if it's a plugin or logger (sub-class of plugin)
+    void *libCreateFn = dlsym(libHandle, "createIDobbyRdkPlugin");
+    void *libDestroyFn = dlsym(libHandle, "destroyIDobbyRdkPlugin");
+
+    void *libCreateLoggerFn = dlsym(libHandle, "createIDobbyRdkLogger");
+    void *libDestroyLoggerFn = dlsym(libHandle, "destroyIDobbyRdkLogger");
+
+    const bool isPlugin = (libCreateFn != nullptr) && (libDestroyFn != nullptr);
+    const bool isLogger = (libCreateLoggerFn != nullptr) && (libDestroyLoggerFn != nullptr);
+
+    if (!isPlugin && !isLogger)
+    {
+        AI_LOG_DEBUG("%s does not contain create/destroy functions, skipping...\n", libPath.c_str());
+        return nullptr;
+    }
+
+    // loggers are also run as plugins, using the logger entry points
+    library->isLogger = !isPlugin;
+    library->createPlugin = reinterpret_cast<CreatePluginFunction>(libCreateFn);
+    library->destroyPlugin = reinterpret_cast<DestroyPluginFunction>(libDestroyFn);
+    library->createLogger = reinterpret_cast<CreateLoggerFunction>(libCreateLoggerFn);
+    library->destroyLogger = reinterpret_cast<DestroyLoggerFunction>(libDestroyLoggerFn);
+
+    name->clear();
+
+    NameFunction nameFn = reinterpret_cast<NameFunction>(dlsym(libHandle, "nameIDobbyRdkPlugin"));
+    if (nameFn)
+    {
+        const char *exportedName = nameFn();
+        if (exportedName && (exportedName[0] != '\0'))
+        {
+            // Plugin names aren't case sensitive, so convert to lowercase
+            name->assign(exportedName);
+            std::transform(name->begin(), name->end(), name->begin(), ::tolower);
+        }
+        else
+        {
+            AI_LOG_WARN("library '%s' exported an invalid plugin name", libPath.c_str());
+        }
+    }
+
+    return library;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the names of the libraries that don't export one.
+ *
+ *  This is the fallback for plugins built without REGISTER_RDK_PLUGIN_NAME,
+ *  each is instantiated once with the given container details and the name
+ *  is remembered until the library changes.
+ *
+ *  Must be called with the lock held.
+ */
+void DobbyRdkPluginCatalogue::nameLibraries(Directory &directory,
+                                            std::shared_ptr<rt_dobby_schema> &containerConfig,
+                                            const std::shared_ptr<DobbyRdkPluginUtils> &utils,
+                                            const std::string &rootfsPath)
+{
+    for (auto &library : directory.libraries)
+    {
+        Entry &entry = library.second;
+        if (entry.named)
+        {
+            continue;
+        }
+
+        AI_LOG_WARN("library '%s' doesn't export its plugin name, it should use "
+                    "REGISTER_RDK_PLUGIN_NAME", library.first.c_str());
+
+        entry.name = pluginName(*entry.library, containerConfig, utils, rootfsPath);
+        entry.named = true;
+
+        mMetrics.pluginsCreatedForName++;
+
+        if (!entry.name.empty())
+        {
+            addPlugin(directory, entry.name, entry.library);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Adds the plugin to the directory's plugins, replacing any earlier
+ *  library with the same plugin name.
+ *
+ */
+void DobbyRdkPluginCatalogue::addPlugin(Directory &directory, const std::string &name,
+                                        const std::shared_ptr<const Library> &library)
+{
+    auto it = directory.plugins.find(name);
+    if (it != directory.plugins.end())
+    {
+        AI_LOG_WARN("already had a plugin called '%s', replacing with new "
+                    "one from '%s'", name.c_str(), library->path.c_str());
+    }
+
+    directory.plugins[name] = library;
+
+    AI_LOG_INFO("Found plugin '%s' in '%s'\n", name.c_str(), library->path.c_str());
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Creates a temporary instance of the plugin to get its name.
+ *
+ *  @return the lowercase plugin name, or an empty string on failure.
+ */
+std::string DobbyRdkPluginCatalogue::pluginName(const Library &library,
+                                                std::shared_ptr<rt_dobby_schema> &containerConfig,
+                                                const std::shared_ptr<DobbyRdkPluginUtils> &utils,
+                                                const std::string &rootfsPath) const
+{
+    std::shared_ptr<IDobbyRdkPlugin> plugin;
+    if (library.isLogger)
+    {
+        plugin.reset(library.createLogger(containerConfig, utils, rootfsPath),
+                     library.destroyLogger);
+    }
+    else
+    {
+        plugin.reset(library.createPlugin(containerConfig, utils, rootfsPath),
+                     library.destroyPlugin);
+    }
+
+    if (!plugin)
+    {
+        AI_LOG_WARN("plugin for library '%s' failed to register", library.path.c_str());
+        return std::string();
+    }
+
+    std::string name = plugin->name();
+    if (name.empty())
+    {
+        AI_LOG_WARN("plugin for library '%s' returned an invalid name", library.path.c_str());
+        return std::string();
+    }
+
+    // Plugin names aren't case sensitive, so convert to lowercase
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    return name;
+}
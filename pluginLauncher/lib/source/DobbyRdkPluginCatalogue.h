@@ -0,0 +1,156 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2021 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyRdkPluginCatalogue.h
+ *
+ */
+#ifndef DOBBYRDKPLUGINCATALOGUE_H
+#define DOBBYRDKPLUGINCATALOGUE_H
+
+#include "IDobbyRdkPlugin.h"
+#include "IDobbyRdkLoggingPlugin.h"
+
+#include <sys/types.h>
+#include <map>
+#include <set>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <time.h>
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class DobbyRdkPluginCatalogue
+ *  @brief Process wide map of rdk plugin name to the library implementing it.
+ *
+ *  The first lookup for a plugin directory dlopen's every library in it (as
+ *  DobbyRdkPluginManager always used to do for every container) and records
+ *  the name each one exports with REGISTER_RDK_PLUGIN_NAME, so later lookups
+ *  just return the cached entries and the plugin manager only has to
+ *  instantiate the plugins named in the container config.
+ *
+ *  Libraries built without REGISTER_RDK_PLUGIN_NAME are only instantiated to
+ *  get their name if a lookup asks for a plugin none of the named libraries
+ *  provide, and then only once.
+ *
+ *  The directory is only scanned again if its mtime changes, i.e. a plugin
+ *  has been installed or removed, and then only new or replaced libraries
+ *  (a different inode at the same path) are opened.  A library is dlclose'd
+ *  once it's gone from the catalogue and the last plugin created from it has
+ *  been destroyed.
+ */
+class DobbyRdkPluginCatalogue
+{
+public:
+    typedef IDobbyRdkPlugin *(*CreatePluginFunction)(std::shared_ptr<rt_dobby_schema>& containerConfig,
+                                                     const std::shared_ptr<DobbyRdkPluginUtils> &util,
+                                                     const std::string &rootfsPath);
+    typedef void (*DestroyPluginFunction)(IDobbyRdkPlugin *);
+
+    typedef IDobbyRdkLoggingPlugin *(*CreateLoggerFunction)(std::shared_ptr<rt_dobby_schema>& containerConfig,
+                                                            const std::shared_ptr<DobbyRdkPluginUtils> &util,
+                                                            const std::string &rootfsPath);
+    typedef void (*DestroyLoggerFunction)(IDobbyRdkLoggingPlugin *);
+
+    typedef const char *(*NameFunction)();
+
+    struct Library
+    {
+        ~Library();
+
+        std::string path;
+        dev_t dev;
+        ino_t ino;
+        void *handle;
+        bool isLogger;
+        CreatePluginFunction createPlugin;
+        DestroyPluginFunction destroyPlugin;
+        CreateLoggerFunction createLogger;
+        DestroyLoggerFunction destroyLogger;
+    };
+
+    struct Metrics
+    {
+        unsigned scans;
+        unsigned librariesOpened;
+        unsigned pluginsCreatedForName;
+    };
+
+public:
+    static DobbyRdkPluginCatalogue& instance();
+
+    bool lookup(const std::string &pluginPath,
+                const std::set<std::string> &names,
+                std::shared_ptr<rt_dobby_schema> &containerConfig,
+                const std::shared_ptr<DobbyRdkPluginUtils> &utils,
+                const std::string &rootfsPath,
+                std::map<std::string, std::shared_ptr<const Library>> *libraries);
+
+    Metrics metrics() const;
+
+private:
+    DobbyRdkPluginCatalogue();
+    ~DobbyRdkPluginCatalogue() = default;
+
+    struct Entry
+    {
+        std::shared_ptr<const Library> library;
+        std::string name;
+        bool named = false;
+    };
+
+    struct Directory
+    {
+        struct timespec mtime;
+
+        // every plugin library in the directory, keyed by path
+        std::map<std::string, Entry> libraries;
+
+        // plugin name to library, for the libraries whose name is known
+        std::map<std::string, std::shared_ptr<const Library>> plugins;
+    };
+
+    bool scan(const std::string &pluginPath, Directory &previous,
+              Directory &directory);
+
+    std::shared_ptr<const Library> openLibrary(const std::string &libPath,
+                                               const struct stat &buf,
+                                               std::string *name);
+
+    void nameLibraries(Directory &directory,
+                       std::shared_ptr<rt_dobby_schema> &containerConfig,
+                       const std::shared_ptr<DobbyRdkPluginUtils> &utils,
+                       const std::string &rootfsPath);
+
+    std::string pluginName(const Library &library,
+                           std::shared_ptr<rt_dobby_schema> &containerConfig,
+                           const std::shared_ptr<DobbyRdkPluginUtils> &utils,
+                           const std::string &rootfsPath) const;
+
+    static void addPlugin(Directory &directory, const std::string &name,
+                          const std::shared_ptr<const Library> &library);
+
+private:
+    mutable std::mutex mLock;
+    std::map<std::string, Directory> mDirectories;
+
+    Metrics mMetrics;
+};
+
+#endif // !defined(DOBBYRDKPLUGINCATALOGUE_H)
@@ -189,3 +189,90 @@ std::vector<std::string> DobbyRdkPluginDependencySolver::getReversedOrderOfDepen
     AI_LOG_FN_EXIT();
     return namesInReversedOrder;
 }
+
+// -----------------------------------------------------------------------------
+/**
+ * @brief Gets the names of the plugins grouped into dependency levels.
+ *
+ * Level 0 holds the plugins with no dependencies, level N the plugins whose
+ * deepest dependency is in level N-1.  None of the plugins within a level
+ * depend on each other, so they can be run at the same time, e.g. with this
+ * code:
+ * @code
+ * DobbyRdkPluginDependencySolver solver;
+ * solver.addPlugin("AppServices");
+ * solver.addPlugin("Networking");
+ * solver.addPlugin("IPC");
+ * solver.addPlugin("Logging");
+ * solver.addDependency("AppServices", "Networking");
+ * solver.addDependency("Networking", "IPC");
+ *
+ * const std::vector<std::vector<std::string>> levels = solver.getDependencyLevels();
+ * @endcode,
+ * @code levels @endcode is @code { { "IPC", "Logging" }, { "Networking" }, { "AppServices" } } @endcode.
+ *
+ * Within a level the plugins keep the order they have in getOrderOfDependency().
+ *
+ * @return The dependency levels. Empty vector if no plugins have been added or a
+ * dependency cycle has been detected.
+ */
+std::vector<std::vector<std::string>> DobbyRdkPluginDependencySolver::getDependencyLevels() const
+{
+    AI_LOG_FN_ENTRY();
+
+    std::vector<std::vector<std::string>> levels;
+    std::vector<VertexDescriptor> descriptorsInOrder;
+    try
+    {
+        boost::topological_sort(mDependencyGraph, std::back_inserter(descriptorsInOrder));
+    }
+    catch(const boost::not_a_dag &e)
+    {
+        AI_LOG_ERROR("Dependency cycle detected");
+        return levels;
+    }
+
+    // The dependencies of a plugin always come before it in the sorted order,
+    // so their levels are known by the time we get to the plugin.
+    const auto nameMap = boost::get(boost::vertex_name, mDependencyGraph);
+    std::vector<size_t> levelOf(boost::num_vertices(mDependencyGraph), 0);
+    for (const VertexDescriptor &descriptor : descriptorsInOrder)
+    {
+        size_t level = 0;
+        auto edges = boost::out_edges(descriptor, mDependencyGraph);
+        for (auto edge = edges.first; edge != edges.second; ++edge)
+        {
+            const VertexDescriptor dependency = boost::target(*edge, mDependencyGraph);
+            level = std::max(level, levelOf[dependency] + 1);
+        }
+
+        levelOf[descriptor] = level;
+        if (levels.size() <= level)
+        {
+            levels.resize(level + 1);
+        }
+        levels[level].push_back(nameMap[descriptor]);
+    }
+
+    AI_LOG_FN_EXIT();
+    return levels;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * @brief Gets the dependency levels in reverse, so the plugins that others
+ * depend on come last.
+ *
+ * @return The dependency levels in reverse order. Empty vector if no plugins have
+ * been added or a dependency cycle has been detected.
+ */
+std::vector<std::vector<std::string>> DobbyRdkPluginDependencySolver::getReversedDependencyLevels() const
+{
+    AI_LOG_FN_ENTRY();
+
+    std::vector<std::vector<std::string>> levels = getDependencyLevels();
+    std::reverse(levels.begin(), levels.end());
+
+    AI_LOG_FN_EXIT();
+    return levels;
+}
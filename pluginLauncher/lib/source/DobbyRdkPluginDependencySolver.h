@@ -45,6 +45,9 @@ public:
     std::vector<std::string> getOrderOfDependency() const;
     std::vector<std::string> getReversedOrderOfDependency() const;
 
+    std::vector<std::vector<std::string>> getDependencyLevels() const;
+    std::vector<std::vector<std::string>> getReversedDependencyLevels() const;
+
 private:
     using VertexIndexProperty = boost::property<boost::vertex_index_t, std::size_t>;
     using VertexNameProperty = boost::property<boost::vertex_name_t, std::string, VertexIndexProperty>;
@@ -22,6 +22,8 @@
  */
 #include "DobbyRdkPluginManager.h"
 #include "DobbyRdkPluginDependencySolver.h"
+#include "DobbyRdkPluginCatalogue.h"
+#include "DobbyPluginMetrics.h"
 #include "IDobbyRdkPlugin.h"
 
 #include <Logging.h>
@@ -35,17 +37,24 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
-#include <sys/mman.h>
+#include <poll.h>
 #include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <list>
 #include <thread>
 
+// The maximum number of plugin hooks run at the same time
+#define MAX_PARALLEL_HOOKS  4
+
 // -----------------------------------------------------------------------------
 /**
- * @brief Create instance of DobbyRdkPlugin Manager and load all plugins that
- * can be found in pluginPath
+ * @brief Create instance of DobbyRdkPlugin Manager and load the plugins listed
+ * in the container config from pluginPath
  *
  * @param[in] containerConfig     Pointer to the libocispec struct for the container config
  * @param[in] pluginPath        Where to search for plugins
@@ -58,7 +67,8 @@ DobbyRdkPluginManager::DobbyRdkPluginManager(std::shared_ptr<rt_dobby_schema> co
       mRootfsPath(rootfsPath),
       mPluginPath(pluginPath),
       mUtils(utils),
-      mDependencySolver(std::make_unique<DobbyRdkPluginDependencySolver>())
+      mDependencySolver(std::make_unique<DobbyRdkPluginDependencySolver>()),
+      mLoadMetrics{ std::chrono::microseconds::zero(), 0, 0, false }
 {
     AI_LOG_FN_ENTRY();
 
@@ -69,65 +79,49 @@ DobbyRdkPluginManager::DobbyRdkPluginManager(std::shared_ptr<rt_dobby_schema> co
 
 // -----------------------------------------------------------------------------
 /**
- * Unload all plugins on destruction
+ * Destroy all plugins on destruction
  */
 DobbyRdkPluginManager::~DobbyRdkPluginManager()
 {
     AI_LOG_FN_ENTRY();
 
-    // destruct the plugins; note you need to take care to destruct the pointer
-    // first then close the library as the destructor needs to be called from
-    // the library.
+    // don't wait for hook threads that outlived their timeout, the hook may
+    // never return and the launcher has to exit for runc to carry on.  The
+    // threads only hold their own references to the plugin and its state, so
+    // they're safe to leave running
+    if (!mTimedOutThreads.empty())
+    {
+        AI_LOG_WARN("leaving %zu timed out hook thread(s) running",
+                    mTimedOutThreads.size());
 
-    // FIXME:: During daemon shutdown, due to a race condition in rare circumstances something can still
-    // hold a reference to the logging plugin, meaning use_count() is > 1 at this point.
-    // If we attempt to dlclose() the plugin in this scenario the daemon will segfault.
+        for (std::thread &thread : mTimedOutThreads)
+        {
+            thread.detach();
+        }
 
-    // This shouldn't happen, but we make some safety checks here just in case until
-    // the root case is fixed. Don't attempt to dlclose() the plugin whilst a reference
-    // is still held elsewhere.
-    std::vector<std::string> doNotUnload = {};
+        mTimedOutThreads.clear();
+    }
+
+    // destruct the plugins; each plugin keeps its library open, so it's safe
+    // for something else to still hold a reference to a plugin (e.g. the
+    // logger during daemon shutdown)
 
     // All loggers are also plugins
-    auto itl = mLoggers.begin();
-    for (; itl != mLoggers.end(); ++itl)
+    for (auto &logger : mLoggers)
     {
-        if (itl->second.second.use_count() > 1)
+        if (logger.second.second.use_count() > 1)
         {
-            doNotUnload.emplace_back(itl->first);
+            AI_LOG_WARN("reference still held to logger %s", logger.first.c_str());
         }
 
-        itl->second.second.reset();
+        logger.second.second.reset();
     }
 
     mLoggers.clear();
 
-    auto it = mPlugins.begin();
-    for (; it != mPlugins.end(); ++it)
+    for (auto &plugin : mPlugins)
     {
-        if (it->second.second.use_count() > 1)
-        {
-            doNotUnload.emplace_back(it->first);
-        }
-
-        it->second.second.reset();
-
-        if (doNotUnload.size() > 0)
-        {
-            // If the plugin is not in the doNotUnload list, close it
-            if (std::find(doNotUnload.begin(), doNotUnload.end(), it->first) == doNotUnload.end())
-            {
-                dlclose(it->second.first);
-            }
-            else
-            {
-                AI_LOG_ERROR("Cannot unload plugin %s due to reference still being held", it->first.c_str());
-            }
-        }
-        else
-        {
-            dlclose(it->second.first);
-        }
+        plugin.second.second.reset();
     }
 
     mPlugins.clear();
@@ -137,12 +131,11 @@ DobbyRdkPluginManager::~DobbyRdkPluginManager()
 
 // -----------------------------------------------------------------------------
 /**
- *  @brief Scans the given path for any shared objects that implement the
- *  plugin entry points.
+ *  @brief Loads the plugins listed in the container config.
  *
- *  This calls dlopen() on all the executable files in the given path (although
- *  it doesn't recurse into subdirs), if the file has symbols createIDobbyRdkPlugin
- *  and destroyIDobbyRdkPlugin then it's deemed to be a 'rdk' plugin.
+ *  The plugin libraries are looked up in the process wide catalogue, which
+ *  only scans the plugin directory the first time (or when it changes), so
+ *  only the plugins the container actually uses get instantiated.
  *
  *  If loaded successfully the plugins are stored in an internal map, keyed
  *  off the plugin name.
@@ -153,197 +146,90 @@ bool DobbyRdkPluginManager::loadPlugins()
 {
     AI_LOG_FN_ENTRY();
 
-    // Check we can access the directory and open it
-    int dirFd = open(mPluginPath.c_str(), O_DIRECTORY | O_CLOEXEC);
-    if (dirFd < 0)
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // get the (lowercase) names of the plugins in the config, if the config
+    // is invalid then preprocessPlugins() will report it
+    std::set<std::string> names;
+    if (mContainerConfig && mContainerConfig->rdk_plugins)
     {
-        AI_LOG_SYS_ERROR_EXIT(errno, "failed to open dir '%s'", mPluginPath.c_str());
-        return false;
+        for (size_t i = 0; i < mContainerConfig->rdk_plugins->plugins_count; i++)
+        {
+            std::string name = mContainerConfig->rdk_plugins->names_of_plugins[i];
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            names.insert(std::move(name));
+        }
     }
 
-    DIR *dir = fdopendir(dirFd);
-    if (dir == nullptr)
+    if (names.empty())
     {
-        AI_LOG_SYS_ERROR_EXIT(errno, "failed to open dir '%s'", mPluginPath.c_str());
-        close(dirFd);
-        return false;
+        AI_LOG_FN_EXIT();
+        return true;
     }
 
-    int directoriesCount = 0;
-    struct dirent **namelist = nullptr;
+    DobbyRdkPluginCatalogue &catalogue = DobbyRdkPluginCatalogue::instance();
+    const DobbyRdkPluginCatalogue::Metrics before = catalogue.metrics();
 
-    // Need to sort directories with versionsort so lib.12 would be greater than lib.2
-    directoriesCount = scandir(mPluginPath.c_str(), &namelist, 0, versionsort);
-    if (directoriesCount < 0)
+    std::map<std::string, std::shared_ptr<const DobbyRdkPluginCatalogue::Library>> libraries;
+    if (!catalogue.lookup(mPluginPath, names, mContainerConfig, mUtils, mRootfsPath, &libraries))
     {
-        AI_LOG_SYS_ERROR(errno, "failed to scan directory '%s'", mPluginPath.c_str());
-        closedir(dir);
+        AI_LOG_FN_EXIT();
         return false;
     }
-    
-    for(int i=0; i<directoriesCount;i++)
-    {
-        // if a symlink verify that the thing we're pointing to is a file
-        if (namelist[i]->d_type == DT_LNK)
-        {
-            struct stat buf;
-            if (fstatat(dirfd(dir), namelist[i]->d_name, &buf, AT_NO_AUTOMOUNT) != 0)
-            {
-                AI_LOG_SYS_ERROR(errno, "failed to stat '%s'", namelist[i]->d_name);
-                free(namelist[i]);
-                continue;
-            }
 
-            if (!S_ISREG(buf.st_mode))
-            {
-                // symlink doesn't point to a regular file so skip it
-                free(namelist[i]);
-                continue;
-            }
-        }
-        else if (namelist[i]->d_type != DT_REG)
-        {
-            // the entry is not a regular file so skip it
-            free(namelist[i]);
-            continue;
-        }
-
-        // try and dlopen it
-        char libPath[PATH_MAX];
-        snprintf(libPath, sizeof(libPath), "%s/%s", mPluginPath.c_str(), namelist[i]->d_name);
-
-        void *libHandle = dlopen(libPath, RTLD_LAZY | RTLD_LOCAL);
-        if (libHandle == nullptr)
-        {
-            AI_LOG_ERROR("Plugin %s failed to load with error %s\n", namelist[i]->d_name, dlerror());
-            continue;
-        }
-
-        // check if it contains the register function
-
-        // These are both the same signature, but exist so we can determine
-        // quickly if it's a plugin or logger (sub-class of plugin)
-        void *libCreateFn = dlsym(libHandle, "createIDobbyRdkPlugin");
-        void *libDestroyFn = dlsym(libHandle, "destroyIDobbyRdkPlugin");
-
-        void *libCreateLoggerFn = dlsym(libHandle, "createIDobbyRdkLogger");
-        void *libDestroyLoggerFn = dlsym(libHandle, "destroyIDobbyRdkLogger");
-
-        const bool isPlugin = (libCreateFn != nullptr) && (libDestroyFn != nullptr);
-        const bool isLogger = (libCreateLoggerFn != nullptr) && (libDestroyLoggerFn != nullptr);
-
-        if (!isPlugin && !isLogger)
-        {
-            dlclose(libHandle);
-            AI_LOG_DEBUG("%s does not contain create/destroy functions, skipping...\n", namelist[i]->d_name);
-            free(namelist[i]);
-            continue;
-        }
+    for (const auto &entry : libraries)
+    {
+        const std::string &pluginName = entry.first;
+        const std::shared_ptr<const DobbyRdkPluginCatalogue::Library> &library = entry.second;
 
+        // the deleters hold a reference to the library so it isn't closed
+        // while any plugin created from it is still around
+        auto destroyPlugin = [library](IDobbyRdkPlugin *p) { library->destroyPlugin(p); };
+        auto destroyLogger = [library](IDobbyRdkLoggingPlugin *p) { library->destroyLogger(p); };
 
         std::shared_ptr<IDobbyRdkPlugin> plugin;
         std::shared_ptr<IDobbyRdkLoggingPlugin> logger;
-        if (isPlugin)
+        if (!library->isLogger)
         {
-            // execute the register function ... fingers crossed
-            typedef IDobbyRdkPlugin *(*CreatePluginFunction)(std::shared_ptr<rt_dobby_schema>& containerConfig,
-                                                            const std::shared_ptr<DobbyRdkPluginUtils> &util,
-                                                            const std::string &rootfsPath);
-            typedef void (*DestroyPluginFunction)(IDobbyRdkPlugin *);
-
-            CreatePluginFunction createFunc = reinterpret_cast<CreatePluginFunction>(libCreateFn);
-            DestroyPluginFunction destroyFunc = reinterpret_cast<DestroyPluginFunction>(libDestroyFn);
-
-            std::shared_ptr<IDobbyRdkPlugin> loadedPlugin(createFunc(mContainerConfig, mUtils, mRootfsPath),
-                                                    destroyFunc);
-
-            plugin = std::move(loadedPlugin);
+            plugin.reset(library->createPlugin(mContainerConfig, mUtils, mRootfsPath),
+                         destroyPlugin);
         }
-        else if (isLogger)
+        else
         {
-            // execute the register function ... fingers crossed
-            typedef IDobbyRdkLoggingPlugin *(*CreateLoggerFunction)(std::shared_ptr<rt_dobby_schema>& containerConfig,
-                                                            const std::shared_ptr<DobbyRdkPluginUtils> &util,
-                                                            const std::string &rootfsPath);
-            typedef void (*DestroyLoggerFunction)(IDobbyRdkLoggingPlugin *);
-
-            CreateLoggerFunction createFunc = reinterpret_cast<CreateLoggerFunction>(libCreateLoggerFn);
-            DestroyLoggerFunction destroyFunc = reinterpret_cast<DestroyLoggerFunction>(libDestroyLoggerFn);
-
-            std::shared_ptr<IDobbyRdkPlugin> loadedPlugin(createFunc(mContainerConfig, mUtils, mRootfsPath),
-                                                    destroyFunc);
-
-            std::shared_ptr<IDobbyRdkLoggingPlugin> loadedLogger(createFunc(mContainerConfig, mUtils, mRootfsPath),
-                                                     destroyFunc);
-
-            logger = std::move(loadedLogger);
-            plugin = std::move(loadedPlugin);
+            plugin.reset(library->createLogger(mContainerConfig, mUtils, mRootfsPath),
+                         destroyLogger);
+            logger.reset(library->createLogger(mContainerConfig, mUtils, mRootfsPath),
+                         destroyLogger);
         }
 
-
-        if (!plugin)
+        if (!plugin || (library->isLogger && !logger))
         {
-            AI_LOG_WARN("plugin for library '%s' failed to register", libPath);
-            dlclose(libHandle);
-            free(namelist[i]);
+            AI_LOG_WARN("plugin for library '%s' failed to register", library->path.c_str());
             continue;
         }
 
-        std::string pluginName = plugin->name();
-        if (pluginName.empty())
+        mPlugins[pluginName] = std::make_pair(library->handle, plugin);
+        if (library->isLogger)
         {
-            AI_LOG_WARN("plugin for library '%s' returned an invalid name", libPath);
-            plugin.reset();
-            dlclose(libHandle);
-            free(namelist[i]);
-            continue;
+            mLoggers[pluginName] = std::make_pair(library->handle, logger);
         }
 
-        // Plugin names aren't case sensitive, so convert to lowercase
-        std::transform(pluginName.begin(), pluginName.end(), pluginName.begin(), ::tolower);
-
-        // it's all good in the hood, so add the library handle and plugin to
-        // the internal maps
-        std::map<std::string,
-                 std::pair<void *,
-                 std::shared_ptr<IDobbyRdkPlugin>>>::iterator it = mPlugins.find(pluginName);
-        if (it != mPlugins.end())
-        {
-            AI_LOG_WARN("already had a plugin called '%s', replacing with new "
-                        "one from '%s'",
-                        pluginName.c_str(), libPath);
-
-            it->second.second.reset();
-
-            if (isLogger)
-            {
-                auto iter = mLoggers.find(pluginName);
-                if(iter != mLoggers.end())
-                {
-                    iter->second.second.reset();
-                    mLoggers.erase(iter);
-                }
-            }
-
-            //  destruct the pointer first then close the library as
-            // the destructor needs to be called from the library.
-            dlclose(it->second.first);
-            mPlugins.erase(it);
-        }
-
-        mPlugins[pluginName] = std::make_pair(libHandle, plugin);
-        if (isLogger)
-        {
-            mLoggers[pluginName] = std::make_pair(libHandle, logger);
-        }
+        AI_LOG_INFO("Loaded plugin '%s' from '%s'\n", pluginName.c_str(), library->path.c_str());
+    }
 
-        AI_LOG_INFO("Loaded plugin '%s' from '%s'\n", pluginName.c_str(), libPath);
+    const DobbyRdkPluginCatalogue::Metrics after = catalogue.metrics();
 
-        free(namelist[i]);
-    }
+    mLoadMetrics.loadTime = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime);
+    mLoadMetrics.pluginsLoaded = mPlugins.size();
+    mLoadMetrics.librariesOpened = after.librariesOpened - before.librariesOpened;
+    mLoadMetrics.directoryScanned = (after.scans != before.scans);
 
-    free(namelist);
-    closedir(dir);
+    AI_LOG_INFO("loaded %u plugins in %lldus (%u libraries opened%s)",
+                mLoadMetrics.pluginsLoaded,
+                static_cast<long long>(mLoadMetrics.loadTime.count()),
+                mLoadMetrics.librariesOpened,
+                mLoadMetrics.directoryScanned ? ", plugin dir scanned" : "");
 
     AI_LOG_FN_EXIT();
     return true;
@@ -542,6 +428,16 @@ std::shared_ptr<IDobbyRdkPlugin> DobbyRdkPluginManager::getPlugin(const std::str
     return plugin;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ * @brief Returns how long it took to load the plugins for the container.
+ *
+ */
+const DobbyRdkPluginManager::LoadMetrics& DobbyRdkPluginManager::loadMetrics() const
+{
+    return mLoadMetrics;
+}
+
 // -----------------------------------------------------------------------------
 /**
  * @brief Just return a list of all loaded logging plugin names
@@ -599,6 +495,19 @@ bool DobbyRdkPluginManager::isRequired(const std::string &pluginName) const
     return mRequiredPlugins.count(pluginName) != 0;
 }
 
+/**
+ * @brief Check if a plugin's timed hooks should be run in a separate process.
+ *
+ * @param[in]   pluginName The name of the plugin to check.
+ *
+ * @return True if the plugin sets IsolateHooksFlag, false if not.
+ */
+bool DobbyRdkPluginManager::isIsolated(const std::string &pluginName) const
+{
+    std::shared_ptr<IDobbyRdkPlugin> plugin = getPlugin(pluginName);
+    return plugin && (plugin->hookHints() & IDobbyRdkPlugin::HintFlags::IsolateHooksFlag);
+}
+
 // -----------------------------------------------------------------------------
 /**
  * @brief Check if a plugin implements the specified hook
@@ -625,177 +534,401 @@ bool DobbyRdkPluginManager::implementsHook(const std::string &pluginName,
 
 // -----------------------------------------------------------------------------
 /**
- * Runs the specified hook for a given plugin
+ * Calls the plugin method for the given hook.
  *
- * @param[in]   pluginName      Name of the plugin to run
+ * Doesn't touch the plugin manager, so is safe to call from a hook thread
+ * that has outlived its timeout.
+ *
+ * @param[in]   plugin          The plugin to run
  * @param[in]   hook            Which hook to execute
  *
  * @return True if the hook executed successfully
  */
-bool DobbyRdkPluginManager::executeHook(const std::string &pluginName,
-                                        const IDobbyRdkPlugin::HintFlags hook) const
+static bool callHook(IDobbyRdkPlugin &plugin, const IDobbyRdkPlugin::HintFlags hook)
 {
-    AI_LOG_FN_ENTRY();
-
-    // If plugin isn't loaded, then we can't run it!
-    std::shared_ptr<IDobbyRdkPlugin> plugin = getPlugin(pluginName);
-    if (!plugin)
-    {
-        AI_LOG_ERROR("Cannot execute hook as plugin %s isn't loaded", pluginName.c_str());
-        AI_LOG_FN_EXIT();
-        return false;
-    }
-
     // We know that plugins are derived from RdkPluginBase which includes
     // base implementations of all hooks, so even if the hint flags are wrong,
     // it's safe to call any hook
     switch (hook)
     {
     case IDobbyRdkPlugin::HintFlags::PostInstallationFlag:
-        return plugin->postInstallation();
+        return plugin.postInstallation();
     case IDobbyRdkPlugin::HintFlags::PreCreationFlag:
-        return plugin->preCreation();
+        return plugin.preCreation();
     case IDobbyRdkPlugin::HintFlags::CreateContainerFlag:
-        return plugin->createContainer();
+        return plugin.createContainer();
     case IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag:
-        return plugin->createRuntime();
+        return plugin.createRuntime();
 #ifdef USE_STARTCONTAINER_HOOK
     case IDobbyRdkPlugin::HintFlags::StartContainerFlag:
-        return plugin->startContainer();
+        return plugin.startContainer();
 #endif
     case IDobbyRdkPlugin::HintFlags::PostStartFlag:
-        return plugin->postStart();
+        return plugin.postStart();
     case IDobbyRdkPlugin::HintFlags::PostHaltFlag:
-        return plugin->postHalt();
+        return plugin.postHalt();
     case IDobbyRdkPlugin::HintFlags::PostStopFlag:
-        return plugin->postStop();
+        return plugin.postStop();
     default:
-        AI_LOG_ERROR_EXIT("Could not work out which hook method to call");
+        AI_LOG_ERROR("Could not work out which hook method to call");
         return false;
     }
 }
 
 // -----------------------------------------------------------------------------
 /**
- * Runs the specified hook for a given plugin, checks if execution takes
- * less than timeoutMs value, and if so kills the process.
+ * Runs the specified hook for a given plugin
  *
  * @param[in]   pluginName      Name of the plugin to run
  * @param[in]   hook            Which hook to execute
- * @param[in]   timeoutMs       Timeout value in miliseconds
  *
  * @return True if the hook executed successfully
  */
-bool DobbyRdkPluginManager::executeHookTimeout(const std::string &pluginName,
-                                                const IDobbyRdkPlugin::HintFlags hook,
-                                                const uint timeoutMs) const
+bool DobbyRdkPluginManager::executeHook(const std::string &pluginName,
+                                        const IDobbyRdkPlugin::HintFlags hook) const
 {
-    int status;
-    pid_t exitedPid;
-    pid_t workerPid;
-    pid_t timeoutPid;
-    const size_t sharedMemorySize = 1;
+    AI_LOG_FN_ENTRY();
 
-    // Create shared memory to get result from hook execution
-    void* sharedMemory = mmap(NULL, sharedMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-    if (sharedMemory == MAP_FAILED)
+    // If plugin isn't loaded, then we can't run it!
+    std::shared_ptr<IDobbyRdkPlugin> plugin = getPlugin(pluginName);
+    if (!plugin)
     {
-        AI_LOG_ERROR_EXIT("Failed to allocate shared memory");
+        AI_LOG_ERROR("Cannot execute hook as plugin %s isn't loaded", pluginName.c_str());
+        AI_LOG_FN_EXIT();
         return false;
     }
 
-    // Set result as fail in case we need to kill worker
-  
-    *static_cast<char*>(sharedMemory) = 0;
+    const DobbyPluginMetrics::Timer timer = DobbyPluginMetrics::startTimer();
+    const bool success = callHook(*plugin, hook);
+    DobbyPluginMetrics::record(timer, pluginName, HookPointToString(hook),
+                               mUtils->getContainerId(), success);
+
+    AI_LOG_FN_EXIT();
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ * Runs the specified hook for a set of plugins, giving up on any that take
+ * longer than timeoutMs.
+ *
+ * Each hook runs on its own thread, unless the plugin is isolated (see
+ * isIsolated()) in which case it runs in a forked worker process.  The
+ * calling thread acts as the watchdog; each worker signals completion on an
+ * fd and the deadlines are enforced with a timerfd, so we never wait on
+ * children we didn't create.
+ *
+ * A worker process that times out is killed along with its process group.  A
+ * thread can't be killed, so its result is ignored and the thread is kept in
+ * mTimedOutThreads until the destructor detaches it.  Threads that finish in
+ * time are joined straight away.
+ *
+ * A worker process can't add to the hook objects of this process, so it
+ * commits whatever its own hook shared through the utils before returning
+ * its result.  The objects it inherited are left for this process to commit.
+ *
+ * Every hook, including those that time out, is recorded in DobbyPluginMetrics
+ * from the point its worker was started.
+ *
+ * Up to MAX_PARALLEL_HOOKS workers run at once.  Isolated plugins are started
+ * first so that, as far as possible, we fork before starting any threads.
+ *
+ * @param[in]   pluginNames     Names of the plugins to run
+ * @param[in]   hook            Which hook to execute
+ * @param[in]   timeoutMs       Timeout value in miliseconds
+ *
+ * @return The result of each hook, in the same order as pluginNames
+ */
+std::vector<bool> DobbyRdkPluginManager::executeHooksTimeout(const std::vector<std::string> &pluginNames,
+                                                             const IDobbyRdkPlugin::HintFlags hook,
+                                                             const uint timeoutMs) const
+{
+    // State shared with a hook thread, may outlive this function
+    struct HookThread
+    {
+        int eventFd = -1;
+        std::atomic<bool> result{ false };
+
+        ~HookThread()
+        {
+            if ((eventFd >= 0) && (close(eventFd) != 0))
+                AI_LOG_SYS_ERROR(errno, "failed to close eventfd");
+        }
+    };
 
-    workerPid = fork();
-    if (workerPid == 0)
+    struct Worker
     {
-        // Create a new SID for the child process
-        if (setsid() < 0)
-            _exit(EXIT_FAILURE);
+        pid_t pid;
+        int resultFd;
+        std::shared_ptr<HookThread> state;
+        std::thread thread;
+        std::chrono::steady_clock::time_point deadline;
+        DobbyPluginMetrics::Timer timer;
+    };
+
+    std::vector<bool> results(pluginNames.size(), false);
 
-        char result = static_cast<char>(executeHook(pluginName, hook));
-         // Set result in shared memory
-        *static_cast<char*>(sharedMemory) = result;
-        _exit(0);
+    const std::string hookName = HookPointToString(hook);
+    const std::string containerId = mUtils->getContainerId();
+
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timerFd < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to create timerfd");
+        return results;
     }
-    else if (workerPid < 0)
+
+    // Isolated plugins first, otherwise keep the order we were given
+    std::vector<size_t> startOrder;
+    startOrder.reserve(pluginNames.size());
+    for (size_t i = 0; i < pluginNames.size(); i++)
     {
-        AI_LOG_ERROR_EXIT("Failed to fork for executeHookTimeout");
-        munmap(sharedMemory, sharedMemorySize);
-        return false;
+        if (isIsolated(pluginNames[i]))
+            startOrder.push_back(i);
+    }
+    for (size_t i = 0; i < pluginNames.size(); i++)
+    {
+        if (!isIsolated(pluginNames[i]))
+            startOrder.push_back(i);
     }
 
-    timeoutPid = fork();
-    if (timeoutPid == 0)
+    std::map<size_t, Worker> running;
+    auto next = startOrder.begin();
+
+    while ((next != startOrder.end()) || !running.empty())
     {
-        struct timespec timeout_val, remaining;
-        timeout_val.tv_nsec = (long)(timeoutMs % 1000) * 1000000;
-        timeout_val.tv_sec = timeoutMs / 1000;
-        // In case signal comes during wait
-        while (nanosleep(&timeout_val, &remaining) && errno == EINTR)
+        // Start as many workers as we're allowed
+        while ((next != startOrder.end()) && (running.size() < MAX_PARALLEL_HOOKS))
         {
-            timeout_val = remaining;
+            const size_t index = *(next++);
+            const std::string &pluginName = pluginNames[index];
+
+            std::shared_ptr<IDobbyRdkPlugin> plugin = getPlugin(pluginName);
+            if (!plugin)
+            {
+                AI_LOG_ERROR("Cannot execute hook as plugin %s isn't loaded", pluginName.c_str());
+                continue;
+            }
+
+            const DobbyPluginMetrics::Timer timer = DobbyPluginMetrics::startTimer();
+            const auto deadline = timer.start + std::chrono::milliseconds(timeoutMs);
+
+            if (isIsolated(pluginName))
+            {
+                int pipeFds[2];
+                if (pipe2(pipeFds, O_CLOEXEC) != 0)
+                {
+                    AI_LOG_SYS_ERROR(errno, "Failed to create pipe for plugin %s",
+                                     pluginName.c_str());
+                    continue;
+                }
+
+                pid_t workerPid = fork();
+                if (workerPid == 0)
+                {
+                    // Create a new SID for the child process
+                    if (setsid() < 0)
+                        _exit(EXIT_FAILURE);
+
+                    close(pipeFds[0]);
+
+                    mUtils->discardHookObjects();
+
+                    bool success = callHook(*plugin, hook);
+                    if (!mUtils->commitHookObjects())
+                    {
+                        AI_LOG_ERROR("failed to commit the changes of plugin %s",
+                                     pluginName.c_str());
+                        success = false;
+                    }
+
+                    char result = static_cast<char>(success);
+                    if (TEMP_FAILURE_RETRY(write(pipeFds[1], &result, 1)) != 1)
+                        _exit(EXIT_FAILURE);
+
+                    _exit(0);
+                }
+
+                close(pipeFds[1]);
+
+                if (workerPid < 0)
+                {
+                    AI_LOG_SYS_ERROR(errno, "Failed to fork to run plugin %s",
+                                     pluginName.c_str());
+                    close(pipeFds[0]);
+                    continue;
+                }
+
+                running.emplace(index, Worker{ workerPid, pipeFds[0], nullptr, std::thread(),
+                                               deadline, timer });
+            }
+            else
+            {
+                auto state = std::make_shared<HookThread>();
+                state->eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+                if (state->eventFd < 0)
+                {
+                    AI_LOG_SYS_ERROR(errno, "Failed to create eventfd for plugin %s",
+                                     pluginName.c_str());
+                    continue;
+                }
+
+                std::thread thread;
+                try
+                {
+                    thread = std::thread([state, plugin, hook]()
+                    {
+                        state->result = callHook(*plugin, hook);
+
+                        uint64_t doorbell = 1;
+                        if (TEMP_FAILURE_RETRY(write(state->eventFd, &doorbell, sizeof(doorbell))) != sizeof(doorbell))
+                            AI_LOG_SYS_ERROR(errno, "failed to signal hook completion");
+                    });
+                }
+                catch (const std::system_error &e)
+                {
+                    AI_LOG_ERROR("Failed to create thread to run plugin %s: %s",
+                                 pluginName.c_str(), e.what());
+                    continue;
+                }
+
+                const int eventFd = state->eventFd;
+                running.emplace(index, Worker{ -1, eventFd, std::move(state), std::move(thread),
+                                               deadline, timer });
+            }
         }
 
-        _exit(0);
-    }
-    
-    // Wait for either worker or timeout to finish
-    do
-    {
-        exitedPid = TEMP_FAILURE_RETRY(wait(&status));
-        if (exitedPid >= 0 &&
-            exitedPid != timeoutPid &&
-            exitedPid != workerPid)
+        if (running.empty())
+        {
+            continue;
+        }
+
+        // Arm the timer for the nearest deadline and wait for it or a worker
+        // to finish
+        std::vector<struct pollfd> pollFds;
+        pollFds.reserve(running.size() + 1);
+        auto nearest = std::chrono::steady_clock::time_point::max();
+        for (const auto &worker : running)
         {
-            AI_LOG_DEBUG("Found non-waited process with pid %d", exitedPid);
+            pollFds.push_back({ worker.second.resultFd, POLLIN, 0 });
+            nearest = std::min(nearest, worker.second.deadline);
         }
-    } while (exitedPid >= 0 &&
-             exitedPid != timeoutPid &&
-             exitedPid != workerPid);
-
-    if (exitedPid == timeoutPid)
-    {
-        // Timeout occurred
-        AI_LOG_ERROR("Timeout executing plugin %s hookpoint %s",
-                     pluginName.c_str(), HookPointToString(hook).c_str());
-
-      // Check if we can kill workerPid (if it ended already
-      // then we will be unable to kill)
-      if (kill(workerPid, 0) == -1)
-      {
-        // Cannot kill process, probably already dead
-        // treat it as if it would return proper waitpid
-        AI_LOG_DEBUG("Cannot kill after timeout");
-        exitedPid = waitpid(workerPid, &status, WNOHANG);
-      }
-      else
-      {
-        // Worker is stuck, we need to kill whole group
-        // in case any child process was stuck too
-        AI_LOG_DEBUG("Can kill after timeout");
-        killpg(workerPid, SIGKILL);
-        // Collect the worker process
-        pid_t waited = waitpid(workerPid, &status, 0);
-        if (waited == -1)
+        pollFds.push_back({ timerFd, POLLIN, 0 });
+
+        const auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            nearest - std::chrono::steady_clock::now());
+
+        struct itimerspec timerSpec;
+        bzero(&timerSpec, sizeof(timerSpec));
+        if (wait.count() > 0)
         {
-          AI_LOG_SYS_WARN(errno, "Failed to wait for workerPid after killing");
+            timerSpec.it_value.tv_sec = wait.count() / 1000000000;
+            timerSpec.it_value.tv_nsec = wait.count() % 1000000000;
+        }
+        else
+        {
+            // already expired, a zero value would disarm the timer
+            timerSpec.it_value.tv_nsec = 1;
+        }
+
+        if (timerfd_settime(timerFd, 0, &timerSpec, nullptr) != 0)
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to arm timerfd");
+        }
+
+        if ((TEMP_FAILURE_RETRY(poll(pollFds.data(), pollFds.size(), -1)) < 0))
+        {
+            AI_LOG_SYS_ERROR(errno, "poll failed waiting for plugin workers");
+        }
+
+        if (pollFds.back().revents & POLLIN)
+        {
+            uint64_t expirations;
+            if (TEMP_FAILURE_RETRY(read(timerFd, &expirations, sizeof(expirations))) < 0)
+                AI_LOG_SYS_ERROR(errno, "failed to read timerfd");
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+
+        size_t i = 0;
+        for (auto it = running.begin(); it != running.end(); ++i)
+        {
+            const size_t index = it->first;
+            Worker &worker = it->second;
+
+            if (pollFds[i].revents != 0)
+            {
+                if (worker.state)
+                {
+                    // the thread has signalled so is about to return
+                    worker.thread.join();
+                    results[index] = worker.state->result;
+                }
+                else
+                {
+                    // Either the result or EOF if the worker died without
+                    // writing one
+                    char result = 0;
+                    if (TEMP_FAILURE_RETRY(read(worker.resultFd, &result, 1)) != 1)
+                    {
+                        AI_LOG_ERROR("Worker for plugin %s exited without a result",
+                                     pluginNames[index].c_str());
+                        result = 0;
+                    }
+
+                    results[index] = static_cast<bool>(result);
+
+                    if (TEMP_FAILURE_RETRY(waitpid(worker.pid, nullptr, 0)) < 0)
+                    {
+                        AI_LOG_SYS_WARN(errno, "Failed to wait for worker of plugin %s",
+                                        pluginNames[index].c_str());
+                    }
+
+                    close(worker.resultFd);
+                }
+            }
+            else if (now >= worker.deadline)
+            {
+                AI_LOG_ERROR("Timeout executing plugin %s hookpoint %s",
+                             pluginNames[index].c_str(), HookPointToString(hook).c_str());
+
+                if (worker.state)
+                {
+                    AI_LOG_WARN("Plugin %s hook thread left running until the manager is destroyed",
+                                pluginNames[index].c_str());
+                    mTimedOutThreads.push_back(std::move(worker.thread));
+                }
+                else
+                {
+                    // Worker is stuck, we need to kill whole group in case
+                    // any child process was stuck too
+                    killpg(worker.pid, SIGKILL);
+                    if (TEMP_FAILURE_RETRY(waitpid(worker.pid, nullptr, 0)) < 0)
+                    {
+                        AI_LOG_SYS_WARN(errno, "Failed to wait for workerPid after killing");
+                    }
+
+                    close(worker.resultFd);
+                }
+
+                results[index] = false;
+            }
+            else
+            {
+                ++it;
+                continue;
+            }
+
+            DobbyPluginMetrics::record(worker.timer, pluginNames[index], hookName,
+                                       containerId, results[index]);
+
+            it = running.erase(it);
         }
-        // Collect child of worker if any
-        wait(nullptr);
-      }
-    }
-    else if (exitedPid == workerPid)
-    {
-        kill(timeoutPid, SIGKILL);
-        wait(nullptr);
     }
-    // get result and free shared memory
-    bool result = static_cast<bool>(*static_cast<char*>(sharedMemory));
-    munmap(sharedMemory, sharedMemorySize);
-    return result;
+
+    close(timerFd);
+
+    return results;
 }
 
 // -----------------------------------------------------------------------------
@@ -850,6 +983,10 @@ std::string DobbyRdkPluginManager::HookPointToString(const IDobbyRdkPlugin::Hint
  * Returns true if all required plugins execute successfully. If non-required plugins
  * fail or are not loaded, then it logs an error but continues running other plugins
  *
+ * Once the plugins have run, any objects they shared through the utils (e.g. the
+ * netfilter rules of all the plugins) are committed, even if a plugin failed so
+ * that the postHalt hooks find what the successful plugins did.
+ *
  * @param[in]   hookPoint   Which hook point to execute
  * @param[in]   timeoutMs   Timeout in miliseconds, if 0 (default value) then there
  *                          will be no timeout.
@@ -875,19 +1012,20 @@ bool DobbyRdkPluginManager::runPlugins(const IDobbyRdkPlugin::HintFlags &hookPoi
         return false;
     }
 
-    // Determine the order of launching based on the dependencies.
-    std::vector<std::string> launchOrder;
+    // Determine the order of launching based on the dependencies, plugins in
+    // the same level don't depend on each other.
+    std::vector<std::vector<std::string>> launchLevels;
     if (hookPoint < IDobbyRdkPlugin::HintFlags::PostHaltFlag)
     {
-        launchOrder = mDependencySolver->getOrderOfDependency();
+        launchLevels = mDependencySolver->getDependencyLevels();
     }
     else
     {
         // Reverse the order for the shutdown hooks, so that the plugins
         // on which other plugins depend are shut down later.
-        launchOrder = mDependencySolver->getReversedOrderOfDependency();
+        launchLevels = mDependencySolver->getReversedDependencyLevels();
     }
-    if (launchOrder.empty())
+    if (launchLevels.empty())
     {
         const bool pluginsRequested = (mContainerConfig->rdk_plugins->plugins_count != 0);
         if (pluginsRequested)
@@ -904,47 +1042,74 @@ bool DobbyRdkPluginManager::runPlugins(const IDobbyRdkPlugin::HintFlags &hookPoi
         }
     }
 
-    // Run all the plugins
-    for (const std::string &pluginName : launchOrder)
+    // Run all the plugins, a level at a time
+    for (const std::vector<std::string> &level : launchLevels)
     {
-        if (!implementsHook(pluginName, hookPoint))
+        std::vector<std::string> pluginNames;
+        for (const std::string &pluginName : level)
         {
-            // If the plugin doesn't need to do anything at this hook point, skip
-            AI_LOG_INFO("Plugin %s has nothing to do at %s", pluginName.c_str(), hookName.c_str());
-            continue;
+            if (!implementsHook(pluginName, hookPoint))
+            {
+                // If the plugin doesn't need to do anything at this hook point, skip
+                AI_LOG_INFO("Plugin %s has nothing to do at %s", pluginName.c_str(), hookName.c_str());
+                continue;
+            }
+
+            // Everything looks good, run the plugin
+            AI_LOG_INFO("Running %s plugin", pluginName.c_str());
+            pluginNames.push_back(pluginName);
         }
 
-        bool success = false;
-        // Everything looks good, run the plugin
-        AI_LOG_INFO("Running %s plugin", pluginName.c_str());
+        // With a timeout the hooks run on watchdog supervised workers, so all
+        // the plugins in the level can run at once.  Without one they are the
+        // Dobby hooks that modify the container config, so they are run one
+        // after the other on this thread.
+        std::vector<bool> results;
         if (timeoutMs != 0)
         {
-            success = executeHookTimeout(pluginName, hookPoint, timeoutMs);
+            results = executeHooksTimeout(pluginNames, hookPoint, timeoutMs);
         }
-        else
+
+        // Report the results in the order of the level, if a required plugin
+        // has failed don't bother running any more levels (or plugins for the
+        // in-process case). If it's not required, just log it
+        bool requiredFailed = false;
+        for (size_t i = 0; (i < pluginNames.size()) && !requiredFailed; i++)
         {
-            success = executeHook(pluginName, hookPoint);
+            const std::string &pluginName = pluginNames[i];
+            const bool success = (timeoutMs != 0) ? results[i] : executeHook(pluginName, hookPoint);
+
+            const bool required = isRequired(pluginName);
+            if (!success && required)
+            {
+                AI_LOG_ERROR("Required plugin %s %s hook has failed", pluginName.c_str(), hookName.c_str());
+                requiredFailed = true;
+            }
+            else if (!success && !required)
+            {
+                AI_LOG_WARN("Non-required plugin %s %s hook has failed. Continuing running other plugins.",
+                            pluginName.c_str(), hookName.c_str());
+            }
+            else
+            {
+                AI_LOG_INFO("Plugin %s has %s hook run successfully", pluginName.c_str(), hookName.c_str());
+            }
         }
 
-        // If the plugin has failed and is required, don't bother running any
-        // other plugins. If it's not required, just log it
-        const bool required = isRequired(pluginName);
-        if (!success && required)
+        if (requiredFailed)
         {
-            AI_LOG_ERROR("Required plugin %s %s hook has failed", pluginName.c_str(), hookName.c_str());
+            mUtils->commitHookObjects();
             AI_LOG_FN_EXIT();
             return false;
         }
-        else if (!success && !required)
-        {
-            AI_LOG_WARN("Non-required plugin %s %s hook has failed. Continuing running other plugins.",
-                        pluginName.c_str(), hookName.c_str());
-        }
-        else
-        {
-            AI_LOG_INFO("Plugin %s has %s hook run successfully", pluginName.c_str(), hookName.c_str());
-        }
     }
+
+    if (!mUtils->commitHookObjects())
+    {
+        AI_LOG_ERROR_EXIT("failed to commit the %s changes of the plugins", hookName.c_str());
+        return false;
+    }
+
     AI_LOG_FN_EXIT();
     return true;
 }
@@ -136,6 +136,21 @@ std::string DobbyRdkPluginUtils::getContainerId() const
     return mContainerId;
 }
 
+// -------------------------------------------------------------------------
+/**
+ *  @brief Replaces the container state given to the plugins.
+ *
+ *  Used by the hook server, which keeps the same utils object (and plugins)
+ *  for all the OCI hooks of a container, to pass on the state of the hook
+ *  being run.  Must not be called while plugins are running.
+ *
+ *  @param[in]  state       The OCI state of the container.
+ */
+void DobbyRdkPluginUtils::setState(const std::shared_ptr<const rt_state_schema> &state)
+{
+    mState = state;
+}
+
 // -------------------------------------------------------------------------
 /**
  *  @brief Gets network info about the container (veth/IP)
@@ -798,3 +813,90 @@ bool DobbyRdkPluginUtils::removeAnnotation(const std::string &key)
 
     return success;
 }
+
+// -------------------------------------------------------------------------
+/**
+ *  @brief Returns the object with the given name that's shared by all the
+ *  plugins running the current hook point, creating it if needed.
+ *
+ *  This lets plugins batch up work, e.g. netfilter rules, that's then done
+ *  once by the @a commit function after all the plugins for the hook point
+ *  have run, rather than once per plugin.  The plugin manager calls
+ *  commitHookObjects() at the end of each hook point.
+ *
+ *  The plugins for a hook point may run in parallel, so the object must do
+ *  its own locking.  @a create is called with the utils lock held, so it
+ *  mustn't call back into this object.
+ *
+ *  @param[in]  name        The name of the object.
+ *  @param[in]  create      Creates the object if it doesn't exist.
+ *  @param[in]  commit      Called with the object once the hook point is
+ *                          done.
+ *
+ *  @return the object, or nullptr if it couldn't be created.
+ */
+std::shared_ptr<void> DobbyRdkPluginUtils::hookObject(const std::string &name,
+                                                      const std::function<std::shared_ptr<void>()> &create,
+                                                      const HookObjectCommit &commit)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    auto it = mHookObjects.find(name);
+    if (it != mHookObjects.end())
+    {
+        return it->second.first;
+    }
+
+    std::shared_ptr<void> object = create();
+    if (object)
+    {
+        mHookObjects.emplace(name, std::make_pair(object, commit));
+    }
+
+    return object;
+}
+
+// -------------------------------------------------------------------------
+/**
+ *  @brief Commits and then releases all the objects created with
+ *  hookObject() since the last commit.
+ *
+ *  @return false if any of the commits failed, otherwise true.
+ */
+bool DobbyRdkPluginUtils::commitHookObjects()
+{
+    AI_LOG_FN_ENTRY();
+
+    std::map<std::string, std::pair<std::shared_ptr<void>, HookObjectCommit>> objects;
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+        objects.swap(mHookObjects);
+    }
+
+    bool success = true;
+    for (const auto &object : objects)
+    {
+        if (!object.second.second(object.second.first))
+        {
+            AI_LOG_ERROR("failed to commit '%s'", object.first.c_str());
+            success = false;
+        }
+    }
+
+    AI_LOG_FN_EXIT();
+    return success;
+}
+
+// -------------------------------------------------------------------------
+/**
+ *  @brief Releases all the objects created with hookObject() since the last
+ *  commit without committing them.
+ *
+ *  Used by a forked hook worker, the objects it inherited are committed by
+ *  the process it was forked from.
+ */
+void DobbyRdkPluginUtils::discardHookObjects()
+{
+    std::lock_guard<std::mutex> locker(mLock);
+    mHookObjects.clear();
+}
@@ -0,0 +1,120 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyHookServer.h
+ *
+ */
+#ifndef DOBBYHOOKSERVER_H
+#define DOBBYHOOKSERVER_H
+
+#include <rt_dobby_schema.h>
+#include <rt_state_schema.h>
+
+#include <map>
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <string>
+#include <memory>
+
+class DobbyRdkPluginUtils;
+class DobbyRdkPluginManager;
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class DobbyHookServer
+ *  @brief Runs the RDK plugin OCI hooks on behalf of DobbyPluginLauncher.
+ *
+ *  Without the server every OCI hook runs DobbyPluginLauncher as a new
+ *  process, which parses the container's config.json, dlopen's all the
+ *  plugin libraries and works out the plugin dependencies before it can run
+ *  a single hook.  With the server the launcher just forwards the hook name,
+ *  config path and OCI state over a unix socket (see DobbyHookServerProtocol.h)
+ *  and waits for the result.
+ *
+ *  The server parses the config and loads the plugins the first time it sees
+ *  a container and keeps them until the container's poststop hook has run or
+ *  the daemon sends a release request for it.  The hooks are run with the
+ *  same DobbyRdkPluginManager code and timeouts as the launcher uses.
+ *
+ *  The server runs in a 'DobbyPluginLauncher --server' process spawned and
+ *  restarted by the daemon (see DobbyHookServerProcess), so a plugin that
+ *  crashes or leaks only takes down the server and not the daemon; the
+ *  launcher runs the hooks itself while the server is being restarted.
+ *
+ *  Only the hooks that run in the runtime namespace (createRuntime, poststart
+ *  and poststop) are forwarded; createContainer and startContainer execute
+ *  inside the container's namespaces so the launcher still runs those itself.
+ *
+ *  Each connection is handled on its own thread so a slow hook for one
+ *  container doesn't hold up the hooks of other containers.
+ */
+class DobbyHookServer
+{
+public:
+    DobbyHookServer(const std::string &socketPath,
+                    const std::string &pluginPath);
+    ~DobbyHookServer();
+
+public:
+    bool isValid() const;
+
+private:
+    struct Container
+    {
+        std::mutex lock;
+        std::string configPath;
+        std::shared_ptr<rt_dobby_schema> config;
+        std::shared_ptr<DobbyRdkPluginUtils> utils;
+        std::shared_ptr<DobbyRdkPluginManager> pluginManager;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    void run();
+    void handleConnection(int sockFd);
+    int32_t runHook(const std::string &hookName,
+                    const std::string &configPath,
+                    const std::string &stateJson);
+
+    std::shared_ptr<Container> getContainer(const std::string &id,
+                                            const std::string &configPath);
+    bool initContainer(Container &container,
+                       const std::string &configPath,
+                       const std::shared_ptr<const rt_state_schema> &state) const;
+    void evictContainers();
+    void releaseContainer(const std::string &id);
+
+private:
+    const std::string mSocketPath;
+    const std::string mPluginPath;
+
+    int mListenFd;
+    int mStopEventFd;
+    std::thread mThread;
+
+    std::mutex mLock;
+    std::map<std::string, std::shared_ptr<Container>> mContainers;
+
+    std::list<std::future<void>> mConnections;
+};
+
+#endif // !defined(DOBBYHOOKSERVER_H)
@@ -0,0 +1,541 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2016 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyHookServer.cpp
+ *
+ */
+#include "DobbyHookServer.h"
+#include "DobbyHookServerProtocol.h"
+#include "DobbyRdkPluginManager.h"
+#include "DobbyRdkPluginUtils.h"
+#include "DobbyPluginMetrics.h"
+
+#include <Logging.h>
+
+#include <poll.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+#include <vector>
+
+
+// the maximum number of containers to keep plugins loaded for, this is only
+// reached if containers go away without their poststop hook being run
+#define MAX_HOOK_SERVER_CONTAINERS  32
+
+// the same per-plugin timeout as DobbyPluginLauncher uses
+#define HOOK_TIMEOUT_MS             4000
+
+
+DobbyHookServer::DobbyHookServer(const std::string &socketPath,
+                                 const std::string &pluginPath)
+    : mSocketPath(socketPath)
+    , mPluginPath(pluginPath)
+    , mListenFd(-1)
+    , mStopEventFd(-1)
+{
+    AI_LOG_FN_ENTRY();
+
+    // make sure the directory for the socket exists
+    const size_t slash = mSocketPath.rfind('/');
+    if ((slash != std::string::npos) && (slash > 0))
+    {
+        const std::string dirPath = mSocketPath.substr(0, slash);
+        if ((mkdir(dirPath.c_str(), 0755) != 0) && (errno != EEXIST))
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to create '%s'", dirPath.c_str());
+        }
+    }
+
+    struct sockaddr_un addr;
+    bzero(&addr, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (mSocketPath.length() >= sizeof(addr.sun_path))
+    {
+        AI_LOG_ERROR_EXIT("socket path '%s' is too long", mSocketPath.c_str());
+        return;
+    }
+    strcpy(addr.sun_path, mSocketPath.c_str());
+
+    mListenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (mListenFd < 0)
+    {
+        AI_LOG_SYS_ERROR_EXIT(errno, "failed to create hook server socket");
+        return;
+    }
+
+    // remove any socket left over from a previous instance
+    if ((unlink(mSocketPath.c_str()) != 0) && (errno != ENOENT))
+    {
+        AI_LOG_SYS_WARN(errno, "failed to remove old socket '%s'",
+                        mSocketPath.c_str());
+    }
+
+    if ((bind(mListenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) ||
+        (chmod(mSocketPath.c_str(), 0600) != 0) ||
+        (listen(mListenFd, 16) != 0))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to setup hook server socket @ '%s'",
+                         mSocketPath.c_str());
+
+        close(mListenFd);
+        mListenFd = -1;
+
+        AI_LOG_FN_EXIT();
+        return;
+    }
+
+    mStopEventFd = eventfd(0, EFD_CLOEXEC);
+    if (mStopEventFd < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to create eventfd");
+
+        close(mListenFd);
+        mListenFd = -1;
+        unlink(mSocketPath.c_str());
+
+        AI_LOG_FN_EXIT();
+        return;
+    }
+
+    mThread = std::thread(&DobbyHookServer::run, this);
+
+    AI_LOG_INFO("hook server listening on '%s'", mSocketPath.c_str());
+
+    AI_LOG_FN_EXIT();
+}
+
+DobbyHookServer::~DobbyHookServer()
+{
+    AI_LOG_FN_ENTRY();
+
+    if (mThread.joinable())
+    {
+        uint64_t doStop = 1;
+        if (TEMP_FAILURE_RETRY(write(mStopEventFd, &doStop, sizeof(doStop))) != sizeof(doStop))
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to signal hook server thread to stop");
+        }
+
+        mThread.join();
+    }
+
+    // wait for any hooks still being run
+    mConnections.clear();
+
+    if ((mStopEventFd >= 0) && (close(mStopEventFd) != 0))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to close eventfd");
+    }
+
+    if (mListenFd >= 0)
+    {
+        if (close(mListenFd) != 0)
+            AI_LOG_SYS_ERROR(errno, "failed to close hook server socket");
+
+        unlink(mSocketPath.c_str());
+    }
+
+    AI_LOG_FN_EXIT();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns true if the server is listening for hook requests.
+ *
+ */
+bool DobbyHookServer::isValid() const
+{
+    return mThread.joinable();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Thread function that accepts connections from the launcher.
+ *
+ */
+void DobbyHookServer::run()
+{
+    pthread_setname_np(pthread_self(), "DOBBY_HOOKS");
+
+    while (true)
+    {
+        struct pollfd fds[2];
+        fds[0].fd = mStopEventFd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = mListenFd;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        int ret = TEMP_FAILURE_RETRY(poll(fds, 2, -1));
+        if (ret < 0)
+        {
+            AI_LOG_SYS_ERROR(errno, "poll failed on hook server socket");
+            break;
+        }
+
+        if (fds[0].revents)
+        {
+            break;
+        }
+
+        if ((fds[1].revents & POLLIN) == 0)
+        {
+            continue;
+        }
+
+        int sockFd = accept4(mListenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (sockFd < 0)
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to accept hook connection");
+            continue;
+        }
+
+        // reap the connections that have finished
+        auto it = mConnections.begin();
+        while (it != mConnections.end())
+        {
+            if (it->wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+                it = mConnections.erase(it);
+            else
+                ++it;
+        }
+
+        mConnections.emplace_back(std::async(std::launch::async,
+                                             &DobbyHookServer::handleConnection,
+                                             this, sockFd));
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads a single request from the launcher, runs the hook and sends
+ *  back the result.
+ *
+ *  Release and metrics requests from the daemon are handled here too, the
+ *  reply to a metrics request carries the serialised DobbyPluginMetrics of
+ *  this process after the result.
+ *
+ *  @param[in]  sockFd      The connected socket, closed on return.
+ */
+void DobbyHookServer::handleConnection(int sockFd)
+{
+    AI_LOG_FN_ENTRY();
+
+    int32_t result = HookNotHandled;
+    std::string payload;
+
+    // only accept requests from root or ourselves
+    struct ucred cred;
+    socklen_t credLen = sizeof(cred);
+    if (getsockopt(sockFd, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) != 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to get hook client credentials");
+    }
+    else if ((cred.uid != 0) && (cred.uid != geteuid()))
+    {
+        AI_LOG_ERROR("rejecting hook request from uid %u", cred.uid);
+    }
+    else
+    {
+        std::vector<char> buf(HOOK_SERVER_MAX_REQUEST_SIZE);
+        ssize_t rd = TEMP_FAILURE_RETRY(recv(sockFd, buf.data(), buf.size(), 0));
+        if (rd <= 0)
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to read hook request");
+        }
+        else
+        {
+            // split the request into its three fields
+            const char *hookName = buf.data();
+            const char *end = buf.data() + rd;
+            const char *configPath = static_cast<const char*>(memchr(hookName, '\0', rd));
+            const char *stateJson = configPath ?
+                static_cast<const char*>(memchr(configPath + 1, '\0', end - (configPath + 1))) :
+                nullptr;
+
+            if (!configPath || !stateJson)
+            {
+                AI_LOG_ERROR("malformed hook request");
+            }
+            else if (strcmp(hookName, HOOK_SERVER_RELEASE_REQUEST) == 0)
+            {
+                releaseContainer(std::string(stateJson + 1, end));
+                result = HookSuccess;
+            }
+            else if (strcmp(hookName, HOOK_SERVER_METRICS_REQUEST) == 0)
+            {
+                payload = DobbyPluginMetrics::serialise(DobbyPluginMetrics::snapshot());
+                if (payload.size() > HOOK_SERVER_MAX_REPLY_SIZE)
+                {
+                    AI_LOG_ERROR("plugin metrics too large to send (%zu bytes)",
+                                 payload.size());
+                    payload.clear();
+                    result = HookFailure;
+                }
+                else
+                {
+                    result = HookSuccess;
+                }
+            }
+            else
+            {
+                result = runHook(hookName, configPath + 1,
+                                 std::string(stateJson + 1, end));
+            }
+        }
+    }
+
+    std::string reply(reinterpret_cast<const char*>(&result), sizeof(result));
+    reply += payload;
+
+    if (TEMP_FAILURE_RETRY(send(sockFd, reply.data(), reply.size(), MSG_NOSIGNAL)) !=
+        static_cast<ssize_t>(reply.size()))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to send hook result");
+    }
+
+    if (close(sockFd) != 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to close hook connection");
+    }
+
+    AI_LOG_FN_EXIT();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Runs the plugins for the given hook.
+ *
+ *  @param[in]  hookName    The name of the OCI hook.
+ *  @param[in]  configPath  The absolute path to the container's config.json.
+ *  @param[in]  stateJson   The OCI state passed to the hook.
+ *
+ *  @return one of the DobbyHookResult values.
+ */
+int32_t DobbyHookServer::runHook(const std::string &hookName,
+                                 const std::string &configPath,
+                                 const std::string &stateJson)
+{
+    AI_LOG_FN_ENTRY();
+
+    // only the hooks executed in the runtime namespace can be run here
+    IDobbyRdkPlugin::HintFlags hookPoint;
+    if (strcasecmp(hookName.c_str(), "createRuntime") == 0)
+        hookPoint = IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag;
+    else if (strcasecmp(hookName.c_str(), "poststart") == 0)
+        hookPoint = IDobbyRdkPlugin::HintFlags::PostStartFlag;
+    else if (strcasecmp(hookName.c_str(), "poststop") == 0)
+        hookPoint = IDobbyRdkPlugin::HintFlags::PostStopFlag;
+    else
+    {
+        AI_LOG_FN_EXIT();
+        return HookNotHandled;
+    }
+
+    parser_error err = nullptr;
+    std::shared_ptr<const rt_state_schema> state(
+        rt_state_schema_parse_data(stateJson.c_str(), nullptr, &err),
+        free_rt_state_schema);
+    if (!state || err)
+    {
+        AI_LOG_ERROR_EXIT("failed to parse container state - %s", err ? err : "");
+        free(err);
+        return HookNotHandled;
+    }
+
+    const std::string id(state->id);
+    std::shared_ptr<Container> container = getContainer(id, configPath);
+
+    int32_t result;
+    {
+        std::lock_guard<std::mutex> locker(container->lock);
+
+        if (!container->config && !initContainer(*container, configPath, state))
+        {
+            // let the launcher have a go, it'll report the same error
+            AI_LOG_FN_EXIT();
+            return HookNotHandled;
+        }
+
+        AI_LOG_MILESTONE("Running hook %s for container '%s'",
+                         hookName.c_str(), id.c_str());
+
+        if (!container->pluginManager)
+        {
+            AI_LOG_WARN("No plugins listed in config - nothing to do");
+            result = HookSuccess;
+        }
+        else
+        {
+            container->utils->setState(state);
+
+            if (container->pluginManager->runPlugins(hookPoint, HOOK_TIMEOUT_MS))
+            {
+                AI_LOG_INFO("Hook %s completed", hookName.c_str());
+                result = HookSuccess;
+            }
+            else
+            {
+                AI_LOG_WARN("Hook %s failed - plugin(s) ran with errors", hookName.c_str());
+                result = HookFailure;
+            }
+        }
+    }
+
+    // poststop is the last hook, so don't need the plugins anymore
+    if (hookPoint == IDobbyRdkPlugin::HintFlags::PostStopFlag)
+    {
+        std::lock_guard<std::mutex> locker(mLock);
+
+        auto it = mContainers.find(id);
+        if ((it != mContainers.end()) && (it->second == container))
+            mContainers.erase(it);
+    }
+
+    AI_LOG_FN_EXIT();
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the cache entry for the container, creating an empty one if
+ *  needed.
+ *
+ *  If the container id is re-used with a different bundle then the old entry
+ *  is replaced.
+ *
+ *  @param[in]  id          The id of the container.
+ *  @param[in]  configPath  The path to the container's config.json.
+ */
+std::shared_ptr<DobbyHookServer::Container> DobbyHookServer::getContainer(const std::string &id,
+                                                                          const std::string &configPath)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    std::shared_ptr<Container> &container = mContainers[id];
+    if (!container || (container->configPath != configPath))
+    {
+        container = std::make_shared<Container>();
+        container->configPath = configPath;
+    }
+
+    container->lastUsed = std::chrono::steady_clock::now();
+    std::shared_ptr<Container> result = container;
+
+    evictContainers();
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Parses the container's config and loads its plugins.
+ *
+ *  Must be called with the container's lock held.
+ *
+ */
+bool DobbyHookServer::initContainer(Container &container,
+                                    const std::string &configPath,
+                                    const std::shared_ptr<const rt_state_schema> &state) const
+{
+    AI_LOG_DEBUG("Loading container config from file: '%s'", configPath.c_str());
+
+    parser_error err = nullptr;
+    std::shared_ptr<rt_dobby_schema> config(
+        rt_dobby_schema_parse_file(configPath.c_str(), nullptr, &err),
+        free_rt_dobby_schema);
+    if (!config)
+    {
+        AI_LOG_ERROR("Failed to parse OCI config with error: %s", err ? err : "");
+        free(err);
+        return false;
+    }
+    free(err);
+
+    container.config = config;
+
+    if (!config->rdk_plugins || (config->rdk_plugins->plugins_count == 0))
+    {
+        return true;
+    }
+
+    // the rootfs path is relative to the bundle unless it's absolute
+    std::string rootfsPath = config->root->path;
+    if (rootfsPath.front() != '/')
+    {
+        const size_t slash = configPath.rfind('/');
+        rootfsPath = configPath.substr(0, slash + 1) + rootfsPath;
+    }
+
+    container.utils = std::make_shared<DobbyRdkPluginUtils>(config, state, state->id);
+    container.pluginManager = std::make_shared<DobbyRdkPluginManager>(config, rootfsPath,
+                                                                      mPluginPath,
+                                                                      container.utils);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Drops the least recently used containers if there are too many.
+ *
+ *  Must be called with mLock held.
+ */
+void DobbyHookServer::evictContainers()
+{
+    while (mContainers.size() > MAX_HOOK_SERVER_CONTAINERS)
+    {
+        auto oldest = mContainers.begin();
+        for (auto it = mContainers.begin(); it != mContainers.end(); ++it)
+        {
+            if (it->second->lastUsed < oldest->second->lastUsed)
+                oldest = it;
+        }
+
+        AI_LOG_INFO("dropping cached hook plugins for '%s'", oldest->first.c_str());
+        mContainers.erase(oldest);
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Drops the cached config and plugins for the container.
+ *
+ *  Sent by the daemon when the container is removed, normally the cache is
+ *  dropped after the poststop hook has run, but that won't happen if the
+ *  container failed to start or the runtime was killed.
+ *
+ *  @param[in]  id          The id of the container.
+ */
+void DobbyHookServer::releaseContainer(const std::string &id)
+{
+    std::lock_guard<std::mutex> locker(mLock);
+
+    mContainers.erase(id);
+}
@@ -25,15 +25,22 @@
 #include "IDobbyRdkPlugin.h"
 #include "DobbyRdkPluginManager.h"
 #include "DobbyRdkPluginUtils.h"
+#include "DobbyHookServerProtocol.h"
+#include "DobbyHookServer.h"
 
 #include <Logging.h>
 
+#if defined(AI_ENABLE_TRACING)
+    #include <PerfettoTracing.h>
+#endif
+
 #include <stdio.h>
 #include <getopt.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <dlfcn.h>
+#include <signal.h>
 #include <sys/stat.h>
 #include <iostream>
 #include <sstream>
@@ -42,6 +49,8 @@
 #include <mutex>
 #include <sys/syscall.h>
 #include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/socket.h>
 
 #ifdef USE_SYSTEMD
     #define SD_JOURNAL_SUPPRESS_LOCATION
@@ -59,6 +68,7 @@
 static std::string gConfigPath;
 static std::string gHookName;
 static std::string gContainerId;
+static std::string gServerSocketPath;
 
 // -----------------------------------------------------------------------------
 /**
@@ -75,6 +85,8 @@ static void displayUsage()
     printf("  -h, --hook                    Specify the hook to run\n");
     printf("  -c, --config=PATH             Path to container OCI config\n");
     printf("\n");
+    printf("  -s, --server=PATH             Run the hook server on the given socket\n");
+    printf("\n");
 }
 
 // -----------------------------------------------------------------------------
@@ -89,13 +101,14 @@ static void parseArgs(const int argc, char **argv)
             {"hook", required_argument, nullptr, (int)'h'},
             {"verbose", no_argument, nullptr, (int)'v'},
             {"config", required_argument, nullptr, (int)'c'},
+            {"server", required_argument, nullptr, (int)'s'},
             {nullptr, 0, nullptr, 0}};
 
     int opt;
     int index;
 
     // Read through all the options and set variables accordingly
-    while ((opt = getopt_long(argc, argv, "+Hvh:c:", longopts, &index)) != -1)
+    while ((opt = getopt_long(argc, argv, "+Hvh:c:s:", longopts, &index)) != -1)
     {
         switch (opt)
         {
@@ -112,8 +125,11 @@ static void parseArgs(const int argc, char **argv)
         case 'c':
             gConfigPath = reinterpret_cast<const char *>(optarg);
             break;
+        case 's':
+            gServerSocketPath = reinterpret_cast<const char *>(optarg);
+            break;
         case '?':
-            if (optopt == 'c')
+            if ((optopt == 'c') || (optopt == 's'))
                 fprintf(stderr, "Warning: Option -%c requires an argument.\n", optopt);
             else if (isprint(optopt))
                 fprintf(stderr, "Warning: Unknown option `-%c'.\n", optopt);
@@ -164,18 +180,14 @@ IDobbyRdkPlugin::HintFlags determineHookPoint(const std::string &hookName)
 
 // -----------------------------------------------------------------------------
 /**
- *  @brief Gets the state of the container as defined in the OCI spec here:
- *  https://github.com/opencontainers/runtime-spec/blob/master/runtime.md#state
+ *  @brief Reads the state of the container passed to the hook on stdin.
  *
  *  Only available with OCI container hooks.
  *
- *  @return State object. nullptr if not available
+ *  @return the state json string, empty if not available
  */
-std::shared_ptr<const rt_state_schema> getContainerState()
+std::string readContainerState()
 {
-    std::mutex lock;
-    std::lock_guard<std::mutex> locker(lock);
-
     char buf[4096];
     bzero(buf, sizeof(buf));
 
@@ -183,12 +195,12 @@ std::shared_ptr<const rt_state_schema> getContainerState()
     if (bytesRead < 0)
     {
         AI_LOG_SYS_ERROR(errno, "failed to read stdin");
-        return nullptr;
+        return std::string();
     }
     else if (bytesRead == 0)
     {
         AI_LOG_WARN("No data read from stdin");
-        return nullptr;
+        return std::string();
     }
     buf[bytesRead] = '\0'; 
     
@@ -205,6 +217,25 @@ std::shared_ptr<const rt_state_schema> getContainerState()
         }
     }
 
+    return hookStdin;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the state of the container as defined in the OCI spec here:
+ *  https://github.com/opencontainers/runtime-spec/blob/master/runtime.md#state
+ *
+ *  @param[in]  hookStdin   The state json read from stdin.
+ *
+ *  @return State object. nullptr if not available
+ */
+std::shared_ptr<const rt_state_schema> getContainerState(const std::string &hookStdin)
+{
+    if (hookStdin.empty())
+    {
+        return nullptr;
+    }
+
     parser_error err = nullptr;
     auto state = std::shared_ptr<const rt_state_schema>(
         rt_state_schema_parse_data(hookStdin.c_str(), nullptr, &err),
@@ -212,7 +243,7 @@ std::shared_ptr<const rt_state_schema> getContainerState()
 
     if (state.get() == nullptr || err)
     {
-        if (hookStdin.length() == sizeof(buf) - 1)
+        if (hookStdin.length() >= 4095)
         {
             AI_LOG_ERROR("Most probably the read buffer is too small and causes the parse error below!");
         }
@@ -230,6 +261,132 @@ std::shared_ptr<const rt_state_schema> getContainerState()
     return state;
 }
 
+/**
+ * @brief Asks the hook server to run the hook.
+ *
+ * Only hooks executed in the runtime namespace can be forwarded, the server
+ * runs outside the container's namespaces.  If the server isn't running, or
+ * it says it can't handle the hook, then false is returned and the plugins
+ * should be run by this process as normal.
+ *
+ * @param[in]   configPath  Absolute path to the container's config.json
+ * @param[in]   stateJson   The container state read from stdin
+ * @param[out]  success     Set to the result of the hook if forwarded
+ *
+ * @return true if the hook was run by the server.
+ */
+bool forwardToHookServer(const std::string &configPath, const std::string &stateJson, bool *success)
+{
+    std::string request;
+    request.reserve(gHookName.length() + configPath.length() + stateJson.length() + 2);
+    request += gHookName;
+    request += '\0';
+    request += configPath;
+    request += '\0';
+    request += stateJson;
+
+    if (request.length() > HOOK_SERVER_MAX_REQUEST_SIZE)
+    {
+        return false;
+    }
+
+    struct sockaddr_un addr;
+    bzero(&addr, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, HOOK_SERVER_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+
+    int sockFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sockFd < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to create socket");
+        return false;
+    }
+
+    if (connect(sockFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        AI_LOG_DEBUG("hook server not available (%d), running plugins locally", errno);
+        close(sockFd);
+        return false;
+    }
+
+    if (TEMP_FAILURE_RETRY(send(sockFd, request.data(), request.length(), MSG_NOSIGNAL)) !=
+        static_cast<ssize_t>(request.length()))
+    {
+        AI_LOG_SYS_WARN(errno, "failed to send request to hook server");
+        close(sockFd);
+        return false;
+    }
+
+    // once sent the plugins may have (partly) run, so from here on any error
+    // is a hook failure rather than a reason to run the plugins again
+    int32_t result = HookFailure;
+    if (TEMP_FAILURE_RETRY(recv(sockFd, &result, sizeof(result), 0)) != sizeof(result))
+    {
+        AI_LOG_ERROR("lost connection to hook server");
+        result = HookFailure;
+    }
+
+    close(sockFd);
+
+    if (result == HookNotHandled)
+    {
+        return false;
+    }
+
+    *success = (result == HookSuccess);
+    return true;
+}
+
+/**
+ * @brief Runs the hook server until asked to stop
+ *
+ * The daemon starts the server as 'DobbyPluginLauncher --server=PATH' and
+ * stops it with SIGTERM, if the server exits any other way the daemon starts
+ * a new one.
+ *
+ * @param[in]   socketPath  The path of the socket to listen on
+ *
+ * @return the exit code for the process.
+ */
+int runHookServer(const std::string &socketPath)
+{
+    // block the stop signals before any threads are created so that they
+    // all inherit the mask and the signals are only picked up by sigwait
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    if (sigprocmask(SIG_BLOCK, &mask, nullptr) != 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to block signals");
+        return EXIT_FAILURE;
+    }
+
+    // the hooks run here are traced to the system backend, in process
+    // tracing is only started in the daemon (this must be done after the
+    // signals are blocked above as it spawns threads)
+#if defined(AI_ENABLE_TRACING)
+    PerfettoTracing::initialise(PerfettoTracing::SystemBackend);
+#endif
+
+    DobbyHookServer server(socketPath, PLUGIN_PATH);
+    if (!server.isValid())
+    {
+        AI_LOG_ERROR("failed to start hook server");
+        return EXIT_FAILURE;
+    }
+
+    int sig = 0;
+    if (sigwait(&mask, &sig) != 0)
+    {
+        AI_LOG_ERROR("sigwait failed");
+        return EXIT_FAILURE;
+    }
+
+    AI_LOG_INFO("hook server stopping on signal %d", sig);
+    return EXIT_SUCCESS;
+}
+
 /**
  * @brief Run the plugins
  *
@@ -254,11 +411,11 @@ bool runPlugins(const IDobbyRdkPlugin::HintFlags &hookPoint, std::shared_ptr<rt_
     AI_LOG_DEBUG("Successfully loaded %zd plugins\n", loadedPlugins.size());
     AI_LOG_DEBUG("Successfully loaded %zd loggers\n", loadedLoggers.size());
 
-    // We've got plugins to run, but nothing is loaded - that's not good
+    // Only the plugins in the config are loaded, if none of them are
+    // installed the plugin manager will fail any that are required
     if (loadedPlugins.size() == 0)
     {
-        AI_LOG_ERROR("No plugins were loaded - are there any plugins installed?");
-        return {};
+        AI_LOG_WARN("None of the plugins in the config are installed");
     }
 
     bool success = pluginManager.runPlugins(hookPoint, 4000);
@@ -437,6 +594,12 @@ int main(int argc, char *argv[])
 
     AICommon::initLogging(logPrinter);
 
+    if (!gServerSocketPath.empty())
+    {
+        gContainerId = "DobbyHookServer";
+        return runHookServer(gServerSocketPath);
+    }
+
     if (gHookName.empty())
     {
         AI_LOG_ERROR_EXIT("Must give a hook name to execute");
@@ -466,22 +629,11 @@ int main(int argc, char *argv[])
     }
     const std::string fullConfigPath = std::string(absPath);
     free(absPath);
-    AI_LOG_DEBUG("Loading container config from file: '%s'", fullConfigPath.c_str());
-
-    parser_error err;
-    std::shared_ptr<rt_dobby_schema> containerConfig(
-        rt_dobby_schema_parse_file(fullConfigPath.c_str(), NULL, &err),
-        free_rt_dobby_schema);
-
-    if (containerConfig == nullptr)
-    {
-        AI_LOG_ERROR("Failed to parse OCI config with error: %s", err);
-        return EXIT_FAILURE;
-    }
 
     // Get container id from state (using hostname may be incorrect if we
     // launch multiple containers from same bundle)
-    std::shared_ptr<const rt_state_schema> state = getContainerState();
+    const std::string stateJson = readContainerState();
+    std::shared_ptr<const rt_state_schema> state = getContainerState(stateJson);
     if (state)
     {
         gContainerId = std::string(state->id);
@@ -492,6 +644,39 @@ int main(int argc, char *argv[])
         return false;
     }
 
+    // Hooks run in the runtime namespace are handed to the hook server,
+    // which already has the config parsed and plugins loaded
+    if ((hookPoint == IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag) ||
+        (hookPoint == IDobbyRdkPlugin::HintFlags::PostStartFlag) ||
+        (hookPoint == IDobbyRdkPlugin::HintFlags::PostStopFlag))
+    {
+        bool success = false;
+        if (forwardToHookServer(fullConfigPath, stateJson, &success))
+        {
+            if (success)
+            {
+                AI_LOG_INFO("Hook %s completed", gHookName.c_str());
+                return EXIT_SUCCESS;
+            }
+
+            AI_LOG_WARN("Hook %s failed - plugin(s) ran with errors", gHookName.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    AI_LOG_DEBUG("Loading container config from file: '%s'", fullConfigPath.c_str());
+
+    parser_error err;
+    std::shared_ptr<rt_dobby_schema> containerConfig(
+        rt_dobby_schema_parse_file(fullConfigPath.c_str(), NULL, &err),
+        free_rt_dobby_schema);
+
+    if (containerConfig == nullptr)
+    {
+        AI_LOG_ERROR("Failed to parse OCI config with error: %s", err);
+        return EXIT_FAILURE;
+    }
+
     AI_LOG_MILESTONE("Running hook %s for container '%s'", gHookName.c_str(), gContainerId.c_str());
 
     // Get the path of the container rootfs to give to plugins
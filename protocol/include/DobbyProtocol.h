@@ -67,11 +67,13 @@
 #define DOBBY_CTRL_EVENT_STOPPED_WITH_STATUS        "StoppedWithStatus"
 #define DOBBY_CTRL_EVENT_HIBERNATED                 "Hibernated"
 #define DOBBY_CTRL_EVENT_AWOKEN                     "Awoken"
+#define DOBBY_CTRL_EVENT_OOM                        "ContainerOOM"
 
 #define DOBBY_DEBUG_INTERFACE                   DOBBY_SERVICE ".debug1"
 #define DOBBY_DEBUG_METHOD_CREATE_BUNDLE            "CreateBundle"
 #define DOBBY_DEBUG_METHOD_GET_SPEC                 "GetSpec"
 #define DOBBY_DEBUG_METHOD_GET_OCI_CONFIG           "GetOCIConfig"
+#define DOBBY_DEBUG_METHOD_GET_PLUGIN_METRICS       "GetPluginMetrics"
 #define DOBBY_DEBUG_START_INPROCESS_TRACING         "StartInProcessTracing"
 #define DOBBY_DEBUG_STOP_INPROCESS_TRACING          "StopInProcessTracing"
 
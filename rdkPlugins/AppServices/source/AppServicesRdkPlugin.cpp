@@ -24,6 +24,7 @@
 #include <fcntl.h>
 
 REGISTER_RDK_PLUGIN(AppServicesRdkPlugin);
+REGISTER_RDK_PLUGIN_NAME("AppServicesRdk");
 
 AppServicesRdkPlugin::AppServicesRdkPlugin(std::shared_ptr<rt_dobby_schema> &containerConfig,
                                            const std::shared_ptr<DobbyRdkPluginUtils> &utils,
@@ -33,7 +34,6 @@ AppServicesRdkPlugin::AppServicesRdkPlugin(std::shared_ptr<rt_dobby_schema> &con
       mUtils(utils),
       mRootfsPath(rootfsPath),
       mPluginConfig(nullptr),
-      mNetfilter(std::make_shared<Netfilter>()),
       mEnableConnLimit(false)
 {
     AI_LOG_FN_ENTRY();
@@ -159,20 +159,15 @@ bool AppServicesRdkPlugin::createRuntime()
         return false;
     }
 
-    // add all rules to cache
-    if (!mNetfilter->addRules(ruleSet, AF_INET, Netfilter::Operation::Insert))
+    // add all rules to the hook's netfilter transaction, they're applied
+    // once all the plugins have run
+    std::shared_ptr<Netfilter> netfilter = Netfilter::hookTransaction(mUtils);
+    if (!netfilter->addRules(ruleSet, AF_INET, Netfilter::Operation::Insert))
     {
         AI_LOG_ERROR_EXIT("failed to setup AS iptables rules for '%s''", mUtils->getContainerId().c_str());
         return false;
     }
 
-    // actually apply the rules
-    if (!mNetfilter->applyRules(AF_INET))
-    {
-        AI_LOG_ERROR_EXIT("Failed to apply AS iptables rules for '%s'", mUtils->getContainerId().c_str());
-        return false;
-    }
-
     // Add the localhost masquerade rules inside the container namespace
     // Ideally this would be done in the createContainer hook, but that fails
     // on Llama with permissions issues (works fine on VM...)
@@ -248,20 +243,15 @@ bool AppServicesRdkPlugin::postHalt()
         return false;
     }
 
-    // add all rules to cache
-    if (!mNetfilter->addRules(ruleSet, AF_INET, Netfilter::Operation::Delete))
+    // add all rules to the hook's netfilter transaction, they're deleted
+    // once all the plugins have run
+    std::shared_ptr<Netfilter> netfilter = Netfilter::hookTransaction(mUtils);
+    if (!netfilter->addRules(ruleSet, AF_INET, Netfilter::Operation::Delete))
     {
         AI_LOG_ERROR_EXIT("failed to setup AS iptables rules for deletion for '%s'", mUtils->getContainerId().c_str());
         return false;
     }
 
-    // actually delete the rules
-    if (!mNetfilter->applyRules(AF_INET))
-    {
-        AI_LOG_ERROR_EXIT("Failed to delete AS iptables rules for '%s'", mUtils->getContainerId().c_str());
-        return false;
-    }
-
     AI_LOG_FN_EXIT();
     return true;
 }
@@ -112,7 +112,6 @@ private:
 
     bool mValid;
     const rt_defs_plugins_app_services_rdk_data* mPluginConfig;
-    std::shared_ptr<Netfilter> mNetfilter;
     const bool mEnableConnLimit;
 };
 
@@ -28,6 +28,7 @@
 
 
 REGISTER_RDK_PLUGIN(DeviceMapperPlugin);
+REGISTER_RDK_PLUGIN_NAME("DeviceMapper");
 
 DeviceMapperPlugin::DeviceMapperPlugin(std::shared_ptr<rt_dobby_schema> &containerConfig,
                                        const std::shared_ptr<DobbyRdkPluginUtils> &utils,
@@ -28,6 +28,7 @@
 #include <mntent.h>
 
 REGISTER_RDK_PLUGIN(GpuPlugin);
+REGISTER_RDK_PLUGIN_NAME("Gpu");
 
 GpuPlugin::GpuPlugin(std::shared_ptr<rt_dobby_schema> &containerConfig,
                      const std::shared_ptr<DobbyRdkPluginUtils> &utils,
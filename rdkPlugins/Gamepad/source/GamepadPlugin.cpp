@@ -23,6 +23,7 @@
 #include <sstream>
 
 REGISTER_RDK_PLUGIN(GamepadPlugin);
+REGISTER_RDK_PLUGIN_NAME("Gamepad");
 
 GamepadPlugin::GamepadPlugin(std::shared_ptr<rt_dobby_schema> &containerConfig,
                      const std::shared_ptr<DobbyRdkPluginUtils> &utils,
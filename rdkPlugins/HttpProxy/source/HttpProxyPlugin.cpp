@@ -28,6 +28,7 @@
 
 
 REGISTER_RDK_PLUGIN(HttpProxyPlugin);
+REGISTER_RDK_PLUGIN_NAME("HttpProxy");
 
 HttpProxyPlugin::HttpProxyPlugin(std::shared_ptr<rt_dobby_schema> &cfg,
                                  const std::shared_ptr<DobbyRdkPluginUtils> &utils,
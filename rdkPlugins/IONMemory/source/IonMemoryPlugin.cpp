@@ -32,6 +32,7 @@
 #include <sys/types.h>
 
 REGISTER_RDK_PLUGIN(IonMemoryPlugin);
+REGISTER_RDK_PLUGIN_NAME("IonMemory");
 
 IonMemoryPlugin::IonMemoryPlugin(std::shared_ptr<rt_dobby_schema> &containerConfig,
                                  const std::shared_ptr<DobbyRdkPluginUtils> &utils,
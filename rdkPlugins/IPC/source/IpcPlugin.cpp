@@ -30,6 +30,7 @@
  * C methods are visible to allow PluginLauncher to find the plugin
  */
 REGISTER_RDK_PLUGIN(IpcPlugin);
+REGISTER_RDK_PLUGIN_NAME("ipc");
 
 /**
  * @brief Constructor - called when plugin is loaded by PluginLauncher
@@ -26,6 +26,7 @@
 #include <limits.h>
 
 REGISTER_RDK_PLUGIN(LocalTimePlugin);
+REGISTER_RDK_PLUGIN_NAME("LocalTime");
 
 LocalTimePlugin::LocalTimePlugin(std::shared_ptr<rt_dobby_schema> &containerConfig,
                                  const std::shared_ptr<DobbyRdkPluginUtils> &utils,
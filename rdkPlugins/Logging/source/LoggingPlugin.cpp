@@ -36,6 +36,7 @@
  * Register the logging plugin with the special logging registration method
  */
 REGISTER_RDK_LOGGER(LoggingPlugin);
+REGISTER_RDK_PLUGIN_NAME("Logging");
 
 /**
  * @brief Constructor - called when plugin is loaded by PluginLauncher
@@ -29,6 +29,7 @@
  * C methods are visible to allow PluginLauncher to find the plugin
  */
 REGISTER_RDK_PLUGIN(Minidump);
+REGISTER_RDK_PLUGIN_NAME("Minidump");
 
 /**
  * @brief Constructor - called when plugin is loaded by PluginLauncher
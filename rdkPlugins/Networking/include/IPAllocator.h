@@ -24,13 +24,41 @@
 #include "NetworkingPluginCommon.h"
 
 #include <memory>
+#include <mutex>
 #include <arpa/inet.h>
+#include <net/if.h>
+#include <stdint.h>
 #include <queue>
 
 #define TOTAL_ADDRESS_POOL_SIZE 250
 
+// the allocation table shared by all the plugin instances, kept next to (not
+// in) ADDRESS_FILE_DIR as everything in that dir is read as an address file
+// Can override the path at build time by setting -DADDRESS_STORE_PATH=/path/to/file
+#ifndef ADDRESS_STORE_PATH
+    #define ADDRESS_STORE_PATH  "/tmp/dobby/plugin/networking.ips"
+#endif
+
 class DobbyRdkPluginUtils;
 
+// -----------------------------------------------------------------------------
+/**
+ *  @class IPAllocator
+ *  @brief Allocates the container IPv4 addresses from the bridge pool.
+ *
+ *  The allocations are kept in a small fixed size file (ADDRESS_STORE_PATH)
+ *  that is mmap'd by every instance; a bitmap of the used addresses and a
+ *  table with the container id and veth name for each one.  The file is only
+ *  changed with an fcntl write lock held, and a slot's bit is set after its
+ *  record is written and cleared before it's wiped, so a hook process dying
+ *  part way through can at worst leave a slot allocated to its container.
+ *
+ *  The per-container files in ADDRESS_FILE_DIR are still written as other
+ *  plugins read the container's address and veth from them, but they're only
+ *  scanned when the table is first created (i.e. to pick up the containers
+ *  started before it existed).  The container IPv6 addresses are derived from
+ *  the IPv4 ones so don't need a table of their own.
+ */
 class IPAllocator
 {
 public:
@@ -48,7 +76,31 @@ public:
     static std::string ipAddressToString(const in_addr_t &ipAddress);
 
 private:
-    bool getContainerIpsFromDisk();
+    struct StoreRecord
+    {
+        char containerId[132];
+        char vethName[IFNAMSIZ];
+        in_addr_t ipAddress;
+    };
+
+    struct Store
+    {
+        uint32_t magic;
+        uint32_t poolSize;
+        uint64_t bitmap[(TOTAL_ADDRESS_POOL_SIZE + 63) / 64];
+        StoreRecord records[TOTAL_ADDRESS_POOL_SIZE];
+    };
+
+    bool openStore();
+    void importAddressFiles();
+
+    bool lockStore(short type) const;
+    void unlockStore() const;
+
+    int findRecord(const std::string &containerId) const;
+    void setRecord(int slot, const std::string &containerId, const std::string &vethName);
+    void clearRecord(int slot);
+
     bool getNetworkInfo(const std::string &filePath, ContainerNetworkInfo &networkInfo) const;
 
 private:
@@ -56,7 +108,11 @@ private:
     const in_addr_t mBeginAddress;
     const in_addr_t mEndAddress;
 
-    std::vector<ContainerNetworkInfo> mAllocatedIps;
+    int mStoreFd;
+    Store *mStore;
+
+    // fcntl locks don't exclude threads of the same process
+    static std::mutex mStoreLock;
 };
 
 #endif
\ No newline at end of file
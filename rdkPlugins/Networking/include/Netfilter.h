@@ -27,6 +27,10 @@
 #include <list>
 #include <string>
 #include <mutex>
+#include <memory>
+#include <stdint.h>
+
+class DobbyRdkPluginUtils;
 
 
 // -----------------------------------------------------------------------------
@@ -38,15 +42,56 @@
  *  iptables-save and iptables-restore cmdline tools for reading and writing
  *  the rules.
  *
+ *  To avoid running iptables-save before every apply, a process wide shadow
+ *  of the rules is kept for the network namespace the process runs in.  The
+ *  shadow is only trusted if a cheap fingerprint of the kernel tables still
+ *  matches the one taken when it was last updated, otherwise the rules are
+ *  dumped again.
+ *
+ *  The shadow starts empty in every process, so it only saves anything in
+ *  long lived processes that apply rules many times (the daemon and the
+ *  hook server); a DobbyPluginLauncher run for a single hook still dumps the
+ *  rules once.  The fingerprint can't be taken in the same transaction as
+ *  iptables-restore, it's taken just after it returns, so a change made by
+ *  another process in that window isn't noticed until the rules next change.
+ *
+ *  With the nftables backend (selected with the "network.netfilterBackend"
+ *  setting) the iptables-nft variants of the tools are used, so each apply is
+ *  committed as a single nf_tables transaction, and the rules added with
+ *  addContainerRules() are put in chains of their own for each container.
+ *  The base chains then only hold a jump to those chains, so adding or
+ *  removing a container is a couple of jump rules and a chain flush rather
+ *  than a delete for every rule, which nf_tables has to match against the
+ *  whole chain.
+ *
+ *  Rules that would otherwise be repeated for every container can instead
+ *  match against an ipset set, with the container only adding or removing
+ *  elements of the set with addSetEntries().  The set changes are made with
+ *  'ipset restore' before the rules in the same apply are written.
+ *
+ *  The plugins running a hook point for a container should add their rules
+ *  to the instance returned by hookTransaction(), which is applied once for
+ *  each ip version after all the plugins have run.
+ *
  *  TODO: replace use of iptables-save and iptables-restore with libiptc
  *
  */
 class Netfilter
 {
 public:
+    enum class Backend { Iptables, Nftables };
+
     Netfilter();
+    explicit Netfilter(Backend backend);
     ~Netfilter() = default;
 
+    static Backend configuredBackend();
+
+    static std::shared_ptr<Netfilter> hookTransaction(const std::shared_ptr<DobbyRdkPluginUtils> &utils);
+
+    static bool setsAvailable();
+    static std::string setName(const std::string &name, const int ipVersion);
+
 public:
     enum class TableType { Invalid, Raw, Nat, Mangle, Filter, Security };
     typedef std::map<TableType, std::list<std::string>> RuleSet;
@@ -57,6 +102,12 @@ public:
     enum class Operation { Append, Insert, Delete, Unchanged };
 
     bool addRules(RuleSet &ruleSet, const int ipVersion, Operation operation);
+    bool addContainerRules(const std::string &containerId, RuleSet &ruleSet,
+                           const int ipVersion, Operation operation);
+
+    bool addSetEntries(const std::string &setName, const std::string &setType,
+                       const std::list<std::string> &entries,
+                       const int ipVersion, Operation operation);
 
     bool createNewChain(TableType table, const std::string &name,
                         const int ipVersion);
@@ -72,23 +123,61 @@ private:
 
     RuleSet getRuleSet(const int ipVersion) const;
 
+    const char *savePath(const int ipVersion) const;
+    const char *restorePath(const int ipVersion) const;
+
     bool ruleInList(const std::string &rule,
                     const std::list<std::string> &rulesList) const;
 
+    typedef struct ContainerRuleSets
+    {
+        RuleSet insertRuleSet;
+        RuleSet appendRuleSet;
+    } ContainerRuleSets;
+
+    typedef struct SetEntries
+    {
+        std::string type;
+        std::list<std::string> addEntries;
+        std::list<std::string> deleteEntries;
+    } SetEntries;
+
     typedef struct RuleSets
     {
         RuleSet appendRuleSet;
         RuleSet insertRuleSet;
         RuleSet deleteRuleSet;
         RuleSet unchangedRuleSet;
+        RuleSet deleteChainRuleSet;
+
+        // rules for each container's own chains (nftables backend only), an
+        // entry with no rules removes all of the container's chains
+        std::map<std::string, ContainerRuleSets> containerRuleSets;
+
+        // ipset elements to add or delete, keyed by set name
+        std::map<std::string, SetEntries> setEntries;
     } RuleSets;
 
     RuleSets mIpv4RuleCache;
     RuleSets mIpv6RuleCache;
 
-    void trimDuplicates(RuleSet &existing, RuleSet &newRuleSet,
+    void trimDuplicates(const RuleSet &existing, RuleSet &newRuleSet,
                         Operation operation) const;
-    bool checkDuplicates(RuleSets ruleCache, const int ipVersion) const;
+    bool checkDuplicates(RuleSets ruleCache, const RuleSet &existing) const;
+
+    static std::string setCommands(const std::map<std::string, SetEntries> &sets,
+                                   const int ipVersion);
+    bool applySets(const std::map<std::string, SetEntries> &sets,
+                   const int ipVersion) const;
+
+    RuleSets containerChainRules(const RuleSets &ruleCache,
+                                 const RuleSet &existing) const;
+
+    const RuleSet &shadowRules(const int ipVersion) const;
+    void updateShadow(const RuleSets &applied, const int ipVersion,
+                      bool success) const;
+
+    bool kernelFingerprint(const int ipVersion, uint64_t *fingerprint) const;
 
     void dump(const RuleSet &ruleSet, const char *title = nullptr) const;
 
@@ -97,13 +186,27 @@ private:
         int major;
         int minor;
         int patch;
+        bool nfTables;
     } IptablesVersion;
 
     IptablesVersion getIptablesVersion() const;
 
 private:
     mutable std::mutex mLock;
+    const Backend mBackend;
     IptablesVersion mIptablesVersion;
+
+    typedef struct Shadow
+    {
+        bool valid;
+        uint64_t fingerprint;
+        RuleSet rules;
+    } Shadow;
+
+    // shadow rules for the process network namespace, keyed by backend and
+    // ip version, the lock is held for the whole of an apply
+    static std::mutex mShadowLock;
+    static std::map<std::pair<Backend, int>, Shadow> mShadows;
 };
 
 #endif // !defined(NETFILTER_H)
@@ -30,10 +30,15 @@
 #include <memory>
 #include <array>
 #include <list>
+#include <set>
 
 #include <arpa/inet.h>
 
 struct nl_sock;
+struct nl_cache;
+struct nl_cache_mngr;
+struct nl_object;
+struct nl_msg;
 
 class NlLink;
 
@@ -49,6 +54,18 @@ class NlLink;
  *  At construction time a new netlink socket is opened, on destruction it is
  *  closed.
  *
+ *  Code running in the process's own network namespace should use the
+ *  instance returned by shared(), which also keeps a cache of the links
+ *  updated from the kernel's link notifications.  Interface lookups and
+ *  picking a free veth name are then done from an in-memory index rather
+ *  than asking the kernel or probing sysfs.
+ *
+ *  Address, route and link flag changes made between beginBatch() and
+ *  commitBatch() are sent without waiting for the kernel to reply to each
+ *  one, the replies are all read by commitBatch().  This is used to
+ *  configure the interfaces inside a container's network namespace in one
+ *  go.
+ *
  */
 class Netlink
 {
@@ -56,6 +73,8 @@ public:
     Netlink();
     ~Netlink();
 
+    static std::shared_ptr<Netlink> shared();
+
 public:
     bool isValid() const;
 
@@ -108,6 +127,19 @@ public:
                            std::vector<std::string> &takenVeths);
     bool checkVeth(const std::string& vethName);
 
+    struct VethPeerDetails
+    {
+        std::string vethName;
+        std::string peerName;
+        bool bridged;
+    };
+
+    std::list<VethPeerDetails> getVethPeers(const std::string& peerPrefix);
+
+    bool moveIfaceToNetns(const std::string& ifaceName,
+                          const std::string& newName, const pid_t pid);
+    bool deleteIface(const std::string& ifaceName);
+
 public:
     bool addRoute(const std::string& iface, const in_addr_t destination,
                   const in_addr_t netmask, const in_addr_t gateway);
@@ -119,6 +151,10 @@ public:
 
     bool delArpEntry(const std::string &iface, in_addr_t address);
 
+public:
+    bool beginBatch();
+    bool commitBatch();
+
 private:
     bool applyChangesToLink(const std::string& ifaceName,
                             const NlLink& changes);
@@ -134,10 +170,39 @@ private:
 
     std::string getAvailableVethName(const int startIndex) const;
 
+    struct nl_cache* linkCache() const;
+    int sendRequest(struct nl_msg* msg);
+
+private:
+    explicit Netlink(bool linkCache);
+
+    bool createLinkCache();
+    void refreshLinkIndex() const;
+
+    static void linkCacheChanged(struct nl_cache *cache, struct nl_object *object,
+                                 int action, void *userData);
+
+    static bool vethNumber(const char *name, unsigned *number);
+    static std::string firstFreeVethName(const std::set<unsigned> &vethNumbers,
+                                         unsigned startIndex);
+
 private:
     struct nl_sock* mSocket;
     int mSysClassNetDirFd;
     mutable std::mutex mLock;
+
+    // the link cache and the index of it, only used by the shared() instance
+    struct nl_cache_mngr* mCacheManager;
+    struct nl_cache* mLinkCache;
+    mutable bool mLinkIndexStale;
+    mutable std::set<std::string> mLinkNames;
+    mutable std::set<unsigned> mVethNumbers;
+
+    // set between beginBatch() and commitBatch(), the number of requests
+    // waiting for a reply and a snapshot of the links used for the lookups
+    bool mBatching;
+    unsigned mBatchPending;
+    struct nl_cache* mBatchLinkCache;
 };
 
 
@@ -51,6 +51,7 @@ public:
 public:
     bool postInstallation() override;
     bool createRuntime() override;
+    bool postStart() override;
     bool postHalt() override;
     bool postStop() override;
 
@@ -73,7 +74,6 @@ private:
     const rt_defs_plugins_networking_data *mPluginData;
 
     std::shared_ptr<NetworkingHelper> mHelper;
-    std::shared_ptr<Netfilter> mNetfilter;
 };
 
 #endif // !defined(NETWORKINGPLUGIN_H)
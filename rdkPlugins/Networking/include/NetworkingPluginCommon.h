@@ -77,6 +77,20 @@ static const struct in6_addr IN6ADDR_ANY = {{
 #define LOCALHOST_IPV6                "::1"
 
 
+// -----------------------------------------------------------------------------
+// ipset sets matched by the rules shared by all containers, when ipset is
+// installed (@see Netfilter::setName() for the IPv6 names)
+
+// container address,protocol:port pairs
+#define HOST_TO_CONTAINER_SET         "DobbyHostToCtr"
+#define CONTAINER_TO_HOST_SET         "DobbyCtrToHost"
+#define INTER_CONTAINER_IN_SET        "DobbyInterIn"
+#define INTER_CONTAINER_OUT_SET       "DobbyInterOut"
+
+// container address,physdev:veth pairs
+#define CONTAINER_VETH_SET            "DobbyVeths"
+
+
 enum class NetworkType { None, Nat, Open };
 
 #endif // !defined(NETWORKINGPLUGINCOMMON_H)
@@ -0,0 +1,71 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   NetworkingSettings.h
+ *
+ */
+#ifndef NETWORKINGSETTINGS_H
+#define NETWORKINGSETTINGS_H
+
+#include <string>
+#include <vector>
+
+// The Dobby settings file the networking settings are read from
+// Can override the path at build time by setting -DDOBBY_SETTINGS_PATH=/path/to/file
+#ifndef DOBBY_SETTINGS_PATH
+    #define DOBBY_SETTINGS_PATH     "/etc/dobby.json"
+#endif
+
+struct yajl_val_s;
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class NetworkingSettings
+ *  @brief Reads the values in the "network" object of the Dobby settings file.
+ *
+ *  The plugins don't have the daemon's settings object, and jsoncpp isn't
+ *  available to them, so the file is parsed with yajl from libocispec.  The
+ *  file is parsed once on construction; if it's missing or can't be parsed
+ *  every lookup returns its default.
+ */
+class NetworkingSettings
+{
+public:
+    explicit NetworkingSettings(const std::string &settingsPath = DOBBY_SETTINGS_PATH);
+    ~NetworkingSettings();
+
+    NetworkingSettings(const NetworkingSettings&) = delete;
+    NetworkingSettings &operator=(const NetworkingSettings&) = delete;
+
+public:
+    bool isValid() const;
+
+    std::string getString(const char *key,
+                          const std::string &defaultValue = std::string()) const;
+    bool getInteger(const char *key, long long *value) const;
+    std::vector<std::string> getStringArray(const char *key) const;
+
+private:
+    struct yajl_val_s *get(const char *key, int type) const;
+
+private:
+    struct yajl_val_s *mTree;
+};
+
+#endif // !defined(NETWORKINGSETTINGS_H)
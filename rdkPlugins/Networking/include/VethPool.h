@@ -0,0 +1,75 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   VethPool.h
+ *
+ */
+#ifndef VETHPOOL_H
+#define VETHPOOL_H
+
+#include <DobbyRdkPluginUtils.h>
+#include "Netlink.h"
+
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <sys/types.h>
+
+// the prefix of the names of the pooled veth ends waiting in the host
+// namespace, the kernel picks the number
+#define VETH_POOL_PEER_PREFIX   "dpool"
+
+// -----------------------------------------------------------------------------
+/**
+ *  @namespace VethPool
+ *
+ *  @brief Functions to manage the optional pool of veth pairs created ahead
+ *  of the containers that use them.
+ *
+ *  The pool size is set with "network.vethPoolSize" in the Dobby settings
+ *  file, the default of 0 disables it.  A pooled pair has its vethN end up,
+ *  forwarding and attached to the bridge, with the other end waiting in the
+ *  host namespace with a VETH_POOL_PEER_PREFIX name.  Attaching to the bridge
+ *  is the last step, so only pairs on the bridge are taken.
+ *
+ *  Taking a pair is a single request that moves the waiting end into the
+ *  container's namespace and renames it, if two containers race for the same
+ *  pair one of them fails and tries the next.  The pool is refilled from the
+ *  postStart hook, i.e. once the container is running, so creating the pairs
+ *  isn't on the createRuntime path.
+ */
+namespace VethPool
+{
+    unsigned size();
+
+    std::string take(const std::shared_ptr<Netlink> &netlink,
+                     const pid_t containerPid,
+                     const std::vector<std::string> &takenVeths);
+
+    bool refill(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
+                const std::shared_ptr<Netlink> &netlink);
+
+    std::set<std::string> vethNames(const std::shared_ptr<Netlink> &netlink);
+
+    bool drain(const std::shared_ptr<Netlink> &netlink);
+};
+
+#endif // !defined(VETHPOOL_H)
@@ -185,7 +185,7 @@ bool DnsmasqSetup::set(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
     if (helper->ipv4())
     {
         Netfilter::RuleSet ipv4RuleSet = constructRules(containerId, AF_INET);
-        if (!netfilter->addRules(ipv4RuleSet, AF_INET, Netfilter::Operation::Append))
+        if (!netfilter->addContainerRules(containerId, ipv4RuleSet, AF_INET, Netfilter::Operation::Append))
         {
             AI_LOG_ERROR_EXIT("failed to setup netfilter rules for dns");
             return false;
@@ -194,7 +194,7 @@ bool DnsmasqSetup::set(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
     if (helper->ipv6())
     {
         Netfilter::RuleSet ipv6RuleSet = constructRules(containerId, AF_INET6);
-        if (!netfilter->addRules(ipv6RuleSet, AF_INET6, Netfilter::Operation::Append))
+        if (!netfilter->addContainerRules(containerId, ipv6RuleSet, AF_INET6, Netfilter::Operation::Append))
         {
             AI_LOG_ERROR_EXIT("failed to setup netfilter rules for dns");
             return false;
@@ -262,7 +262,7 @@ bool DnsmasqSetup::removeRules(const std::shared_ptr<Netfilter> &netfilter,
     if (helper->ipv4())
     {
         Netfilter::RuleSet ipv4RuleSet = constructRules(containerId, AF_INET);
-        if (!netfilter->addRules(ipv4RuleSet, AF_INET, Netfilter::Operation::Delete))
+        if (!netfilter->addContainerRules(containerId, ipv4RuleSet, AF_INET, Netfilter::Operation::Delete))
         {
             AI_LOG_ERROR_EXIT("failed to delete netfilter rules for dnsmasq");
             return false;
@@ -271,7 +271,7 @@ bool DnsmasqSetup::removeRules(const std::shared_ptr<Netfilter> &netfilter,
     if (helper->ipv6())
     {
         Netfilter::RuleSet ipv6RuleSet = constructRules(containerId, AF_INET6);
-        if (!netfilter->addRules(ipv6RuleSet, AF_INET6, Netfilter::Operation::Delete))
+        if (!netfilter->addContainerRules(containerId, ipv6RuleSet, AF_INET6, Netfilter::Operation::Delete))
         {
             AI_LOG_ERROR_EXIT("failed to delete netfilter rules for dnsmasq");
             return false;
@@ -22,22 +22,31 @@
 #include <Logging.h>
 
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <dirent.h>
 #include <algorithm>
 #include <fcntl.h>
 #include <unistd.h>
 #include <libgen.h>
 #include <limits.h>
+#include <string.h>
+
+// changed whenever the layout of IPAllocator::Store changes
+#define ADDRESS_STORE_MAGIC     0x44495031  // 'DIP1'
+
+std::mutex IPAllocator::mStoreLock;
 
 IPAllocator::IPAllocator(const std::shared_ptr<DobbyRdkPluginUtils> &utils)
     : mUtils(utils),
       mBeginAddress(INADDR_BRIDGE + 1),
-      mEndAddress(mBeginAddress + TOTAL_ADDRESS_POOL_SIZE)
+      mEndAddress(mBeginAddress + TOTAL_ADDRESS_POOL_SIZE),
+      mStoreFd(-1),
+      mStore(nullptr)
 {
     AI_LOG_FN_ENTRY();
 
-    // Update internal state based on the disk store
-    if (!getContainerIpsFromDisk())
+    // Map the allocation table, creating it if needed
+    if (!openStore())
     {
         AI_LOG_ERROR("Failed to initialise IP backing store");
     }
@@ -48,6 +57,17 @@ IPAllocator::IPAllocator(const std::shared_ptr<DobbyRdkPluginUtils> &utils)
 IPAllocator::~IPAllocator()
 {
     AI_LOG_FN_ENTRY();
+
+    if ((mStore != nullptr) && (munmap(mStore, sizeof(Store)) != 0))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to unmap IP backing store");
+    }
+
+    if ((mStoreFd >= 0) && (close(mStoreFd) != 0))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to close IP backing store");
+    }
+
     AI_LOG_FN_EXIT();
 }
 
@@ -67,6 +87,9 @@ in_addr_t IPAllocator::allocateIpAddress(const std::string &vethName)
 /**
  * @brief Allocated an IP address with the specified veth
  *
+ * The first free address is found from the bitmap in the allocation table,
+ * so this doesn't depend on the number of containers running.
+ *
  * @param[in]  containerId  Name of the container to associate the IP with
  * @param[in]  vethName     Name of the veth interface used by the container
  *
@@ -76,33 +99,63 @@ in_addr_t IPAllocator::allocateIpAddress(const std::string &containerId, const s
 {
     AI_LOG_FN_ENTRY();
 
+    if ((containerId.size() >= sizeof(StoreRecord::containerId)) ||
+        (vethName.size() >= sizeof(StoreRecord::vethName)))
+    {
+        AI_LOG_ERROR_EXIT("invalid container id or veth name");
+        return 0;
+    }
+
+    if (!lockStore(F_WRLCK))
+    {
+        AI_LOG_ERROR_EXIT("IP backing store not available - cannot allocate IP address for %s", containerId.c_str());
+        return 0;
+    }
+
+    // A container only has one address, release any left from a previous run
+    int slot = findRecord(containerId);
+    if (slot >= 0)
+    {
+        clearRecord(slot);
+    }
+
     // Attempt to find a free IP address
-    in_addr_t ipAddress = 0;
-    for (in_addr_t addr = mBeginAddress; addr < mEndAddress; addr++)
+    slot = -1;
+    for (size_t i = 0; (i < (sizeof(mStore->bitmap) / sizeof(mStore->bitmap[0]))) && (slot < 0); i++)
     {
-        // If the IP address isn't allocated, we can use it
-        if (std::find_if(mAllocatedIps.begin(), mAllocatedIps.end(), [addr](const ContainerNetworkInfo &info)
-                         { return info.ipAddressRaw == addr; }) == mAllocatedIps.end())
+        const uint64_t freeBits = ~mStore->bitmap[i];
+        if (freeBits != 0)
         {
-            ipAddress = addr;
-            break;
+            const int bit = (i * 64) + __builtin_ctzll(freeBits);
+            if (bit < TOTAL_ADDRESS_POOL_SIZE)
+            {
+                slot = bit;
+            }
         }
     }
 
-    if (ipAddress == 0)
+    if (slot < 0)
     {
+        unlockStore();
         AI_LOG_ERROR_EXIT("IP Address pool exhausted - cannot allocate IP address for %s", containerId.c_str());
         return 0;
     }
 
+    setRecord(slot, containerId, vethName);
+    const in_addr_t ipAddress = mStore->records[slot].ipAddress;
+
+    unlockStore();
+
     AI_LOG_DEBUG("Allocating %s IP address %s (%u)", containerId.c_str(), ipAddressToString(htonl(ipAddress)).c_str(), ipAddress);
 
     std::string addressFilePath = ADDRESS_FILE_DIR + containerId;
     const std::string fileContent(std::to_string(ipAddress) + "/" + vethName);
 
-    // write address and veth name to a file
+    // write address and veth name to a file for the other plugins
     if (!mUtils->writeTextFile(addressFilePath, fileContent, O_CREAT | O_TRUNC, 0644))
     {
+        deallocateIpAddress(containerId);
+
         AI_LOG_ERROR_EXIT("failed to write ip address file - could not alloate IP for %s", containerId.c_str());
         return 0;
     }
@@ -123,31 +176,31 @@ bool IPAllocator::deallocateIpAddress(const std::string &containerId)
 {
     AI_LOG_FN_ENTRY();
 
-    // Nothing to do, already deallocated
-    if (mAllocatedIps.empty())
+    if (!lockStore(F_WRLCK))
     {
-        return true;
+        AI_LOG_ERROR_EXIT("IP backing store not available - cannot deallocate IP address for %s", containerId.c_str());
+        return false;
     }
 
-    // Remove file from disk store
-    const std::string addressFilePath = ADDRESS_FILE_DIR + containerId;
-    if (unlink(addressFilePath.c_str()) == -1)
+    // Remove from the allocation table
+    const int slot = findRecord(containerId);
+    if (slot >= 0)
     {
-        AI_LOG_WARN("failed to remove address file for container %s at %s", containerId.c_str(), addressFilePath.c_str());
-        return false;
+        AI_LOG_DEBUG("Deallocating IP address %s for %s",
+                     ipAddressToString(htonl(mStore->records[slot].ipAddress)).c_str(),
+                     containerId.c_str());
+
+        clearRecord(slot);
     }
 
-    // Remove from in-memory store
-    ContainerNetworkInfo tmp;
-    tmp.containerId = containerId;
+    unlockStore();
 
-    auto itr = std::find(mAllocatedIps.begin(), mAllocatedIps.end(), tmp);
-    if (itr != mAllocatedIps.end())
+    // Remove file from disk store, nothing to do if already deallocated
+    const std::string addressFilePath = ADDRESS_FILE_DIR + containerId;
+    if ((unlink(addressFilePath.c_str()) == -1) && (errno != ENOENT))
     {
-        AI_LOG_DEBUG("Deallocating IP address %s for %s", itr->ipAddress.c_str(), containerId.c_str());
-
-        // Remove allocation
-        mAllocatedIps.erase(itr);
+        AI_LOG_WARN("failed to remove address file for container %s at %s", containerId.c_str(), addressFilePath.c_str());
+        return false;
     }
 
     AI_LOG_FN_EXIT();
@@ -164,8 +217,34 @@ bool IPAllocator::deallocateIpAddress(const std::string &containerId)
  */
 bool IPAllocator::getContainerNetworkInfo(const std::string &containerId, ContainerNetworkInfo &networkInfo) const
 {
-    const std::string filePath = ADDRESS_FILE_DIR + containerId;
-    return getNetworkInfo(filePath, networkInfo);
+    AI_LOG_FN_ENTRY();
+
+    if (!lockStore(F_RDLCK))
+    {
+        AI_LOG_ERROR_EXIT("IP backing store not available");
+        return false;
+    }
+
+    const int slot = findRecord(containerId);
+    if (slot < 0)
+    {
+        unlockStore();
+        AI_LOG_ERROR_EXIT("no IP address allocated to container %s", containerId.c_str());
+        return false;
+    }
+
+    const StoreRecord &record = mStore->records[slot];
+    networkInfo.containerId = containerId;
+    networkInfo.ipAddressRaw = record.ipAddress;
+    networkInfo.vethName = record.vethName;
+
+    unlockStore();
+
+    // Convert the in_addr_t value to a human readable value (e.g. 100.64.11.x)
+    networkInfo.ipAddress = ipAddressToString(htonl(networkInfo.ipAddressRaw));
+
+    AI_LOG_FN_EXIT();
+    return true;
 }
 
 /**
@@ -214,47 +293,102 @@ bool IPAllocator::getNetworkInfo(const std::string &filePath, ContainerNetworkIn
 }
 
 /**
- * @brief Synchronise the in-memory pool of allocated IPs with the disk store
+ * @brief Opens and maps the allocation table, creating it if it doesn't exist
+ * or was written with a different layout.
  *
  * @return True on success
  */
-bool IPAllocator::getContainerIpsFromDisk()
+bool IPAllocator::openStore()
 {
     AI_LOG_FN_ENTRY();
 
-    mAllocatedIps.clear();
+    // Create directory we will store the address files in
+    struct stat buf;
+    if ((stat(ADDRESS_FILE_DIR, &buf) != 0) && !mUtils->mkdirRecursive(ADDRESS_FILE_DIR, 0644))
+    {
+        AI_LOG_ERROR_EXIT("Failed to create dir @ '%s'", ADDRESS_FILE_DIR);
+        return false;
+    }
 
-    // Dir doesn't exist, no containers have run yet
-    DIR *dir = opendir(ADDRESS_FILE_DIR);
-    if (!dir)
+    mStoreFd = open(ADDRESS_STORE_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (mStoreFd < 0)
     {
-        if (errno == ENOENT)
-        {
-            // Create directory we will store IPs in
-            if (!mUtils->mkdirRecursive(ADDRESS_FILE_DIR, 0644))
-            {
-                AI_LOG_ERROR_EXIT("Failed to create dir @ '%s'", ADDRESS_FILE_DIR);
-                return false;
-            }
+        AI_LOG_SYS_ERROR_EXIT(errno, "Failed to open '%s'", ADDRESS_STORE_PATH);
+        return false;
+    }
+
+    // Mapping a file beyond its end is fine as long as nothing is accessed
+    // there, and we only touch it with the lock held after sizing it below
+    void *addr = mmap(nullptr, sizeof(Store), PROT_READ | PROT_WRITE, MAP_SHARED, mStoreFd, 0);
+    if (addr == MAP_FAILED)
+    {
+        AI_LOG_SYS_ERROR_EXIT(errno, "Failed to map '%s'", ADDRESS_STORE_PATH);
+        close(mStoreFd);
+        mStoreFd = -1;
+        return false;
+    }
+
+    mStore = static_cast<Store*>(addr);
 
-            AI_LOG_FN_EXIT();
-            return true;
+    bool success = lockStore(F_WRLCK);
+    if (success)
+    {
+        // A new file is zero filled, which is also how an empty table looks
+        if ((fstat(mStoreFd, &buf) != 0) ||
+            ((buf.st_size != sizeof(Store)) && (ftruncate(mStoreFd, sizeof(Store)) != 0)))
+        {
+            AI_LOG_SYS_ERROR(errno, "Failed to size '%s'", ADDRESS_STORE_PATH);
+            success = false;
         }
-        else
+        else if ((mStore->magic != ADDRESS_STORE_MAGIC) ||
+                 (mStore->poolSize != TOTAL_ADDRESS_POOL_SIZE))
         {
-            AI_LOG_SYS_ERROR_EXIT(errno, "Failed to open directory @ '%s'", ADDRESS_FILE_DIR);
-            return false;
+            AI_LOG_INFO("initialising IP backing store '%s'", ADDRESS_STORE_PATH);
+
+            memset(mStore, 0, sizeof(Store));
+            importAddressFiles();
+
+            // Only mark the table valid once it's complete
+            mStore->poolSize = TOTAL_ADDRESS_POOL_SIZE;
+            __atomic_store_n(&mStore->magic, ADDRESS_STORE_MAGIC, __ATOMIC_RELEASE);
         }
+
+        unlockStore();
+    }
+
+    if (!success)
+    {
+        munmap(mStore, sizeof(Store));
+        mStore = nullptr;
+        close(mStoreFd);
+        mStoreFd = -1;
+    }
+
+    AI_LOG_FN_EXIT();
+    return success;
+}
+
+/**
+ * @brief Fills a new allocation table from the address files already on
+ * disk, i.e. those written for containers started before the table existed.
+ *
+ * Must be called with the store locked.
+ */
+void IPAllocator::importAddressFiles()
+{
+    AI_LOG_FN_ENTRY();
+
+    DIR *dir = opendir(ADDRESS_FILE_DIR);
+    if (!dir)
+    {
+        AI_LOG_SYS_ERROR_EXIT(errno, "Failed to open directory @ '%s'", ADDRESS_FILE_DIR);
+        return;
     }
 
-    // Work out what IPs are currently allocated to what containers
     // Each container gets a file in the store directory
     // Filename = container ID
     // Contents = ipaddress/veth
     struct dirent *entry = nullptr;
-    char pathBuf[PATH_MAX + 1];
-    bzero(pathBuf, sizeof(pathBuf));
-
     while ((entry = readdir(dir)) != nullptr)
     {
         if (entry->d_type == DT_REG && entry->d_name[0] != '.')
@@ -267,16 +401,133 @@ bool IPAllocator::getContainerIpsFromDisk()
                 AI_LOG_ERROR("Failed to parse network info from file %s", fullPath.c_str());
                 continue;
             }
-            mAllocatedIps.emplace_back(networkInfo);
+
+            if ((networkInfo.ipAddressRaw < mBeginAddress) ||
+                (networkInfo.ipAddressRaw >= mEndAddress) ||
+                (networkInfo.containerId.size() >= sizeof(StoreRecord::containerId)) ||
+                (networkInfo.vethName.size() >= sizeof(StoreRecord::vethName)))
+            {
+                AI_LOG_ERROR("Invalid network info in file %s", fullPath.c_str());
+                continue;
+            }
+
+            setRecord(networkInfo.ipAddressRaw - mBeginAddress,
+                      networkInfo.containerId, networkInfo.vethName);
         }
     }
 
     closedir(dir);
 
     AI_LOG_FN_EXIT();
+}
+
+/**
+ * @brief Takes the lock on the allocation table.
+ *
+ * @param[in]   type    F_RDLCK or F_WRLCK
+ *
+ * @return False if there's no table or the lock couldn't be taken
+ */
+bool IPAllocator::lockStore(short type) const
+{
+    if (mStore == nullptr)
+    {
+        return false;
+    }
+
+    mStoreLock.lock();
+
+    struct flock fl;
+    bzero(&fl, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 0;
+
+    while (fcntl(mStoreFd, F_SETLKW, &fl) != 0)
+    {
+        if (errno != EINTR)
+        {
+            AI_LOG_SYS_ERROR(errno, "Failed to lock '%s'", ADDRESS_STORE_PATH);
+            mStoreLock.unlock();
+            return false;
+        }
+    }
+
     return true;
 }
 
+/**
+ * @brief Releases the lock taken by lockStore().
+ */
+void IPAllocator::unlockStore() const
+{
+    struct flock fl;
+    bzero(&fl, sizeof(fl));
+    fl.l_type = F_UNLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 0;
+
+    if (fcntl(mStoreFd, F_SETLK, &fl) != 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "Failed to unlock '%s'", ADDRESS_STORE_PATH);
+    }
+
+    mStoreLock.unlock();
+}
+
+/**
+ * @brief Finds the slot allocated to the container.
+ *
+ * Must be called with the store locked.
+ *
+ * @return The slot index, or -1 if the container doesn't have one
+ */
+int IPAllocator::findRecord(const std::string &containerId) const
+{
+    for (int slot = 0; slot < TOTAL_ADDRESS_POOL_SIZE; slot++)
+    {
+        if (((mStore->bitmap[slot / 64] >> (slot % 64)) & 1) &&
+            (strncmp(mStore->records[slot].containerId, containerId.c_str(),
+                     sizeof(StoreRecord::containerId)) == 0))
+        {
+            return slot;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Fills in the record for the slot and then marks it as used.
+ *
+ * Must be called with the store locked.
+ */
+void IPAllocator::setRecord(int slot, const std::string &containerId, const std::string &vethName)
+{
+    StoreRecord &record = mStore->records[slot];
+
+    bzero(&record, sizeof(record));
+    strncpy(record.containerId, containerId.c_str(), sizeof(record.containerId) - 1);
+    strncpy(record.vethName, vethName.c_str(), sizeof(record.vethName) - 1);
+    record.ipAddress = mBeginAddress + slot;
+
+    __atomic_or_fetch(&mStore->bitmap[slot / 64], (uint64_t)1 << (slot % 64), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Marks the slot as free and then wipes its record.
+ *
+ * Must be called with the store locked.
+ */
+void IPAllocator::clearRecord(int slot)
+{
+    __atomic_and_fetch(&mStore->bitmap[slot / 64], ~((uint64_t)1 << (slot % 64)), __ATOMIC_RELEASE);
+
+    bzero(&mStore->records[slot], sizeof(StoreRecord));
+}
+
 /**
  * @brief Convert an string to an IP address. Note - doesn't do any
  * byte-order modifications
@@ -427,11 +427,136 @@ Netfilter::RuleSet constructRules(const std::shared_ptr<NetworkingHelper> &helpe
     return ruleSet;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Adds or deletes the ipset entries for the container's ports, along
+ *  with the FORWARD rules shared by all containers that match against them.
+ *
+ *  These replace the FORWARD rules constructRules() creates for each port.
+ *  The shared rules are added every time, the duplicates are dropped when
+ *  the rules are applied, and are left in place when a container stops.
+ *
+ *  @param[in]  netfilter           Instance of Netfilter class.
+ *  @param[in]  helper              Instance of NetworkingHelper.
+ *  @param[in]  containerPorts      structs containing ports to configure.
+ *  @param[in]  ipVersion           IPv family version (AF_INET/AF_INET6).
+ *  @param[in]  operation           Insert to add the entries, Delete to
+ *                                  remove them.
+ *
+ *  @return true on success, otherwise false.
+ */
+static bool updateSets(const std::shared_ptr<Netfilter> &netfilter,
+                       const std::shared_ptr<NetworkingHelper> &helper,
+                       const InterContainerPorts &containerPorts,
+                       const int ipVersion,
+                       Netfilter::Operation operation)
+{
+    std::string containerAddress;
+    std::string containersAddressRange;
+    if (ipVersion == AF_INET)
+    {
+        containerAddress = helper->ipv4AddrStr();
+        containersAddressRange = BRIDGE_ADDRESS_RANGE "/24";
+    }
+    else if (ipVersion == AF_INET6)
+    {
+        containerAddress = helper->ipv6AddrStr();
+        containersAddressRange = BRIDGE_ADDRESS_RANGE_IPV6 "/120";
+    }
+    else
+    {
+        AI_LOG_ERROR("supported ip address families are AF_INET or AF_INET6");
+        return false;
+    }
+
+    const std::string vethSet = Netfilter::setName(CONTAINER_VETH_SET, ipVersion);
+    const std::list<std::string> vethEntries =
+    {
+        containerAddress + ",physdev:" + helper->vethName()
+    };
+
+    if (!netfilter->addSetEntries(vethSet, "hash:net,iface", vethEntries,
+                                  ipVersion, operation))
+    {
+        return false;
+    }
+
+    // the in ports are matched on the source port of the server's replies,
+    // the out ports on the destination port of the client's requests
+    const struct
+    {
+        const char *setName;
+        const char *match;
+        const std::vector<InterContainerPort> &ports;
+    } directions[] =
+    {
+        { INTER_CONTAINER_IN_SET,  "src,src", containerPorts.inPorts  },
+        { INTER_CONTAINER_OUT_SET, "src,dst", containerPorts.outPorts },
+    };
+
+    char ruleBuf[512];
+    std::list<std::string> filterRules;
+
+    for (const auto &direction : directions)
+    {
+        if (direction.ports.empty())
+        {
+            continue;
+        }
+
+        const std::string setName = Netfilter::setName(direction.setName, ipVersion);
+
+        std::list<std::string> entries;
+        for (const InterContainerPort &port : direction.ports)
+        {
+            entries.emplace_back(containerAddress + "," +
+                                 ((port.protocol == InterContainerPort::Protocol::Udp) ? "udp:" : "tcp:") +
+                                 std::to_string(port.port));
+        }
+
+        if (!netfilter->addSetEntries(setName, "hash:ip,port", entries,
+                                      ipVersion, operation))
+        {
+            return false;
+        }
+
+        snprintf(ruleBuf, sizeof(ruleBuf),
+                 "FORWARD "
+                 "-d %s "                                   // any container address
+                 "-i " BRIDGE_NAME " "
+                 "-o " BRIDGE_NAME " "
+                 "-m set --match-set %s %s "                // container address,port
+                 "-m set --match-set %s src,src "           // container address,veth
+                 "-j ACCEPT",                               // accept the packet
+                 containersAddressRange.c_str(),
+                 setName.c_str(), direction.match,
+                 vethSet.c_str());
+
+        filterRules.emplace_back(ruleBuf);
+    }
+
+    // the shared rules are left for the other containers
+    if ((operation != Netfilter::Operation::Delete) && !filterRules.empty())
+    {
+        Netfilter::RuleSet ruleSet = { { Netfilter::TableType::Filter, filterRules } };
+        if (!netfilter->addRules(ruleSet, ipVersion, Netfilter::Operation::Insert))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Adds the necessary iptables firewall rules to enable routing of
  *  packets to / from one container to another.
  *
+ *  If ipset is installed the FORWARD rules are shared by all containers and
+ *  match against sets of the containers' ports, @see updateSets().  Only the
+ *  DNAT rules for the 'in' ports are added for each container.
+ *
  *  @param[in]  netfilter           Instance of Netfilter class.
  *  @param[in]  helper              Instance of NetworkingHelper.
  *  @param[in]  utils               Instance of DobbyRdkPluginUtils.
@@ -466,6 +591,7 @@ bool InterContainerRouting::addRules(const std::shared_ptr<Netfilter> &netfilter
     }
 
     const std::string containerId = utils->getContainerId();
+    const bool useSets = Netfilter::setsAvailable();
 
     // add IPv4 rules to iptables if needed
     if (helper->ipv4())
@@ -474,9 +600,20 @@ bool InterContainerRouting::addRules(const std::shared_ptr<Netfilter> &netfilter
                                                       containerId,
                                                       containerPorts,
                                                       AF_INET);
+        if (useSets)
+        {
+            // the FORWARD rules are replaced by the shared set rules
+            ipv4Rules.erase(Netfilter::TableType::Filter);
+            if (!updateSets(netfilter, helper, containerPorts, AF_INET, Netfilter::Operation::Insert))
+            {
+                AI_LOG_ERROR_EXIT("failed to update the inter-container IPv4 sets");
+                return false;
+            }
+        }
+
         if (!ipv4Rules.empty())
         {
-            if (!netfilter->addRules(ipv4Rules, AF_INET, Netfilter::Operation::Insert))
+            if (!netfilter->addContainerRules(containerId, ipv4Rules, AF_INET, Netfilter::Operation::Insert))
             {
                 AI_LOG_ERROR_EXIT("failed to insert port forward rules to iptables");
                 return false;
@@ -491,9 +628,20 @@ bool InterContainerRouting::addRules(const std::shared_ptr<Netfilter> &netfilter
                                                       containerId,
                                                       containerPorts,
                                                       AF_INET6);
+        if (useSets)
+        {
+            // the FORWARD rules are replaced by the shared set rules
+            ipv6Rules.erase(Netfilter::TableType::Filter);
+            if (!updateSets(netfilter, helper, containerPorts, AF_INET6, Netfilter::Operation::Insert))
+            {
+                AI_LOG_ERROR_EXIT("failed to update the inter-container IPv6 sets");
+                return false;
+            }
+        }
+
         if (!ipv6Rules.empty())
         {
-            if (!netfilter->addRules(ipv6Rules, AF_INET6, Netfilter::Operation::Insert))
+            if (!netfilter->addContainerRules(containerId, ipv6Rules, AF_INET6, Netfilter::Operation::Insert))
             {
                 AI_LOG_ERROR_EXIT("failed to insert port forward rules to ip6tables");
                 return false;
@@ -557,14 +705,26 @@ bool InterContainerRouting::removeRules(const std::shared_ptr<Netfilter> &netfil
     }
 
     const std::string containerId = utils->getContainerId();
+    const bool useSets = Netfilter::setsAvailable();
 
     // delete IPv4 rules from ip6tables if needed
     if (helper->ipv4())
     {
         Netfilter::RuleSet ipv4Rules = constructRules(helper, containerId, containerPorts, AF_INET);
+        if (useSets)
+        {
+            // the FORWARD rules are replaced by the shared set rules
+            ipv4Rules.erase(Netfilter::TableType::Filter);
+            if (!updateSets(netfilter, helper, containerPorts, AF_INET, Netfilter::Operation::Delete))
+            {
+                AI_LOG_ERROR_EXIT("failed to update the inter-container IPv4 sets");
+                return false;
+            }
+        }
+
         if (!ipv4Rules.empty())
         {
-            if (!netfilter->addRules(ipv4Rules, AF_INET, Netfilter::Operation::Delete))
+            if (!netfilter->addContainerRules(containerId, ipv4Rules, AF_INET, Netfilter::Operation::Delete))
             {
                 AI_LOG_ERROR_EXIT("failed to delete inter-container iptables rule");
                 return false;
@@ -576,9 +736,20 @@ bool InterContainerRouting::removeRules(const std::shared_ptr<Netfilter> &netfil
     if (helper->ipv6())
     {
         Netfilter::RuleSet ipv6Rules = constructRules(helper, containerId, containerPorts, AF_INET6);
+        if (useSets)
+        {
+            // the FORWARD rules are replaced by the shared set rules
+            ipv6Rules.erase(Netfilter::TableType::Filter);
+            if (!updateSets(netfilter, helper, containerPorts, AF_INET6, Netfilter::Operation::Delete))
+            {
+                AI_LOG_ERROR_EXIT("failed to update the inter-container IPv6 sets");
+                return false;
+            }
+        }
+
         if (!ipv6Rules.empty())
         {
-            if (!netfilter->addRules(ipv6Rules, AF_INET6, Netfilter::Operation::Delete))
+            if (!netfilter->addContainerRules(containerId, ipv6Rules, AF_INET6, Netfilter::Operation::Delete))
             {
                 AI_LOG_ERROR_EXIT("failed to delete inter-container ip6tables rule");
                 return false;
@@ -19,6 +19,7 @@
 
 #include "MulticastForwarder.h"
 #include "NetworkingPluginCommon.h"
+#include "BridgeFilter.h"
 
 #include <Logging.h>
 #include <sstream>
@@ -83,6 +84,9 @@ bool MulticastForwarder::set(const std::shared_ptr<Netfilter> &netfilter,
     std::mutex lock;
     std::lock_guard<std::mutex> locker(lock);
 
+    // the ebtables rules for all the groups are applied in one go
+    BridgeFilter bridgeFilter(EBTABLES_PATH);
+
     for (size_t i = 0; i < pluginData->multicast_forwarding_len; i++)
     {
         const std::string address = pluginData->multicast_forwarding[i]->ip;
@@ -111,7 +115,7 @@ bool MulticastForwarder::set(const std::shared_ptr<Netfilter> &netfilter,
         };
 
         // add ruleset to be inserted to iptables
-        if (!netfilter->addRules(rules, addrFamily, Netfilter::Operation::Insert))
+        if (!netfilter->addContainerRules(containerId, rules, addrFamily, Netfilter::Operation::Insert))
         {
             AI_LOG_ERROR_EXIT("failed to add MulticastForwarder iptables rules"
                               " %s:%d for insertion", address.c_str(), port);
@@ -119,14 +123,8 @@ bool MulticastForwarder::set(const std::shared_ptr<Netfilter> &netfilter,
         }
 
 
-        // insert ebtables rules
-        if (!executeCommand(EBTABLES_PATH " -I " + constructEbtablesRule(address, vethName, addrFamily)))
-        {
-            AI_LOG_ERROR_EXIT("failed to insert MulticastForwarder ebtables "
-                              "rules for '%s', group %s", containerId.c_str(),
-                              address.c_str());
-            return false;
-        }
+        // queue ebtables rules for insertion
+        bridgeFilter.insertRule(constructEbtablesRule(address, vethName, addrFamily));
 
         // add smcroute rules
         if (!addSmcrouteRules(extIfaces, address, containerId))
@@ -138,6 +136,14 @@ bool MulticastForwarder::set(const std::shared_ptr<Netfilter> &netfilter,
         }
     }
 
+    // insert ebtables rules
+    if (!bridgeFilter.commit())
+    {
+        AI_LOG_ERROR_EXIT("failed to insert MulticastForwarder ebtables "
+                          "rules for '%s'", containerId.c_str());
+        return false;
+    }
+
     AI_LOG_FN_EXIT();
     return true;
 }
@@ -174,6 +180,9 @@ bool MulticastForwarder::removeRules(const std::shared_ptr<Netfilter> &netfilter
     std::mutex lock;
     std::lock_guard<std::mutex> locker(lock);
 
+    // the ebtables rules for all the groups are applied in one go
+    BridgeFilter bridgeFilter(EBTABLES_PATH);
+
     for (size_t i = 0; i < pluginData->multicast_forwarding_len; i++)
     {
         const std::string address = pluginData->multicast_forwarding[i]->ip;
@@ -202,7 +211,7 @@ bool MulticastForwarder::removeRules(const std::shared_ptr<Netfilter> &netfilter
         };
 
         // delete ruleset from iptables
-        if (!netfilter->addRules(rules, addrFamily, Netfilter::Operation::Delete))
+        if (!netfilter->addContainerRules(containerId, rules, addrFamily, Netfilter::Operation::Delete))
         {
             AI_LOG_ERROR_EXIT("failed to add MulticastForwarder iptables rules"
                               " %s:%d for deletion", address.c_str(), port);
@@ -210,14 +219,8 @@ bool MulticastForwarder::removeRules(const std::shared_ptr<Netfilter> &netfilter
         }
 
 
-        // delete ebtables rules
-        if (!executeCommand(EBTABLES_PATH " -D " + constructEbtablesRule(address, vethName, addrFamily)))
-        {
-            AI_LOG_ERROR_EXIT("failed to delete MulticastForwarder ebtables "
-                              "rules for '%s', group %s", containerId.c_str(),
-                              address.c_str());
-            return false;
-        }
+        // queue ebtables rules for deletion
+        bridgeFilter.deleteRule(constructEbtablesRule(address, vethName, addrFamily));
 
         // remove smcroute rules
         if (!removeSmcrouteRules(containerId))
@@ -229,6 +232,14 @@ bool MulticastForwarder::removeRules(const std::shared_ptr<Netfilter> &netfilter
         }
     }
 
+    // delete ebtables rules
+    if (!bridgeFilter.commit())
+    {
+        AI_LOG_ERROR_EXIT("failed to delete MulticastForwarder ebtables "
+                          "rules for '%s'", containerId.c_str());
+        return false;
+    }
+
     AI_LOG_FN_EXIT();
     return true;
 }
@@ -239,6 +250,8 @@ bool MulticastForwarder::removeRules(const std::shared_ptr<Netfilter> &netfilter
  *  @brief Simply checks that ebtables and smcroutectl are available.
  *
  *  iptables isn't checked, because it's generally available on all builds.
+ *  ebtables is only needed if the bridge rules can't be written directly to
+ *  nf_tables.
  *
  *  @return true if success, otherwise false.
  */
@@ -246,7 +259,7 @@ bool checkCompatibility()
 {
     struct stat buffer;
 
-    if (stat (EBTABLES_PATH, &buffer) < 0)
+    if (!BridgeFilter::nativeSupported() && (stat (EBTABLES_PATH, &buffer) < 0))
     {
         AI_LOG_SYS_ERROR_EXIT(errno, "Multicast forwarding not supported - ebtables not found in PATH");
         return false;
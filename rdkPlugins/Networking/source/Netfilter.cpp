@@ -21,21 +21,26 @@
  *
  */
 #include "Netfilter.h"
+#include "NetworkingSettings.h"
 #include "StdStreamPipe.h"
 
 #if defined (DOBBY_BUILD)
     #include <Logging.h>
+    #include <DobbyRdkPluginUtils.h>
 #else
     #include <Dobby/Logging.h>
+    #include <Dobby/rdkPlugins/DobbyRdkPluginUtils.h>
 #endif
 
 #include <vector>
+#include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <cerrno>
 #include <iterator>
+#include <cstddef>
 #include <libgen.h>
 
 #include <fcntl.h>
@@ -44,23 +49,49 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+#include <linux/netfilter_ipv4/ip_tables.h>
+#include <linux/netfilter_ipv6/ip6_tables.h>
 #include <ext/stdio_filebuf.h>
 #include <regex>
 
 #define IPTABLES_SAVE_PATH "/usr/sbin/iptables-save"
 #define IPTABLES_RESTORE_PATH "/usr/sbin/iptables-restore"
+#define IPTABLES_NFT_SAVE_PATH "/usr/sbin/iptables-nft-save"
+#define IPTABLES_NFT_RESTORE_PATH "/usr/sbin/iptables-nft-restore"
 
 #if defined(DEV_VM)
     #define IPTABLES_PATH "/sbin/iptables"
     #define IP6TABLES_SAVE_PATH "/sbin/ip6tables-save"
     #define IP6TABLES_RESTORE_PATH "/sbin/ip6tables-restore"
+    #define IP6TABLES_NFT_SAVE_PATH "/sbin/ip6tables-nft-save"
+    #define IP6TABLES_NFT_RESTORE_PATH "/sbin/ip6tables-nft-restore"
 #else
     #define IPTABLES_PATH "/usr/sbin/iptables"
     #define IP6TABLES_SAVE_PATH "/usr/sbin/ip6tables-save"
     #define IP6TABLES_RESTORE_PATH "/usr/sbin/ip6tables-restore"
+    #define IP6TABLES_NFT_SAVE_PATH "/usr/sbin/ip6tables-nft-save"
+    #define IP6TABLES_NFT_RESTORE_PATH "/usr/sbin/ip6tables-nft-restore"
 #endif
 
+// Can override the ipset tool at build time by setting -DIPSET_PATH=/path/to/ipset
+#ifndef IPSET_PATH
+    #if defined(DEV_VM)
+        #define IPSET_PATH "/sbin/ipset"
+    #else
+        #define IPSET_PATH "/usr/sbin/ipset"
+    #endif
+#endif
+
+// All the chains created for a container start with this
+#define CONTAINER_CHAIN_PREFIX "Dobby_"
+
 
 // for some reason the XiOne toolchain is build against old kernel headers
 // which doesn't have the memfd syscall
@@ -81,9 +112,410 @@ static inline int memfd_create(const char *name, unsigned int flags)
 #    define MFD_CLOEXEC         0x0001U
 #  endif
 
+std::mutex Netfilter::mShadowLock;
+std::map<std::pair<Netfilter::Backend, int>, Netfilter::Shadow> Netfilter::mShadows;
+
+namespace
+{
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief FNV-1a hash of the supplied bytes, continuing from @a hash.
+ */
+uint64_t fnv1a(uint64_t hash, const void *data, size_t length)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Hashes the entries of a legacy (x_tables) table, skipping the
+ *  packet and byte counters so traffic doesn't change the result.
+ *
+ *  The entries are read with the same getsockopt calls iptables-save uses,
+ *  but without the fork/exec or having to format and parse the rules.
+ *
+ *  A table that isn't loaded doesn't contribute to the hash.
+ *
+ *  @return false if the table couldn't be read.
+ */
+template <typename GetInfo, typename GetEntries, typename Entry>
+bool hashXtTable(int sockFd, int level, int infoOpt, int entriesOpt,
+                 const char *tableName, uint64_t *hash)
+{
+    GetInfo info;
+    memset(&info, 0, sizeof(info));
+    strncpy(info.name, tableName, sizeof(info.name) - 1);
+
+    socklen_t length = sizeof(info);
+    if (getsockopt(sockFd, level, infoOpt, &info, &length) != 0)
+    {
+        return (errno == ENOENT);
+    }
+
+    std::vector<uint64_t> buffer(((sizeof(GetEntries) + info.size) / sizeof(uint64_t)) + 1);
+    GetEntries *entries = reinterpret_cast<GetEntries*>(buffer.data());
+    strncpy(entries->name, tableName, sizeof(entries->name) - 1);
+    entries->size = info.size;
+
+    // fails with EAGAIN if the table changed since we got the size
+    length = sizeof(GetEntries) + info.size;
+    if (getsockopt(sockFd, level, entriesOpt, entries, &length) != 0)
+    {
+        AI_LOG_SYS_WARN(errno, "failed to get entries of table '%s'", tableName);
+        return false;
+    }
+
+    *hash = fnv1a(*hash, tableName, strlen(tableName));
+
+    const uint8_t *table = reinterpret_cast<const uint8_t*>(entries->entrytable);
+    size_t offset = 0;
+    while (offset < info.size)
+    {
+        const Entry *entry = reinterpret_cast<const Entry*>(table + offset);
+        if ((entry->next_offset < sizeof(Entry)) ||
+            ((offset + entry->next_offset) > info.size))
+        {
+            AI_LOG_WARN("invalid entry in table '%s'", tableName);
+            return false;
+        }
+
+        const size_t countersStart = offsetof(Entry, counters);
+        const size_t countersEnd = countersStart + sizeof(entry->counters);
+
+        *hash = fnv1a(*hash, entry, countersStart);
+        *hash = fnv1a(*hash, reinterpret_cast<const uint8_t*>(entry) + countersEnd,
+                      entry->next_offset - countersEnd);
+
+        offset += entry->next_offset;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the nf_tables ruleset generation id of the current network
+ *  namespace.
+ *
+ *  The generation is bumped on every nf_tables commit, so it changes whenever
+ *  any rule is changed via iptables-nft (or nft).
+ *
+ *  @return false if the generation couldn't be read.
+ */
+bool nftGenerationId(uint32_t *genId)
+{
+    int sockFd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_NETFILTER);
+    if (sockFd < 0)
+    {
+        AI_LOG_SYS_WARN(errno, "failed to create netfilter netlink socket");
+        return false;
+    }
+
+    struct
+    {
+        struct nlmsghdr header;
+        struct nfgenmsg message;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = sizeof(request);
+    request.header.nlmsg_type = (NFNL_SUBSYS_NFTABLES << 8) | NFT_MSG_GETGEN;
+    request.header.nlmsg_flags = NLM_F_REQUEST;
+    request.header.nlmsg_seq = 1;
+    request.message.nfgen_family = AF_UNSPEC;
+    request.message.version = NFNETLINK_V0;
+
+    bool found = false;
+
+    if (TEMP_FAILURE_RETRY(send(sockFd, &request, sizeof(request), 0)) != sizeof(request))
+    {
+        AI_LOG_SYS_WARN(errno, "failed to send nf_tables generation request");
+    }
+    else
+    {
+        uint32_t reply[1024];
+        ssize_t length = TEMP_FAILURE_RETRY(recv(sockFd, reply, sizeof(reply), 0));
+
+        const struct nlmsghdr *header = reinterpret_cast<const struct nlmsghdr*>(reply);
+        if ((length > 0) && NLMSG_OK(header, static_cast<size_t>(length)) &&
+            (header->nlmsg_type == ((NFNL_SUBSYS_NFTABLES << 8) | NFT_MSG_NEWGEN)))
+        {
+            const size_t attrsOffset = NLMSG_LENGTH(NLMSG_ALIGN(sizeof(struct nfgenmsg)));
+            const uint8_t *attrs = reinterpret_cast<const uint8_t*>(header) + attrsOffset;
+            size_t remaining = header->nlmsg_len - attrsOffset;
+
+            while (!found && (remaining >= sizeof(struct nlattr)))
+            {
+                const struct nlattr *attr = reinterpret_cast<const struct nlattr*>(attrs);
+                if ((attr->nla_len < sizeof(struct nlattr)) || (attr->nla_len > remaining))
+                    break;
+
+                if (((attr->nla_type & NLA_TYPE_MASK) == NFTA_GEN_ID) &&
+                    (attr->nla_len >= (NLA_HDRLEN + sizeof(uint32_t))))
+                {
+                    uint32_t value;
+                    memcpy(&value, attrs + NLA_HDRLEN, sizeof(value));
+                    *genId = ntohl(value);
+                    found = true;
+                }
+
+                attrs += NLA_ALIGN(attr->nla_len);
+                remaining -= std::min<size_t>(remaining, NLA_ALIGN(attr->nla_len));
+            }
+        }
+
+        if (!found)
+        {
+            AI_LOG_WARN("no generation id in nf_tables reply");
+        }
+    }
+
+    close(sockFd);
+    return found;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns true if the calling thread is in the network namespace of
+ *  the process.
+ *
+ *  Rules applied from inside a container's namespace (via callInNamespace)
+ *  aren't shadowed, the namespace is usually new and short lived.
+ */
+bool inProcessNetNs()
+{
+    char threadNsPath[64];
+    snprintf(threadNsPath, sizeof(threadNsPath), "/proc/self/task/%ld/ns/net",
+             syscall(SYS_gettid));
+
+    struct stat processNs, threadNs;
+    if ((stat("/proc/self/ns/net", &processNs) != 0) ||
+        (stat(threadNsPath, &threadNs) != 0))
+    {
+        return false;
+    }
+
+    return (processNs.st_dev == threadNs.st_dev) &&
+           (processNs.st_ino == threadNs.st_ino);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Splits a rule into the chain it's for and the rest of the rule.
+ *
+ *  i.e. "FORWARD -i dobby0 -j ACCEPT" gives "FORWARD" and
+ *  "-i dobby0 -j ACCEPT".
+ */
+std::pair<std::string, std::string> splitRule(const std::string &rule)
+{
+    const size_t space = rule.find(' ');
+    if (space == std::string::npos)
+    {
+        return std::make_pair(rule, std::string());
+    }
+
+    return std::make_pair(rule.substr(0, space), rule.substr(space + 1));
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the prefix of all the chains created for the container.
+ *
+ *  Chain names are limited to 28 characters so a hash of the container id is
+ *  used rather than the id itself.
+ */
+std::string containerChainPrefix(const std::string &containerId)
+{
+    const uint32_t hash = static_cast<uint32_t>(
+        fnv1a(0xcbf29ce484222325ULL, containerId.data(), containerId.size()));
+
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), CONTAINER_CHAIN_PREFIX "%08x_", hash);
+    return prefix;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the name of the container's chain that the rules for the
+ *  @a baseChain are put in.
+ *
+ *  Rules that would have been inserted and appended to the base chain are
+ *  kept in separate chains, suffixed with 'I' and 'A', so they keep the same
+ *  position relative to the other rules in the base chain.
+ */
+std::string containerChainName(const std::string &prefix,
+                               const std::string &baseChain,
+                               bool inserted)
+{
+    static const std::map<std::string, std::string> abbreviations =
+    {
+        { "PREROUTING",         "PRE"   },
+        { "POSTROUTING",        "POST"  },
+        { "INPUT",              "IN"    },
+        { "OUTPUT",             "OUT"   },
+        { "FORWARD",            "FWD"   },
+        { "DobbyInputChain",    "DIC"   },
+    };
+
+    auto it = abbreviations.find(baseChain);
+    const std::string abbreviation = (it != abbreviations.end()) ?
+                                     it->second : baseChain.substr(0, 6);
+
+    return prefix + abbreviation + (inserted ? "_I" : "_A");
+}
+
+} // namespace
+
 Netfilter::Netfilter()
-    : mIptablesVersion(getIptablesVersion())
+    : Netfilter(configuredBackend())
+{
+}
+
+Netfilter::Netfilter(Backend backend)
+    : mBackend(backend)
+{
+    // the installed iptables doesn't change, so only ask for its version once
+    static const IptablesVersion iptablesVersion = getIptablesVersion();
+    mIptablesVersion = iptablesVersion;
+
+    // the nft variants of the tools always use nf_tables
+    if (mBackend == Backend::Nftables)
+    {
+        mIptablesVersion.nfTables = true;
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads the "network.netfilterBackend" value from the settings file.
+ *
+ *  @return the backend to use, iptables if not set or not valid.
+ */
+static Netfilter::Backend readBackendSetting()
 {
+    const NetworkingSettings settings;
+    const std::string name = settings.getString("netfilterBackend", "iptables");
+
+    if (name == "nftables")
+    {
+        return Netfilter::Backend::Nftables;
+    }
+    else if (name != "iptables")
+    {
+        AI_LOG_WARN("unknown netfilter backend '%s', using iptables",
+                    name.c_str());
+    }
+
+    return Netfilter::Backend::Iptables;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the backend set in the Dobby settings file.
+ *
+ *  The settings file is only read once per process.
+ */
+Netfilter::Backend Netfilter::configuredBackend()
+{
+    static const Backend backend = readBackendSetting();
+    return backend;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the Netfilter instance shared by all the plugins running
+ *  the current hook point for the container.
+ *
+ *  Rules added to it are applied, for both ip versions, once all the plugins
+ *  have run, so a container start or stop costs one iptables-restore per ip
+ *  version rather than one per plugin.  Plugins shouldn't call applyRules()
+ *  on it themselves.
+ *
+ *  The instance is shared between plugin libraries, which each build
+ *  Netfilter.cpp, it's only committed by the library that created it.
+ *
+ *  @param[in]  utils       The utils of the container.
+ *
+ *  @return the shared instance.
+ */
+std::shared_ptr<Netfilter> Netfilter::hookTransaction(const std::shared_ptr<DobbyRdkPluginUtils> &utils)
+{
+    std::shared_ptr<void> object = utils->hookObject("netfilter",
+        []()
+        {
+            return std::static_pointer_cast<void>(std::make_shared<Netfilter>());
+        },
+        [](const std::shared_ptr<void> &object)
+        {
+            std::shared_ptr<Netfilter> netfilter = std::static_pointer_cast<Netfilter>(object);
+
+            bool success = netfilter->applyRules(AF_INET);
+            success = netfilter->applyRules(AF_INET6) && success;
+            return success;
+        });
+
+    return std::static_pointer_cast<Netfilter>(object);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns true if the ipset tool is installed, and so rules can match
+ *  against sets added with addSetEntries().
+ *
+ *  Only checked once per process.
+ */
+bool Netfilter::setsAvailable()
+{
+    static const bool available = (access(IPSET_PATH, X_OK) == 0);
+    return available;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the name of the set to use for the ip version.
+ *
+ *  An ipset set only holds addresses of one family, so the IPv6 set has a '6'
+ *  appended to the name.
+ */
+std::string Netfilter::setName(const std::string &name, const int ipVersion)
+{
+    return (ipVersion == AF_INET6) ? (name + "6") : name;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the path to the iptables-save tool for the backend and
+ *  ip version.
+ */
+const char *Netfilter::savePath(const int ipVersion) const
+{
+    if (mBackend == Backend::Nftables)
+    {
+        return (ipVersion == AF_INET) ? IPTABLES_NFT_SAVE_PATH : IP6TABLES_NFT_SAVE_PATH;
+    }
+
+    return (ipVersion == AF_INET) ? IPTABLES_SAVE_PATH : IP6TABLES_SAVE_PATH;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the path to the iptables-restore tool for the backend and
+ *  ip version.
+ */
+const char *Netfilter::restorePath(const int ipVersion) const
+{
+    if (mBackend == Backend::Nftables)
+    {
+        return (ipVersion == AF_INET) ? IPTABLES_NFT_RESTORE_PATH : IP6TABLES_NFT_RESTORE_PATH;
+    }
+
+    return (ipVersion == AF_INET) ? IPTABLES_RESTORE_PATH : IP6TABLES_RESTORE_PATH;
 }
 
 // -----------------------------------------------------------------------------
@@ -254,26 +686,15 @@ Netfilter::RuleSet Netfilter::getRuleSet(const int ipVersion) const
     StdStreamPipe stdErrPipe(true);
 
     // exec the iptables-save function, passing in the pipe for stdout
-    if (ipVersion == AF_INET)
-    {
-        if (!forkExec(IPTABLES_SAVE_PATH, { }, -1, rulesMemFd, stdErrPipe.writeFd()))
-        {
-            close(rulesMemFd);
-            return RuleSet();
-        }
-    }
-    else if (ipVersion == AF_INET6)
+    if ((ipVersion != AF_INET) && (ipVersion != AF_INET6))
     {
-        if (!forkExec(IP6TABLES_SAVE_PATH, { }, -1, rulesMemFd, stdErrPipe.writeFd()))
-        {
-            close(rulesMemFd);
-            return RuleSet();
-        }
+        close(rulesMemFd);
+        AI_LOG_ERROR_EXIT("netfilter only supports AF_INET or AF_INET6");
+        return RuleSet();
     }
-    else
+    else if (!forkExec(savePath(ipVersion), { }, -1, rulesMemFd, stdErrPipe.writeFd()))
     {
         close(rulesMemFd);
-        AI_LOG_ERROR_EXIT("netfilter only supports AF_INET or AF_INET6");
         return RuleSet();
     }
 
@@ -378,7 +799,7 @@ Netfilter::RuleSet Netfilter::getRuleSet(const int ipVersion) const
  *  @param[in]  newRuleSet      new ruleset to add from mRuleSets.
  *  @param[in]  operation       operation intended to be added for the ruleset.
  */
-void Netfilter::trimDuplicates(RuleSet &existing, RuleSet &newRuleSet, Operation operation) const
+void Netfilter::trimDuplicates(const RuleSet &existing, RuleSet &newRuleSet, Operation operation) const
 {
     // iterate through all tables in new ruleset
     for (std::pair<const TableType, std::list<std::string>> &newRules : newRuleSet)
@@ -427,23 +848,14 @@ void Netfilter::trimDuplicates(RuleSet &existing, RuleSet &newRuleSet, Operation
  *  rules need to be applied.
  *
  *  @param[in]  ruleCache       cache of rules to check for duplicates.
- *  @param[in]  ipVersion       iptables version to use.
+ *  @param[in]  existing        the rules currently in iptables.
  *
  *  @return true if there are any new rules to write, otherwise false.
  */
-bool Netfilter::checkDuplicates(RuleSets ruleCache, const int ipVersion) const
+bool Netfilter::checkDuplicates(RuleSets ruleCache, const RuleSet &existing) const
 {
     AI_LOG_FN_ENTRY();
 
-    // get the existing iptables rules
-    RuleSet existing = getRuleSet(ipVersion);
-
-    if (existing.size() == 0)
-    {
-        AI_LOG_ERROR("Failed to get existing iptables rules - cannot determine which rules to write");
-        return false;
-    }
-
     // trim duplicates rules from the rulesets we want to add to iptables
     trimDuplicates(existing, ruleCache.appendRuleSet, Operation::Append);
     trimDuplicates(existing, ruleCache.insertRuleSet, Operation::Insert);
@@ -477,6 +889,10 @@ bool Netfilter::checkDuplicates(RuleSets ruleCache, const int ipVersion) const
  *  of fork/exec. Running benchmark tests with an implementation of a libiptc
  *  wrapper resulted in slower results compared to using fork/exec [RDK-29283].
  *
+ *  Any rules added with addContainerRules() are resolved against the existing
+ *  rules into the changes to the container's chains and written in the same
+ *  restore.  The rule caches are emptied once written.
+ *
  *  @param[in]  ipVersion       iptables version to use.
  *
  *  @return true on success, false on failure.
@@ -504,18 +920,82 @@ bool Netfilter::applyRules(const int ipVersion)
     // positive attitude
     bool success = true;
 
-    // get reference to the correct cache
-    RuleSets &ruleCache = (ipVersion == AF_INET) ? mIpv4RuleCache : mIpv6RuleCache;
+    std::lock_guard<std::mutex> locker(mLock);
+
+    // take the rules out of the cache, they're only written once
+    RuleSets &cache = (ipVersion == AF_INET) ? mIpv4RuleCache : mIpv6RuleCache;
+    RuleSets ruleCache = std::move(cache);
+    cache = RuleSets();
+
+    // the sets must exist before any rules matching against them are written
+    if (!ruleCache.setEntries.empty() && !applySets(ruleCache.setEntries, ipVersion))
+    {
+        AI_LOG_ERROR_EXIT("failed to update the ipset sets");
+        return false;
+    }
+
+    // nothing to do, so don't bother reading the existing rules
+    if (ruleCache.appendRuleSet.empty() && ruleCache.insertRuleSet.empty() &&
+        ruleCache.deleteRuleSet.empty() && ruleCache.unchangedRuleSet.empty() &&
+        ruleCache.containerRuleSets.empty())
+    {
+        AI_LOG_FN_EXIT();
+        return true;
+    }
+
+    // in the process's own namespace check against the shadow rules, holding
+    // the lock until the shadow has been updated with our changes
+    std::unique_lock<std::mutex> shadowLocker(mShadowLock, std::defer_lock);
+    const bool useShadow = inProcessNetNs();
+    if (useShadow)
+    {
+        shadowLocker.lock();
+    }
+
+    // get the existing iptables rules
+    RuleSet dumped;
+    if (!useShadow)
+    {
+        dumped = getRuleSet(ipVersion);
+    }
+
+    const RuleSet &existing = useShadow ? shadowRules(ipVersion) : dumped;
+    if (existing.empty())
+    {
+        AI_LOG_ERROR("Failed to get existing iptables rules - cannot determine which rules to write");
+        AI_LOG_FN_EXIT();
+        return true;
+    }
+
+    // work out the changes to the containers' chains, these aren't checked
+    // for duplicates as the chains are always flushed before being written
+    const RuleSets containerRules = containerChainRules(ruleCache, existing);
 
     // before doing anything to the rules, check for duplicates in iptables and
     // remove the duplicates from our cache
-    if (!checkDuplicates(ruleCache, ipVersion))
+    if (!checkDuplicates(ruleCache, existing) &&
+        containerRules.unchangedRuleSet.empty())
     {
         // all of the rules were duplicate, none left to write
         AI_LOG_FN_EXIT();
         return true;
     }
 
+    auto mergeRuleSet = [](RuleSet &to, const RuleSet &from)
+    {
+        for (const auto &table : from)
+        {
+            std::list<std::string> &rules = to[table.first];
+            rules.insert(rules.end(), table.second.begin(), table.second.end());
+        }
+    };
+
+    mergeRuleSet(ruleCache.unchangedRuleSet, containerRules.unchangedRuleSet);
+    mergeRuleSet(ruleCache.appendRuleSet, containerRules.appendRuleSet);
+    mergeRuleSet(ruleCache.insertRuleSet, containerRules.insertRuleSet);
+    mergeRuleSet(ruleCache.deleteRuleSet, containerRules.deleteRuleSet);
+    mergeRuleSet(ruleCache.deleteChainRuleSet, containerRules.deleteChainRuleSet);
+
     // fill the pipe with the iptables rules
     const TableType tableTypes[] = { TableType::Raw,     TableType::Nat,
                                      TableType::Mangle,  TableType::Filter,
@@ -524,30 +1004,26 @@ bool Netfilter::applyRules(const int ipVersion)
     // iterate through all tables
     for (TableType tableType : tableTypes)
     {
-        // check if there are any rules to be applied for this table
-        RuleSet::iterator tableUnchanged = ruleCache.unchangedRuleSet.find(tableType);
-        RuleSet::iterator tableAppend = ruleCache.appendRuleSet.find(tableType);
-        RuleSet::iterator tableInsert = ruleCache.insertRuleSet.find(tableType);
-        RuleSet::iterator tableDelete = ruleCache.deleteRuleSet.find(tableType);
-
-        // add all rules with their matching operation to the table rules
-        std::list<std::pair<Operation, std::list<std::string>>> tableRules;
-        // Unchanged = new chain, which will have to go first
-        if (tableUnchanged != ruleCache.unchangedRuleSet.end())
-        {
-            tableRules.emplace_back(std::pair<Operation, std::list<std::string>>({ Operation::Unchanged, tableUnchanged->second }));
-        }
-        if (tableAppend != ruleCache.appendRuleSet.end())
-        {
-            tableRules.emplace_back(std::pair<Operation, std::list<std::string>>({ Operation::Append, tableAppend->second }));
-        }
-        if (tableInsert != ruleCache.insertRuleSet.end())
+        // add all rules with their matching operation to the table rules,
+        // Unchanged = new chain, which will have to go first and chains can
+        // only be deleted once nothing refers to them so they go last
+        const std::pair<const char*, const RuleSet*> operations[] =
         {
-            tableRules.emplace_back(std::pair<Operation, std::list<std::string>>({ Operation::Insert, tableInsert->second }));
-        }
-        if (tableDelete != ruleCache.deleteRuleSet.end())
+            { "",       &ruleCache.unchangedRuleSet     },
+            { "-A ",    &ruleCache.appendRuleSet        },
+            { "-I ",    &ruleCache.insertRuleSet        },
+            { "-D ",    &ruleCache.deleteRuleSet        },
+            { "-X ",    &ruleCache.deleteChainRuleSet   },
+        };
+
+        std::list<std::pair<const char*, const std::list<std::string>*>> tableRules;
+        for (const auto &operation : operations)
         {
-            tableRules.emplace_back(std::pair<Operation, std::list<std::string>>({ Operation::Delete, tableDelete->second }));
+            auto table = operation.second->find(tableType);
+            if ((table != operation.second->end()) && !table->second.empty())
+            {
+                tableRules.emplace_back(operation.first, &table->second);
+            }
         }
 
         // if there are no rules to install, try the next table
@@ -569,29 +1045,12 @@ bool Netfilter::applyRules(const int ipVersion)
         }
 
         // iterate through rule operations
-        for (auto &ruleGroup : tableRules)
+        for (const auto &ruleGroup : tableRules)
         {
-            std::string operationStr;
-            switch (ruleGroup.first)
-            {
-                case Operation::Append:
-                    operationStr = "-A ";
-                    break;
-                case Operation::Insert:
-                    operationStr = "-I ";
-                    break;
-                case Operation::Delete:
-                    operationStr = "-D ";
-                    break;
-                case Operation::Unchanged:
-                    operationStr = "";
-                    break;
-            }
-
             // and then the actual rules
-            for (const std::string &rule : ruleGroup.second)
+            for (const std::string &rule : *ruleGroup.second)
             {
-                rulesStream << operationStr;
+                rulesStream << ruleGroup.first;
                 rulesStream << rule;
                 rulesStream << '\n';
             }
@@ -645,14 +1104,9 @@ bool Netfilter::applyRules(const int ipVersion)
             AI_LOG_SYS_ERROR(errno, "failed to seek to the beginning of the memfd");
         }
 
-        if (ipVersion == AF_INET)
+        if ((ipVersion == AF_INET) || (ipVersion == AF_INET6))
         {
-            success = forkExec(IPTABLES_RESTORE_PATH, args,
-                               rulesFd, -1, stdErrPipe.writeFd());
-        }
-        else if (ipVersion == AF_INET6)
-        {
-            success = forkExec(IP6TABLES_RESTORE_PATH, args,
+            success = forkExec(restorePath(ipVersion), args,
                                rulesFd, -1, stdErrPipe.writeFd());
         }
         else
@@ -663,10 +1117,279 @@ bool Netfilter::applyRules(const int ipVersion)
 
     }
 
+    if (useShadow)
+    {
+        updateShadow(ruleCache, ipVersion, success);
+    }
+
     AI_LOG_FN_EXIT();
     return success;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the 'ipset restore' commands that create the sets and add
+ *  and delete their elements.
+ *
+ *  The deletes are written before the adds, so an element that is both
+ *  deleted and added ends up in the set.
+ *
+ *  @param[in]  sets            The set changes, keyed by set name.
+ *  @param[in]  ipVersion       The address family of the sets.
+ *
+ *  @return the commands, one per line.
+ */
+std::string Netfilter::setCommands(const std::map<std::string, SetEntries> &sets,
+                                   const int ipVersion)
+{
+    const char *family = (ipVersion == AF_INET6) ? "inet6" : "inet";
+
+    std::ostringstream commands;
+    for (const auto &set : sets)
+    {
+        commands << "create " << set.first << ' ' << set.second.type
+                 << " family " << family << '\n';
+
+        for (const std::string &entry : set.second.deleteEntries)
+        {
+            commands << "del " << set.first << ' ' << entry << '\n';
+        }
+        for (const std::string &entry : set.second.addEntries)
+        {
+            commands << "add " << set.first << ' ' << entry << '\n';
+        }
+    }
+
+    return commands.str();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Creates the sets if they don't already exist and adds and deletes
+ *  their elements with a single 'ipset restore'.
+ *
+ *  The restore is run with '-exist' so adding an element already in the set,
+ *  or deleting one that isn't, isn't treated as an error.  The sets
+ *  themselves are never destroyed as the rules matching against them are
+ *  shared by all the containers.
+ *
+ *  @param[in]  sets            The set changes, keyed by set name.
+ *  @param[in]  ipVersion       The address family of the sets.
+ *
+ *  @return true on success, false on failure.
+ */
+bool Netfilter::applySets(const std::map<std::string, SetEntries> &sets,
+                          const int ipVersion) const
+{
+    AI_LOG_FN_ENTRY();
+
+    int commandsFd = memfd_create("ipset-restore-buf", MFD_CLOEXEC);
+    if (commandsFd < 0)
+    {
+        AI_LOG_SYS_ERROR_EXIT(errno, "failed to create memfd buffer");
+        return false;
+    }
+
+    bool success = writeString(commandsFd, setCommands(sets, ipVersion));
+    if (success && (lseek(commandsFd, 0, SEEK_SET) < 0))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to seek to the beginning of the memfd");
+        success = false;
+    }
+
+    if (success)
+    {
+        // create a pipe to store the stderr output (it's destructor prints the
+        // content of the pipe if not empty)
+        StdStreamPipe stdErrPipe(true);
+
+        success = forkExec(IPSET_PATH, { "-exist", "restore" },
+                           commandsFd, -1, stdErrPipe.writeFd());
+    }
+
+    close(commandsFd);
+
+    AI_LOG_FN_EXIT();
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the shadow of the rules in the kernel, re-reading them with
+ *  iptables-save if they may have changed since the shadow was updated.
+ *
+ *  The shadow holds every rule in the tables, not just the ones Dobby added,
+ *  as they are all needed for the duplicate checks.
+ *
+ *  Must be called with mShadowLock held.
+ *
+ *  @param[in]  ipVersion       iptables version to use.
+ *
+ *  @return the current rules, empty if they couldn't be read.
+ */
+const Netfilter::RuleSet &Netfilter::shadowRules(const int ipVersion) const
+{
+    Shadow &shadow = mShadows[std::make_pair(mBackend, ipVersion)];
+
+    // take the fingerprint before any dump, so that a change made while
+    // dumping is caught next time
+    uint64_t fingerprint = 0;
+    const bool haveFingerprint = kernelFingerprint(ipVersion, &fingerprint);
+
+    if (shadow.valid && haveFingerprint && (shadow.fingerprint == fingerprint))
+    {
+        AI_LOG_DEBUG("iptables rules unchanged, using shadow rules");
+        return shadow.rules;
+    }
+
+    if (shadow.valid)
+    {
+        AI_LOG_INFO("iptables rules changed outside of Dobby, re-reading them");
+    }
+
+    shadow.rules = getRuleSet(ipVersion);
+    shadow.fingerprint = fingerprint;
+    shadow.valid = haveFingerprint && !shadow.rules.empty();
+
+    return shadow.rules;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Applies the rules just written by iptables-restore to the shadow
+ *  and takes a new fingerprint of the kernel tables.
+ *
+ *  If the restore failed we can't tell which tables were committed, so the
+ *  shadow is dropped and the rules are read again on the next apply.
+ *
+ *  Must be called with mShadowLock held.
+ *
+ *  @param[in]  applied         the rules passed to iptables-restore.
+ *  @param[in]  ipVersion       iptables version to use.
+ *  @param[in]  success         the result of iptables-restore.
+ */
+void Netfilter::updateShadow(const RuleSets &applied, const int ipVersion,
+                             bool success) const
+{
+    Shadow &shadow = mShadows[std::make_pair(mBackend, ipVersion)];
+    if (!success || !shadow.valid)
+    {
+        shadow.valid = false;
+        return;
+    }
+
+    // a chain declaration flushes the chain if it already exists, so drop
+    // the rules of those chains first
+    for (const auto &table : applied.unchangedRuleSet)
+    {
+        std::list<std::string> &rules = shadow.rules[table.first];
+        for (const std::string &declaration : table.second)
+        {
+            if (declaration.size() < 2)
+            {
+                continue;
+            }
+
+            const std::string chain = splitRule(declaration.substr(1)).first;
+            rules.remove_if([&chain](const std::string &rule)
+                            {
+                                return splitRule(rule).first == chain;
+                            });
+        }
+    }
+
+    // the shadow is only used for membership checks so the position of
+    // appended vs inserted rules doesn't matter, new chains aren't tracked
+    for (const RuleSet *added : { &applied.appendRuleSet, &applied.insertRuleSet })
+    {
+        for (const auto &table : *added)
+        {
+            std::list<std::string> &rules = shadow.rules[table.first];
+            rules.insert(rules.end(), table.second.begin(), table.second.end());
+        }
+    }
+
+    for (const auto &table : applied.deleteRuleSet)
+    {
+        std::list<std::string> &rules = shadow.rules[table.first];
+        for (const std::string &rule : table.second)
+        {
+            auto it = std::find(rules.begin(), rules.end(), rule);
+            if (it != rules.end())
+            {
+                rules.erase(it);
+            }
+        }
+    }
+
+    shadow.valid = kernelFingerprint(ipVersion, &shadow.fingerprint);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Takes a cheap fingerprint of the kernel's rules, used to tell if
+ *  the rules have changed since the shadow was updated.
+ *
+ *  For iptables-nft this is the nf_tables generation id, which changes on any
+ *  nf_tables commit in the namespace.  For legacy iptables it's a hash of the
+ *  table entries (minus the counters) read directly from the kernel.
+ *
+ *  @param[in]  ipVersion       iptables version to use.
+ *  @param[out] fingerprint     the fingerprint.
+ *
+ *  @return false if the fingerprint couldn't be taken.
+ */
+bool Netfilter::kernelFingerprint(const int ipVersion, uint64_t *fingerprint) const
+{
+    if (mIptablesVersion.nfTables)
+    {
+        uint32_t genId;
+        if (!nftGenerationId(&genId))
+        {
+            return false;
+        }
+
+        *fingerprint = genId;
+        return true;
+    }
+
+    int sockFd = socket(ipVersion, SOCK_RAW | SOCK_CLOEXEC, IPPROTO_RAW);
+    if (sockFd < 0)
+    {
+        AI_LOG_SYS_WARN(errno, "failed to create raw socket");
+        return false;
+    }
+
+    static const char *tableNames[] = { "raw", "nat", "mangle", "filter", "security" };
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    bool success = true;
+
+    for (const char *tableName : tableNames)
+    {
+        if (ipVersion == AF_INET)
+        {
+            success = hashXtTable<struct ipt_getinfo, struct ipt_get_entries, struct ipt_entry>(
+                sockFd, IPPROTO_IP, IPT_SO_GET_INFO, IPT_SO_GET_ENTRIES, tableName, &hash);
+        }
+        else
+        {
+            success = hashXtTable<struct ip6t_getinfo, struct ip6t_get_entries, struct ip6t_entry>(
+                sockFd, IPPROTO_IPV6, IP6T_SO_GET_INFO, IP6T_SO_GET_ENTRIES, tableName, &hash);
+        }
+
+        if (!success)
+        {
+            break;
+        }
+    }
+
+    close(sockFd);
+
+    *fingerprint = hash;
+    return success;
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Writes the string into the supplied file descriptor
@@ -779,6 +1502,8 @@ bool Netfilter::addRules(RuleSet &ruleSet, const int ipVersion, Operation operat
         return false;
     }
 
+    std::lock_guard<std::mutex> locker(mLock);
+
     // get pointer to the correct operation's ruleset in the cache
     RuleSets *ruleCache = (ipVersion == AF_INET) ? &mIpv4RuleCache : &mIpv6RuleCache;
     RuleSet *cacheRuleSet;
@@ -818,6 +1543,274 @@ bool Netfilter::addRules(RuleSet &ruleSet, const int ipVersion, Operation operat
     return true;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Adds rules for a container to the internal rule caches.
+ *
+ *  With the iptables backend this is the same as addRules().
+ *
+ *  With the nftables backend the appended and inserted rules are put in
+ *  chains of the container's own, with a single jump to each chain from the
+ *  chain the rules were for.  The chains are created (or replaced) by the
+ *  next applyRules() call, with any of the container's chains that no longer
+ *  have rules removed.
+ *
+ *  A delete removes all of the container's chains for the ip version, so
+ *  the rules passed in are not used.
+ *
+ *  @param[in]  containerId     The id of the container the rules are for.
+ *  @param[in]  ruleSet         The ruleset to apply.
+ *  @param[in]  ipVersion       iptables version to use.
+ *  @param[in]  operation       iptables operation to use for rules.
+ *
+ *  @return returns true on success, otherwise false.
+ */
+bool Netfilter::addContainerRules(const std::string &containerId,
+                                  RuleSet &ruleSet, const int ipVersion,
+                                  Operation operation)
+{
+    if (mBackend != Backend::Nftables)
+    {
+        return addRules(ruleSet, ipVersion, operation);
+    }
+
+    AI_LOG_FN_ENTRY();
+
+    if (ipVersion != AF_INET && ipVersion != AF_INET6)
+    {
+        AI_LOG_ERROR_EXIT("incorrect ip version %d, use AF_INET or AF_INET6", ipVersion);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    // get the container's rules in the correct cache
+    RuleSets &ruleCache = (ipVersion == AF_INET) ? mIpv4RuleCache : mIpv6RuleCache;
+    ContainerRuleSets &containerRules = ruleCache.containerRuleSets[containerId];
+
+    RuleSet *cacheRuleSet;
+    switch (operation)
+    {
+        case Operation::Append:
+            cacheRuleSet = &containerRules.appendRuleSet;
+            break;
+        case Operation::Insert:
+            cacheRuleSet = &containerRules.insertRuleSet;
+            break;
+        case Operation::Delete:
+            // an entry without any rules removes all the container's chains
+            containerRules = ContainerRuleSets();
+            AI_LOG_FN_EXIT();
+            return true;
+        case Operation::Unchanged:
+            AI_LOG_ERROR_EXIT("operation type 'Unchanged' not allowed, use Append, "
+                              "Insert or Delete");
+            return false;
+    }
+
+    for (auto &it : ruleSet)
+    {
+        std::list<std::string> &rules = (*cacheRuleSet)[it.first];
+        rules.splice(rules.end(), it.second);
+    }
+
+    AI_LOG_FN_EXIT();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Adds elements to, or deletes them from, an ipset set.
+ *
+ *  The set is created with the given type and the family of @a ipVersion if
+ *  it doesn't exist.  Append and Insert both add the elements.
+ *
+ *  NB: The sets are not changed until the Netfilter::applyRules() method is
+ *  called, which updates them before writing any rules.
+ *
+ *  @param[in]  setName         The name of the set, @see setName().
+ *  @param[in]  setType         The ipset type of the set, e.g. "hash:ip,port".
+ *  @param[in]  entries         The elements, in the ipset syntax for the type.
+ *  @param[in]  ipVersion       The address family of the set.
+ *  @param[in]  operation       Whether to add or delete the elements.
+ *
+ *  @return returns true on success, otherwise false.
+ */
+bool Netfilter::addSetEntries(const std::string &setName, const std::string &setType,
+                              const std::list<std::string> &entries,
+                              const int ipVersion, Operation operation)
+{
+    AI_LOG_FN_ENTRY();
+
+    if (ipVersion != AF_INET && ipVersion != AF_INET6)
+    {
+        AI_LOG_ERROR_EXIT("incorrect ip version %d, use AF_INET or AF_INET6", ipVersion);
+        return false;
+    }
+    if (operation == Operation::Unchanged)
+    {
+        AI_LOG_ERROR_EXIT("operation type 'Unchanged' not allowed, use Append, "
+                          "Insert or Delete");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    RuleSets &ruleCache = (ipVersion == AF_INET) ? mIpv4RuleCache : mIpv6RuleCache;
+    SetEntries &setEntries = ruleCache.setEntries[setName];
+    setEntries.type = setType;
+
+    std::list<std::string> &cacheEntries = (operation == Operation::Delete) ?
+                                           setEntries.deleteEntries :
+                                           setEntries.addEntries;
+    cacheEntries.insert(cacheEntries.end(), entries.begin(), entries.end());
+
+    AI_LOG_FN_EXIT();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Works out the rules needed to bring the containers' chains from
+ *  the @a existing rules to the ones in the @a ruleCache.
+ *
+ *  For every chain the container should have the chain is declared, which
+ *  creates it or flushes it if it already exists, the rules are appended to
+ *  it and a jump to it is added to the base chain if there isn't one already.
+ *  The rules for the 'inserted' chains are reversed so that they end up in
+ *  the same order as inserting them one by one into the base chain did.
+ *
+ *  Any other chains of the container are flushed and deleted, along with the
+ *  jumps to them.
+ *
+ *  The container's chains are found from the existing rules in the chains
+ *  and the jumps to them, so an empty chain without any jumps to it isn't
+ *  found.
+ *
+ *  @param[in]  ruleCache       the rule cache being applied.
+ *  @param[in]  existing        the rules currently in iptables.
+ *
+ *  @return the rules to write, the unchanged ruleset is empty if there's
+ *  nothing to do.
+ */
+Netfilter::RuleSets Netfilter::containerChainRules(const RuleSets &ruleCache,
+                                                   const RuleSet &existing) const
+{
+    RuleSets changes;
+
+    typedef struct Chain
+    {
+        std::string baseChain;
+        bool inserted;
+        std::list<std::string> rules;
+    } Chain;
+
+    for (const auto &container : ruleCache.containerRuleSets)
+    {
+        const std::string prefix = containerChainPrefix(container.first);
+        const std::string jumpPrefix = "-j " + prefix;
+
+        // the container's chains that exist now and the chains jumping to them
+        std::map<TableType, std::map<std::string, std::list<std::string>>> current;
+        for (const auto &table : existing)
+        {
+            for (const std::string &rule : table.second)
+            {
+                const std::pair<std::string, std::string> split = splitRule(rule);
+                if (split.first.compare(0, prefix.size(), prefix) == 0)
+                {
+                    current[table.first][split.first];
+                }
+                else if ((split.second.compare(0, jumpPrefix.size(), jumpPrefix) == 0) &&
+                         (split.second.find(' ', 3) == std::string::npos))
+                {
+                    current[table.first][split.second.substr(3)].push_back(split.first);
+                }
+            }
+        }
+
+        // the chains the container should have
+        std::map<TableType, std::map<std::string, Chain>> wanted;
+        for (const bool inserted : { true, false })
+        {
+            const RuleSet &ruleSet = inserted ? container.second.insertRuleSet :
+                                                container.second.appendRuleSet;
+            for (const auto &table : ruleSet)
+            {
+                for (const std::string &rule : table.second)
+                {
+                    const std::pair<std::string, std::string> split = splitRule(rule);
+                    const std::string name = containerChainName(prefix, split.first, inserted);
+
+                    Chain &chain = wanted[table.first][name];
+                    chain.baseChain = split.first;
+                    chain.inserted = inserted;
+                    if (inserted)
+                    {
+                        chain.rules.push_front(split.second);
+                    }
+                    else
+                    {
+                        chain.rules.push_back(split.second);
+                    }
+                }
+            }
+        }
+
+        // create or replace the wanted chains
+        for (const auto &table : wanted)
+        {
+            for (const auto &it : table.second)
+            {
+                const std::string &name = it.first;
+                const Chain &chain = it.second;
+
+                changes.unchangedRuleSet[table.first].emplace_back(":" + name + " - [0:0]");
+
+                std::list<std::string> &appendRules = changes.appendRuleSet[table.first];
+                for (const std::string &rule : chain.rules)
+                {
+                    appendRules.emplace_back(name + " " + rule);
+                }
+
+                const std::list<std::string> &jumps = current[table.first][name];
+                if (std::find(jumps.begin(), jumps.end(), chain.baseChain) == jumps.end())
+                {
+                    RuleSet &jumpRuleSet = chain.inserted ? changes.insertRuleSet :
+                                                            changes.appendRuleSet;
+                    jumpRuleSet[table.first].emplace_back(chain.baseChain + " -j " + name);
+                }
+            }
+        }
+
+        // and remove any others
+        for (const auto &table : current)
+        {
+            const auto wantedTable = wanted.find(table.first);
+
+            for (const auto &it : table.second)
+            {
+                const std::string &name = it.first;
+                if ((wantedTable != wanted.end()) &&
+                    (wantedTable->second.count(name) > 0))
+                {
+                    continue;
+                }
+
+                for (const std::string &baseChain : it.second)
+                {
+                    changes.deleteRuleSet[table.first].emplace_back(baseChain + " -j " + name);
+                }
+
+                changes.unchangedRuleSet[table.first].emplace_back(":" + name + " - [0:0]");
+                changes.deleteChainRuleSet[table.first].emplace_back(name);
+            }
+        }
+    }
+
+    return changes;
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Creates a new IPTables chain with the given name and put it in the
@@ -838,6 +1831,8 @@ bool Netfilter::createNewChain(TableType table, const std::string &name, const i
 {
     AI_LOG_FN_ENTRY();
 
+    std::lock_guard<std::mutex> locker(mLock);
+
     // get reference to the correct cache
     RuleSets &ruleCache = (ipVersion == AF_INET) ? mIpv4RuleCache : mIpv6RuleCache;
 
@@ -905,7 +1900,8 @@ Netfilter::IptablesVersion Netfilter::getIptablesVersion() const
     Netfilter::IptablesVersion version{
         0, // Major
         0, // Minor
-        0  // Patch
+        0, // Patch
+        false
     };
 
     // create a pipe for reading the stderr
@@ -937,6 +1933,9 @@ Netfilter::IptablesVersion Netfilter::getIptablesVersion() const
     version.minor = std::stoi(matches.str(2));
     version.patch = std::stoi(matches.str(3));
 
+    // iptables 1.8+ reports which backend it's using, e.g. "(nf_tables)"
+    version.nfTables = (output.find("nf_tables") != std::string::npos);
+
     AI_LOG_DEBUG("Running iptables version %d.%d.%d",
                 version.major, version.minor, version.patch);
 
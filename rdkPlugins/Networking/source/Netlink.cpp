@@ -31,10 +31,14 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sstream>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
 #include <linux/if.h>
 #include <netlink/netlink.h>
 #include <netlink/socket.h>
 #include <netlink/errno.h>
+#include <netlink/cache.h>
 #include <netlink/route/rule.h>
 #include <netlink/route/link.h>
 #include <netlink/route/addr.h>
@@ -432,6 +436,12 @@ public:
         : mLink(fromName(nl, name))
     { }
 
+    // looks up the link in the cache if not null, otherwise asks the kernel
+    NlLink(struct nl_cache* cache, struct nl_sock* nl, const std::string& name)
+        : mLink((cache != nullptr) ? rtnl_link_get_by_name(cache, name.c_str()) :
+                                     fromName(nl, name))
+    { }
+
     ~NlLink()
     {
         if (mLink != nullptr)
@@ -470,9 +480,42 @@ private:
 };
 
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns true if the calling thread is in the network namespace of
+ *  the process.
+ */
+static bool inProcessNetNs()
+{
+    char threadNsPath[64];
+    snprintf(threadNsPath, sizeof(threadNsPath), "/proc/self/task/%ld/ns/net",
+             syscall(SYS_gettid));
+
+    struct stat processNs, threadNs;
+    if ((stat("/proc/self/ns/net", &processNs) != 0) ||
+        (stat(threadNsPath, &threadNs) != 0))
+    {
+        return false;
+    }
+
+    return (processNs.st_dev == threadNs.st_dev) &&
+           (processNs.st_ino == threadNs.st_ino);
+}
+
 Netlink::Netlink()
+    : Netlink(false)
+{
+}
+
+Netlink::Netlink(bool linkCache)
     : mSocket(nullptr)
     , mSysClassNetDirFd(-1)
+    , mCacheManager(nullptr)
+    , mLinkCache(nullptr)
+    , mLinkIndexStale(true)
+    , mBatching(false)
+    , mBatchPending(0)
+    , mBatchLinkCache(nullptr)
 {
     AI_LOG_FN_ENTRY();
 
@@ -527,6 +570,13 @@ Netlink::Netlink()
         AI_LOG_SYS_FATAL(errno, "failed to open '/sys/class/net'");
     }
 
+    // if the cache can't be created we just fall back to asking the kernel
+    if (linkCache && (mSocket != nullptr) && !createLinkCache())
+    {
+        AI_LOG_WARN("failed to create link cache, interfaces will be looked up "
+                    "with netlink requests");
+    }
+
     AI_LOG_FN_EXIT();
 }
 
@@ -534,6 +584,20 @@ Netlink::~Netlink()
 {
     AI_LOG_FN_ENTRY();
 
+    if (mBatchLinkCache != nullptr)
+    {
+        nl_cache_free(mBatchLinkCache);
+        mBatchLinkCache = nullptr;
+    }
+
+    // frees the link cache as well
+    if (mCacheManager != nullptr)
+    {
+        nl_cache_mngr_free(mCacheManager);
+        mCacheManager = nullptr;
+        mLinkCache = nullptr;
+    }
+
     if (mSocket != nullptr)
     {
         nl_socket_free(mSocket);
@@ -548,6 +612,198 @@ Netlink::~Netlink()
     AI_LOG_FN_EXIT();
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the netlink object shared by everything running in the
+ *  process's network namespace.
+ *
+ *  The object, its socket and link cache are kept for the life of the process
+ *  so hooks don't pay for setting them up each time.  A netlink socket talks
+ *  to the namespace it was opened in, so threads that have entered another
+ *  network namespace (i.e. via callInNamespace) get a new object of their
+ *  own instead.
+ *
+ *  @return the shared netlink object.
+ */
+std::shared_ptr<Netlink> Netlink::shared()
+{
+    if (!inProcessNetNs())
+    {
+        return std::make_shared<Netlink>();
+    }
+
+    static std::mutex lock;
+    static std::shared_ptr<Netlink> instance;
+
+    std::lock_guard<std::mutex> locker(lock);
+
+    // try again if we failed to open the socket last time
+    if (!instance || !instance->isValid())
+    {
+        instance.reset(new Netlink(true));
+    }
+
+    return instance;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Creates a cache of the links that's kept up to date from the
+ *  RTNLGRP_LINK notifications.
+ *
+ *  The cache manager has a socket of its own subscribed to the notifications,
+ *  they're read whenever the cache is used, @see refreshLinkIndex().
+ *
+ *  @return true on success, otherwise false.
+ */
+bool Netlink::createLinkCache()
+{
+    AI_LOG_FN_ENTRY();
+
+    // nb: the manager's socket is non-blocking, so reading it never waits
+    int ret = nl_cache_mngr_alloc(nullptr, NETLINK_ROUTE, 0, &mCacheManager);
+    if (ret < 0)
+    {
+        AI_LOG_NL_ERROR_EXIT(ret, "failed to create cache manager");
+        mCacheManager = nullptr;
+        return false;
+    }
+
+    int fd = nl_cache_mngr_get_fd(mCacheManager);
+    int flags = (fd < 0) ? -1 : fcntl(fd, F_GETFD, 0);
+    if ((flags < 0) || (fcntl(fd, F_SETFD, flags | FD_CLOEXEC) < 0))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to set FD_CLOEXEC on cache manager socket");
+    }
+
+    ret = nl_cache_mngr_add(mCacheManager, "route/link", &Netlink::linkCacheChanged,
+                            this, &mLinkCache);
+    if (ret < 0)
+    {
+        AI_LOG_NL_ERROR_EXIT(ret, "failed to add link cache");
+        nl_cache_mngr_free(mCacheManager);
+        mCacheManager = nullptr;
+        mLinkCache = nullptr;
+        return false;
+    }
+
+    mLinkIndexStale = true;
+
+    AI_LOG_FN_EXIT();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Called by the cache manager for every link added, changed or
+ *  removed, marks the index for rebuilding.
+ */
+void Netlink::linkCacheChanged(struct nl_cache *cache, struct nl_object *object,
+                               int action, void *userData)
+{
+    (void)cache;
+    (void)object;
+    (void)action;
+
+    static_cast<const Netlink*>(userData)->mLinkIndexStale = true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Applies any pending link notifications to the cache and rebuilds
+ *  the index of link names if anything changed.
+ *
+ *  If notifications were lost, i.e. the socket buffer overflowed, the cache
+ *  is refilled from the kernel.  Any notifications still queued are dropped
+ *  first, they're older than the refill and applying them afterwards could
+ *  bring back links that have since been deleted.
+ *
+ *  Must be called with the lock held.
+ */
+void Netlink::refreshLinkIndex() const
+{
+    int ret = nl_cache_mngr_data_ready(mCacheManager);
+    if (ret < 0)
+    {
+        AI_LOG_NL_WARN(ret, "failed to read link notifications, refilling cache");
+
+        const int fd = nl_cache_mngr_get_fd(mCacheManager);
+        char buf[4096];
+        while ((fd >= 0) && (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) >= 0))
+            continue;
+
+        ret = nl_cache_refill(mSocket, mLinkCache);
+        if (ret < 0)
+        {
+            AI_LOG_NL_ERROR(ret, "failed to refill link cache");
+        }
+
+        mLinkIndexStale = true;
+    }
+
+    if (!mLinkIndexStale)
+    {
+        return;
+    }
+
+    mLinkNames.clear();
+    mVethNumbers.clear();
+
+    for (struct nl_object *object = nl_cache_get_first(mLinkCache);
+         object != nullptr; object = nl_cache_get_next(object))
+    {
+        const char *name = rtnl_link_get_name(reinterpret_cast<struct rtnl_link*>(object));
+        if (name == nullptr)
+        {
+            continue;
+        }
+
+        mLinkNames.emplace(name);
+
+        unsigned number;
+        if (vethNumber(name, &number))
+        {
+            mVethNumbers.insert(number);
+        }
+    }
+
+    mLinkIndexStale = false;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the number of a link named "veth<number>".
+ *
+ *  @return false if the name isn't a veth name, e.g. "veth", "veth1a".
+ */
+bool Netlink::vethNumber(const char *name, unsigned *number)
+{
+    char trailing;
+    return (sscanf(name, "veth%u%c", number, &trailing) == 1);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the name of the first veth from @a startIndex whose number
+ *  isn't in @a vethNumbers.
+ *
+ *  @return the name, or an empty string if all the names up to veth1023 are
+ *  taken.
+ */
+std::string Netlink::firstFreeVethName(const std::set<unsigned> &vethNumbers,
+                                       unsigned startIndex)
+{
+    for (unsigned n = startIndex; n < 1024; n++)
+    {
+        if (vethNumbers.count(n) == 0)
+        {
+            return "veth" + std::to_string(n);
+        }
+    }
+
+    return std::string();
+}
+
 bool Netlink::isValid() const
 {
     std::lock_guard<std::mutex> locker(mLock);
@@ -560,14 +816,28 @@ bool Netlink::applyChangesToLink(const std::string& ifaceName,
     AI_LOG_FN_ENTRY();
 
     // get the link with the given name
-    NlLink link(mSocket, ifaceName);
+    NlLink link(linkCache(), mSocket, ifaceName);
     if (!link)
     {
         return false;
     }
 
-    // apply the changes
-    int ret = rtnl_link_change(mSocket, link, changes, 0);
+    // apply the changes, if batching just queue the request
+    int ret;
+    if (!mBatching)
+    {
+        ret = rtnl_link_change(mSocket, link, changes, 0);
+    }
+    else
+    {
+        struct nl_msg *msg = nullptr;
+        ret = rtnl_link_build_change_request(link, changes, 0, &msg);
+        if (ret == 0)
+        {
+            ret = sendRequest(msg);
+        }
+    }
+
     if (ret != 0)
     {
         AI_LOG_NL_ERROR_EXIT(ret, "failed to apply changes");
@@ -612,7 +882,12 @@ bool Netlink::setLinkAddress(const NlLink& link, const in_addr_t address,
     rtnl_addr_set_link(addr, link);
 
     // add the address
-    int ret = rtnl_addr_add(mSocket, addr, 0);
+    struct nl_msg *msg = nullptr;
+    int ret = rtnl_addr_build_add_request(addr, 0, &msg);
+    if (ret == 0)
+    {
+        ret = sendRequest(msg);
+    }
     if ((ret != 0) && (ret != -NLE_EXIST))
     {
         AI_LOG_NL_ERROR_EXIT(ret, "failed to add new link address");
@@ -657,7 +932,12 @@ bool Netlink::setLinkAddress(const NlLink& link, const struct in6_addr address,
     rtnl_addr_set_link(addr, link);
 
     // add the address
-    int ret = rtnl_addr_add(mSocket, addr, 0);
+    struct nl_msg *msg = nullptr;
+    int ret = rtnl_addr_build_add_request(addr, 0, &msg);
+    if (ret == 0)
+    {
+        ret = sendRequest(msg);
+    }
     if ((ret != 0) && (ret != -NLE_EXIST))
     {
         AI_LOG_NL_ERROR_EXIT(ret, "failed to add new link address");
@@ -697,7 +977,7 @@ bool Netlink::setIfaceAddress(const std::string& ifaceName,
     }
 
     // get the link with the given name
-    NlLink link(mSocket, ifaceName);
+    NlLink link(linkCache(), mSocket, ifaceName);
     if (!link)
     {
         AI_LOG_ERROR_EXIT("failed to get link with name '%s'", ifaceName.c_str());
@@ -740,7 +1020,7 @@ bool Netlink::setIfaceAddress(const std::string& ifaceName,
     }
 
     // get the link with the given name
-    NlLink link(mSocket, ifaceName);
+    NlLink link(linkCache(), mSocket, ifaceName);
     if (!link)
     {
         AI_LOG_ERROR_EXIT("failed to get link with name '%s'", ifaceName.c_str());
@@ -1107,7 +1387,7 @@ std::array<uint8_t, 6> Netlink::getIfaceMAC(const std::string& ifaceName)
     }
 
     // get the current link
-    NlLink iface(mSocket, ifaceName);
+    NlLink iface(linkCache(), mSocket, ifaceName);
     if (!iface)
     {
         AI_LOG_ERROR_EXIT("failed to get link '%s'", ifaceName.c_str());
@@ -1260,8 +1540,13 @@ bool Netlink::ifaceIsUp(const std::string& ifaceName) const
         return false;
     }
 
-    // get the link
-    NlLink link(mSocket, ifaceName);
+    if (mLinkCache != nullptr)
+    {
+        refreshLinkIndex();
+    }
+
+    // get the link, from the cache if we have one
+    NlLink link(mLinkCache, mSocket, ifaceName);
     if (!link)
     {
         AI_LOG_ERROR_EXIT("failed to get link '%s'", ifaceName.c_str());
@@ -1297,9 +1582,20 @@ bool Netlink::ifaceExists(const std::string& ifaceName) const
         return false;
     }
 
-    // get the link
-    NlLink link(mSocket, ifaceName);
-    if (!link)
+    // check the index if we have a link cache, otherwise ask the kernel
+    bool exists;
+    if (mLinkCache != nullptr)
+    {
+        refreshLinkIndex();
+        exists = (mLinkNames.count(ifaceName) > 0);
+    }
+    else
+    {
+        NlLink link(mSocket, ifaceName);
+        exists = static_cast<bool>(link);
+    }
+
+    if (!exists)
     {
         AI_LOG_INFO("Interface %s does not exist", ifaceName.c_str());
         AI_LOG_FN_EXIT();
@@ -1315,8 +1611,12 @@ bool Netlink::ifaceExists(const std::string& ifaceName) const
 /**
  *  @brief Returns the number of the next free veth device.
  *
- *  This works by scanning /sys/class/net/ for devices with names "veth%d",
- *  the first one not found is returned.
+ *  With a link cache the first number from @a startIndex that isn't in the
+ *  index of veth names is returned.  Otherwise this works by scanning
+ *  /sys/class/net/ for devices with names "veth%d", the first one not found
+ *  is returned.
+ *
+ *  Must be called with the lock held.
  *
  *  @param[in]  startIndex      Starting index for veth names
  *
@@ -1325,13 +1625,26 @@ bool Netlink::ifaceExists(const std::string& ifaceName) const
  */
 std::string Netlink::getAvailableVethName(const int startIndex) const
 {
+    char vethName[32];
+
+    if (mLinkCache != nullptr)
+    {
+        refreshLinkIndex();
+
+        const std::string freeName = firstFreeVethName(mVethNumbers, startIndex);
+        if (freeName.empty())
+        {
+            AI_LOG_ERROR("no available veth device names");
+        }
+        return freeName;
+    }
+
     if (mSysClassNetDirFd < 0)
     {
         AI_LOG_ERROR("missing fd for '/sys/class/net' directory");
         return std::string();
     }
 
-    char vethName[32];
     for (unsigned n = startIndex; n < 1024; n++)
     {
         snprintf(vethName, sizeof(vethName), "veth%u", n);
@@ -1345,16 +1658,57 @@ std::string Netlink::getAvailableVethName(const int startIndex) const
     return std::string();
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Creates a veth pair with one end in the given network namespace.
+ *
+ *  The pair and the namespace of the peer are set in the one RTM_NEWLINK
+ *  request, so the peer is created directly in the namespace rather than
+ *  being moved there afterwards.
+ *
+ *  @return 0 on success, otherwise a negative netlink error code.
+ */
+static int addVethPair(struct nl_sock* nl, const std::string& vethName,
+                       const std::string& peerVethName, int peerNsFd)
+{
+    struct rtnl_link* link = rtnl_link_veth_alloc();
+    if (link == nullptr)
+    {
+        return -NLE_NOMEM;
+    }
+
+    rtnl_link_set_name(link, vethName.c_str());
+
+    struct rtnl_link* peer = rtnl_link_veth_get_peer(link);
+    rtnl_link_set_name(peer, peerVethName.c_str());
+    if (peerNsFd >= 0)
+    {
+        rtnl_link_set_ns_fd(peer, peerNsFd);
+    }
+    rtnl_link_put(peer);
+
+    int ret = rtnl_link_add(nl, link, NLM_F_CREATE | NLM_F_EXCL);
+
+    // frees the peer as well
+    rtnl_link_put(link);
+
+    return ret;
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Creates a veth pair for the netns attached to the given pid
  *
+ *  The namespace is opened once and passed to the kernel by fd, so all the
+ *  attempts refer to the same namespace even if the pid is reused.
+ *
  *  @param[in]  peerVethName    The name of the veth interface inside the net
  *                              namespace (container), typically this will be
  *                              "eth0".
  *  @param[in]  peerPid         The pid of the process which has the netns we
  *                              want to create the veth in (i.e. the pid of
- *                              init process within the container).
+ *                              init process within the container), or 0 to
+ *                              leave the peer in this namespace.
  *  @param[in]  takenVeths      Veth devices reserved by other containers.
  *                              We want to check that in case of races.
  *
@@ -1382,6 +1736,20 @@ std::string Netlink::createVeth(const std::string& peerVethName,
         return std::string();
     }
 
+    int peerNsFd = -1;
+    if (peerPid != 0)
+    {
+        char nsPath[64];
+        snprintf(nsPath, sizeof(nsPath), "/proc/%d/ns/net", peerPid);
+
+        peerNsFd = open(nsPath, O_RDONLY | O_CLOEXEC);
+        if (peerNsFd < 0)
+        {
+            AI_LOG_SYS_ERROR_EXIT(errno, "failed to open '%s'", nsPath);
+            return std::string();
+        }
+    }
+
     // frustratingly choosing a name for a veth device is not straight forward,
     // we have to get the list of existing devices and then pick one not in
     // that list, if the creation fails we have to go back through the loop.
@@ -1421,8 +1789,7 @@ std::string Netlink::createVeth(const std::string& peerVethName,
         }
 
         // create the veth pair
-        int ret = rtnl_link_veth_add(mSocket, vethName.c_str(),
-                                     peerVethName.c_str(), peerPid);
+        int ret = addVethPair(mSocket, vethName, peerVethName, peerNsFd);
         if (ret == -NLE_EXIST)
         {
             AI_LOG_WARN("'%s' already exists, trying again to get free veth"
@@ -1439,8 +1806,9 @@ std::string Netlink::createVeth(const std::string& peerVethName,
             // surely if we've tried over 300 names by now, we won't find one
             if (vethNameStartIndex > 300)
             {
-                AI_LOG_ERROR_EXIT("failed to find free veth device");
-                return std::string();
+                AI_LOG_ERROR("failed to find free veth device");
+                vethName.clear();
+                break;
             }
 
             continue;
@@ -1473,10 +1841,199 @@ std::string Netlink::createVeth(const std::string& peerVethName,
         break;
     }
 
+    if ((peerNsFd >= 0) && (close(peerNsFd) != 0))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to close fd");
+    }
+
     AI_LOG_FN_EXIT();
     return vethName;
 }
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the veth pairs with one end in this namespace whose name starts
+ *  with the given prefix.
+ *
+ *  Pairs whose other end isn't in this namespace are skipped.
+ *
+ *  @param[in]  peerPrefix      The prefix of the names to look for.
+ *
+ *  @return the details of the matching pairs, the peer is the end with the
+ *  matching name and bridged is true if the other end is attached to a bridge.
+ */
+std::list<Netlink::VethPeerDetails> Netlink::getVethPeers(const std::string& peerPrefix)
+{
+    AI_LOG_FN_ENTRY();
+
+    std::list<VethPeerDetails> peers;
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (mSocket == nullptr)
+    {
+        AI_LOG_ERROR_EXIT("invalid socket");
+        return peers;
+    }
+
+    // use the link cache if we have one, otherwise get a dump of the links
+    struct nl_cache *cache = linkCache();
+    struct nl_cache *dumpCache = nullptr;
+    if (cache == nullptr)
+    {
+        int ret = rtnl_link_alloc_cache(mSocket, AF_UNSPEC, &dumpCache);
+        if (ret != 0)
+        {
+            AI_LOG_NL_ERROR_EXIT(ret, "failed to get the links");
+            return peers;
+        }
+
+        cache = dumpCache;
+    }
+
+    for (struct nl_object *object = nl_cache_get_first(cache);
+         object != nullptr; object = nl_cache_get_next(object))
+    {
+        struct rtnl_link *peer = reinterpret_cast<struct rtnl_link *>(object);
+
+        const char *peerName = rtnl_link_get_name(peer);
+        if ((peerName == nullptr) ||
+            (strncmp(peerName, peerPrefix.c_str(), peerPrefix.size()) != 0) ||
+            !rtnl_link_is_veth(peer))
+        {
+            continue;
+        }
+
+        // for a veth the link index is the other end of the pair
+        NlLink veth(rtnl_link_get(cache, rtnl_link_get_link(peer)));
+        if (!veth)
+        {
+            continue;
+        }
+
+        VethPeerDetails details;
+        details.vethName = rtnl_link_get_name(veth);
+        details.peerName = peerName;
+        details.bridged = (rtnl_link_get_master(veth) > 0);
+
+        peers.emplace_back(std::move(details));
+    }
+
+    if (dumpCache != nullptr)
+    {
+        nl_cache_free(dumpCache);
+    }
+
+    AI_LOG_FN_EXIT();
+    return peers;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Moves an interface into the netns attached to the given pid and
+ *  renames it.
+ *
+ *  The move and the rename are a single request, so the new name only has to
+ *  be free in the target namespace.  If the interface has already been moved
+ *  by someone else the call fails.
+ *
+ *  @param[in]  ifaceName       The name of the interface to move.
+ *  @param[in]  newName         The name to give it in the namespace.
+ *  @param[in]  pid             The pid of a process in the namespace.
+ *
+ *  @return true on success, false on failure.
+ */
+bool Netlink::moveIfaceToNetns(const std::string& ifaceName,
+                               const std::string& newName, const pid_t pid)
+{
+    AI_LOG_FN_ENTRY();
+
+    if (newName.empty() || (newName.size() >= IFNAMSIZ))
+    {
+        AI_LOG_ERROR_EXIT("invalid interface name");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (mSocket == nullptr)
+    {
+        AI_LOG_ERROR_EXIT("invalid socket");
+        return false;
+    }
+
+    char nsPath[64];
+    snprintf(nsPath, sizeof(nsPath), "/proc/%d/ns/net", pid);
+
+    int nsFd = open(nsPath, O_RDONLY | O_CLOEXEC);
+    if (nsFd < 0)
+    {
+        AI_LOG_SYS_ERROR_EXIT(errno, "failed to open '%s'", nsPath);
+        return false;
+    }
+
+    // create an empty link object with just the name and namespace changed
+    NlLink changes;
+    if (!changes)
+    {
+        AI_LOG_ERROR_EXIT("failed to create changes object");
+        close(nsFd);
+        return false;
+    }
+
+    rtnl_link_set_name(changes, newName.c_str());
+    rtnl_link_set_ns_fd(changes, nsFd);
+
+    // apply the changes
+    bool success = applyChangesToLink(ifaceName, changes);
+
+    if (close(nsFd) != 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to close fd");
+    }
+
+    AI_LOG_FN_EXIT();
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Deletes an interface, for a veth this deletes both ends of the pair.
+ *
+ *  @param[in]  ifaceName       The name of the interface to delete.
+ *
+ *  @return true on success, false on failure.
+ */
+bool Netlink::deleteIface(const std::string& ifaceName)
+{
+    AI_LOG_FN_ENTRY();
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (mSocket == nullptr)
+    {
+        AI_LOG_ERROR_EXIT("invalid socket");
+        return false;
+    }
+
+    NlLink link(linkCache(), mSocket, ifaceName);
+    if (!link)
+    {
+        AI_LOG_ERROR_EXIT("failed to get link '%s'", ifaceName.c_str());
+        return false;
+    }
+
+    int ret = rtnl_link_delete(mSocket, link);
+    if (ret != 0)
+    {
+        AI_LOG_NL_ERROR_EXIT(ret, "failed to delete link '%s'", ifaceName.c_str());
+        return false;
+    }
+
+    AI_LOG_FN_EXIT();
+    return true;
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Creates a new bridge device
@@ -1760,7 +2317,7 @@ bool Netlink::addRoute(const std::string &iface, const in_addr_t destination,
     }
 
     // get the link we want to route to
-    NlLink link(mSocket, iface);
+    NlLink link(linkCache(), mSocket, iface);
     if (!link)
     {
         AI_LOG_ERROR_EXIT("failed to get link '%s'", iface.c_str());
@@ -1811,7 +2368,12 @@ bool Netlink::addRoute(const std::string &iface, const in_addr_t destination,
 
     // and finally add the route to the table
     AI_LOG_INFO("adding route '%s'", route.toString().c_str());
-    ret = rtnl_route_add(mSocket, route, 0);
+    struct nl_msg *msg = nullptr;
+    ret = rtnl_route_build_add_request(route, 0, &msg);
+    if (ret == 0)
+    {
+        ret = sendRequest(msg);
+    }
     if (ret == -NLE_EXIST)
     {
         // failing to add a route that already exists isn't harmful for
@@ -1869,7 +2431,7 @@ bool Netlink::addRoute(const std::string &iface, const struct in6_addr destinati
     }
 
     // get the link we want to route to
-    NlLink link(mSocket, iface);
+    NlLink link(linkCache(), mSocket, iface);
     if (!link)
     {
         AI_LOG_ERROR_EXIT("failed to get link '%s'", iface.c_str());
@@ -1934,7 +2496,12 @@ bool Netlink::addRoute(const std::string &iface, const struct in6_addr destinati
 
     // and finally add the route to the table
     AI_LOG_INFO("adding route '%s'", route.toString().c_str());
-    ret = rtnl_route_add(mSocket, route, 0);
+    struct nl_msg *msg = nullptr;
+    ret = rtnl_route_build_add_request(route, 0, &msg);
+    if (ret == 0)
+    {
+        ret = sendRequest(msg);
+    }
 
 
     if (ret == -NLE_EXIST)
@@ -2109,3 +2676,147 @@ bool Netlink::delArpEntry(const std::string &iface, const in_addr_t address)
     AI_LOG_FN_EXIT();
     return true;
 }
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Starts a batch of requests.
+ *
+ *  Until commitBatch() is called the address, route and link flag changes are
+ *  sent without waiting for the kernel to reply.  The links are read once
+ *  here and looked up from that snapshot while the batch is open, as asking
+ *  the kernel for them would mean reading the replies out of order.
+ *
+ *  Only requests that add addresses or routes, change link flags or read a
+ *  link's details can be made between beginBatch() and commitBatch().
+ *
+ *  @return true if the batch was started, otherwise false.
+ */
+bool Netlink::beginBatch()
+{
+    AI_LOG_FN_ENTRY();
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (mSocket == nullptr)
+    {
+        AI_LOG_ERROR_EXIT("invalid socket");
+        return false;
+    }
+
+    if (mBatching)
+    {
+        AI_LOG_ERROR_EXIT("batch already started");
+        return false;
+    }
+
+    // take a snapshot of the links for the lookups
+    int ret = rtnl_link_alloc_cache(mSocket, AF_UNSPEC, &mBatchLinkCache);
+    if (ret != 0)
+    {
+        AI_LOG_NL_ERROR_EXIT(ret, "failed to get the links");
+        mBatchLinkCache = nullptr;
+        return false;
+    }
+
+    mBatching = true;
+    mBatchPending = 0;
+
+    AI_LOG_FN_EXIT();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Waits for the replies to all the requests sent since beginBatch().
+ *
+ *  As with the requests made outside a batch, a reply saying an address or
+ *  route already exists isn't treated as an error.  All the replies are read
+ *  even if one of them reports an error.
+ *
+ *  @return true if all the requests succeeded, otherwise false.
+ */
+bool Netlink::commitBatch()
+{
+    AI_LOG_FN_ENTRY();
+
+    std::lock_guard<std::mutex> locker(mLock);
+
+    if (!mBatching)
+    {
+        AI_LOG_ERROR_EXIT("no batch started");
+        return false;
+    }
+
+    // the kernel replies in order, so libnl's sequence number checks still
+    // apply as each ack is read
+    bool success = true;
+    for (; mBatchPending > 0; mBatchPending--)
+    {
+        int ret = nl_wait_for_ack(mSocket);
+        if (ret == -NLE_EXIST)
+        {
+            AI_LOG_WARN("address or route already exists");
+        }
+        else if (ret != 0)
+        {
+            AI_LOG_NL_ERROR(ret, "batched netlink request failed");
+            success = false;
+        }
+    }
+
+    nl_cache_free(mBatchLinkCache);
+    mBatchLinkCache = nullptr;
+    mBatching = false;
+
+    AI_LOG_FN_EXIT();
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the cache to look up links in, or nullptr if they should be
+ *  requested from the kernel.
+ *
+ *  Must be called with the lock held.
+ */
+struct nl_cache* Netlink::linkCache() const
+{
+    if (mBatchLinkCache != nullptr)
+    {
+        return mBatchLinkCache;
+    }
+
+    if (mLinkCache != nullptr)
+    {
+        refreshLinkIndex();
+    }
+
+    return mLinkCache;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Sends a request and waits for the kernel to ack it, or if a batch
+ *  has been started just sends it.
+ *
+ *  Takes ownership of @a msg.  Must be called with the lock held.
+ *
+ *  @return 0 on success, otherwise a negative netlink error code.
+ */
+int Netlink::sendRequest(struct nl_msg* msg)
+{
+    if (!mBatching)
+    {
+        return nl_send_sync(mSocket, msg);
+    }
+
+    int ret = nl_send_auto(mSocket, msg);
+    nlmsg_free(msg);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    mBatchPending++;
+    return 0;
+}
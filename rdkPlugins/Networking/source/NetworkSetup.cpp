@@ -24,6 +24,7 @@
 #include "NetworkingHelper.h"
 #include "IPAllocator.h"
 #include "Netfilter.h"
+#include "VethPool.h"
 
 #include <Logging.h>
 
@@ -35,6 +36,8 @@
 #include <sys/wait.h>
 #include <dirent.h>
 
+#include <chrono>
+
 
 // -----------------------------------------------------------------------------
 /**
@@ -354,7 +357,7 @@ bool NetworkSetup::setupBridgeDevice(const std::shared_ptr<DobbyRdkPluginUtils>
 {
     AI_LOG_FN_ENTRY();
 
-    std::shared_ptr<Netlink> netlink = std::make_shared<Netlink>();
+    std::shared_ptr<Netlink> netlink = Netlink::shared();
     if (!netlink->isValid())
     {
         AI_LOG_ERROR_EXIT("failed to create netlink object");
@@ -572,6 +575,9 @@ bool saveContainerAddress(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
  *      - sets the default routes for both the lo and eth0 interfaces
  *      - brings both interfaces up
  *
+ *  All the changes are sent as one batch on a socket opened inside the
+ *  namespace, so the kernel's replies are only waited for once at the end.
+ *
  *  @param[in]  helper          Instance of NetworkingHelper.
  *
  *  @return true if successful, otherwise false
@@ -588,6 +594,12 @@ bool setupContainerNet(const std::shared_ptr<NetworkingHelper> &helper)
         return false;
     }
 
+    if (!netlink->beginBatch())
+    {
+        AI_LOG_ERROR_EXIT("failed to start netlink batch inside the container");
+        return false;
+    }
+
     // step 2 - set the address of the ifaceName interface inside the container
 
     // first add IPv4 address if enabled
@@ -685,6 +697,13 @@ bool setupContainerNet(const std::shared_ptr<NetworkingHelper> &helper)
     // may be used to update the ARP table on the bridge
     helper->storeContainerVethPeerMac(netlink->getIfaceMAC(PEER_NAME));
 
+    // step 6 - wait for the kernel to apply all the above
+    if (!netlink->commitBatch())
+    {
+        AI_LOG_ERROR_EXIT("failed to configure container interfaces");
+        return false;
+    }
+
     AI_LOG_FN_EXIT();
     return true;
 }
@@ -718,8 +737,10 @@ bool NetworkSetup::setupVeth(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
 {
     AI_LOG_FN_ENTRY();
 
-    // step 1 - create a new netlink object
-    std::shared_ptr<Netlink> netlink = std::make_shared<Netlink>();
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // step 1 - get the shared netlink object
+    std::shared_ptr<Netlink> netlink = Netlink::shared();
     if (!netlink->isValid())
     {
         AI_LOG_ERROR_EXIT("failed to create netlink object");
@@ -734,12 +755,18 @@ bool NetworkSetup::setupVeth(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
         return false;
     }
 
-    // step 3 - create a veth pair for the container, using the name of the
-    // first external interface defined in Dobby settings
+    // step 3 - take a veth pair for the container from the pool, or if there
+    // isn't one create a new pair, using the name of the first external
+    // interface defined in Dobby settings
     std::vector<std::string> takenVeths;
     utils->getTakenVeths(takenVeths);
 
-    std::string vethName = netlink->createVeth(PEER_NAME, containerPid, takenVeths);
+    std::string vethName = VethPool::take(netlink, containerPid, takenVeths);
+    const bool pooled = !vethName.empty();
+    if (!pooled)
+    {
+        vethName = netlink->createVeth(PEER_NAME, containerPid, takenVeths);
+    }
     if (vethName.empty())
     {
         AI_LOG_ERROR_EXIT("failed to create veth pair for container '%s'",
@@ -756,8 +783,8 @@ bool NetworkSetup::setupVeth(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
     }
 
     // step 5 - enable ip forwarding on the veth interface created outside
-    // the container
-    if (!netlink->setIfaceForwarding(vethName, true))
+    // the container, pooled veths already have it enabled
+    if (!pooled && !netlink->setIfaceForwarding(vethName, true))
     {
         AI_LOG_ERROR_EXIT("failed to enable IPv4 forwarding on %s for '%s'",
                           vethName.c_str(), containerId.c_str());
@@ -765,8 +792,8 @@ bool NetworkSetup::setupVeth(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
     }
 
     // step 6 - attach the veth iface on the outside of the container to the
-    // bridge interface
-    if (!netlink->addIfaceToBridge(BRIDGE_NAME, vethName))
+    // bridge interface, pooled veths are already attached
+    if (!pooled && !netlink->addIfaceToBridge(BRIDGE_NAME, vethName))
     {
         AI_LOG_ERROR_EXIT("failed to attach veth to bridge for container '%s'",
                           containerId.c_str());
@@ -828,8 +855,9 @@ bool NetworkSetup::setupVeth(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
     }
     */
 
-    // step 10 - bring the veth interface outside the container up
-    if (!netlink->ifaceUp(vethName))
+    // step 10 - bring the veth interface outside the container up, pooled
+    // veths are already up
+    if (!pooled && !netlink->ifaceUp(vethName))
     {
         AI_LOG_ERROR_EXIT("failed to bring up veth interface");
         return false;
@@ -865,7 +893,7 @@ bool NetworkSetup::setupVeth(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
             operation = Netfilter::Operation::Insert;
         }
 
-        if (!netfilter->addRules(ipv4RuleSet, AF_INET, operation))
+        if (!netfilter->addContainerRules(containerId, ipv4RuleSet, AF_INET, operation))
         {
             AI_LOG_ERROR_EXIT("failed to add iptables rule to drop veth packets");
             return false;
@@ -885,13 +913,17 @@ bool NetworkSetup::setupVeth(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
             operation = Netfilter::Operation::Insert;
         }
 
-        if (!netfilter->addRules(ipv6RuleSet, AF_INET6, operation))
+        if (!netfilter->addContainerRules(containerId, ipv6RuleSet, AF_INET6, operation))
         {
             AI_LOG_ERROR_EXIT("failed to add iptables rule to drop veth packets");
             return false;
         }
     }
 
+    const auto elapsed = std::chrono::steady_clock::now() - startTime;
+    AI_LOG_INFO("veth setup for container '%s' took %lldms", containerId.c_str(),
+                static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()));
+
     AI_LOG_FN_EXIT();
     return true;
 }
@@ -919,8 +951,8 @@ bool NetworkSetup::removeVethPair(const std::shared_ptr<Netfilter> &netfilter,
 
     bool success = true;
 
-    // create a new netlink object
-    std::shared_ptr<Netlink> netlink = std::make_shared<Netlink>();
+    // get the shared netlink object
+    std::shared_ptr<Netlink> netlink = Netlink::shared();
     if (!netlink->isValid())
     {
         AI_LOG_ERROR_EXIT("failed to create netlink object");
@@ -943,7 +975,7 @@ bool NetworkSetup::removeVethPair(const std::shared_ptr<Netfilter> &netfilter,
             ipv4RuleSet = createDropAllRule(vethName);
         }
 
-        if (!netfilter->addRules(ipv4RuleSet, AF_INET, Netfilter::Operation::Delete))
+        if (!netfilter->addContainerRules(containerId, ipv4RuleSet, AF_INET, Netfilter::Operation::Delete))
         {
             AI_LOG_ERROR("failed to delete netfilter rules for container veth");
             success = false;
@@ -963,7 +995,7 @@ bool NetworkSetup::removeVethPair(const std::shared_ptr<Netfilter> &netfilter,
             ipv6RuleSet = createDropAllRule(vethName);
         }
 
-        if (!netfilter->addRules(ipv6RuleSet, AF_INET6, Netfilter::Operation::Delete))
+        if (!netfilter->addContainerRules(containerId, ipv6RuleSet, AF_INET6, Netfilter::Operation::Delete))
         {
             AI_LOG_ERROR("failed to delete netfilter rules for container veth");
             success = false;
@@ -1036,8 +1068,8 @@ bool NetworkSetup::removeBridgeDevice(const std::shared_ptr<Netfilter> &netfilte
         }
     }
 
-    // create a new netlink object
-    std::shared_ptr<Netlink> netlink = std::make_shared<Netlink>();
+    // get the shared netlink object
+    std::shared_ptr<Netlink> netlink = Netlink::shared();
     if (!netlink->isValid())
     {
         AI_LOG_ERROR_EXIT("failed to create netlink object");
@@ -25,6 +25,8 @@
 #include "Netlink.h"
 #include "IPAllocator.h"
 #include "InterContainerRouting.h"
+#include "VethPool.h"
+#include "NetworkingSettings.h"
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -33,6 +35,7 @@
 #include <algorithm>
 
 REGISTER_RDK_PLUGIN(NetworkingPlugin);
+REGISTER_RDK_PLUGIN_NAME("Networking");
 
 NetworkingPlugin::NetworkingPlugin(std::shared_ptr<rt_dobby_schema> &cfg,
                                    const std::shared_ptr<DobbyRdkPluginUtils> &utils,
@@ -42,8 +45,7 @@ NetworkingPlugin::NetworkingPlugin(std::shared_ptr<rt_dobby_schema> &cfg,
       mContainerConfig(cfg),
       mUtils(utils),
       mRootfsPath(rootfsPath),
-      mPluginData(nullptr),
-      mNetfilter(std::make_shared<Netfilter>())
+      mPluginData(nullptr)
 {
     AI_LOG_FN_ENTRY();
 
@@ -99,6 +101,7 @@ unsigned NetworkingPlugin::hookHints() const
     return (
         IDobbyRdkPlugin::HintFlags::PostInstallationFlag |
         IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag |
+        IDobbyRdkPlugin::HintFlags::PostStartFlag |
         IDobbyRdkPlugin::HintFlags::PostStopFlag |
         IDobbyRdkPlugin::HintFlags::PostHaltFlag
     );
@@ -158,6 +161,9 @@ bool NetworkingPlugin::createRuntime()
         return true;
     }
 
+    // the rules are applied once all the plugins have run the hook
+    const std::shared_ptr<Netfilter> netfilter = Netfilter::hookTransaction(mUtils);
+
     // get available external interfaces
     const std::vector<std::string> extIfaces = GetAvailableExternalInterfaces();
     if (extIfaces.empty())
@@ -167,7 +173,7 @@ bool NetworkingPlugin::createRuntime()
     }
 
     // check if another container has already initialised the bridge device for us
-    std::shared_ptr<Netlink> netlink = std::make_shared<Netlink>();
+    std::shared_ptr<Netlink> netlink = Netlink::shared();
     bool bridgeExists = netlink->ifaceExists(std::string(BRIDGE_NAME));
 
     if (!bridgeExists)
@@ -175,7 +181,7 @@ bool NetworkingPlugin::createRuntime()
         AI_LOG_DEBUG("Dobby network bridge not found, setting it up");
 
         // setup the bridge device
-        if (!NetworkSetup::setupBridgeDevice(mUtils, mNetfilter, extIfaces))
+        if (!NetworkSetup::setupBridgeDevice(mUtils, netfilter, extIfaces))
         {
             AI_LOG_ERROR_EXIT("failed to setup Dobby bridge device");
             return false;
@@ -183,7 +189,7 @@ bool NetworkingPlugin::createRuntime()
     }
 
     // setup veth, ip address and iptables rules for container
-    if (!NetworkSetup::setupVeth(mUtils, mNetfilter, mHelper, mRootfsPath, mUtils->getContainerId(), mNetworkType))
+    if (!NetworkSetup::setupVeth(mUtils, netfilter, mHelper, mRootfsPath, mUtils->getContainerId(), mNetworkType))
     {
         AI_LOG_ERROR_EXIT("failed to setup virtual ethernet device");
         return false;
@@ -192,7 +198,7 @@ bool NetworkingPlugin::createRuntime()
     // setup dnsmasq rules if enabled
     if (mNetworkType != NetworkType::None && mPluginData->dnsmasq)
     {
-        if (!DnsmasqSetup::set(mUtils, mNetfilter, mHelper, mRootfsPath,
+        if (!DnsmasqSetup::set(mUtils, netfilter, mHelper, mRootfsPath,
                                mUtils->getContainerId(), mNetworkType))
         {
             AI_LOG_ERROR_EXIT("failed to setup container for dnsmasq use");
@@ -203,7 +209,7 @@ bool NetworkingPlugin::createRuntime()
     // add port forwards if any have been configured
     if (mPluginData->port_forwarding != nullptr)
     {
-        if (!PortForwarding::addPortForwards(mNetfilter, mHelper, mUtils->getContainerId(), mPluginData->port_forwarding))
+        if (!PortForwarding::addPortForwards(netfilter, mHelper, mUtils->getContainerId(), mPluginData->port_forwarding))
         {
             AI_LOG_ERROR_EXIT("failed to add port forwards");
             return false;
@@ -220,9 +226,9 @@ bool NetworkingPlugin::createRuntime()
               std::string containerIp = mHelper->ipv4AddrStr();
 
               // Ensure Netfilter instance exists
-              if (!mNetfilter)
+              if (!netfilter)
               {
-                  AI_LOG_ERROR("mNetfilter is null, cannot add NAT rules");
+                  AI_LOG_ERROR("netfilter is null, cannot add NAT rules");
                   return false;
               }
 
@@ -260,8 +266,8 @@ bool NetworkingPlugin::createRuntime()
               // Add NAT rules list to RuleSet under Nat table
               ruleSet[Netfilter::TableType::Nat] = std::move(natRules);
 
-              // Apply rules using addRules
-              if (mNetfilter->addRules(ruleSet, AF_INET, Netfilter::Operation::Append))
+              // Apply rules using addContainerRules
+              if (netfilter->addContainerRules(mUtils->getContainerId(), ruleSet, AF_INET, Netfilter::Operation::Append))
               {
                   AI_LOG_INFO("Container-to-host NAT rules added successfully");
               }
@@ -287,7 +293,7 @@ bool NetworkingPlugin::createRuntime()
     // enable multicast forwarding
     if (mPluginData->multicast_forwarding != nullptr)
     {
-        if (!MulticastForwarder::set(mNetfilter, mPluginData, mHelper->vethName(), mUtils->getContainerId(), extIfaces))
+        if (!MulticastForwarder::set(netfilter, mPluginData, mHelper->vethName(), mUtils->getContainerId(), extIfaces))
         {
             AI_LOG_ERROR_EXIT("failed to add multicast forwards");
             return false;
@@ -297,7 +303,7 @@ bool NetworkingPlugin::createRuntime()
     // enable inter-container communication
     if ((mPluginData->inter_container != nullptr) && (mPluginData->inter_container_len > 0))
     {
-        if (!InterContainerRouting::addRules(mNetfilter, mHelper, mUtils,
+        if (!InterContainerRouting::addRules(netfilter, mHelper, mUtils,
                                              mPluginData->inter_container,
                                              mPluginData->inter_container_len))
         {
@@ -306,11 +312,31 @@ bool NetworkingPlugin::createRuntime()
         }
     }
 
-    // apply iptables changes
-    if (!mNetfilter->applyRules(AF_INET) || !mNetfilter->applyRules(AF_INET6))
+    AI_LOG_FN_EXIT();
+    return true;
+}
+
+/**
+ * @brief OCI Hook - Run in host namespace once the container has started
+ *
+ * Refills the veth pool if enabled, the container is already running so this
+ * isn't holding up its start.
+ */
+bool NetworkingPlugin::postStart()
+{
+    AI_LOG_FN_ENTRY();
+
+    if (!mValid || (mNetworkType == NetworkType::Open) || (VethPool::size() == 0))
+    {
+        AI_LOG_FN_EXIT();
+        return true;
+    }
+
+    // failing to refill the pool only means the next container creates its
+    // own veth pair, so isn't a hook failure
+    if (!VethPool::refill(mUtils, Netlink::shared()))
     {
-        AI_LOG_ERROR_EXIT("failed to apply iptables rules");
-        return false;
+        AI_LOG_WARN("failed to refill the veth pool");
     }
 
     AI_LOG_FN_EXIT();
@@ -364,6 +390,9 @@ bool NetworkingPlugin::postHalt()
         return true;
     }
 
+    // the rules are applied once all the plugins have run the hook
+    const std::shared_ptr<Netfilter> netfilter = Netfilter::hookTransaction(mUtils);
+
     // Get container veth/ip
     ContainerNetworkInfo networkInfo;
     IPAllocator ipAllocator(mUtils);
@@ -378,7 +407,7 @@ bool NetworkingPlugin::postHalt()
         mHelper->storeContainerInterface(networkInfo.ipAddressRaw, networkInfo.vethName);
 
         // delete the veth pair for the container
-        if (!NetworkSetup::removeVethPair(mNetfilter, mHelper, networkInfo.vethName, mNetworkType, mUtils->getContainerId()))
+        if (!NetworkSetup::removeVethPair(netfilter, mHelper, networkInfo.vethName, mNetworkType, mUtils->getContainerId()))
         {
             AI_LOG_WARN("failed to remove veth pair %s", networkInfo.vethName.c_str());
             success = false;
@@ -399,13 +428,24 @@ bool NetworkingPlugin::postHalt()
     else
     {
         // if there are no containers using the bridge device left, remove bridge device
-        std::shared_ptr<Netlink> netlink = std::make_shared<Netlink>();
+        std::shared_ptr<Netlink> netlink = Netlink::shared();
         auto bridgeConnections = netlink->getAttachedIfaces(BRIDGE_NAME);
 
-        // Ignore the tap0 device as that may or may not be present, doesn't matter for this check
-        if (bridgeConnections.size() == 0 || (bridgeConnections.size() == 1 && strcmp(bridgeConnections.front().name, "dobby_tap0") == 0))
+        // Ignore the tap0 device as that may or may not be present, doesn't matter for this check,
+        // and the pooled veths as they aren't used by a container
+        const std::set<std::string> pooledVeths = VethPool::vethNames(netlink);
+        bridgeConnections.remove_if([&pooledVeths](const Netlink::BridgePortDetails &port)
+                                    { return (strcmp(port.name, "dobby_tap0") == 0) ||
+                                             (pooledVeths.count(port.name) > 0); });
+
+        if (bridgeConnections.empty())
         {
-            if (!NetworkSetup::removeBridgeDevice(mNetfilter, extIfaces))
+            if (!pooledVeths.empty() && !VethPool::drain(netlink))
+            {
+                success = false;
+            }
+
+            if (!NetworkSetup::removeBridgeDevice(netfilter, extIfaces))
             {
                 success = false;
             }
@@ -415,7 +455,7 @@ bool NetworkingPlugin::postHalt()
     // if dnsmasq iptables rules were set up for container, "uninstall" them
     if (mNetworkType != NetworkType::None && mPluginData->dnsmasq)
     {
-        if (!DnsmasqSetup::removeRules(mNetfilter, mHelper, mUtils->getContainerId()))
+        if (!DnsmasqSetup::removeRules(netfilter, mHelper, mUtils->getContainerId()))
         {
             success = false;
         }
@@ -426,7 +466,7 @@ bool NetworkingPlugin::postHalt()
     // applied inside the container namespace
     if (mPluginData->port_forwarding != nullptr)
     {
-        if (!PortForwarding::removePortForwards(mNetfilter, mHelper, mUtils->getContainerId(), mPluginData->port_forwarding))
+        if (!PortForwarding::removePortForwards(netfilter, mHelper, mUtils->getContainerId(), mPluginData->port_forwarding))
         {
             success = false;
         }
@@ -478,7 +518,7 @@ bool NetworkingPlugin::postHalt()
 
             ruleSet[Netfilter::TableType::Nat] = std::move(natRules);
 
-            if (mNetfilter->addRules(ruleSet, AF_INET, Netfilter::Operation::Delete))
+            if (netfilter->addContainerRules(mUtils->getContainerId(), ruleSet, AF_INET, Netfilter::Operation::Delete))
             {
                 AI_LOG_INFO("Successfully removed container-to-host NAT rules");
             }
@@ -493,7 +533,7 @@ bool NetworkingPlugin::postHalt()
     // remove multicast forwarding rules if configured
     if (mPluginData->multicast_forwarding != nullptr)
     {
-        if (!MulticastForwarder::removeRules(mNetfilter, mPluginData, mHelper->vethName(), mUtils->getContainerId(), extIfaces))
+        if (!MulticastForwarder::removeRules(netfilter, mPluginData, mHelper->vethName(), mUtils->getContainerId(), extIfaces))
         {
             AI_LOG_ERROR_EXIT("failed to remove multicast forwards");
             return false;
@@ -503,7 +543,7 @@ bool NetworkingPlugin::postHalt()
     // remove inter-container communication rules if configured
     if ((mPluginData->inter_container != nullptr) && (mPluginData->inter_container_len > 0))
     {
-        if (!InterContainerRouting::removeRules(mNetfilter, mHelper, mUtils,
+        if (!InterContainerRouting::removeRules(netfilter, mHelper, mUtils,
                                                 mPluginData->inter_container,
                                                 mPluginData->inter_container_len))
         {
@@ -512,13 +552,6 @@ bool NetworkingPlugin::postHalt()
         }
     }
 
-    // apply iptables changes
-    if (!mNetfilter->applyRules(AF_INET) || !mNetfilter->applyRules(AF_INET6))
-    {
-        AI_LOG_ERROR_EXIT("failed to apply iptables rules");
-        return false;
-    }
-
     AI_LOG_FN_EXIT();
     return success;
 }
@@ -619,44 +652,12 @@ std::vector<std::string> NetworkingPlugin::GetAvailableExternalInterfaces() cons
  */
 std::vector<std::string> NetworkingPlugin::GetExternalInterfacesFromSettings() const
 {
-    // We don't have jsoncpp here, so use yajl from libocispec
-    std::vector<std::string> ifacesFromSettings = {};
-
-    std::string settingsFile = mUtils->readTextFile("/etc/dobby.json");
-
-    if (settingsFile.empty())
-    {
-        AI_LOG_ERROR("Could not read settings file @ '/etc/dobby.json'");
-        return {};
-    }
-
-    yajl_val tree;
-    char errbuf[1024];
-
-    // Parse the settings file
-    tree = yajl_tree_parse (settingsFile.c_str(), errbuf, sizeof (errbuf));
-    if (!tree || strlen(errbuf) > 0)
+    const NetworkingSettings settings;
+    if (!settings.isValid())
     {
-        yajl_tree_free(tree);
-        AI_LOG_ERROR_EXIT("Failed to parse Dobby settings file, err '%s'", errbuf);
+        AI_LOG_ERROR("Could not read settings file @ '%s'", DOBBY_SETTINGS_PATH);
         return {};
     }
 
-    // Read the external interfaces array
-    const char* path[] = {"network", "externalInterfaces", (const char *) 0};
-    yajl_val extInterfaces = yajl_tree_get(tree, path, yajl_t_array);
-    if (extInterfaces && YAJL_GET_ARRAY (extInterfaces) && YAJL_GET_ARRAY (extInterfaces)->len > 0)
-    {
-        size_t i;
-        size_t len = YAJL_GET_ARRAY (extInterfaces)->len;
-        yajl_val *values = YAJL_GET_ARRAY (extInterfaces)->values;
-
-        for (i = 0; i < len; i++)
-        {
-            ifacesFromSettings.push_back(YAJL_GET_STRING(values[i]));
-        }
-    }
-
-    yajl_tree_free(tree);
-    return ifacesFromSettings;
+    return settings.getStringArray("externalInterfaces");
 }
@@ -0,0 +1,175 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   NetworkingSettings.cpp
+ *
+ */
+#include "NetworkingSettings.h"
+
+#if defined (DOBBY_BUILD)
+    #include <Logging.h>
+#else
+    #include <Dobby/Logging.h>
+#endif
+
+#include <fstream>
+#include <iterator>
+#include <cstring>
+
+#include <yajl/yajl_tree.h>
+
+
+NetworkingSettings::NetworkingSettings(const std::string &settingsPath)
+    : mTree(nullptr)
+{
+    std::ifstream file(settingsPath);
+    if (!file)
+    {
+        AI_LOG_DEBUG("no settings file @ '%s'", settingsPath.c_str());
+        return;
+    }
+
+    const std::string settings((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+
+    char errbuf[1024] = { '\0' };
+    yajl_val tree = yajl_tree_parse(settings.c_str(), errbuf, sizeof(errbuf));
+    if (!tree || strlen(errbuf) > 0)
+    {
+        yajl_tree_free(tree);
+        AI_LOG_ERROR("failed to parse settings file '%s', err '%s'",
+                     settingsPath.c_str(), errbuf);
+        return;
+    }
+
+    mTree = tree;
+}
+
+NetworkingSettings::~NetworkingSettings()
+{
+    if (mTree)
+    {
+        yajl_tree_free(mTree);
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns true if the settings file was read and parsed.
+ */
+bool NetworkingSettings::isValid() const
+{
+    return (mTree != nullptr);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the value of "network.<key>" if it's of the given type.
+ *
+ *  @return the value, nullptr if not set or of a different type.
+ */
+yajl_val NetworkingSettings::get(const char *key, int type) const
+{
+    if (!mTree)
+    {
+        return nullptr;
+    }
+
+    const char *path[] = { "network", key, (const char *) 0 };
+    return yajl_tree_get(mTree, path, static_cast<yajl_type>(type));
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the "network.<key>" string.
+ *
+ *  @param[in]  key             The name of the setting.
+ *  @param[in]  defaultValue    Returned if the setting isn't a string.
+ *
+ *  @return the value of the setting.
+ */
+std::string NetworkingSettings::getString(const char *key,
+                                          const std::string &defaultValue) const
+{
+    yajl_val value = get(key, yajl_t_string);
+    if (!value || !YAJL_GET_STRING(value))
+    {
+        return defaultValue;
+    }
+
+    return YAJL_GET_STRING(value);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the "network.<key>" integer.
+ *
+ *  @param[in]  key             The name of the setting.
+ *  @param[out] value           Set to the value of the setting.
+ *
+ *  @return false if the setting isn't an integer, @a value is left as is.
+ */
+bool NetworkingSettings::getInteger(const char *key, long long *value) const
+{
+    yajl_val number = get(key, yajl_t_number);
+    if (!number || !YAJL_IS_INTEGER(number))
+    {
+        return false;
+    }
+
+    *value = YAJL_GET_INTEGER(number);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the strings in the "network.<key>" array, any elements that
+ *  aren't strings are skipped.
+ *
+ *  @param[in]  key             The name of the setting.
+ *
+ *  @return the strings, empty if the setting isn't an array.
+ */
+std::vector<std::string> NetworkingSettings::getStringArray(const char *key) const
+{
+    std::vector<std::string> strings;
+
+    yajl_val array = get(key, yajl_t_array);
+    if (!array || !YAJL_GET_ARRAY(array))
+    {
+        return strings;
+    }
+
+    const size_t len = YAJL_GET_ARRAY(array)->len;
+    const yajl_val *values = YAJL_GET_ARRAY(array)->values;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (YAJL_IS_STRING(values[i]) && YAJL_GET_STRING(values[i]))
+        {
+            strings.emplace_back(YAJL_GET_STRING(values[i]));
+        }
+        else
+        {
+            AI_LOG_WARN("ignoring non-string element of network.%s", key);
+        }
+    }
+
+    return strings;
+}
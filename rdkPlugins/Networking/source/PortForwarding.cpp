@@ -24,12 +24,173 @@
 #include <fcntl.h>
 
 
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Adds or deletes the ipset entries for the container's ports, along
+ *  with the rules shared by all containers that match against the sets.
+ *
+ *  The shared rules are added every time, the duplicates are dropped when
+ *  the rules are applied, and are left in place when a container stops.  The
+ *  host to container DNAT rules can't be shared as their destination is the
+ *  container, so those are still added for each port.
+ *
+ *  @param[in]  netfilter           Instance of Netfilter class.
+ *  @param[in]  helper              Instance of NetworkingHelper.
+ *  @param[in]  containerId         Container identifier.
+ *  @param[in]  portForwards        structs containing ports to forward.
+ *  @param[in]  ipVersion           IPv family version (AF_INET/AF_INET6).
+ *  @param[in]  operation           Insert to add the entries, Delete to
+ *                                  remove them.
+ *
+ *  @return true on success, otherwise false.
+ */
+static bool updatePortForwardSets(const std::shared_ptr<Netfilter> &netfilter,
+                                  const std::shared_ptr<NetworkingHelper> &helper,
+                                  const std::string &containerId,
+                                  const PortForwards &portForwards,
+                                  const int ipVersion,
+                                  Netfilter::Operation operation)
+{
+    std::string containerAddress;
+    std::string bridgeAddress;
+    std::string localhostAddress;
+    std::string localhostMask;
+    if (ipVersion == AF_INET)
+    {
+        containerAddress = helper->ipv4AddrStr();
+        bridgeAddress = BRIDGE_ADDRESS "/32";
+        localhostAddress = LOCALHOST;
+        localhostMask = "/32";
+    }
+    else if (ipVersion == AF_INET6)
+    {
+        containerAddress = helper->ipv6AddrStr();
+        bridgeAddress = BRIDGE_ADDRESS_IPV6 "/128";
+        localhostAddress = LOCALHOST_IPV6;
+        localhostMask = "/128";
+    }
+    else
+    {
+        AI_LOG_ERROR("supported ip address families are AF_INET or AF_INET6");
+        return false;
+    }
+
+    const std::string hostToContainerSet = Netfilter::setName(HOST_TO_CONTAINER_SET, ipVersion);
+    const std::string containerToHostSet = Netfilter::setName(CONTAINER_TO_HOST_SET, ipVersion);
+    const std::string vethSet = Netfilter::setName(CONTAINER_VETH_SET, ipVersion);
+
+    char ruleBuf[256];
+    Netfilter::RuleSet sharedRules;
+    Netfilter::RuleSet dnatRules;
+
+    if (!portForwards.hostToContainer.empty())
+    {
+        std::list<std::string> entries;
+        for (const PortForward &portForward : portForwards.hostToContainer)
+        {
+            entries.emplace_back(containerAddress + "," + portForward.protocol + ":" + portForward.port);
+
+            dnatRules[Netfilter::TableType::Nat].emplace_back(
+                createPreroutingRule(portForward, containerId, containerAddress, ipVersion));
+        }
+
+        if (!netfilter->addSetEntries(hostToContainerSet, "hash:ip,port", entries,
+                                      ipVersion, operation))
+        {
+            return false;
+        }
+
+        // accept the forwarded packets once they've been DNAT'ed
+        snprintf(ruleBuf, sizeof(ruleBuf),
+                 "FORWARD "
+                 "! -i " BRIDGE_NAME " "
+                 "-o " BRIDGE_NAME " "
+                 "-m set --match-set %s dst,dst "
+                 "-j ACCEPT",
+                 hostToContainerSet.c_str());
+        sharedRules[Netfilter::TableType::Filter].emplace_back(ruleBuf);
+    }
+
+    if (!portForwards.containerToHost.empty())
+    {
+        std::list<std::string> entries;
+        for (const PortForward &portForward : portForwards.containerToHost)
+        {
+            entries.emplace_back(containerAddress + "," + portForward.protocol + ":" + portForward.port);
+        }
+
+        const std::list<std::string> vethEntries =
+        {
+            containerAddress + ",physdev:" + helper->vethName()
+        };
+
+        if (!netfilter->addSetEntries(containerToHostSet, "hash:ip,port", entries,
+                                      ipVersion, operation) ||
+            !netfilter->addSetEntries(vethSet, "hash:net,iface", vethEntries,
+                                      ipVersion, operation))
+        {
+            return false;
+        }
+
+        // send packets for the ports to localhost, leaving the port unchanged
+        snprintf(ruleBuf, sizeof(ruleBuf),
+                 "PREROUTING "
+                 "-d %s "                                   // bridge address
+                 "-i " BRIDGE_NAME " "
+                 "-m set --match-set %s src,dst "           // container address,port
+                 "-j DNAT --to-destination %s",             // localhost address
+                 bridgeAddress.c_str(),
+                 containerToHostSet.c_str(),
+                 localhostAddress.c_str());
+        sharedRules[Netfilter::TableType::Nat].emplace_back(ruleBuf);
+
+        // and accept them if they came from the container's own veth
+        snprintf(ruleBuf, sizeof(ruleBuf),
+                 "DobbyInputChain "
+                 "-d %s%s "                                 // localhost address
+                 "-i " BRIDGE_NAME " "
+                 "-m set --match-set %s src,dst "           // container address,port
+                 "-m set --match-set %s src,src "           // container address,veth
+                 "-j ACCEPT",
+                 localhostAddress.c_str(), localhostMask.c_str(),
+                 containerToHostSet.c_str(),
+                 vethSet.c_str());
+        sharedRules[Netfilter::TableType::Filter].emplace_back(ruleBuf);
+    }
+
+    // the shared rules are left for the other containers
+    if ((operation != Netfilter::Operation::Delete) && !sharedRules.empty())
+    {
+        if (!netfilter->addRules(sharedRules, ipVersion, Netfilter::Operation::Insert))
+        {
+            return false;
+        }
+    }
+
+    if (!dnatRules.empty())
+    {
+        const Netfilter::Operation dnatOperation = (operation == Netfilter::Operation::Delete) ?
+                                                   Netfilter::Operation::Delete :
+                                                   Netfilter::Operation::Append;
+        if (!netfilter->addContainerRules(containerId, dnatRules, ipVersion, dnatOperation))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Adds the two iptables firewall rules to enable port forwarding.
  *
  *  The 'protocol' field can be omitted in which case TCP will be specified.
  *
+ *  If ipset is installed the ports are added to sets that a fixed number of
+ *  rules match against, so the rules don't grow with the number of
+ *  containers, @see updatePortForwardSets().
+ *
  *  @param[in]  netfilter           Instance of Netfilter class.
  *  @param[in]  helper              Instance of NetworkingHelper.
  *  @param[in]  containerId         Container identifier.
@@ -53,6 +214,23 @@ bool PortForwarding::addPortForwards(const std::shared_ptr<Netfilter> &netfilter
         return false;
     }
 
+    if (Netfilter::setsAvailable())
+    {
+        if ((helper->ipv4() &&
+             !updatePortForwardSets(netfilter, helper, containerId, portForwards,
+                                    AF_INET, Netfilter::Operation::Insert)) ||
+            (helper->ipv6() &&
+             !updatePortForwardSets(netfilter, helper, containerId, portForwards,
+                                    AF_INET6, Netfilter::Operation::Insert)))
+        {
+            AI_LOG_ERROR_EXIT("failed to add port forward set entries");
+            return false;
+        }
+
+        AI_LOG_FN_EXIT();
+        return true;
+    }
+
     // add IPv4 rules to iptables if needed
     if (helper->ipv4())
     {
@@ -67,7 +245,7 @@ bool PortForwarding::addPortForwards(const std::shared_ptr<Netfilter> &netfilter
         }
 
         // insert vector index 0 of constructed rules
-        if (!netfilter->addRules(ipv4Rules[0], AF_INET, Netfilter::Operation::Insert))
+        if (!netfilter->addContainerRules(containerId, ipv4Rules[0], AF_INET, Netfilter::Operation::Insert))
         {
             AI_LOG_ERROR_EXIT("failed to insert port forward rules to iptables");
             return false;
@@ -76,7 +254,7 @@ bool PortForwarding::addPortForwards(const std::shared_ptr<Netfilter> &netfilter
         // append potential rules from vector index 1 of constructed rules
         if (ipv4Rules.size() > 1)
         {
-            if (!netfilter->addRules(ipv4Rules[1], AF_INET, Netfilter::Operation::Append))
+            if (!netfilter->addContainerRules(containerId, ipv4Rules[1], AF_INET, Netfilter::Operation::Append))
             {
                 AI_LOG_ERROR_EXIT("failed to append port forward rules to iptables");
                 return false;
@@ -98,7 +276,7 @@ bool PortForwarding::addPortForwards(const std::shared_ptr<Netfilter> &netfilter
         }
 
         // insert vector index 0 of constructed rules
-        if (!netfilter->addRules(ipv6Rules[0], AF_INET6, Netfilter::Operation::Insert))
+        if (!netfilter->addContainerRules(containerId, ipv6Rules[0], AF_INET6, Netfilter::Operation::Insert))
         {
             AI_LOG_ERROR_EXIT("failed to insert port forward rules to ip6tables");
             return false;
@@ -107,7 +285,7 @@ bool PortForwarding::addPortForwards(const std::shared_ptr<Netfilter> &netfilter
         // append potential rules from vector index 1 of constructed rules
         if (ipv6Rules.size() > 1)
         {
-            if (!netfilter->addRules(ipv6Rules[1], AF_INET6, Netfilter::Operation::Append))
+            if (!netfilter->addContainerRules(containerId, ipv6Rules[1], AF_INET6, Netfilter::Operation::Append))
             {
                 AI_LOG_ERROR_EXIT("failed to append port forward rules to ip6tables");
                 return false;
@@ -147,6 +325,23 @@ bool PortForwarding::removePortForwards(const std::shared_ptr<Netfilter> &netfil
         return false;
     }
 
+    if (Netfilter::setsAvailable())
+    {
+        if ((helper->ipv4() &&
+             !updatePortForwardSets(netfilter, helper, containerId, portForwards,
+                                    AF_INET, Netfilter::Operation::Delete)) ||
+            (helper->ipv6() &&
+             !updatePortForwardSets(netfilter, helper, containerId, portForwards,
+                                    AF_INET6, Netfilter::Operation::Delete)))
+        {
+            AI_LOG_ERROR_EXIT("failed to delete port forward set entries");
+            return false;
+        }
+
+        AI_LOG_FN_EXIT();
+        return true;
+    }
+
     // delete IPv4 rules from ip6tables if needed
     if (helper->ipv4())
     {
@@ -163,7 +358,7 @@ bool PortForwarding::removePortForwards(const std::shared_ptr<Netfilter> &netfil
         // delete constructed rulesets
         for (size_t i = 0; i < ipv4Rules.size(); i++)
         {
-            if (!netfilter->addRules(ipv4Rules[i], AF_INET, Netfilter::Operation::Delete))
+            if (!netfilter->addContainerRules(containerId, ipv4Rules[i], AF_INET, Netfilter::Operation::Delete))
             {
                 AI_LOG_ERROR_EXIT("failed to delete port forwarding ip6tables rule"
                                   "at index %zu", i);
@@ -189,7 +384,7 @@ bool PortForwarding::removePortForwards(const std::shared_ptr<Netfilter> &netfil
         // delete constructed rulesets
         for (size_t i = 0; i < ipv6Rules.size(); i++)
         {
-            if (!netfilter->addRules(ipv6Rules[i], AF_INET6, Netfilter::Operation::Delete))
+            if (!netfilter->addContainerRules(containerId, ipv6Rules[i], AF_INET6, Netfilter::Operation::Delete))
             {
                 AI_LOG_ERROR_EXIT("failed to delete port forwarding ip6tables rule"
                                   "at index %zu", i);
@@ -0,0 +1,316 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   VethPool.cpp
+ *
+ */
+
+#include "VethPool.h"
+#include "NetworkingPluginCommon.h"
+#include "NetworkingSettings.h"
+
+#include <Logging.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include <algorithm>
+
+// serialises the refills and the drain of the pool between the hook processes
+// Can override the path at build time by setting -DVETH_POOL_LOCK_PATH=/path/to/file
+#ifndef VETH_POOL_LOCK_PATH
+    #define VETH_POOL_LOCK_PATH     "/tmp/dobby/plugin/networking.vethpool.lock"
+#endif
+
+// more than this is unlikely to be useful and just holds on to veth names
+#define VETH_POOL_MAX_SIZE      16
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads the "network.vethPoolSize" value from the settings file.
+ *
+ *  @return the pool size, 0 if not set or not valid.
+ */
+static unsigned readPoolSizeSetting()
+{
+    const NetworkingSettings settings;
+
+    long long size = 0;
+    if (!settings.getInteger("vethPoolSize", &size))
+    {
+        return 0;
+    }
+
+    if ((size < 0) || (size > VETH_POOL_MAX_SIZE))
+    {
+        AI_LOG_WARN("invalid veth pool size %lld, must be 0 to %d",
+                    size, VETH_POOL_MAX_SIZE);
+        return 0;
+    }
+
+    return static_cast<unsigned>(size);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Takes the lock used to serialise changes to the pool.
+ *
+ *  @return the fd holding the lock, or -1 on failure.
+ */
+static int lockPool()
+{
+    int fd = open(VETH_POOL_LOCK_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to open '%s'", VETH_POOL_LOCK_PATH);
+        return -1;
+    }
+
+    while (flock(fd, LOCK_EX) != 0)
+    {
+        if (errno != EINTR)
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to lock '%s'", VETH_POOL_LOCK_PATH);
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Releases the lock taken by lockPool().
+ */
+static void unlockPool(int fd)
+{
+    // closing the fd drops the lock
+    if (close(fd) != 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to close '%s'", VETH_POOL_LOCK_PATH);
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the configured size of the pool, the settings file is only
+ *  read the first time.
+ *
+ *  @return the pool size, 0 if the pool is disabled.
+ */
+unsigned VethPool::size()
+{
+    static const unsigned poolSize = readPoolSizeSetting();
+    return poolSize;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Takes a pair from the pool for the container.
+ *
+ *  The waiting end of the pair is moved into the container's network
+ *  namespace and renamed to PEER_NAME, the other end is already attached to
+ *  the bridge and up.
+ *
+ *  @param[in]  netlink         Instance of the Netlink class.
+ *  @param[in]  containerPid    The pid of the container's init process.
+ *  @param[in]  takenVeths      Veth devices reserved by other containers.
+ *
+ *  @return the name of the host end of the pair, or an empty string if the
+ *  pool is disabled or empty.
+ */
+std::string VethPool::take(const std::shared_ptr<Netlink> &netlink,
+                           const pid_t containerPid,
+                           const std::vector<std::string> &takenVeths)
+{
+    AI_LOG_FN_ENTRY();
+
+    if (size() == 0)
+    {
+        AI_LOG_FN_EXIT();
+        return std::string();
+    }
+
+    for (const Netlink::VethPeerDetails &pair : netlink->getVethPeers(VETH_POOL_PEER_PREFIX))
+    {
+        if (!pair.bridged ||
+            (std::find(takenVeths.begin(), takenVeths.end(), pair.vethName) != takenVeths.end()))
+        {
+            continue;
+        }
+
+        // fails if another container has just taken the same pair
+        if (netlink->moveIfaceToNetns(pair.peerName, PEER_NAME, containerPid))
+        {
+            AI_LOG_INFO("took veth pair ('%s' <-> '%s') from the pool",
+                        pair.vethName.c_str(), pair.peerName.c_str());
+
+            AI_LOG_FN_EXIT();
+            return pair.vethName;
+        }
+    }
+
+    AI_LOG_INFO("veth pool is empty");
+
+    AI_LOG_FN_EXIT();
+    return std::string();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Creates pairs until the pool is at the configured size.
+ *
+ *  Pairs that aren't attached to the bridge were left by a refill that didn't
+ *  finish, so are deleted first.
+ *
+ *  @param[in]  utils       Instance of DobbyRdkPluginUtils.
+ *  @param[in]  netlink     Instance of the Netlink class.
+ *
+ *  @return true if the pool is full, otherwise false.
+ */
+bool VethPool::refill(const std::shared_ptr<DobbyRdkPluginUtils> &utils,
+                      const std::shared_ptr<Netlink> &netlink)
+{
+    AI_LOG_FN_ENTRY();
+
+    const unsigned poolSize = size();
+    if (poolSize == 0)
+    {
+        AI_LOG_FN_EXIT();
+        return true;
+    }
+
+    int lockFd = lockPool();
+    if (lockFd < 0)
+    {
+        AI_LOG_FN_EXIT();
+        return false;
+    }
+
+    unsigned pooled = 0;
+    for (const Netlink::VethPeerDetails &pair : netlink->getVethPeers(VETH_POOL_PEER_PREFIX))
+    {
+        if (pair.bridged)
+        {
+            pooled++;
+        }
+        else
+        {
+            AI_LOG_WARN("deleting incomplete pooled veth pair ('%s' <-> '%s')",
+                        pair.vethName.c_str(), pair.peerName.c_str());
+            netlink->deleteIface(pair.peerName);
+        }
+    }
+
+    bool success = true;
+    while (success && (pooled < poolSize))
+    {
+        std::vector<std::string> takenVeths;
+        utils->getTakenVeths(takenVeths);
+
+        // leave the kernel to number the waiting end
+        const std::string vethName =
+            netlink->createVeth(VETH_POOL_PEER_PREFIX "%d", 0, takenVeths);
+        if (vethName.empty())
+        {
+            AI_LOG_ERROR("failed to create pooled veth pair");
+            success = false;
+            break;
+        }
+
+        // the pair is only taken once it's on the bridge, so do that last
+        success = netlink->setIfaceForwarding(vethName, true) &&
+                  netlink->ifaceUp(vethName) &&
+                  netlink->addIfaceToBridge(BRIDGE_NAME, vethName);
+        if (!success)
+        {
+            AI_LOG_ERROR("failed to setup pooled veth '%s'", vethName.c_str());
+            netlink->deleteIface(vethName);
+            break;
+        }
+
+        pooled++;
+    }
+
+    unlockPool(lockFd);
+
+    AI_LOG_FN_EXIT();
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the host end names of the pairs in the pool.
+ *
+ *  This and drain() don't check the pool size, so pairs left from when the
+ *  pool was enabled are still found.
+ *
+ *  @param[in]  netlink     Instance of the Netlink class.
+ *
+ *  @return the names of the vethN interfaces in the pool.
+ */
+std::set<std::string> VethPool::vethNames(const std::shared_ptr<Netlink> &netlink)
+{
+    std::set<std::string> names;
+
+    for (const Netlink::VethPeerDetails &pair : netlink->getVethPeers(VETH_POOL_PEER_PREFIX))
+    {
+        names.insert(pair.vethName);
+    }
+
+    return names;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Deletes all the pairs in the pool, i.e. before removing the bridge.
+ *
+ *  @param[in]  netlink     Instance of the Netlink class.
+ *
+ *  @return true on success, false if any pair couldn't be deleted.
+ */
+bool VethPool::drain(const std::shared_ptr<Netlink> &netlink)
+{
+    AI_LOG_FN_ENTRY();
+
+    int lockFd = lockPool();
+    if (lockFd < 0)
+    {
+        AI_LOG_FN_EXIT();
+        return false;
+    }
+
+    bool success = true;
+    for (const Netlink::VethPeerDetails &pair : netlink->getVethPeers(VETH_POOL_PEER_PREFIX))
+    {
+        if (!netlink->deleteIface(pair.peerName))
+        {
+            success = false;
+        }
+    }
+
+    unlockPool(lockFd);
+
+    AI_LOG_FN_EXIT();
+    return success;
+}
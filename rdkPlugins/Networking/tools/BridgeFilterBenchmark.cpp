@@ -0,0 +1,160 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   BridgeFilterBenchmark.cpp
+ *
+ *  Times inserting and then deleting 1, 10 and 50 ebtables rules, by running
+ *  the ebtables tool for each rule, with one BridgeFilter commit per rule and
+ *  with a single BridgeFilter commit for all of them.  Every run is done in a
+ *  new network namespace so the host rules aren't touched, and so needs to be
+ *  run as root.
+ *
+ *  The rules are the ones the MulticastForwarder adds for each multicast
+ *  group a container is given.
+ */
+#include "BridgeFilter.h"
+
+#include <Logging.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+
+
+enum class Method
+{
+    Tool,
+    NativePerRule,
+    NativeBatch
+};
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the args of the rule with the given index.
+ */
+static std::string ruleArgs(unsigned index)
+{
+    return "OUTPUT -o veth" + std::to_string(index % 8) + " -p IPv4 --ip-dst 239.255." +
+           std::to_string(index / 250) + "." + std::to_string(1 + (index % 250)) +
+           " -j ACCEPT";
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Inserts or deletes @a count rules with the given method.
+ *
+ *  @return the time taken in milliseconds, or a negative value on failure.
+ */
+static double run(Method method, unsigned count, bool insert)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    BridgeFilter batch;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (method == Method::Tool)
+        {
+            const std::string command = std::string("ebtables ") + (insert ? "-I " : "-D ") +
+                                        ruleArgs(i) + " > /dev/null 2>&1";
+            if (system(command.c_str()) != 0)
+            {
+                return -1.0;
+            }
+        }
+        else
+        {
+            BridgeFilter single;
+            BridgeFilter &filter = (method == Method::NativeBatch) ? batch : single;
+
+            if (insert)
+                filter.insertRule(ruleArgs(i));
+            else
+                filter.deleteRule(ruleArgs(i));
+
+            if ((method == Method::NativePerRule) && !filter.commit())
+            {
+                return -1.0;
+            }
+        }
+    }
+
+    if ((method == Method::NativeBatch) && !batch.commit())
+    {
+        return -1.0;
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    const unsigned counts[] = { 1, 10, 50 };
+    const std::pair<Method, const char*> methods[] =
+    {
+        { Method::Tool, "ebtables" },
+        { Method::NativePerRule, "per-rule" },
+        { Method::NativeBatch, "batched" },
+    };
+
+    if (!BridgeFilter::nativeSupported())
+    {
+        fprintf(stderr, "ebtables is the legacy tool, native rules will fall back to it\n");
+    }
+
+    printf("%-10s %8s %14s %14s %14s\n", "method", "rules",
+           "insert (ms)", "delete (ms)", "per rule (ms)");
+
+    for (const auto &method : methods)
+    {
+        for (unsigned count : counts)
+        {
+            // start each run with empty tables
+            if (unshare(CLONE_NEWNET) != 0)
+            {
+                fprintf(stderr, "unshare(CLONE_NEWNET) failed - %s\n", strerror(errno));
+                return EXIT_FAILURE;
+            }
+
+            const double insert = run(method.first, count, true);
+            const double remove = run(method.first, count, false);
+            if ((insert < 0.0) || (remove < 0.0))
+            {
+                fprintf(stderr, "failed to apply %u rules with %s, skipping method\n",
+                        count, method.second);
+                break;
+            }
+
+            printf("%-10s %8u %14.1f %14.1f %14.3f\n", method.second, count,
+                   insert, remove, (insert + remove) / (2 * count));
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   NetfilterBenchmark.cpp
+ *
+ *  Times adding and then removing the netfilter rules for 1, 10 and 50
+ *  containers with each of the Netfilter backends.  Every run is done in a
+ *  new network namespace so the host rules aren't touched, and so needs to
+ *  be run as root.
+ *
+ *  The rules are similar to the ones the Networking plugin adds for a NAT
+ *  container with a port forward and dnsmasq enabled, and each container is
+ *  added and removed with its own apply, as it would be by the plugin hooks.
+ */
+#include "Netfilter.h"
+
+#include <Logging.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the rules for the container with the given index.
+ *
+ *  The first ruleset is inserted, the second appended.
+ */
+static std::vector<Netfilter::RuleSet> containerRules(unsigned index)
+{
+    const std::string id = "bench" + std::to_string(index);
+    const std::string veth = "veth" + std::to_string(index);
+    const std::string address = "100.64." + std::to_string(11 + (index / 250)) + "." +
+                                std::to_string(2 + (index % 250));
+    const std::string port = std::to_string(8000 + index);
+
+    Netfilter::RuleSet insertRules =
+    {
+        {
+            Netfilter::TableType::Nat,
+            {
+                "PREROUTING ! -i dobby0 -p tcp -m tcp --dport " + port +
+                    " -m comment --comment " + id + " -j DNAT --to-destination " +
+                    address + ":" + port,
+            }
+        },
+        {
+            Netfilter::TableType::Filter,
+            {
+                "FORWARD -d " + address + "/32 ! -i dobby0 -o dobby0 -p tcp -m tcp"
+                    " --dport " + port + " -m comment --comment " + id + " -j ACCEPT",
+            }
+        },
+    };
+
+    Netfilter::RuleSet appendRules =
+    {
+        {
+            Netfilter::TableType::Filter,
+            {
+                "DobbyInputChain -i " + veth + " ! -s " + address + "/32 -j DROP",
+                "DobbyInputChain -s " + address + "/32 -d 100.64.11.1/32 -i dobby0"
+                    " -p udp -m udp --dport 53 -m comment --comment " + id + " -j ACCEPT",
+                "DobbyInputChain -s " + address + "/32 -d 100.64.11.1/32 -i dobby0"
+                    " -p tcp -m tcp --dport 53 -m comment --comment " + id + " -j ACCEPT",
+            }
+        },
+    };
+
+    return { insertRules, appendRules };
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Adds or removes the rules for @a count containers, one apply per
+ *  container.
+ *
+ *  @return the time taken in milliseconds, or a negative value on failure.
+ */
+static double run(Netfilter::Backend backend, unsigned count, bool add)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        Netfilter netfilter(backend);
+        const std::string id = "bench" + std::to_string(i);
+
+        std::vector<Netfilter::RuleSet> rules = containerRules(i);
+        if (add)
+        {
+            netfilter.addContainerRules(id, rules[0], AF_INET, Netfilter::Operation::Insert);
+            netfilter.addContainerRules(id, rules[1], AF_INET, Netfilter::Operation::Append);
+        }
+        else
+        {
+            netfilter.addContainerRules(id, rules[0], AF_INET, Netfilter::Operation::Delete);
+            netfilter.addContainerRules(id, rules[1], AF_INET, Netfilter::Operation::Delete);
+        }
+
+        if (!netfilter.applyRules(AF_INET))
+        {
+            return -1.0;
+        }
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Creates the chain the container rules are appended to, as the
+ *  bridge setup does.
+ */
+static bool setupBridgeRules(Netfilter::Backend backend)
+{
+    Netfilter netfilter(backend);
+    netfilter.createNewChain(Netfilter::TableType::Filter, "DobbyInputChain", AF_INET);
+
+    Netfilter::RuleSet rules =
+    {
+        { Netfilter::TableType::Filter, { "INPUT -i dobby0 -j DobbyInputChain" } },
+    };
+    netfilter.addRules(rules, AF_INET, Netfilter::Operation::Append);
+
+    return netfilter.applyRules(AF_INET);
+}
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    const unsigned counts[] = { 1, 10, 50 };
+    const std::pair<Netfilter::Backend, const char*> backends[] =
+    {
+        { Netfilter::Backend::Iptables, "iptables" },
+        { Netfilter::Backend::Nftables, "nftables" },
+    };
+
+    printf("%-10s %10s %14s %14s %14s\n", "backend", "containers",
+           "setup (ms)", "teardown (ms)", "per ctr (ms)");
+
+    for (const auto &backend : backends)
+    {
+        for (unsigned count : counts)
+        {
+            // start each run with empty tables
+            if (unshare(CLONE_NEWNET) != 0)
+            {
+                fprintf(stderr, "unshare(CLONE_NEWNET) failed - %s\n", strerror(errno));
+                return EXIT_FAILURE;
+            }
+
+            if (!setupBridgeRules(backend.first))
+            {
+                fprintf(stderr, "failed to setup %s rules, skipping backend\n",
+                        backend.second);
+                break;
+            }
+
+            const double setup = run(backend.first, count, true);
+            const double teardown = run(backend.first, count, false);
+            if ((setup < 0.0) || (teardown < 0.0))
+            {
+                fprintf(stderr, "failed to apply %s rules for %u containers\n",
+                        backend.second, count);
+                continue;
+            }
+
+            printf("%-10s %10u %14.1f %14.1f %14.2f\n", backend.second, count,
+                   setup, teardown, (setup + teardown) / count);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
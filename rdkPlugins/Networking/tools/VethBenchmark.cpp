@@ -0,0 +1,327 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   VethBenchmark.cpp
+ *
+ *  Times creating and configuring the veth pair of a container, with the
+ *  interfaces inside the container's namespace configured one request at a
+ *  time (each request waits for its ack and looks the link up with its own
+ *  RTM_GETLINK, as before Netlink::beginBatch() was added) and as a single
+ *  batch (as NetworkSetup does now).
+ *
+ *  The bridge is created in a new network namespace so the host isn't
+ *  touched, and each container is a child process in a namespace of its own,
+ *  so it needs to be run as root.  The number of containers per mode can be
+ *  given as the only argument, the default is 50.
+ */
+#include "Netlink.h"
+#include "NetworkingPluginCommon.h"
+
+#include <Logging.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+typedef std::chrono::steady_clock Clock;
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief The time taken by each stage of the setup of one container, in
+ *  microseconds.
+ */
+struct Timings
+{
+    double create;
+    double host;
+    double container;
+};
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Starts a child process in a new network namespace that waits until
+ *  it's killed.
+ *
+ *  @return the pid of the child, or -1 on failure.
+ */
+static pid_t startContainer()
+{
+    int pipeFds[2];
+    if (pipe2(pipeFds, O_CLOEXEC) != 0)
+    {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(pipeFds[0]);
+
+        char ready = (unshare(CLONE_NEWNET) == 0) ? 1 : 0;
+        if (TEMP_FAILURE_RETRY(write(pipeFds[1], &ready, 1)) != 1)
+            _exit(EXIT_FAILURE);
+
+        while (true)
+            pause();
+    }
+
+    close(pipeFds[1]);
+
+    char ready = 0;
+    if ((pid > 0) &&
+        ((TEMP_FAILURE_RETRY(read(pipeFds[0], &ready, 1)) != 1) || !ready))
+    {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        pid = -1;
+    }
+
+    close(pipeFds[0]);
+    return pid;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Kills the container process, which also deletes the veth pair.
+ */
+static void stopContainer(pid_t pid)
+{
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Configures the container end of the veth as setupContainerNet()
+ *  does, optionally as one batch.
+ *
+ *  Called from a thread in the container's network namespace.
+ */
+static bool configureContainerNet(in_addr_t address, bool batched)
+{
+    Netlink netlink;
+    if (!netlink.isValid())
+    {
+        return false;
+    }
+
+    if (batched && !netlink.beginBatch())
+    {
+        return false;
+    }
+
+    const std::string ifaceName(PEER_NAME);
+    const std::string loName("lo");
+
+    bool success =
+        netlink.setIfaceAddress(ifaceName, address, INADDR_BRIDGE_NETMASK) &&
+        netlink.setIfaceAddress(loName, INADDR_LO, INADDR_LO_NETMASK) &&
+        netlink.ifaceUp(ifaceName) &&
+        netlink.ifaceUp(loName) &&
+        netlink.addRoute(ifaceName, INADDR_CREATE(0, 0, 0, 0),
+                         INADDR_CREATE(0, 0, 0, 0), INADDR_BRIDGE) &&
+        netlink.addRoute(loName, (INADDR_LO & INADDR_LO_NETMASK),
+                         INADDR_LO_NETMASK, INADDR_CREATE(0, 0, 0, 0));
+
+    netlink.getIfaceMAC(ifaceName);
+
+    if (batched)
+    {
+        success = netlink.commitBatch() && success;
+    }
+
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Runs configureContainerNet() on a thread in the namespace of the
+ *  container, the same way DobbyRdkPluginUtils::callInNamespace() does.
+ */
+static bool configureInNamespace(pid_t pid, in_addr_t address, bool batched)
+{
+    char nsPath[64];
+    snprintf(nsPath, sizeof(nsPath), "/proc/%d/ns/net", pid);
+
+    int nsFd = open(nsPath, O_RDONLY | O_CLOEXEC);
+    if (nsFd < 0)
+    {
+        return false;
+    }
+
+    bool success = false;
+    std::thread thread([&]()
+    {
+        success = (setns(nsFd, CLONE_NEWNET) == 0) &&
+                  configureContainerNet(address, batched);
+    });
+    thread.join();
+
+    close(nsFd);
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Creates and configures the veth pair for one container.
+ *
+ *  @return false on failure.
+ */
+static bool setupContainer(const std::shared_ptr<Netlink> &netlink, pid_t pid,
+                           unsigned index, bool batched, Timings *timings)
+{
+    const in_addr_t address = INADDR_CREATE(100, 64, 11, 2 + (index % 250));
+
+    const auto start = Clock::now();
+
+    std::vector<std::string> takenVeths;
+    const std::string vethName = netlink->createVeth(PEER_NAME, pid, takenVeths);
+    if (vethName.empty())
+    {
+        return false;
+    }
+
+    const auto created = Clock::now();
+
+    if (!netlink->setIfaceForwarding(vethName, true) ||
+        !netlink->addIfaceToBridge(BRIDGE_NAME, vethName) ||
+        !netlink->ifaceUp(vethName))
+    {
+        return false;
+    }
+
+    const auto hostDone = Clock::now();
+
+    if (!configureInNamespace(pid, address, batched))
+    {
+        return false;
+    }
+
+    const auto containerDone = Clock::now();
+
+    typedef std::chrono::duration<double, std::micro> Micros;
+    timings->create = Micros(created - start).count();
+    timings->host = Micros(hostDone - created).count();
+    timings->container = Micros(containerDone - hostDone).count();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the median of the values.
+ */
+static double median(std::vector<double> values)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char *argv[])
+{
+    const unsigned count = (argc > 1) ? strtoul(argv[1], nullptr, 0) : 50;
+    if (count == 0)
+    {
+        fprintf(stderr, "usage: %s [containers]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    __ai_debug_log_level = AI_DEBUG_LEVEL_WARNING;
+
+    // keep the bridge and veths out of the host namespace
+    if (unshare(CLONE_NEWNET) != 0)
+    {
+        fprintf(stderr, "unshare(CLONE_NEWNET) failed - %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    std::shared_ptr<Netlink> netlink = Netlink::shared();
+    if (!netlink->isValid() ||
+        !netlink->createBridge(BRIDGE_NAME) ||
+        !netlink->setIfaceAddress(BRIDGE_NAME, INADDR_BRIDGE, INADDR_BRIDGE_NETMASK) ||
+        !netlink->ifaceUp(BRIDGE_NAME))
+    {
+        fprintf(stderr, "failed to create the bridge\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%-12s %10s %14s %14s %14s %14s\n", "mode", "containers",
+           "create (us)", "host (us)", "netns (us)", "total (us)");
+
+    const std::pair<bool, const char*> modes[] =
+    {
+        { false, "sequential" },
+        { true,  "batched" },
+    };
+
+    for (const auto &mode : modes)
+    {
+        std::vector<double> create, host, container, total;
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            const pid_t pid = startContainer();
+            if (pid < 0)
+            {
+                fprintf(stderr, "failed to start container process\n");
+                return EXIT_FAILURE;
+            }
+
+            Timings timings;
+            const bool success = setupContainer(netlink, pid, i, mode.first, &timings);
+
+            stopContainer(pid);
+
+            if (!success)
+            {
+                fprintf(stderr, "failed to setup veth for container %u\n", i);
+                return EXIT_FAILURE;
+            }
+
+            create.push_back(timings.create);
+            host.push_back(timings.host);
+            container.push_back(timings.container);
+            total.push_back(timings.create + timings.host + timings.container);
+        }
+
+        // medians, so the odd slow run (e.g. the kernel reaping the netns of
+        // a previous container) doesn't skew the result
+        printf("%-12s %10u %14.0f %14.0f %14.0f %14.0f\n", mode.second, count,
+               median(create), median(host), median(container), median(total));
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -23,6 +23,7 @@
  * C methods are visible to allow PluginLauncher to find the plugin
  */
 REGISTER_RDK_PLUGIN(OOMCrash);
+REGISTER_RDK_PLUGIN_NAME("OOMCrash");
 
 /**
  * @brief Constructor - called when plugin is loaded by PluginLauncher
@@ -30,6 +30,7 @@
 
 
 REGISTER_RDK_PLUGIN(RtSchedulingPlugin);
+REGISTER_RDK_PLUGIN_NAME("RtScheduling");
 
 RtSchedulingPlugin::RtSchedulingPlugin(std::shared_ptr<rt_dobby_schema> &containerConfig,
                                        const std::shared_ptr<DobbyRdkPluginUtils> &utils,
@@ -31,6 +31,7 @@
  * C methods are visible to allow PluginLauncher to find the plugin
  */
 REGISTER_RDK_PLUGIN(Storage);
+REGISTER_RDK_PLUGIN_NAME("Storage");
 
 /**
  * @brief Constructor - called when plugin is loaded by PluginLauncher
@@ -70,7 +71,10 @@ unsigned Storage::hookHints() const
         IDobbyRdkPlugin::HintFlags::StartContainerFlag |
 #endif //#ifdef ENABLE_TESTS
         IDobbyRdkPlugin::HintFlags::PostStartFlag |
-        IDobbyRdkPlugin::HintFlags::PostStopFlag);
+        IDobbyRdkPlugin::HintFlags::PostStopFlag |
+        // loop mounts can block in the kernel, so can't be left running
+        // on a thread after a timeout
+        IDobbyRdkPlugin::HintFlags::IsolateHooksFlag);
 }
 
 // Begin Hook Methods
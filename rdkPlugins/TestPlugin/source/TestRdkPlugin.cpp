@@ -24,6 +24,7 @@
  * C methods are visible to allow PluginLauncher to find the plugin
  */
 REGISTER_RDK_PLUGIN(TestRdkPlugin);
+REGISTER_RDK_PLUGIN_NAME("TestRdkPlugin");
 
 /**
  * @brief Constructor - called when plugin is loaded by PluginLauncher
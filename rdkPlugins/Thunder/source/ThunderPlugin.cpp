@@ -32,6 +32,7 @@
  * C methods are visible to allow PluginLauncher to find the plugin
  */
 REGISTER_RDK_PLUGIN(ThunderPlugin);
+REGISTER_RDK_PLUGIN_NAME("Thunder");
 
 /**
  * @brief Constructor - called when plugin is loaded by PluginLauncher
@@ -48,7 +49,6 @@ ThunderPlugin::ThunderPlugin(std::shared_ptr<rt_dobby_schema> &containerConfig,
       mContainerConfig(containerConfig),
       mRootfsPath(rootfsPath),
       mUtils(utils),
-      mNetfilter(std::make_shared<Netfilter>()),
       mThunderPort(9998), // Change this if Thunder runs on non-standard port
       mEnableConnLimit(false),
       mSocketDirectory("/tmp/SecurityAgent"),
@@ -275,20 +275,15 @@ bool ThunderPlugin::createRuntime()
         return false;
     }
 
-    // add all rules to cache
-    if (!mNetfilter->addRules(ruleSet, AF_INET, Netfilter::Operation::Insert))
+    // add all rules to the hook's netfilter transaction, they're applied
+    // once all the plugins have run
+    std::shared_ptr<Netfilter> netfilter = Netfilter::hookTransaction(mUtils);
+    if (!netfilter->addRules(ruleSet, AF_INET, Netfilter::Operation::Insert))
     {
         AI_LOG_ERROR_EXIT("failed to setup Thunder iptables rules for '%s''", mUtils->getContainerId().c_str());
         return false;
     }
 
-    // actually apply the rules
-    if (!mNetfilter->applyRules(AF_INET))
-    {
-        AI_LOG_ERROR_EXIT("Failed to apply Thunder iptables rules for '%s'", mUtils->getContainerId().c_str());
-        return false;
-    }
-
     AI_LOG_FN_EXIT();
     return true;
 }
@@ -311,20 +306,15 @@ bool ThunderPlugin::postHalt()
         return false;
     }
 
-    // add all rules to cache
-    if (!mNetfilter->addRules(ruleSet, AF_INET, Netfilter::Operation::Delete))
+    // add all rules to the hook's netfilter transaction, they're deleted
+    // once all the plugins have run
+    std::shared_ptr<Netfilter> netfilter = Netfilter::hookTransaction(mUtils);
+    if (!netfilter->addRules(ruleSet, AF_INET, Netfilter::Operation::Delete))
     {
         AI_LOG_ERROR_EXIT("failed to setup Thunder iptables rules for deletion for '%s'", mUtils->getContainerId().c_str());
         return false;
     }
 
-    // actually delete the rules
-    if (!mNetfilter->applyRules(AF_INET))
-    {
-        AI_LOG_ERROR_EXIT("Failed to delete Thunder iptables rules for '%s'", mUtils->getContainerId().c_str());
-        return false;
-    }
-
     AI_LOG_FN_EXIT();
     return true;
 }
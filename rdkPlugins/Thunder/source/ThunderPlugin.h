@@ -101,7 +101,6 @@ private:
     const std::string mRootfsPath;
     const std::shared_ptr<DobbyRdkPluginUtils> mUtils;
 
-    std::shared_ptr<Netfilter> mNetfilter;
     in_port_t mThunderPort;
 
 private:
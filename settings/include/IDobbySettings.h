@@ -264,6 +264,78 @@ public:
     };
 
     virtual PidsSettings pidsSettings() const = 0;
+
+    // -------------------------------------------------------------------------
+    /**
+     *  Automatic cpuset placement settings
+     *
+     *      - enabled
+     *          Specifies if the daemon should manage the cpuset.cpus of
+     *          containers that don't pin their own cores
+     *      - foregroundApps
+     *          A list of app names that should be isolated onto dedicated
+     *          cores while running.  Hostname field from containers config is
+     *          used as app name.
+     *      - foregroundCores
+     *          The number of cores reserved for foreground apps
+     *      - coresPerContainer
+     *          The number of cores given to each background container, 0 means
+     *          all the cores not reserved for foreground apps
+     *      - rebalanceInterval
+     *          Period in seconds between rebalancing background containers by
+     *          their cpu usage, 0 disables periodic rebalancing
+     *
+     */
+    struct CpusetPlacementSettings
+    {
+        bool enabled;
+        std::vector<std::string> foregroundApps;
+        int foregroundCores;
+        int coresPerContainer;
+        int rebalanceInterval;
+    };
+
+    virtual CpusetPlacementSettings cpusetPlacementSettings() const = 0;
+
+    // -------------------------------------------------------------------------
+    /**
+     *  Compiled spec cache settings
+     *
+     *      - enabled
+     *          Specifies if the OCI config generated from a Dobby spec should be
+     *          cached and reused when the same spec is started again
+     *      - persist
+     *          Specifies if cache entries should also be stored in the
+     *          workspace so they survive a daemon restart
+     *      - maxEntries
+     *          The maximum number of specs held in the in-memory cache
+     *
+     */
+    struct SpecCacheSettings
+    {
+        bool enabled;
+        bool persist;
+        int maxEntries;
+    };
+
+    virtual SpecCacheSettings specCacheSettings() const = 0;
+
+    // -------------------------------------------------------------------------
+    /**
+     *  Hook server settings
+     *
+     *      - enabled
+     *          Specifies if the daemon should run the RDK plugin hook server,
+     *          DobbyPluginLauncher forwards the runtime namespace OCI hooks to
+     *          it rather than loading the plugins itself for every hook
+     *
+     */
+    struct HookServerSettings
+    {
+        bool enabled;
+    };
+
+    virtual HookServerSettings hookServerSettings() const = 0;
 };
 
 #endif // !defined(IDOBBYSETTINGS_H)
\ No newline at end of file
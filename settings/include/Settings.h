@@ -80,6 +80,9 @@ public:
     StraceSettings straceSettings() const override;
     ApparmorSettings apparmorSettings() const override;
     PidsSettings pidsSettings() const override;
+    CpusetPlacementSettings cpusetPlacementSettings() const override;
+    SpecCacheSettings specCacheSettings() const override;
+    HookServerSettings hookServerSettings() const override;
 
     void dump(int aiLogLevel = -1) const;
 
@@ -133,6 +136,9 @@ private:
     StraceSettings mStraceSettings;
     ApparmorSettings mApparmorSettings;
     PidsSettings mPidsSettings;
+    CpusetPlacementSettings mCpusetPlacementSettings;
+    SpecCacheSettings mSpecCacheSettings;
+    HookServerSettings mHookServerSettings;
 };
 
 #endif // !defined(SETTINGS_H)
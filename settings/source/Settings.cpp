@@ -385,6 +385,112 @@ Settings::Settings(const Json::Value& settings)
             }
         }
     }
+
+    // Process cpuset placement settings
+    {
+        Json::Value cpusetSettings = Json::Path(".cpusetPlacement").resolve(settings);
+        if (!cpusetSettings.isNull())
+        {
+            if (cpusetSettings.isObject())
+            {
+                const Json::Value enabled = cpusetSettings["enable"];
+                if (enabled.isBool())
+                    mCpusetPlacementSettings.enabled = enabled.asBool();
+                else
+                    AI_LOG_ERROR("Invalid entry in cpusetPlacement.enable in JSON settings file");
+
+                const Json::Value apps = cpusetSettings["foregroundApps"];
+                if (apps.isArray())
+                {
+                    for (const Json::Value &app : apps)
+                    {
+                        if (app.isString())
+                            mCpusetPlacementSettings.foregroundApps.push_back(app.asString());
+                        else
+                            AI_LOG_ERROR("Invalid entry in cpusetPlacement.foregroundApps in JSON settings file");
+                    }
+                }
+                else if (!apps.isNull())
+                {
+                    AI_LOG_ERROR("Invalid entry in cpusetPlacement.foregroundApps in JSON settings file");
+                }
+
+                const Json::Value foregroundCores = cpusetSettings["foregroundCores"];
+                if (foregroundCores.isIntegral() && (foregroundCores.asInt() >= 0))
+                    mCpusetPlacementSettings.foregroundCores = foregroundCores.asInt();
+                else if (!foregroundCores.isNull())
+                    AI_LOG_ERROR("Invalid entry in cpusetPlacement.foregroundCores in JSON settings file");
+
+                const Json::Value coresPerContainer = cpusetSettings["coresPerContainer"];
+                if (coresPerContainer.isIntegral() && (coresPerContainer.asInt() >= 0))
+                    mCpusetPlacementSettings.coresPerContainer = coresPerContainer.asInt();
+                else if (!coresPerContainer.isNull())
+                    AI_LOG_ERROR("Invalid entry in cpusetPlacement.coresPerContainer in JSON settings file");
+
+                const Json::Value rebalanceInterval = cpusetSettings["rebalanceInterval"];
+                if (rebalanceInterval.isIntegral() && (rebalanceInterval.asInt() >= 0))
+                    mCpusetPlacementSettings.rebalanceInterval = rebalanceInterval.asInt();
+                else if (!rebalanceInterval.isNull())
+                    AI_LOG_ERROR("Invalid entry in cpusetPlacement.rebalanceInterval in JSON settings file");
+            }
+            else
+            {
+                AI_LOG_ERROR("Invalid cpusetPlacement type in settings file, should be object");
+            }
+        }
+    }
+
+    // Process compiled spec cache settings
+    {
+        Json::Value specCacheSettings = Json::Path(".specCache").resolve(settings);
+        if (!specCacheSettings.isNull())
+        {
+            if (specCacheSettings.isObject())
+            {
+                const Json::Value enabled = specCacheSettings["enable"];
+                if (enabled.isBool())
+                    mSpecCacheSettings.enabled = enabled.asBool();
+                else if (!enabled.isNull())
+                    AI_LOG_ERROR("Invalid entry in specCache.enable in JSON settings file");
+
+                const Json::Value persist = specCacheSettings["persist"];
+                if (persist.isBool())
+                    mSpecCacheSettings.persist = persist.asBool();
+                else if (!persist.isNull())
+                    AI_LOG_ERROR("Invalid entry in specCache.persist in JSON settings file");
+
+                const Json::Value maxEntries = specCacheSettings["maxEntries"];
+                if (maxEntries.isIntegral() && (maxEntries.asInt() > 0))
+                    mSpecCacheSettings.maxEntries = maxEntries.asInt();
+                else if (!maxEntries.isNull())
+                    AI_LOG_ERROR("Invalid entry in specCache.maxEntries in JSON settings file");
+            }
+            else
+            {
+                AI_LOG_ERROR("Invalid specCache type in settings file, should be object");
+            }
+        }
+    }
+
+    // Process hook server settings
+    {
+        Json::Value hookServerSettings = Json::Path(".hookServer").resolve(settings);
+        if (!hookServerSettings.isNull())
+        {
+            if (hookServerSettings.isObject())
+            {
+                const Json::Value enabled = hookServerSettings["enable"];
+                if (enabled.isBool())
+                    mHookServerSettings.enabled = enabled.asBool();
+                else if (!enabled.isNull())
+                    AI_LOG_ERROR("Invalid entry in hookServer.enable in JSON settings file");
+            }
+            else
+            {
+                AI_LOG_ERROR("Invalid hookServer type in settings file, should be object");
+            }
+        }
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -397,6 +503,17 @@ void Settings::setDefaults()
     mConsoleSocketPath = "/tmp/dobbyPty.sock";
     mStraceSettings.logsDir = "/tmp/strace";
 
+    mCpusetPlacementSettings.enabled = false;
+    mCpusetPlacementSettings.foregroundCores = 1;
+    mCpusetPlacementSettings.coresPerContainer = 0;
+    mCpusetPlacementSettings.rebalanceInterval = 30;
+
+    mSpecCacheSettings.enabled = true;
+    mSpecCacheSettings.persist = false;
+    mSpecCacheSettings.maxEntries = 16;
+
+    mHookServerSettings.enabled = true;
+
 #if defined(RDK)
     mWorkspaceDir = getPathFromEnv("AI_WORKSPACE_PATH", "/var/volatile/rdk");
     mPersistentDir = getPathFromEnv("AI_PERSISTENT_PATH", "/opt/persistent/rdk");
@@ -548,6 +665,21 @@ IDobbySettings::PidsSettings Settings::pidsSettings() const
     return mPidsSettings;
 }
 
+IDobbySettings::CpusetPlacementSettings Settings::cpusetPlacementSettings() const
+{
+    return mCpusetPlacementSettings;
+}
+
+IDobbySettings::SpecCacheSettings Settings::specCacheSettings() const
+{
+    return mSpecCacheSettings;
+}
+
+IDobbySettings::HookServerSettings Settings::hookServerSettings() const
+{
+    return mHookServerSettings;
+}
+
 // -----------------------------------------------------------------------------
 /**
  *  @brief Debugging function to dump the settings to the log - info level.
@@ -590,6 +722,22 @@ void Settings::dump(int aiLogLevel) const
     __AI_LOG_PRINTF(aiLogLevel, "settings.pidsSettings.enabled='%s'", mPidsSettings.enabled ? "true" : "false");
     __AI_LOG_PRINTF(aiLogLevel, "settings.pidsSettings.limit=%d", mPidsSettings.limit);
 
+    __AI_LOG_PRINTF(aiLogLevel, "settings.cpusetPlacementSettings.enabled='%s'", mCpusetPlacementSettings.enabled ? "true" : "false");
+    i = 0;
+    for (const auto& app : mCpusetPlacementSettings.foregroundApps)
+    {
+        __AI_LOG_PRINTF(aiLogLevel, "settings.cpusetPlacementSettings.foregroundApps[%u]='%s'", i++, app.c_str());
+    }
+    __AI_LOG_PRINTF(aiLogLevel, "settings.cpusetPlacementSettings.foregroundCores=%d", mCpusetPlacementSettings.foregroundCores);
+    __AI_LOG_PRINTF(aiLogLevel, "settings.cpusetPlacementSettings.coresPerContainer=%d", mCpusetPlacementSettings.coresPerContainer);
+    __AI_LOG_PRINTF(aiLogLevel, "settings.cpusetPlacementSettings.rebalanceInterval=%d", mCpusetPlacementSettings.rebalanceInterval);
+
+    __AI_LOG_PRINTF(aiLogLevel, "settings.specCacheSettings.enabled='%s'", mSpecCacheSettings.enabled ? "true" : "false");
+    __AI_LOG_PRINTF(aiLogLevel, "settings.specCacheSettings.persist='%s'", mSpecCacheSettings.persist ? "true" : "false");
+    __AI_LOG_PRINTF(aiLogLevel, "settings.specCacheSettings.maxEntries=%d", mSpecCacheSettings.maxEntries);
+
+    __AI_LOG_PRINTF(aiLogLevel, "settings.hookServerSettings.enabled='%s'", mHookServerSettings.enabled ? "true" : "false");
+
     dumpHardwareAccess(aiLogLevel, "gpu", mGpuHardwareAccess);
     dumpHardwareAccess(aiLogLevel, "vpu", mVpuHardwareAccess);
 }
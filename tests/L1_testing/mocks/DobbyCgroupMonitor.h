@@ -0,0 +1,63 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2025 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyCgroupMonitor.h
+ *
+ */
+
+#ifndef DOBBYCGROUPMONITOR_H
+#define DOBBYCGROUPMONITOR_H
+
+#include "ContainerId.h"
+#include "IDobbyEnv.h"
+
+#include <memory>
+#include <functional>
+#include <sys/types.h>
+
+class DobbyCgroupMonitorImpl {
+public:
+
+    virtual ~DobbyCgroupMonitorImpl() = default;
+
+    virtual void stop() = 0;
+    virtual bool addContainer(const ContainerId &id) = 0;
+    virtual void removeContainer(const ContainerId &id) = 0;
+};
+
+class DobbyCgroupMonitor {
+
+protected:
+    static DobbyCgroupMonitorImpl* impl;
+
+public:
+    typedef std::function<void(const ContainerId &id)> ContainerEmptyFunc;
+    typedef std::function<void(const ContainerId &id, pid_t victim)> ContainerOomFunc;
+
+    DobbyCgroupMonitor();
+    DobbyCgroupMonitor(const std::shared_ptr<IDobbyEnv> &env, const ContainerEmptyFunc &containerEmptyCb, const ContainerOomFunc &containerOomCb);
+    ~DobbyCgroupMonitor();
+
+    static void setImpl(DobbyCgroupMonitorImpl* newImpl);
+    void stop();
+    bool addContainer(const ContainerId &id);
+    void removeContainer(const ContainerId &id);
+};
+
+#endif // !defined(DOBBYCGROUPMONITOR_H)
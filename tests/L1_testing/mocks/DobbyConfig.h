@@ -33,6 +33,8 @@
 #  include <jsoncpp/json.h>
 #endif
 
+#define PLUGINLAUNCHER_PATH "/usr/bin/DobbyPluginLauncher"
+
 class DobbyConfigImpl {
 
 public:
@@ -64,7 +66,7 @@ public:
     static void setImpl(DobbyConfigImpl* newImpl);
     bool writeConfigJson(const std::string& filePath) const;
     virtual const std::map<std::string, Json::Value>& rdkPlugins() const = 0;
-    const std::shared_ptr<rt_dobby_schema> config();
+    const std::shared_ptr<rt_dobby_schema> config() const;
     bool changeProcessArgs(const std::string& command);
     bool addWesterosMount(const std::string& socketPath);
     bool addEnvironmentVar(const std::string& envVar);
@@ -35,7 +35,7 @@ bool DobbyConfig::writeConfigJson(const std::string& filePath) const
     return impl->writeConfigJson(filePath);
 }
 
-const std::shared_ptr<rt_dobby_schema> DobbyConfig::config()
+const std::shared_ptr<rt_dobby_schema> DobbyConfig::config() const
 {
    EXPECT_NE(impl, nullptr);
 
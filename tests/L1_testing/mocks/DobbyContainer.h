@@ -38,6 +38,9 @@ public:
     virtual void setRestartOnCrash(const std::list<int>& files) = 0;
     virtual void clearRestartOnCrash() = 0;
     virtual bool shouldRestart(int statusCode) = 0;
+    virtual std::chrono::milliseconds restartBackoff() const = 0;
+    virtual unsigned restartCount() const = 0;
+    virtual unsigned totalRestartCount() const = 0;
     virtual const std::list<int>& files() const = 0;
     virtual int32_t allocDescriptor() = 0;
 };
@@ -63,6 +66,8 @@ public:
     std::list<int> mFiles;
     bool hasCurseOfDeath;
     uint32_t hibernatingPid = 0;
+    bool restartPending = false;
+    std::chrono::time_point<std::chrono::steady_clock> restartTime;
     const std::shared_ptr<const DobbyRootfs> rootfs;
 
     DobbyContainer();
@@ -71,6 +76,9 @@ public:
     ~DobbyContainer();
 
     bool shouldRestart(int statusCode);
+    std::chrono::milliseconds restartBackoff() const;
+    unsigned restartCount() const;
+    unsigned totalRestartCount() const;
 
     std::string customConfigFilePath;
 
@@ -63,6 +63,27 @@ bool DobbyContainer::shouldRestart(int statusCode)
     return impl->shouldRestart(statusCode);
 }
 
+std::chrono::milliseconds DobbyContainer::restartBackoff() const
+{
+   EXPECT_NE(impl, nullptr);
+
+    return impl->restartBackoff();
+}
+
+unsigned DobbyContainer::restartCount() const
+{
+   EXPECT_NE(impl, nullptr);
+
+    return impl->restartCount();
+}
+
+unsigned DobbyContainer::totalRestartCount() const
+{
+   EXPECT_NE(impl, nullptr);
+
+    return impl->totalRestartCount();
+}
+
 void DobbyContainer::setImpl(DobbyContainerImpl* newImpl)
 {
      // Handles both resetting 'impl' to nullptr and assigning a new value to 'impl'
@@ -31,6 +31,9 @@ public:
     MOCK_METHOD(void, setRestartOnCrash, (const std::list<int>& files), (override));
     MOCK_METHOD(void, clearRestartOnCrash, (), (override));
     MOCK_METHOD(bool, shouldRestart, (int statusCode), (override));
+    MOCK_METHOD(std::chrono::milliseconds, restartBackoff, (), (const, override));
+    MOCK_METHOD(unsigned, restartCount, (), (const, override));
+    MOCK_METHOD(unsigned, totalRestartCount, (), (const, override));
     MOCK_METHOD((const std::list<int>&), files, (), (const, override));
     MOCK_METHOD(int32_t, allocDescriptor, (), (override));
 };
@@ -0,0 +1,59 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2025 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyCpusetPlacer.h
+ *
+ */
+
+#ifndef DOBBYCPUSETPLACER_H
+#define DOBBYCPUSETPLACER_H
+
+#include "ContainerId.h"
+#include "IDobbyEnv.h"
+#include "IDobbyUtils.h"
+#include "IDobbySettings.h"
+
+#include <memory>
+#include <string>
+
+class DobbyCpusetPlacerImpl {
+public:
+
+    virtual ~DobbyCpusetPlacerImpl() = default;
+
+    virtual bool addContainer(const ContainerId &id, const std::string &appName) = 0;
+    virtual void removeContainer(const ContainerId &id) = 0;
+};
+
+class DobbyCpusetPlacer {
+
+protected:
+    static DobbyCpusetPlacerImpl* impl;
+
+public:
+    DobbyCpusetPlacer();
+    DobbyCpusetPlacer(const std::shared_ptr<IDobbyEnv> &env, const std::shared_ptr<IDobbyUtils> &utils, const IDobbySettings::CpusetPlacementSettings &settings);
+    ~DobbyCpusetPlacer();
+
+    static void setImpl(DobbyCpusetPlacerImpl* newImpl);
+    bool addContainer(const ContainerId &id, const std::string &appName);
+    void removeContainer(const ContainerId &id);
+};
+
+#endif // !defined(DOBBYCPUSETPLACER_H)
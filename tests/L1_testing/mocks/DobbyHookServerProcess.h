@@ -0,0 +1,57 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2025 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   DobbyHookServerProcess.h
+ *
+ */
+
+#ifndef DOBBYHOOKSERVERPROCESS_H
+#define DOBBYHOOKSERVERPROCESS_H
+
+#include "ContainerId.h"
+#include "DobbyPluginMetrics.h"
+
+#include <memory>
+#include <string>
+
+class DobbyHookServerProcessImpl {
+public:
+
+    virtual ~DobbyHookServerProcessImpl() = default;
+
+    virtual void removeContainer(const ContainerId &id) = 0;
+    virtual bool getPluginMetrics(DobbyPluginMetrics::Snapshot *snapshot) const = 0;
+};
+
+class DobbyHookServerProcess {
+
+protected:
+    static DobbyHookServerProcessImpl* impl;
+
+public:
+    DobbyHookServerProcess();
+    DobbyHookServerProcess(const std::string &socketPath, const std::string &launcherPath);
+    ~DobbyHookServerProcess();
+
+    static void setImpl(DobbyHookServerProcessImpl* newImpl);
+    void removeContainer(const ContainerId &id);
+    bool getPluginMetrics(DobbyPluginMetrics::Snapshot *snapshot) const;
+};
+
+#endif // !defined(DOBBYHOOKSERVERPROCESS_H)
@@ -32,7 +32,9 @@ DobbyManager::DobbyManager(std::shared_ptr<DobbyEnv>&,
                                                     std::function<void(int, const ContainerId&)>& StartedFunc,
                                                     std::function<void(int, const ContainerId&, int)>& StoppedFunc,
                                                     std::function<void(int32_t cd, const ContainerId& id)>&,
-                                                    std::function<void(int32_t cd, const ContainerId& id)>&)
+                                                    std::function<void(int32_t cd, const ContainerId& id)>&,
+                                                    std::function<void(int32_t cd, const ContainerId& id, pid_t victim)>&,
+                                                    std::function<bool(std::function<void()>&& work)>&)
 : mContainerStartedCb(StartedFunc)
 , mContainerStoppedCb(StoppedFunc)
 {
@@ -195,4 +197,11 @@ std::string DobbyManager::ociConfigOfContainer(int32_t cd)
     return impl->ociConfigOfContainer(cd);
 }
 
+DobbyPluginMetrics::Snapshot DobbyManager::pluginMetrics()
+{
+   EXPECT_NE(impl, nullptr);
+
+    return impl->pluginMetrics();
+}
+
 
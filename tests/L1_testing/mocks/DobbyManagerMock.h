@@ -87,4 +87,6 @@ public:
 
     MOCK_METHOD(std::string, ociConfigOfContainer, (int32_t cd), (const,override));
 
+    MOCK_METHOD(DobbyPluginMetrics::Snapshot, pluginMetrics, (), (const,override));
+
 };
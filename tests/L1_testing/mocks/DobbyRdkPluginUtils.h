@@ -40,7 +40,10 @@
     #include <Dobby/rdkPlugins/IDobbyStartState.h>
 #endif
 
-#define ADDRESS_FILE_DIR          "/tmp/dobby/plugin/networking/"
+// the tests can use their own dir by setting -DADDRESS_FILE_DIR=/path/to/dir/
+#ifndef ADDRESS_FILE_DIR
+    #define ADDRESS_FILE_DIR      "/tmp/dobby/plugin/networking/"
+#endif
 
 typedef struct ContainerNetworkInfo
 {
@@ -80,6 +83,9 @@ public:
     virtual bool addAnnotation(const std::string &key, const std::string &value) = 0;
     virtual bool removeAnnotation(const std::string &key) = 0;
     virtual std::map<std::string, std::string> getAnnotations() const = 0;
+    virtual std::shared_ptr<void> hookObject(const std::string &name,const std::function<std::shared_ptr<void>()> &create,const std::function<bool(const std::shared_ptr<void>&)> &commit) = 0;
+    virtual bool commitHookObjects() = 0;
+    virtual void discardHookObjects() = 0;
 };
 
 class DobbyRdkPluginUtils {
@@ -107,6 +113,14 @@ public:
     ~DobbyRdkPluginUtils();
 
     static void setImpl(DobbyRdkPluginUtilsImpl* newImpl);
+
+    template< class Function, class... Args >
+    inline bool callInNamespace(pid_t pid, int nsType, Function&& f, Args&&... args) const
+    {
+        return this->callInNamespaceImpl(pid, nsType, std::bind(std::forward<Function>(f),
+                                                                std::forward<Args>(args)...));
+    }
+
     bool callInNamespaceImpl(pid_t pid, int nsType,const std::function<bool()>& func) const;
     void nsThread(int newNsFd, int nsType, bool* success,std::function<bool()>& func) const;
     pid_t getContainerPid() const;
@@ -124,6 +138,11 @@ public:
     bool addAnnotation(const std::string &key, const std::string &value);
     bool removeAnnotation(const std::string &key);
     std::map<std::string, std::string> getAnnotations() const;
+
+    typedef std::function<bool(const std::shared_ptr<void>&)> HookObjectCommit;
+    std::shared_ptr<void> hookObject(const std::string &name,const std::function<std::shared_ptr<void>()> &create,const HookObjectCommit &commit);
+    bool commitHookObjects();
+    void discardHookObjects();
 };
 
 
@@ -175,4 +175,25 @@ std::map<std::string, std::string> DobbyRdkPluginUtils::getAnnotations() const
    EXPECT_NE(impl, nullptr);
 
     return impl->getAnnotations();
-}
\ No newline at end of file
+}
+
+std::shared_ptr<void> DobbyRdkPluginUtils::hookObject(const std::string &name,const std::function<std::shared_ptr<void>()> &create,const HookObjectCommit &commit)
+{
+   EXPECT_NE(impl, nullptr);
+
+    return impl->hookObject(name, create, commit);
+}
+
+bool DobbyRdkPluginUtils::commitHookObjects()
+{
+   EXPECT_NE(impl, nullptr);
+
+    return impl->commitHookObjects();
+}
+
+void DobbyRdkPluginUtils::discardHookObjects()
+{
+   EXPECT_NE(impl, nullptr);
+
+    impl->discardHookObjects();
+}
@@ -46,5 +46,8 @@ public:
     MOCK_METHOD(bool, addAnnotation, (const std::string &key, const std::string &value), (override));
     MOCK_METHOD(bool, removeAnnotation, (const std::string &key), (override));
     MOCK_METHOD((std::map<std::string, std::string>), getAnnotations, (), (const, override));
+    MOCK_METHOD(std::shared_ptr<void>, hookObject, (const std::string &name,const std::function<std::shared_ptr<void>()> &create,const std::function<bool(const std::shared_ptr<void>&)> &commit), (override));
+    MOCK_METHOD(bool, commitHookObjects, (), (override));
+    MOCK_METHOD(void, discardHookObjects, (), (override));
 };
 
@@ -40,4 +40,7 @@ class DobbySettingsMock : public IDobbySettings {
     MOCK_METHOD(StraceSettings, straceSettings, (), (const, override));
     MOCK_METHOD(ApparmorSettings, apparmorSettings, (), (const, override));
     MOCK_METHOD(PidsSettings, pidsSettings, (), (const, override));
+    MOCK_METHOD(CpusetPlacementSettings, cpusetPlacementSettings, (), (const, override));
+    MOCK_METHOD(SpecCacheSettings, specCacheSettings, (), (const, override));
+    MOCK_METHOD(HookServerSettings, hookServerSettings, (), (const, override));
 };
@@ -26,6 +26,7 @@
 #include "IDobbyRdkPlugin.h"
 #include "IDobbyRdkLoggingPlugin.h"
 #include "ContainerId.h"
+#include "DobbyPluginMetrics.h"
 #include <IIpcService.h>
 
 #include <pthread.h>
@@ -118,6 +119,8 @@ public:
 
     virtual std::string ociConfigOfContainer(int32_t cd) const = 0;
 
+    virtual DobbyPluginMetrics::Snapshot pluginMetrics() const = 0;
+
 };
 
 class DobbyManager {
@@ -131,6 +134,8 @@ public:
     typedef std::function<void(int32_t cd, const ContainerId& id)> ContainerStartedFunc;
     typedef std::function<void(int32_t cd, const ContainerId& id, int32_t status)> ContainerStoppedFunc;
     typedef std::function<void(int32_t cd, const ContainerId& id)> ContainerHibernatedFunc;
+    typedef std::function<void(int32_t cd, const ContainerId& id, pid_t victim)> ContainerOomFunc;
+    typedef std::function<bool(std::function<void()>&& work)> PostWorkFunc;
 
     DobbyManager();
     DobbyManager(std::shared_ptr<DobbyEnv>&,
@@ -140,7 +145,9 @@ public:
                                   std::function<void(int, const ContainerId&)>& StartedFunc,
                                   std::function<void(int, const ContainerId&, int)>& StoppedFunc,
                                   std::function<void(int32_t cd, const ContainerId& id)>& containerHibernatedCb,
-                                  std::function<void(int32_t cd, const ContainerId& id)>& containerAwokenCb);
+                                  std::function<void(int32_t cd, const ContainerId& id)>& containerAwokenCb,
+                                  std::function<void(int32_t cd, const ContainerId& id, pid_t victim)>& containerOomCb,
+                                  std::function<bool(std::function<void()>&& work)>& postWorkCb);
     ~DobbyManager();
 
     static void setImpl(DobbyManagerImpl* newImpl);
@@ -188,6 +195,7 @@ public:
     int32_t stateOfContainer(int32_t cd);
     std::string statsOfContainer(int32_t cd);
     std::string ociConfigOfContainer(int32_t cd);
+    DobbyPluginMetrics::Snapshot pluginMetrics();
 
     ContainerStartedFunc mContainerStartedCb;
     ContainerStoppedFunc mContainerStoppedCb;
@@ -33,6 +33,12 @@ rt_dobby_schema_parse_file (const char *filename, const struct parser_context *c
    rt_dobby_schema *ptr = NULL;
    return ptr;
 }
+rt_dobby_schema *
+rt_dobby_schema_parse_data (const char *jsondata, const struct parser_context *ctx, parser_error *err)
+{
+   rt_dobby_schema *ptr = NULL;
+   return ptr;
+}
 void
 free_rt_dobby_schema (rt_dobby_schema *ptr)
 {
@@ -0,0 +1,424 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#define private public
+#include "BridgeFilter.h"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/netlink.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+typedef std::vector<std::pair<uint16_t, std::string>> AttrList;
+
+// Splits a block of netlink attributes into their types (without the nested
+// flag) and payloads.
+static AttrList parseAttrs(const std::string &data)
+{
+    AttrList attrs;
+    size_t offset = 0;
+    while ((offset + NLA_HDRLEN) <= data.size())
+    {
+        struct nlattr attr;
+        memcpy(&attr, data.data() + offset, sizeof(attr));
+        if ((attr.nla_len < NLA_HDRLEN) || ((offset + attr.nla_len) > data.size()))
+            break;
+
+        attrs.emplace_back(attr.nla_type & NLA_TYPE_MASK,
+                           data.substr(offset + NLA_HDRLEN, attr.nla_len - NLA_HDRLEN));
+        offset += NLA_ALIGN(attr.nla_len);
+    }
+    return attrs;
+}
+
+static std::string findAttr(const AttrList &attrs, uint16_t type)
+{
+    for (const auto &attr : attrs)
+    {
+        if (attr.first == type)
+            return attr.second;
+    }
+    return std::string();
+}
+
+static uint32_t attrU32(const AttrList &attrs, uint16_t type)
+{
+    const std::string data = findAttr(attrs, type);
+    uint32_t value = 0;
+    if (data.size() == sizeof(value))
+        memcpy(&value, data.data(), sizeof(value));
+    return ntohl(value);
+}
+
+static std::string attrString(const AttrList &attrs, uint16_t type)
+{
+    const std::string data = findAttr(attrs, type);
+    return data.substr(0, data.find('\0'));
+}
+
+// The value a cmp expression compares the register against.
+static std::string cmpValue(const AttrList &exprData)
+{
+    return findAttr(parseAttrs(findAttr(exprData, NFTA_CMP_DATA)), NFTA_DATA_VALUE);
+}
+
+static BridgeFilter::Rule parsedRule(const std::string &args)
+{
+    BridgeFilter::Rule rule;
+    rule.operation = BridgeFilter::Operation::Insert;
+    rule.args = args;
+    rule.native = BridgeFilter::parseRule(args, &rule);
+    return rule;
+}
+
+TEST(BridgeFilterParseTest, ParsesIpv4Rule)
+{
+    const BridgeFilter::Rule rule =
+        parsedRule("OUTPUT -o veth0 -p IPv4 --ip-dst 239.0.0.1 -j ACCEPT");
+
+    ASSERT_TRUE(rule.native);
+    EXPECT_EQ(rule.chain, "OUTPUT");
+    EXPECT_EQ(rule.outIface, "veth0");
+    EXPECT_TRUE(rule.inIface.empty());
+    EXPECT_EQ(rule.protocol, ETH_P_IP);
+    EXPECT_TRUE(rule.srcAddress.empty());
+    EXPECT_EQ(rule.dstAddress, std::vector<uint8_t>({ 239, 0, 0, 1 }));
+    EXPECT_EQ(rule.verdict, static_cast<uint32_t>(NF_ACCEPT));
+    EXPECT_EQ(rule.comment, "dobby:OUTPUT -o veth0 -p IPv4 --ip-dst 239.0.0.1 -j ACCEPT");
+}
+
+TEST(BridgeFilterParseTest, ParsesIpv6RuleAndNormalisesComment)
+{
+    const BridgeFilter::Rule rule =
+        parsedRule("  FORWARD   --in-interface eth0 -p IPv6 --ip6-source ff02::fb -j DROP ");
+
+    ASSERT_TRUE(rule.native);
+    EXPECT_EQ(rule.chain, "FORWARD");
+    EXPECT_EQ(rule.inIface, "eth0");
+    EXPECT_EQ(rule.protocol, ETH_P_IPV6);
+    ASSERT_EQ(rule.srcAddress.size(), 16u);
+    EXPECT_EQ(rule.srcAddress[0], 0xff);
+    EXPECT_EQ(rule.srcAddress[1], 0x02);
+    EXPECT_EQ(rule.srcAddress[15], 0xfb);
+    EXPECT_EQ(rule.verdict, static_cast<uint32_t>(NF_DROP));
+
+    // the comment is what the delete is matched on, so the same rule with
+    // different spacing has to give the same comment
+    EXPECT_EQ(rule.comment, "dobby:FORWARD --in-interface eth0 -p IPv6 --ip6-source ff02::fb -j DROP");
+}
+
+TEST(BridgeFilterParseTest, RejectsRulesItCantEncode)
+{
+    const char* const unsupported[] =
+    {
+        "OUTPUT --logical-in br0 -j ACCEPT",                // unknown option
+        "OUTPUT -o ! veth0 -j ACCEPT",                      // negation
+        "OUTPUT -o veth+ -j ACCEPT",                        // wildcard
+        "OUTPUT -p IPv4 --ip-dst 239.0.0.0/8 -j ACCEPT",    // mask
+        "OUTPUT --ip-dst 239.0.0.1 -j ACCEPT",              // address without protocol
+        "OUTPUT -p IPv6 --ip-dst 239.0.0.1 -j ACCEPT",      // address of the wrong family
+        "OUTPUT -p 0x88cc -j ACCEPT",                       // unnamed protocol
+        "OUTPUT -o veth0 -j RETURN",                        // unsupported target
+        "OUTPUT -o veth0",                                  // no target
+        "OUTPUT -o veth0 -j",                               // missing value
+        "PREROUTING -j ACCEPT",                             // not a filter chain
+        "",
+    };
+
+    for (const char *args : unsupported)
+    {
+        EXPECT_FALSE(parsedRule(args).native) << "'" << args << "'";
+    }
+}
+
+TEST(BridgeFilterEncodeTest, EncodesRuleAsEbtablesNftWould)
+{
+    const BridgeFilter::Rule rule =
+        parsedRule("OUTPUT -o veth0 -p IPv4 --ip-dst 239.0.0.1 -j DROP");
+    ASSERT_TRUE(rule.native);
+
+    std::vector<uint8_t> buf;
+    BridgeFilter::encodeRule(rule, 42, &buf);
+
+    // a single NEWRULE message for the bridge family, inserted at the start
+    // of the chain (no NLM_F_APPEND)
+    ASSERT_GE(buf.size(), NLMSG_LENGTH(sizeof(struct nfgenmsg)));
+    struct nlmsghdr header;
+    memcpy(&header, buf.data(), sizeof(header));
+    EXPECT_EQ(header.nlmsg_len, buf.size());
+    EXPECT_EQ(header.nlmsg_type, (NFNL_SUBSYS_NFTABLES << 8) | NFT_MSG_NEWRULE);
+    EXPECT_EQ(header.nlmsg_flags, NLM_F_REQUEST | NLM_F_CREATE | NLM_F_ACK);
+    EXPECT_EQ(header.nlmsg_seq, 42u);
+
+    struct nfgenmsg message;
+    memcpy(&message, buf.data() + NLMSG_HDRLEN, sizeof(message));
+    EXPECT_EQ(message.nfgen_family, NFPROTO_BRIDGE);
+
+    const size_t attrsOffset = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+    const AttrList attrs = parseAttrs(std::string(buf.begin() + attrsOffset, buf.end()));
+    EXPECT_EQ(attrString(attrs, NFTA_RULE_TABLE), "filter");
+    EXPECT_EQ(attrString(attrs, NFTA_RULE_CHAIN), "OUTPUT");
+
+    // oifname == "veth0", ether type == IPv4, ip daddr == 239.0.0.1, drop
+    const AttrList exprs = parseAttrs(findAttr(attrs, NFTA_RULE_EXPRESSIONS));
+    std::vector<std::string> names;
+    std::vector<AttrList> data;
+    for (const auto &expr : exprs)
+    {
+        ASSERT_EQ(expr.first, NFTA_LIST_ELEM);
+        const AttrList elem = parseAttrs(expr.second);
+        names.push_back(attrString(elem, NFTA_EXPR_NAME));
+        data.push_back(parseAttrs(findAttr(elem, NFTA_EXPR_DATA)));
+    }
+
+    const std::vector<std::string> expectedNames =
+        { "meta", "cmp", "payload", "cmp", "payload", "cmp", "immediate" };
+    ASSERT_EQ(names, expectedNames);
+
+    EXPECT_EQ(attrU32(data[0], NFTA_META_KEY), static_cast<uint32_t>(NFT_META_OIFNAME));
+    EXPECT_EQ(cmpValue(data[1]), std::string("veth0", 6));
+
+    EXPECT_EQ(attrU32(data[2], NFTA_PAYLOAD_BASE), static_cast<uint32_t>(NFT_PAYLOAD_LL_HEADER));
+    EXPECT_EQ(attrU32(data[2], NFTA_PAYLOAD_OFFSET), 12u);
+    EXPECT_EQ(attrU32(data[2], NFTA_PAYLOAD_LEN), 2u);
+    EXPECT_EQ(cmpValue(data[3]), std::string("\x08\x00", 2));
+
+    EXPECT_EQ(attrU32(data[4], NFTA_PAYLOAD_BASE), static_cast<uint32_t>(NFT_PAYLOAD_NETWORK_HEADER));
+    EXPECT_EQ(attrU32(data[4], NFTA_PAYLOAD_OFFSET), 16u);
+    EXPECT_EQ(attrU32(data[4], NFTA_PAYLOAD_LEN), 4u);
+    EXPECT_EQ(cmpValue(data[5]), std::string("\xef\x00\x00\x01", 4));
+
+    const AttrList verdict =
+        parseAttrs(findAttr(parseAttrs(findAttr(data[6], NFTA_IMMEDIATE_DATA)), NFTA_DATA_VERDICT));
+    EXPECT_EQ(attrU32(verdict, NFTA_VERDICT_CODE), static_cast<uint32_t>(NF_DROP));
+
+    // the comment in the format ebtables-nft and nft use, type 0 followed by
+    // the length and the nul terminated string
+    const std::string comment = "dobby:OUTPUT -o veth0 -p IPv4 --ip-dst 239.0.0.1 -j DROP";
+    std::string expectedUserdata;
+    expectedUserdata += '\0';
+    expectedUserdata += static_cast<char>(comment.size() + 1);
+    expectedUserdata += comment;
+    expectedUserdata += '\0';
+    EXPECT_EQ(findAttr(attrs, NFTA_RULE_USERDATA), expectedUserdata);
+}
+
+TEST(BridgeFilterEncodeTest, EncodesIpv6SourceAddress)
+{
+    const BridgeFilter::Rule rule =
+        parsedRule("INPUT -i eth0 -p IPv6 --ip6-src fe80::1 -j ACCEPT");
+    ASSERT_TRUE(rule.native);
+
+    std::vector<uint8_t> buf;
+    BridgeFilter::encodeRule(rule, 1, &buf);
+
+    const size_t attrsOffset = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+    const AttrList attrs = parseAttrs(std::string(buf.begin() + attrsOffset, buf.end()));
+    const AttrList exprs = parseAttrs(findAttr(attrs, NFTA_RULE_EXPRESSIONS));
+    ASSERT_EQ(exprs.size(), 7u);
+
+    const AttrList meta = parseAttrs(findAttr(parseAttrs(exprs[0].second), NFTA_EXPR_DATA));
+    EXPECT_EQ(attrU32(meta, NFTA_META_KEY), static_cast<uint32_t>(NFT_META_IIFNAME));
+
+    const AttrList ethertype = parseAttrs(findAttr(parseAttrs(exprs[3].second), NFTA_EXPR_DATA));
+    EXPECT_EQ(cmpValue(ethertype), std::string("\x86\xdd", 2));
+
+    // the ipv6 source address is 8 bytes into the header
+    const AttrList payload = parseAttrs(findAttr(parseAttrs(exprs[4].second), NFTA_EXPR_DATA));
+    EXPECT_EQ(attrU32(payload, NFTA_PAYLOAD_OFFSET), 8u);
+    EXPECT_EQ(attrU32(payload, NFTA_PAYLOAD_LEN), 16u);
+
+    const AttrList address = parseAttrs(findAttr(parseAttrs(exprs[5].second), NFTA_EXPR_DATA));
+    struct in6_addr expected;
+    ASSERT_EQ(inet_pton(AF_INET6, "fe80::1", &expected), 1);
+    EXPECT_EQ(cmpValue(address), std::string(reinterpret_cast<const char*>(&expected), 16));
+}
+
+// Tests of which rules go to the ebtables tool, using a script in place of
+// the tool that records the args it was run with.
+class BridgeFilterFallbackTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        char dirTemplate[] = "/tmp/bridgefiltertest.XXXXXX";
+        ASSERT_NE(mkdtemp(dirTemplate), nullptr);
+        mDir = dirTemplate;
+        mToolPath = mDir + "/ebtables";
+        mLogPath = mDir + "/calls";
+        writeTool(0);
+    }
+
+    void TearDown() override
+    {
+        const std::string command = "rm -rf " + mDir;
+        EXPECT_EQ(system(command.c_str()), 0);
+    }
+
+    void writeTool(int exitCode)
+    {
+        std::ofstream tool(mToolPath, std::ios::trunc);
+        tool << "#!/bin/sh\n"
+             << "echo \"$@\" >> " << mLogPath << "\n"
+             << "exit " << exitCode << "\n";
+        tool.close();
+        ASSERT_EQ(chmod(mToolPath.c_str(), 0755), 0);
+    }
+
+    std::vector<std::string> toolCalls() const
+    {
+        std::vector<std::string> calls;
+        std::ifstream log(mLogPath);
+        std::string line;
+        while (std::getline(log, line))
+            calls.push_back(line);
+        return calls;
+    }
+
+    std::string mDir;
+    std::string mToolPath;
+    std::string mLogPath;
+};
+
+TEST_F(BridgeFilterFallbackTest, UnsupportedRuleIsRunThroughTool)
+{
+    BridgeFilter filter(mToolPath);
+    filter.insertRule("OUTPUT --logical-in br0 -j ACCEPT");
+    filter.deleteRule("OUTPUT -o veth0 -j RETURN");
+
+    ASSERT_EQ(filter.mRules.size(), 2u);
+    EXPECT_FALSE(filter.mRules.front().native);
+    EXPECT_FALSE(filter.mRules.back().native);
+
+    EXPECT_TRUE(filter.commit());
+    EXPECT_TRUE(filter.mRules.empty());
+
+    const std::vector<std::string> expected =
+        { "-I OUTPUT --logical-in br0 -j ACCEPT", "-D OUTPUT -o veth0 -j RETURN" };
+    EXPECT_EQ(toolCalls(), expected);
+}
+
+TEST_F(BridgeFilterFallbackTest, LegacyEbtablesRunsEveryRuleThroughTool)
+{
+    BridgeFilter filter(mToolPath);
+    filter.mNativeSupported = false;
+
+    filter.insertRule("OUTPUT -o veth0 -p IPv4 --ip-dst 239.0.0.1 -j ACCEPT");
+    filter.deleteRule("OUTPUT -o veth1 -p IPv4 --ip-dst 239.0.0.2 -j DROP");
+
+    // rules that could be encoded still aren't
+    ASSERT_EQ(filter.mRules.size(), 2u);
+    EXPECT_FALSE(filter.mRules.front().native);
+    EXPECT_FALSE(filter.mRules.back().native);
+
+    EXPECT_TRUE(filter.commit());
+
+    const std::vector<std::string> expected =
+    {
+        "-I OUTPUT -o veth0 -p IPv4 --ip-dst 239.0.0.1 -j ACCEPT",
+        "-D OUTPUT -o veth1 -p IPv4 --ip-dst 239.0.0.2 -j DROP",
+    };
+    EXPECT_EQ(toolCalls(), expected);
+}
+
+TEST_F(BridgeFilterFallbackTest, ToolFailureFailsCommit)
+{
+    writeTool(1);
+
+    BridgeFilter filter(mToolPath);
+    filter.insertRule("OUTPUT --logical-in br0 -j ACCEPT");
+    filter.insertRule("OUTPUT --logical-out br0 -j ACCEPT");
+
+    EXPECT_FALSE(filter.commit());
+
+    // a failed rule doesn't stop the rest being tried
+    EXPECT_EQ(toolCalls().size(), 2u);
+}
+
+TEST_F(BridgeFilterFallbackTest, DetectsLegacyEbtables)
+{
+    const std::string legacy = mDir + "/xtables-legacy-multi";
+    const std::string nft = mDir + "/xtables-nft-multi";
+    const std::string legacyLink = mDir + "/ebtables-legacy-link";
+    const std::string nftLink = mDir + "/ebtables-nft-link";
+    const std::string missing = mDir + "/missing";
+
+    std::ofstream(legacy).close();
+    std::ofstream(nft).close();
+    ASSERT_EQ(symlink(legacy.c_str(), legacyLink.c_str()), 0);
+    ASSERT_EQ(symlink(nft.c_str(), nftLink.c_str()), 0);
+
+    // the real file is checked, not the name of the link
+    EXPECT_FALSE(BridgeFilter::nativeSupported({ legacyLink }));
+    EXPECT_TRUE(BridgeFilter::nativeSupported({ nftLink }));
+
+    // the first one found is the one that's used
+    EXPECT_FALSE(BridgeFilter::nativeSupported({ missing, legacyLink, nftLink }));
+    EXPECT_TRUE(BridgeFilter::nativeSupported({ missing, nftLink, legacyLink }));
+
+    // with no ebtables at all nothing can be using the legacy tables
+    EXPECT_TRUE(BridgeFilter::nativeSupported({ missing }));
+}
+
+TEST_F(BridgeFilterFallbackTest, NativeRulesRoundTripInNewNamespace)
+{
+    if (geteuid() != 0)
+    {
+        GTEST_SKIP() << "needs root to create a network namespace";
+    }
+
+    const std::string args = "OUTPUT -o veth0 -p IPv4 --ip-dst 239.0.0.1 -j ACCEPT";
+
+    // the filter opens its socket in the calling thread's namespace, so the
+    // rules never touch the host's tables
+    std::thread thread([&]()
+    {
+        ASSERT_EQ(unshare(CLONE_NEWNET), 0);
+
+        BridgeFilter filter(mToolPath);
+        filter.mNativeSupported = true;
+
+        filter.insertRule(args);
+        EXPECT_TRUE(filter.commit());
+        EXPECT_TRUE(toolCalls().empty()) << "insert wasn't applied natively";
+
+        // the rule inserted natively is found again by its comment
+        filter.deleteRule("OUTPUT  -o veth0 -p IPv4 --ip-dst 239.0.0.1  -j ACCEPT");
+        EXPECT_TRUE(filter.commit());
+        EXPECT_TRUE(toolCalls().empty()) << "delete wasn't applied natively";
+
+        // it's gone now, so a second delete is handed to the tool
+        filter.deleteRule(args);
+        EXPECT_TRUE(filter.commit());
+        EXPECT_EQ(toolCalls(), std::vector<std::string>({ "-D " + args }));
+    });
+    thread.join();
+}
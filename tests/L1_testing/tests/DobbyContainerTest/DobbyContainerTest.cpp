@@ -0,0 +1,142 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <limits.h>
+#define private public
+#include "DobbyContainer.h"
+
+class DobbyContainerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        container.setRestartOnCrash({ });
+    }
+
+    // returns the backoff with the given number of attempts made
+    std::chrono::milliseconds backoffAfter(unsigned attempts)
+    {
+        container.mRestartCount = attempts;
+        return container.restartBackoff();
+    }
+
+    DobbyContainer container{ nullptr, nullptr, nullptr };
+};
+
+TEST_F(DobbyContainerTest, BackoffDoublesWithEachAttempt)
+{
+    // 250ms, 500ms, 1s, 2s, ... each within +/-25%
+    for (unsigned attempt = 1; attempt <= 7; attempt++)
+    {
+        const long expected = 250L << (attempt - 1);
+
+        for (int i = 0; i < 50; i++)
+        {
+            const long delay = backoffAfter(attempt).count();
+            EXPECT_GE(delay, expected - (expected / 4)) << "attempt " << attempt;
+            EXPECT_LE(delay, expected + (expected / 4)) << "attempt " << attempt;
+        }
+    }
+}
+
+TEST_F(DobbyContainerTest, BackoffIsCappedAtThirtySeconds)
+{
+    // 250ms << 7 is 32s, so the cap applies from the 8th attempt
+    for (unsigned attempt : { 8u, 9u, 10u, 17u, 32u, 1000u })
+    {
+        for (int i = 0; i < 50; i++)
+        {
+            const long delay = backoffAfter(attempt).count();
+            EXPECT_GE(delay, 22500) << "attempt " << attempt;
+            EXPECT_LE(delay, 37500) << "attempt " << attempt;
+        }
+    }
+}
+
+TEST_F(DobbyContainerTest, BackoffJitterSpreadsTheDelay)
+{
+    // the jitter should actually move the delay around, not just stay
+    // within bounds
+    long minDelay = LONG_MAX;
+    long maxDelay = 0;
+
+    for (int i = 0; i < 500; i++)
+    {
+        const long delay = backoffAfter(5).count();
+        minDelay = std::min(minDelay, delay);
+        maxDelay = std::max(maxDelay, delay);
+    }
+
+    EXPECT_GE(minDelay, 3000);
+    EXPECT_LE(maxDelay, 5000);
+    EXPECT_LT(minDelay, 3500);
+    EXPECT_GT(maxDelay, 4500);
+}
+
+TEST_F(DobbyContainerTest, BackoffBeforeAnyAttemptIsTheBase)
+{
+    const long delay = backoffAfter(0).count();
+    EXPECT_GE(delay, 187);
+    EXPECT_LE(delay, 313);
+}
+
+TEST_F(DobbyContainerTest, BudgetAllowsTenRestartsInTheWindow)
+{
+    for (unsigned i = 1; i <= 10; i++)
+    {
+        EXPECT_TRUE(container.shouldRestart(EXIT_FAILURE)) << "attempt " << i;
+        EXPECT_EQ(container.restartCount(), i);
+    }
+
+    EXPECT_FALSE(container.shouldRestart(EXIT_FAILURE));
+    EXPECT_FALSE(container.shouldRestart(EXIT_FAILURE));
+    EXPECT_EQ(container.totalRestartCount(), 10u);
+}
+
+TEST_F(DobbyContainerTest, BudgetIsRefilledAfterFiveMinutes)
+{
+    for (unsigned i = 1; i <= 10; i++)
+    {
+        EXPECT_TRUE(container.shouldRestart(EXIT_FAILURE));
+    }
+
+    // move the last attempt back to just inside the window
+    container.mLastRestartAttempt = std::chrono::steady_clock::now() - std::chrono::minutes(4);
+    EXPECT_FALSE(container.shouldRestart(EXIT_FAILURE));
+
+    // and then outside it
+    container.mLastRestartAttempt = std::chrono::steady_clock::now() - std::chrono::minutes(6);
+    EXPECT_TRUE(container.shouldRestart(EXIT_FAILURE));
+    EXPECT_EQ(container.restartCount(), 1u);
+    EXPECT_EQ(container.totalRestartCount(), 11u);
+
+    // the backoff starts again from the base too
+    EXPECT_LE(container.restartBackoff().count(), 313);
+}
+
+TEST_F(DobbyContainerTest, NoRestartOnCleanExitOrWithoutFlag)
+{
+    EXPECT_FALSE(container.shouldRestart(EXIT_SUCCESS));
+    EXPECT_EQ(container.restartCount(), 0u);
+
+    container.clearRestartOnCrash();
+    EXPECT_FALSE(container.shouldRestart(EXIT_FAILURE));
+}
@@ -0,0 +1,288 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include "ContainerId.h"
+#define private public
+#include "DobbyCpusetPlacer.h"
+#undef private
+#include "DobbyEnvMock.h"
+#include "DobbyUtilsMock.h"
+
+using ::testing::_;
+using ::testing::NiceMock;
+using ::testing::Return;
+using ::testing::Invoke;
+
+DobbyUtilsImpl* DobbyUtils::impl = nullptr;
+
+static std::string readFile(const std::string &path, size_t)
+{
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static bool writeFile(const std::string &path, const std::string &str, int, mode_t)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << str;
+    return file.good();
+}
+
+class DobbyCpusetPlacerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/dobbycpuset-XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        mCgroupPath = tmpl;
+
+        // four cores available to the containers
+        writeFile(mCgroupPath + "/cpuset.cpus.effective", "0-3\n", 0, 0);
+
+        p_envMock = new NiceMock<DobbyEnvMock>;
+        p_utilsMock = new NiceMock<DobbyUtilsMock>;
+        DobbyEnv::setImpl(p_envMock);
+        DobbyUtils::setImpl(p_utilsMock);
+
+        ON_CALL(*p_envMock, cgroupVersion())
+            .WillByDefault(Return(IDobbyEnv::CgroupVersion::V2));
+        ON_CALL(*p_envMock, cgroupMountPath(_))
+            .WillByDefault(Return(mCgroupPath));
+        ON_CALL(*p_utilsMock, readTextFile(_, _))
+            .WillByDefault(Invoke(readFile));
+        ON_CALL(*p_utilsMock, writeTextFile(_, _, _, _))
+            .WillByDefault(Invoke(writeFile));
+
+        mEnv = std::make_shared<DobbyEnv>();
+        mUtils = std::make_shared<DobbyUtils>();
+
+        mSettings.enabled = true;
+        mSettings.foregroundApps = { "foreground" };
+        mSettings.foregroundCores = 1;
+        mSettings.coresPerContainer = 0;
+        mSettings.rebalanceInterval = 0;
+    }
+
+    void TearDown() override
+    {
+        mPlacer.reset();
+
+        DobbyEnv::setImpl(nullptr);
+        DobbyUtils::setImpl(nullptr);
+        delete p_envMock;
+        delete p_utilsMock;
+
+        const std::string command = "rm -rf " + mCgroupPath;
+        EXPECT_EQ(system(command.c_str()), 0);
+    }
+
+    void createPlacer()
+    {
+        mPlacer = std::make_unique<DobbyCpusetPlacer>(mEnv, mUtils, mSettings);
+    }
+
+    // creates the cgroup dir of a container, initially on all the cores
+    ContainerId createContainer(const std::string &name, uint64_t usageUsec = 0)
+    {
+        const std::string dir = mCgroupPath + "/" + name;
+        EXPECT_EQ(mkdir(dir.c_str(), 0755), 0);
+        writeFile(dir + "/cpuset.cpus", "0-3\n", 0, 0);
+        setUsage(name, usageUsec);
+
+        return ContainerId::create(name);
+    }
+
+    void setUsage(const std::string &name, uint64_t usageUsec)
+    {
+        writeFile(mCgroupPath + "/" + name + "/cpu.stat",
+                  "usage_usec " + std::to_string(usageUsec) + "\nuser_usec 0\n", 0, 0);
+    }
+
+    // returns the cores in the container's cpuset.cpus file, normalised
+    std::string cpusOf(const std::string &name)
+    {
+        const std::string contents = readFile(mCgroupPath + "/" + name + "/cpuset.cpus", 0);
+        return DobbyCpusetPlacer::formatCpuList(DobbyCpusetPlacer::parseCpuList(contents));
+    }
+
+    NiceMock<DobbyEnvMock> *p_envMock = nullptr;
+    NiceMock<DobbyUtilsMock> *p_utilsMock = nullptr;
+
+    std::string mCgroupPath;
+    std::shared_ptr<IDobbyEnv> mEnv;
+    std::shared_ptr<IDobbyUtils> mUtils;
+    IDobbySettings::CpusetPlacementSettings mSettings;
+    std::unique_ptr<DobbyCpusetPlacer> mPlacer;
+};
+
+TEST(DobbyCpusetPlacerParseTest, ParsesRangesAndSingleCores)
+{
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList("0-3"), std::vector<unsigned>({ 0, 1, 2, 3 }));
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList("0-2,4"), std::vector<unsigned>({ 0, 1, 2, 4 }));
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList("5"), std::vector<unsigned>({ 5 }));
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList("6,1-2,0"), std::vector<unsigned>({ 0, 1, 2, 6 }));
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList("1-3,2-4"), std::vector<unsigned>({ 1, 2, 3, 4 }));
+}
+
+TEST(DobbyCpusetPlacerParseTest, IgnoresSurroundingWhitespace)
+{
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList("0-3\n"), std::vector<unsigned>({ 0, 1, 2, 3 }));
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList("0-3 \n"), std::vector<unsigned>({ 0, 1, 2, 3 }));
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList("  1,3\t\r\n"), std::vector<unsigned>({ 1, 3 }));
+}
+
+TEST(DobbyCpusetPlacerParseTest, RejectsInvalidLists)
+{
+    EXPECT_TRUE(DobbyCpusetPlacer::parseCpuList("").empty());
+    EXPECT_TRUE(DobbyCpusetPlacer::parseCpuList("\n").empty());
+    EXPECT_TRUE(DobbyCpusetPlacer::parseCpuList("abc").empty());
+    EXPECT_TRUE(DobbyCpusetPlacer::parseCpuList("1-").empty());
+    EXPECT_TRUE(DobbyCpusetPlacer::parseCpuList("3-1").empty());
+    EXPECT_TRUE(DobbyCpusetPlacer::parseCpuList("1,,2").empty());
+    EXPECT_TRUE(DobbyCpusetPlacer::parseCpuList("1 2").empty());
+    EXPECT_TRUE(DobbyCpusetPlacer::parseCpuList("-1").empty());
+}
+
+TEST(DobbyCpusetPlacerParseTest, FormatsRangesAndSingleCores)
+{
+    EXPECT_EQ(DobbyCpusetPlacer::formatCpuList({ }), "");
+    EXPECT_EQ(DobbyCpusetPlacer::formatCpuList({ 3 }), "3");
+    EXPECT_EQ(DobbyCpusetPlacer::formatCpuList({ 0, 1, 2, 4 }), "0-2,4");
+    EXPECT_EQ(DobbyCpusetPlacer::formatCpuList({ 0, 2, 4 }), "0,2,4");
+    EXPECT_EQ(DobbyCpusetPlacer::formatCpuList({ 0, 1, 3, 4, 5, 7 }), "0-1,3-5,7");
+}
+
+TEST(DobbyCpusetPlacerParseTest, FormatThenParseRoundTrips)
+{
+    const std::vector<unsigned> cores = { 0, 1, 2, 5, 7, 8, 9, 15 };
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList(DobbyCpusetPlacer::formatCpuList(cores)), cores);
+}
+
+TEST_F(DobbyCpusetPlacerTest, ForegroundAppGetsDedicatedCores)
+{
+    createPlacer();
+    ASSERT_EQ(mPlacer->mCores, std::vector<unsigned>({ 0, 1, 2, 3 }));
+
+    // on its own a background container keeps all the cores
+    EXPECT_TRUE(mPlacer->addContainer(createContainer("background"), "background"));
+    EXPECT_EQ(cpusOf("background"), "0-3");
+
+    // the foreground app gets the highest core to itself
+    EXPECT_TRUE(mPlacer->addContainer(createContainer("foreground"), "foreground"));
+    EXPECT_EQ(cpusOf("foreground"), "3");
+    EXPECT_EQ(cpusOf("background"), "0-2");
+
+    // and gives it back when it goes
+    mPlacer->removeContainer(ContainerId::create("foreground"));
+    EXPECT_EQ(cpusOf("background"), "0-3");
+}
+
+TEST_F(DobbyCpusetPlacerTest, ForegroundNeverTakesTheLastCore)
+{
+    mSettings.foregroundCores = 8;
+    createPlacer();
+
+    EXPECT_TRUE(mPlacer->addContainer(createContainer("background"), "background"));
+    EXPECT_TRUE(mPlacer->addContainer(createContainer("foreground"), "foreground"));
+
+    EXPECT_EQ(cpusOf("foreground"), "1-3");
+    EXPECT_EQ(cpusOf("background"), "0");
+}
+
+TEST_F(DobbyCpusetPlacerTest, BackgroundContainersAreSpreadOverCores)
+{
+    mSettings.coresPerContainer = 1;
+    createPlacer();
+
+    for (const char *name : { "a", "b", "c", "d" })
+        EXPECT_TRUE(mPlacer->addContainer(createContainer(name), name));
+
+    // all idle, so each should end up on its own core
+    std::set<std::string> used;
+    for (const char *name : { "a", "b", "c", "d" })
+        used.insert(cpusOf(name));
+    EXPECT_EQ(used, std::set<std::string>({ "0", "1", "2", "3" }));
+}
+
+TEST_F(DobbyCpusetPlacerTest, HeaviestContainerGetsTheEmptiestCores)
+{
+    mSettings.coresPerContainer = 2;
+    createPlacer();
+
+    for (const char *name : { "light", "heavy", "medium" })
+        EXPECT_TRUE(mPlacer->addContainer(createContainer(name), name));
+
+    mPlacer->mContainers[ContainerId::create("heavy")].load = 1.8;
+    mPlacer->mContainers[ContainerId::create("medium")].load = 0.6;
+    mPlacer->mContainers[ContainerId::create("light")].load = 0.1;
+    mPlacer->placeContainers();
+
+    // heavy gets two cores to itself, medium the other two, light shares
+    // with medium as that pair is then the least loaded
+    const std::string heavy = cpusOf("heavy");
+    const std::string medium = cpusOf("medium");
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList(heavy).size(), 2u);
+    EXPECT_EQ(DobbyCpusetPlacer::parseCpuList(medium).size(), 2u);
+    EXPECT_NE(heavy, medium);
+    EXPECT_EQ(cpusOf("light"), medium);
+}
+
+TEST_F(DobbyCpusetPlacerTest, LoadIsMeasuredFromWhenTheContainerWasAdded)
+{
+    createPlacer();
+
+    EXPECT_TRUE(mPlacer->addContainer(createContainer("old", 0), "old"));
+    EXPECT_TRUE(mPlacer->addContainer(createContainer("new", 0), "new"));
+
+    DobbyCpusetPlacer::Container &oldContainer = mPlacer->mContainers[ContainerId::create("old")];
+    DobbyCpusetPlacer::Container &newContainer = mPlacer->mContainers[ContainerId::create("new")];
+
+    // pretend 'old' was added 4s ago and 'new' 1s ago, both kept one core
+    // busy since then
+    const auto now = std::chrono::steady_clock::now();
+    oldContainer.lastSampleTime = now - std::chrono::seconds(4);
+    newContainer.lastSampleTime = now - std::chrono::seconds(1);
+    setUsage("old", 4000000);
+    setUsage("new", 1000000);
+
+    mPlacer->updateLoads();
+
+    EXPECT_NEAR(oldContainer.load, 1.0, 0.05);
+    EXPECT_NEAR(newContainer.load, 1.0, 0.05);
+    EXPECT_EQ(oldContainer.lastUsage, 4000000u);
+    EXPECT_EQ(newContainer.lastSampleTime, oldContainer.lastSampleTime);
+}
+
+TEST_F(DobbyCpusetPlacerTest, ContainerWithoutCgroupIsNotManaged)
+{
+    createPlacer();
+
+    EXPECT_FALSE(mPlacer->addContainer(ContainerId::create("missing"), "missing"));
+    EXPECT_TRUE(mPlacer->mContainers.empty());
+}
@@ -38,6 +38,9 @@
 
 #include "DobbyRunCMock.h"
 #include "DobbyUtilsMock.h"
+#include "DobbyCgroupMonitorMock.h"
+#include "DobbyCpusetPlacerMock.h"
+#include "DobbyHookServerProcessMock.h"
 
 #include "DobbyManager.h"
 #include "DobbyContainerMock.h"
@@ -94,6 +97,9 @@ AI_IPC::IpcFileDescriptorApiImpl* AI_IPC::IpcFileDescriptor::impl = nullptr;
 DobbyIPCUtilsImpl* DobbyIPCUtils::impl = nullptr;
 DobbyUtilsImpl* DobbyUtils::impl = nullptr;
 DobbyHibernateImpl* DobbyHibernate::impl = nullptr;
+DobbyCgroupMonitorImpl* DobbyCgroupMonitor::impl = nullptr;
+DobbyCpusetPlacerImpl* DobbyCpusetPlacer::impl = nullptr;
+DobbyHookServerProcessImpl* DobbyHookServerProcess::impl = nullptr;
 
 
 using ::testing::NiceMock;
@@ -171,6 +177,7 @@ protected:
         DobbyIPCUtilsMock*  p_ipcutilsMock = nullptr;
         DobbyUtilsMock*  p_utilsMock = nullptr;
         DobbyHibernateMock*  p_hibernateMock = nullptr;
+        DobbyCgroupMonitorMock*  p_cgroupMonitorMock = nullptr;
 
         DobbyBundle *p_bundle = nullptr;
         DobbyBundleConfig *p_bundleConfig = nullptr;
@@ -211,6 +218,7 @@ protected:
             p_ipcutilsMock = new NiceMock <DobbyIPCUtilsMock>;
             p_utilsMock = new NiceMock <DobbyUtilsMock>;
             p_hibernateMock = new NiceMock <DobbyHibernateMock>;
+            p_cgroupMonitorMock = new NiceMock <DobbyCgroupMonitorMock>;
 
             DobbyContainer::setImpl(p_containerMock);
             DobbyRdkPluginManager::setImpl(p_rdkPluginManagerMock);
@@ -237,6 +245,7 @@ protected:
             DobbyIPCUtils::setImpl(p_ipcutilsMock);
             DobbyUtils::setImpl(p_utilsMock);
             DobbyHibernate::setImpl(p_hibernateMock);
+            DobbyCgroupMonitor::setImpl(p_cgroupMonitorMock);
             p_dobbysettingsMock =  std::make_shared<NiceMock<DobbySettingsMock>>();
 
            const std::shared_ptr<DobbyEnv> p_env = std::make_shared<DobbyEnv>(p_dobbysettingsMock);
@@ -308,6 +317,7 @@ protected:
             DobbyIPCUtils::setImpl(nullptr);
             DobbyUtils::setImpl(nullptr);
             DobbyHibernate::setImpl(nullptr);
+            DobbyCgroupMonitor::setImpl(nullptr);
 
             p_dobbysettingsMock.reset();
 
@@ -439,6 +449,12 @@ protected:
                 p_hibernateMock = nullptr;
             }
 
+            if(p_cgroupMonitorMock != nullptr)
+            {
+                delete  p_cgroupMonitorMock;
+                p_cgroupMonitorMock = nullptr;
+            }
+
         }
 
         void expect_startContainerFromBundle(int32_t cd, ContainerId &id)
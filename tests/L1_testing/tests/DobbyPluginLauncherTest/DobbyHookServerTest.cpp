@@ -0,0 +1,246 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DobbyHookServerProtocol.h"
+#include "DobbyPluginMetrics.h"
+#define private public
+#include "DobbyHookServer.h"
+#undef private
+
+// Tests the hook server's request handling and its cache of containers.  The
+// requests tested here are all answered without parsing a container config,
+// running the plugins for a hook is covered by the plugin manager tests.
+class DobbyHookServerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        // kept short, the path of a unix socket is limited to 108 chars
+        mSocketPath = "/tmp/DobbyHookServerTest." + std::to_string(getpid()) + ".sock";
+        mServer.reset(new DobbyHookServer(mSocketPath, "/nonexistent"));
+        ASSERT_TRUE(mServer->isValid());
+    }
+
+    void TearDown() override
+    {
+        mServer.reset();
+    }
+
+    // sends a request of the three '\0' separated fields and returns the
+    // result, with anything after it in @a payload
+    int32_t request(const std::string &hookName, const std::string &configPath,
+                    const std::string &state, std::string *payload = nullptr)
+    {
+        std::string packet = hookName;
+        packet.push_back('\0');
+        packet += configPath;
+        packet.push_back('\0');
+        packet += state;
+
+        return sendPacket(packet, payload);
+    }
+
+    int32_t sendPacket(const std::string &packet, std::string *payload = nullptr)
+    {
+        int sockFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (sockFd < 0)
+        {
+            ADD_FAILURE() << "failed to create socket - " << strerror(errno);
+            return -1;
+        }
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, mSocketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+        int32_t result = -1;
+        std::vector<char> reply(HOOK_SERVER_MAX_REPLY_SIZE + sizeof(result));
+
+        ssize_t rd = -1;
+        if ((connect(sockFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) &&
+            (send(sockFd, packet.data(), packet.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(packet.size())))
+        {
+            rd = recv(sockFd, reply.data(), reply.size(), 0);
+        }
+        close(sockFd);
+
+        if (rd < static_cast<ssize_t>(sizeof(result)))
+        {
+            ADD_FAILURE() << "no reply from the hook server";
+            return -1;
+        }
+
+        memcpy(&result, reply.data(), sizeof(result));
+        if (payload)
+        {
+            payload->assign(reply.data() + sizeof(result), rd - sizeof(result));
+        }
+
+        return result;
+    }
+
+    size_t cachedContainers()
+    {
+        std::lock_guard<std::mutex> locker(mServer->mLock);
+        return mServer->mContainers.size();
+    }
+
+    std::string mSocketPath;
+    std::unique_ptr<DobbyHookServer> mServer;
+};
+
+TEST_F(DobbyHookServerTest, ListensOnASocketOnlyTheOwnerCanUse)
+{
+    struct stat details;
+    ASSERT_EQ(stat(mSocketPath.c_str(), &details), 0);
+    EXPECT_TRUE(S_ISSOCK(details.st_mode));
+    EXPECT_EQ(details.st_mode & 0777, 0600u);
+
+    mServer.reset();
+    EXPECT_NE(access(mSocketPath.c_str(), F_OK), 0);
+}
+
+TEST_F(DobbyHookServerTest, ReplacesALeftoverSocket)
+{
+    // the old socket is left behind as if the server had crashed
+    const int listenFd = mServer->mListenFd;
+    mServer->mListenFd = -1;
+    mServer.reset();
+    close(listenFd);
+    ASSERT_EQ(access(mSocketPath.c_str(), F_OK), 0);
+
+    mServer.reset(new DobbyHookServer(mSocketPath, "/nonexistent"));
+    ASSERT_TRUE(mServer->isValid());
+
+    EXPECT_EQ(request("release", "", "nothing"), HookSuccess);
+}
+
+TEST_F(DobbyHookServerTest, MalformedRequestIsNotHandled)
+{
+    EXPECT_EQ(sendPacket("createRuntime"), HookNotHandled);
+    EXPECT_EQ(sendPacket(std::string("createRuntime\0/bundle/config.json", 32)), HookNotHandled);
+
+    EXPECT_EQ(cachedContainers(), 0u);
+}
+
+TEST_F(DobbyHookServerTest, HooksInTheContainerNamespacesAreLeftToTheLauncher)
+{
+    const std::string state = "{ \"ociVersion\": \"1.0.2\", \"id\": \"test\", \"pid\": 1,"
+                              " \"status\": \"created\", \"bundle\": \"/bundle\" }";
+
+    EXPECT_EQ(request("createContainer", "/bundle/config.json", state), HookNotHandled);
+    EXPECT_EQ(request("startContainer", "/bundle/config.json", state), HookNotHandled);
+    EXPECT_EQ(request("prestart", "/bundle/config.json", state), HookNotHandled);
+
+    EXPECT_EQ(cachedContainers(), 0u);
+}
+
+TEST_F(DobbyHookServerTest, UnparsableStateIsNotHandled)
+{
+    EXPECT_EQ(request("createRuntime", "/bundle/config.json", "not json"), HookNotHandled);
+    EXPECT_EQ(request("poststop", "/bundle/config.json", ""), HookNotHandled);
+
+    EXPECT_EQ(cachedContainers(), 0u);
+}
+
+TEST_F(DobbyHookServerTest, ReleaseDropsTheContainer)
+{
+    mServer->getContainer("first", "/first/config.json");
+    mServer->getContainer("second", "/second/config.json");
+    ASSERT_EQ(cachedContainers(), 2u);
+
+    EXPECT_EQ(request(HOOK_SERVER_RELEASE_REQUEST, "", "first"), HookSuccess);
+    EXPECT_EQ(cachedContainers(), 1u);
+    EXPECT_EQ(mServer->mContainers.count("second"), 1u);
+
+    // releasing an unknown container isn't an error
+    EXPECT_EQ(request(HOOK_SERVER_RELEASE_REQUEST, "", "first"), HookSuccess);
+    EXPECT_EQ(cachedContainers(), 1u);
+}
+
+TEST_F(DobbyHookServerTest, MetricsRequestReturnsTheServersTimings)
+{
+    // the stats are process wide, so may already have been recorded
+    const std::pair<std::string, std::string> key("HookServerTest", "postStart");
+    const DobbyPluginMetrics::Snapshot before = DobbyPluginMetrics::snapshot();
+    const uint64_t count = before.count(key) ? before.at(key).count : 0;
+
+    DobbyPluginMetrics::record(DobbyPluginMetrics::startTimer(),
+                               key.first, key.second, "test", false);
+
+    std::string payload;
+    ASSERT_EQ(request(HOOK_SERVER_METRICS_REQUEST, "", "", &payload), HookSuccess);
+
+    DobbyPluginMetrics::Snapshot snapshot;
+    ASSERT_TRUE(DobbyPluginMetrics::deserialise(payload, &snapshot));
+
+    auto it = snapshot.find(key);
+    ASSERT_NE(it, snapshot.end());
+    EXPECT_EQ(it->second.count, count + 1);
+    EXPECT_EQ(it->second.failures, count + 1);
+}
+
+TEST_F(DobbyHookServerTest, ContainerIsReplacedWhenItsBundleChanges)
+{
+    auto container = mServer->getContainer("test", "/bundle1/config.json");
+    EXPECT_EQ(mServer->getContainer("test", "/bundle1/config.json"), container);
+
+    // the same id re-used for a different bundle
+    auto replaced = mServer->getContainer("test", "/bundle2/config.json");
+    EXPECT_NE(replaced, container);
+    EXPECT_EQ(replaced->configPath, "/bundle2/config.json");
+    EXPECT_EQ(cachedContainers(), 1u);
+}
+
+TEST_F(DobbyHookServerTest, LeastRecentlyUsedContainerIsDropped)
+{
+    // give the containers distinct times, oldest first, then use the first
+    // one again
+    const auto start = std::chrono::steady_clock::now() - std::chrono::hours(1);
+    for (int i = 0; i < 32; i++)
+    {
+        mServer->getContainer("c" + std::to_string(i), "/config.json")->lastUsed =
+            start + std::chrono::seconds(i);
+    }
+    mServer->getContainer("c0", "/config.json");
+    ASSERT_EQ(cachedContainers(), 32u);
+
+    mServer->getContainer("c32", "/config.json");
+
+    EXPECT_EQ(cachedContainers(), 32u);
+    EXPECT_EQ(mServer->mContainers.count("c0"), 1u);
+    EXPECT_EQ(mServer->mContainers.count("c1"), 0u);
+    EXPECT_EQ(mServer->mContainers.count("c32"), 1u);
+}
@@ -0,0 +1,132 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include "DobbyPluginMetrics.h"
+
+namespace
+{
+    DobbyPluginMetrics::HookStats makeStats(uint64_t count, uint64_t failures,
+                                            int64_t totalUs, int64_t maxUs,
+                                            size_t bucket)
+    {
+        DobbyPluginMetrics::HookStats stats = { count, failures,
+                                                std::chrono::microseconds(totalUs),
+                                                std::chrono::microseconds(maxUs), { } };
+        stats.buckets[bucket] = count;
+        return stats;
+    }
+
+    void expectEqual(const DobbyPluginMetrics::HookStats &actual,
+                     const DobbyPluginMetrics::HookStats &expected)
+    {
+        EXPECT_EQ(actual.count, expected.count);
+        EXPECT_EQ(actual.failures, expected.failures);
+        EXPECT_EQ(actual.total.count(), expected.total.count());
+        EXPECT_EQ(actual.max.count(), expected.max.count());
+        EXPECT_EQ(actual.buckets, expected.buckets);
+    }
+}
+
+TEST(DobbyPluginMetricsTest, SerialisedSnapshotParsesBack)
+{
+    DobbyPluginMetrics::Snapshot snapshot;
+    snapshot[{ "Networking", "createRuntime" }] = makeStats(3, 1, 4500, 2100, 4);
+    snapshot[{ "Networking", "postStop" }] = makeStats(1, 0, 800, 800, 0);
+    snapshot[{ "Logging", "postStart" }] = makeStats(7, 0, 123456789, 99999999,
+                                                     DobbyPluginMetrics::BUCKET_COUNT - 1);
+
+    DobbyPluginMetrics::Snapshot parsed;
+    ASSERT_TRUE(DobbyPluginMetrics::deserialise(DobbyPluginMetrics::serialise(snapshot), &parsed));
+
+    ASSERT_EQ(parsed.size(), snapshot.size());
+    for (const auto &entry : snapshot)
+    {
+        auto it = parsed.find(entry.first);
+        ASSERT_NE(it, parsed.end()) << entry.first.first << " " << entry.first.second;
+        expectEqual(it->second, entry.second);
+    }
+}
+
+TEST(DobbyPluginMetricsTest, EmptySnapshotParsesBack)
+{
+    DobbyPluginMetrics::Snapshot parsed;
+    parsed[{ "stale", "createRuntime" }] = makeStats(1, 0, 1, 1, 0);
+
+    EXPECT_EQ(DobbyPluginMetrics::serialise(DobbyPluginMetrics::Snapshot()), "");
+    EXPECT_TRUE(DobbyPluginMetrics::deserialise("", &parsed));
+    EXPECT_TRUE(parsed.empty());
+}
+
+TEST(DobbyPluginMetricsTest, MalformedDataIsRejected)
+{
+    DobbyPluginMetrics::Snapshot snapshot;
+    snapshot[{ "Networking", "createRuntime" }] = makeStats(3, 1, 4500, 2100, 4);
+    const std::string good = DobbyPluginMetrics::serialise(snapshot);
+
+    DobbyPluginMetrics::Snapshot parsed;
+
+    // missing the last bucket
+    EXPECT_FALSE(DobbyPluginMetrics::deserialise(good.substr(0, good.rfind(' ')) + "\n", &parsed));
+    EXPECT_TRUE(parsed.empty());
+
+    // an extra field
+    EXPECT_FALSE(DobbyPluginMetrics::deserialise(good.substr(0, good.size() - 1) + " 1\n", &parsed));
+
+    // a field that isn't a number
+    EXPECT_FALSE(DobbyPluginMetrics::deserialise("Networking createRuntime x 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n", &parsed));
+}
+
+TEST(DobbyPluginMetricsTest, MergeAddsToExistingHooks)
+{
+    DobbyPluginMetrics::Snapshot daemon;
+    daemon[{ "Networking", "createRuntime" }] = makeStats(2, 0, 3000, 2000, 3);
+    daemon[{ "Logging", "postInstallation" }] = makeStats(1, 0, 100, 100, 0);
+
+    DobbyPluginMetrics::Snapshot server;
+    server[{ "Networking", "createRuntime" }] = makeStats(1, 1, 5000, 5000, 5);
+    server[{ "Networking", "postStop" }] = makeStats(4, 0, 400, 150, 0);
+
+    DobbyPluginMetrics::merge(&daemon, server);
+
+    ASSERT_EQ(daemon.size(), 3u);
+
+    DobbyPluginMetrics::HookStats expected = makeStats(3, 1, 8000, 5000, 3);
+    expected.buckets[3] = 2;
+    expected.buckets[5] = 1;
+    expectEqual(daemon[{ "Networking", "createRuntime" }], expected);
+
+    expectEqual(daemon[{ "Networking", "postStop" }], makeStats(4, 0, 400, 150, 0));
+    expectEqual(daemon[{ "Logging", "postInstallation" }], makeStats(1, 0, 100, 100, 0));
+}
+
+TEST(DobbyPluginMetricsTest, RecordedHooksAreSerialised)
+{
+    const DobbyPluginMetrics::Timer timer = DobbyPluginMetrics::startTimer();
+    DobbyPluginMetrics::record(timer, "MetricsTestPlugin", "postHalt", "container", false);
+
+    DobbyPluginMetrics::Snapshot parsed;
+    ASSERT_TRUE(DobbyPluginMetrics::deserialise(
+        DobbyPluginMetrics::serialise(DobbyPluginMetrics::snapshot()), &parsed));
+
+    auto it = parsed.find({ "MetricsTestPlugin", "postHalt" });
+    ASSERT_NE(it, parsed.end());
+    EXPECT_EQ(it->second.count, 1u);
+    EXPECT_EQ(it->second.failures, 1u);
+}
@@ -0,0 +1,232 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#define private public
+#include "DobbyRdkPluginCatalogue.h"
+
+typedef std::map<std::string, std::shared_ptr<const DobbyRdkPluginCatalogue::Library>> LibraryMap;
+
+class DobbyRdkPluginCatalogueTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/dobbycatalogue-XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        mPluginPath = tmpl;
+    }
+
+    void TearDown() override
+    {
+        const std::string command = "rm -rf " + mPluginPath;
+        EXPECT_EQ(system(command.c_str()), 0);
+    }
+
+    // copies the library into the plugin dir via a temporary file, so the
+    // file always gets a new inode, then moves the dir mtime on so the
+    // change is seen even on filesystems with coarse timestamps
+    void install(const char *libPath, const std::string &fileName)
+    {
+        const std::string tmpPath = mPluginPath + "/." + fileName + ".tmp";
+        {
+            std::ifstream src(libPath, std::ios::binary);
+            std::ofstream dst(tmpPath, std::ios::binary);
+            ASSERT_TRUE(src.good());
+            dst << src.rdbuf();
+        }
+
+        ASSERT_EQ(rename(tmpPath.c_str(), (mPluginPath + "/" + fileName).c_str()), 0);
+        touchDir();
+    }
+
+    void uninstall(const std::string &fileName)
+    {
+        ASSERT_EQ(unlink((mPluginPath + "/" + fileName).c_str()), 0);
+        touchDir();
+    }
+
+    void touchDir()
+    {
+        struct timespec times[2];
+        times[0].tv_sec = times[1].tv_sec = ++mDirTime;
+        times[0].tv_nsec = times[1].tv_nsec = 0;
+        ASSERT_EQ(utimensat(AT_FDCWD, mPluginPath.c_str(), times, 0), 0);
+    }
+
+    LibraryMap lookup(const std::set<std::string> &names)
+    {
+        std::shared_ptr<rt_dobby_schema> config;
+        LibraryMap libraries;
+        EXPECT_TRUE(mCatalogue.lookup(mPluginPath, names, config, nullptr, "/tmp", &libraries));
+        return libraries;
+    }
+
+    static int callInt(const std::shared_ptr<const DobbyRdkPluginCatalogue::Library> &library,
+                       const char *symbol)
+    {
+        auto fn = reinterpret_cast<int (*)()>(dlsym(library->handle, symbol));
+        return fn ? fn() : -1;
+    }
+
+    static int version(const std::shared_ptr<const DobbyRdkPluginCatalogue::Library> &library)
+    {
+        return callInt(library, "catalogueTestPluginVersion");
+    }
+
+    static int instances(const std::shared_ptr<const DobbyRdkPluginCatalogue::Library> &library)
+    {
+        return callInt(library, "catalogueTestPluginInstances");
+    }
+
+    DobbyRdkPluginCatalogue mCatalogue;
+    std::string mPluginPath;
+    time_t mDirTime = 1000000;
+};
+
+TEST_F(DobbyRdkPluginCatalogueTest, ExportedNameIsUsedWithoutCreatingThePlugin)
+{
+    install(ALPHA_V1_PLUGIN, "libAlpha.so");
+
+    LibraryMap libraries = lookup({ "alpha", "missing" });
+
+    ASSERT_EQ(libraries.size(), 1u);
+    ASSERT_EQ(libraries.count("alpha"), 1u);
+    EXPECT_EQ(version(libraries["alpha"]), 1);
+    EXPECT_EQ(instances(libraries["alpha"]), 0);
+    EXPECT_EQ(mCatalogue.metrics().pluginsCreatedForName, 0u);
+}
+
+TEST_F(DobbyRdkPluginCatalogueTest, UnchangedDirectoryIsNotScannedAgain)
+{
+    install(ALPHA_V1_PLUGIN, "libAlpha.so");
+
+    const auto first = lookup({ "alpha" });
+    const auto second = lookup({ "alpha" });
+
+    EXPECT_EQ(mCatalogue.metrics().scans, 1u);
+    EXPECT_EQ(mCatalogue.metrics().librariesOpened, 1u);
+    EXPECT_EQ(first.at("alpha"), second.at("alpha"));
+}
+
+TEST_F(DobbyRdkPluginCatalogueTest, RescanOnlyOpensNewLibraries)
+{
+    install(ALPHA_V1_PLUGIN, "libAlpha.so");
+    const auto before = lookup({ "alpha" });
+
+    // the mtime changes, but libAlpha.so keeps its inode so is reused
+    install(LEGACY_PLUGIN, "libLegacy.so");
+    const auto after = lookup({ "alpha" });
+
+    EXPECT_EQ(mCatalogue.metrics().scans, 2u);
+    EXPECT_EQ(mCatalogue.metrics().librariesOpened, 2u);
+    EXPECT_EQ(before.at("alpha"), after.at("alpha"));
+}
+
+TEST_F(DobbyRdkPluginCatalogueTest, ReplacedLibraryIsReopenedAndOldOneClosed)
+{
+    install(ALPHA_V1_PLUGIN, "libAlpha.so");
+
+    std::weak_ptr<const DobbyRdkPluginCatalogue::Library> oldLibrary;
+    {
+        const auto libraries = lookup({ "alpha" });
+        ASSERT_EQ(version(libraries.at("alpha")), 1);
+        oldLibrary = libraries.at("alpha");
+    }
+
+    install(ALPHA_V2_PLUGIN, "libAlpha.so");
+    const auto libraries = lookup({ "alpha" });
+
+    ASSERT_EQ(libraries.count("alpha"), 1u);
+    EXPECT_EQ(version(libraries.at("alpha")), 2);
+    EXPECT_EQ(mCatalogue.metrics().librariesOpened, 2u);
+
+    // nothing else held the old library, so it's been dropped (and closed)
+    EXPECT_TRUE(oldLibrary.expired());
+}
+
+TEST_F(DobbyRdkPluginCatalogueTest, ReplacedLibraryInUseIsKeptUntilReleased)
+{
+    install(ALPHA_V1_PLUGIN, "libAlpha.so");
+
+    // holding the library is what a live plugin instance does
+    std::shared_ptr<const DobbyRdkPluginCatalogue::Library> inUse = lookup({ "alpha" }).at("alpha");
+
+    install(ALPHA_V2_PLUGIN, "libAlpha.so");
+
+    // dlopen still gives the old version while it's loaded
+    EXPECT_EQ(version(lookup({ "alpha" }).at("alpha")), 1);
+
+    std::weak_ptr<const DobbyRdkPluginCatalogue::Library> oldLibrary = inUse;
+    inUse.reset();
+
+    // the directory hasn't changed again, but the next lookup rescans
+    const auto libraries = lookup({ "alpha" });
+    EXPECT_EQ(version(libraries.at("alpha")), 2);
+    EXPECT_TRUE(oldLibrary.expired());
+}
+
+TEST_F(DobbyRdkPluginCatalogueTest, RemovedLibraryIsDropped)
+{
+    install(ALPHA_V1_PLUGIN, "libAlpha.so");
+
+    std::weak_ptr<const DobbyRdkPluginCatalogue::Library> oldLibrary = lookup({ "alpha" }).at("alpha");
+
+    uninstall("libAlpha.so");
+
+    EXPECT_TRUE(lookup({ "alpha" }).empty());
+    EXPECT_TRUE(oldLibrary.expired());
+}
+
+TEST_F(DobbyRdkPluginCatalogueTest, LibraryWithoutNameIsOnlyCreatedOnAMiss)
+{
+    install(ALPHA_V1_PLUGIN, "libAlpha.so");
+    install(LEGACY_PLUGIN, "libLegacy.so");
+
+    // everything wanted is found by exported name
+    EXPECT_EQ(lookup({ "alpha" }).size(), 1u);
+    EXPECT_EQ(mCatalogue.metrics().pluginsCreatedForName, 0u);
+
+    // the legacy library has to be created to find out it's 'legacy'
+    const auto libraries = lookup({ "legacy" });
+    ASSERT_EQ(libraries.count("legacy"), 1u);
+    EXPECT_EQ(mCatalogue.metrics().pluginsCreatedForName, 1u);
+    EXPECT_EQ(instances(libraries.at("legacy")), 1);
+
+    // but only the once, even for names that don't exist
+    EXPECT_EQ(lookup({ "legacy", "missing" }).size(), 1u);
+    EXPECT_EQ(mCatalogue.metrics().pluginsCreatedForName, 1u);
+    EXPECT_EQ(instances(libraries.at("legacy")), 1);
+}
+
+TEST_F(DobbyRdkPluginCatalogueTest, MissingDirectoryFails)
+{
+    std::shared_ptr<rt_dobby_schema> config;
+    LibraryMap libraries;
+    EXPECT_FALSE(mCatalogue.lookup(mPluginPath + "/missing", { "alpha" }, config,
+                                   nullptr, "/tmp", &libraries));
+    EXPECT_TRUE(libraries.empty());
+}
@@ -0,0 +1,212 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <map>
+#include "DobbyRdkPluginDependencySolver.h"
+
+typedef std::vector<std::vector<std::string>> Levels;
+
+class DobbyRdkPluginDependencySolverTest : public ::testing::Test
+{
+protected:
+    void addPlugins(const std::vector<std::string> &names)
+    {
+        for (const std::string &name : names)
+        {
+            ASSERT_TRUE(solver.addPlugin(name)) << name;
+        }
+    }
+
+    // checks every plugin is in exactly one level, every dependency is in an
+    // earlier level and within a level the order matches getOrderOfDependency()
+    void checkLevels(const Levels &levels,
+                     const std::vector<std::pair<std::string, std::string>> &dependencies)
+    {
+        const std::vector<std::string> order = solver.getOrderOfDependency();
+
+        std::map<std::string, size_t> levelOf;
+        for (size_t level = 0; level < levels.size(); level++)
+        {
+            EXPECT_FALSE(levels[level].empty()) << "level " << level;
+
+            size_t lastPosition = 0;
+            for (const std::string &name : levels[level])
+            {
+                EXPECT_TRUE(levelOf.emplace(name, level).second) << name << " in two levels";
+
+                const auto position = std::find(order.begin(), order.end(), name) - order.begin();
+                EXPECT_GE(static_cast<size_t>(position), lastPosition) << name << " out of order";
+                lastPosition = position;
+            }
+        }
+
+        EXPECT_EQ(levelOf.size(), order.size());
+
+        for (const auto &dependency : dependencies)
+        {
+            ASSERT_EQ(levelOf.count(dependency.first), 1u) << dependency.first;
+            ASSERT_EQ(levelOf.count(dependency.second), 1u) << dependency.second;
+            EXPECT_LT(levelOf[dependency.second], levelOf[dependency.first])
+                << dependency.first << " depends on " << dependency.second;
+        }
+    }
+
+    DobbyRdkPluginDependencySolver solver;
+};
+
+TEST_F(DobbyRdkPluginDependencySolverTest, NoPluginsGivesNoLevels)
+{
+    EXPECT_TRUE(solver.getDependencyLevels().empty());
+    EXPECT_TRUE(solver.getReversedDependencyLevels().empty());
+}
+
+TEST_F(DobbyRdkPluginDependencySolverTest, IndependentPluginsShareOneLevel)
+{
+    addPlugins({ "Storage", "Logging", "IPC" });
+
+    const Levels levels = solver.getDependencyLevels();
+
+    ASSERT_EQ(levels.size(), 1u);
+    EXPECT_EQ(levels[0], solver.getOrderOfDependency());
+    checkLevels(levels, { });
+}
+
+TEST_F(DobbyRdkPluginDependencySolverTest, ChainGivesALevelPerPlugin)
+{
+    // the example from the getDependencyLevels() docs
+    addPlugins({ "AppServices", "Networking", "IPC", "Logging" });
+    ASSERT_TRUE(solver.addDependency("AppServices", "Networking"));
+    ASSERT_TRUE(solver.addDependency("Networking", "IPC"));
+
+    const Levels levels = solver.getDependencyLevels();
+
+    ASSERT_EQ(levels.size(), 3u);
+    EXPECT_EQ(levels[1], std::vector<std::string>{ "networking" });
+    EXPECT_EQ(levels[2], std::vector<std::string>{ "appservices" });
+
+    std::vector<std::string> first = levels[0];
+    std::sort(first.begin(), first.end());
+    EXPECT_EQ(first, (std::vector<std::string>{ "ipc", "logging" }));
+
+    checkLevels(levels, { { "appservices", "networking" }, { "networking", "ipc" } });
+}
+
+TEST_F(DobbyRdkPluginDependencySolverTest, PluginGoesAboveItsDeepestDependency)
+{
+    // a needs b and c, c needs d; b and d have nothing to wait for
+    addPlugins({ "a", "b", "c", "d" });
+    ASSERT_TRUE(solver.addDependency("a", "b"));
+    ASSERT_TRUE(solver.addDependency("a", "c"));
+    ASSERT_TRUE(solver.addDependency("c", "d"));
+
+    const Levels levels = solver.getDependencyLevels();
+
+    ASSERT_EQ(levels.size(), 3u);
+    EXPECT_EQ(levels[0].size(), 2u);
+    EXPECT_EQ(levels[1], std::vector<std::string>{ "c" });
+    EXPECT_EQ(levels[2], std::vector<std::string>{ "a" });
+
+    checkLevels(levels, { { "a", "b" }, { "a", "c" }, { "c", "d" } });
+}
+
+TEST_F(DobbyRdkPluginDependencySolverTest, OrderWithinLevelsFollowsOrderOfDependency)
+{
+    const std::vector<std::pair<std::string, std::string>> dependencies =
+    {
+        { "p1", "p0" }, { "p2", "p0" }, { "p3", "p1" }, { "p3", "p2" },
+        { "p4", "p0" }, { "p5", "p4" }, { "p6", "p3" }, { "p7", "p5" },
+        { "p8", "p1" }, { "p9", "p8" },
+    };
+
+    addPlugins({ "p9", "p0", "p5", "p3", "p7", "p1", "p8", "p2", "p6", "p4", "q0", "q1" });
+    for (const auto &dependency : dependencies)
+    {
+        ASSERT_TRUE(solver.addDependency(dependency.first, dependency.second));
+    }
+
+    const Levels levels = solver.getDependencyLevels();
+
+    ASSERT_EQ(levels.size(), 4u);
+    checkLevels(levels, dependencies);
+
+    // and asking again gives exactly the same answer
+    EXPECT_EQ(solver.getDependencyLevels(), levels);
+}
+
+TEST_F(DobbyRdkPluginDependencySolverTest, ReversedLevelsAreTheLevelsBackwards)
+{
+    addPlugins({ "a", "b", "c" });
+    ASSERT_TRUE(solver.addDependency("a", "b"));
+    ASSERT_TRUE(solver.addDependency("b", "c"));
+
+    Levels levels = solver.getDependencyLevels();
+    std::reverse(levels.begin(), levels.end());
+
+    EXPECT_EQ(solver.getReversedDependencyLevels(), levels);
+}
+
+TEST_F(DobbyRdkPluginDependencySolverTest, CycleGivesNoLevels)
+{
+    addPlugins({ "a", "b", "c", "d" });
+    ASSERT_TRUE(solver.addDependency("a", "b"));
+    ASSERT_TRUE(solver.addDependency("b", "c"));
+    ASSERT_TRUE(solver.addDependency("c", "a"));
+
+    EXPECT_TRUE(solver.getDependencyLevels().empty());
+    EXPECT_TRUE(solver.getReversedDependencyLevels().empty());
+    EXPECT_TRUE(solver.getOrderOfDependency().empty());
+}
+
+TEST_F(DobbyRdkPluginDependencySolverTest, SelfDependencyIsACycle)
+{
+    addPlugins({ "a", "b" });
+    ASSERT_TRUE(solver.addDependency("a", "a"));
+
+    EXPECT_TRUE(solver.getDependencyLevels().empty());
+}
+
+TEST_F(DobbyRdkPluginDependencySolverTest, MissingDependencyIsRejected)
+{
+    addPlugins({ "a", "b" });
+
+    EXPECT_FALSE(solver.addDependency("a", "missing"));
+    EXPECT_FALSE(solver.addDependency("missing", "a"));
+    ASSERT_TRUE(solver.addDependency("b", "a"));
+
+    // the rejected dependencies don't add plugins or edges
+    const Levels levels = solver.getDependencyLevels();
+    ASSERT_EQ(levels.size(), 2u);
+    EXPECT_EQ(levels[0], std::vector<std::string>{ "a" });
+    EXPECT_EQ(levels[1], std::vector<std::string>{ "b" });
+}
+
+TEST_F(DobbyRdkPluginDependencySolverTest, NamesAreCaseInsensitive)
+{
+    ASSERT_TRUE(solver.addPlugin("Networking"));
+    EXPECT_FALSE(solver.addPlugin("NETWORKING"));
+    ASSERT_TRUE(solver.addPlugin("ipc"));
+    ASSERT_TRUE(solver.addDependency("networking", "IPC"));
+
+    const Levels levels = solver.getDependencyLevels();
+    ASSERT_EQ(levels.size(), 2u);
+    EXPECT_EQ(levels[0], std::vector<std::string>{ "ipc" });
+    EXPECT_EQ(levels[1], std::vector<std::string>{ "networking" });
+}
@@ -0,0 +1,270 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include "DobbyRdkPluginManager.h"
+#include "DobbyRdkPluginUtils.h"
+#include "DobbyPluginMetrics.h"
+
+// The hook test plugins (see fixtures/HookTestPlugin.cpp) all implement
+// createRuntime:
+//   alpha, beta   - return straight away, on a thread
+//   slow          - take 2s, on a thread
+//   isolated      - return straight away, in a forked worker
+//   stuck         - take 2s, in a forked worker
+//   later         - return straight away, in a forked worker, after alpha
+class DobbyRdkPluginManagerTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        char tmpl[] = "/tmp/dobbyhooktest-XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        mPluginPath = tmpl;
+
+        std::istringstream plugins(HOOK_TEST_PLUGINS);
+        std::string plugin;
+        while (std::getline(plugins, plugin, ':'))
+        {
+            const std::string link = mPluginPath + plugin.substr(plugin.rfind('/'));
+            ASSERT_EQ(symlink(plugin.c_str(), link.c_str()), 0);
+        }
+    }
+
+    static void TearDownTestSuite()
+    {
+        const std::string command = "rm -rf " + mPluginPath;
+        EXPECT_EQ(system(command.c_str()), 0);
+    }
+
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/dobbyhookrootfs-XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        mRootfsPath = tmpl;
+    }
+
+    void TearDown() override
+    {
+        const std::string command = "rm -rf " + mRootfsPath;
+        EXPECT_EQ(system(command.c_str()), 0);
+    }
+
+    // creates a manager for a container using the given plugins, each with
+    // whether it's required
+    std::unique_ptr<DobbyRdkPluginManager> createManager(const std::vector<std::pair<std::string, bool>> &plugins)
+    {
+        std::shared_ptr<rt_dobby_schema> config(
+            static_cast<rt_dobby_schema *>(calloc(1, sizeof(rt_dobby_schema))),
+            [](rt_dobby_schema *cfg)
+            {
+                free(cfg->rdk_plugins);
+                free(cfg);
+            });
+        config->rdk_plugins = static_cast<rt_dobby_schema_rdk_plugins *>(
+            calloc(1, sizeof(rt_dobby_schema_rdk_plugins)));
+
+        rt_dobby_schema_rdk_plugins *rdkPlugins = config->rdk_plugins;
+        EXPECT_LE(plugins.size(), sizeof(rdkPlugins->names_of_plugins) / sizeof(rdkPlugins->names_of_plugins[0]));
+        for (const auto &plugin : plugins)
+        {
+            EXPECT_LT(plugin.first.size(), sizeof(rdkPlugins->names_of_plugins[0]));
+            strcpy(rdkPlugins->names_of_plugins[rdkPlugins->plugins_count], plugin.first.c_str());
+            rdkPlugins->required_plugins[rdkPlugins->plugins_count] = plugin.second;
+            rdkPlugins->plugins_count++;
+        }
+
+        auto utils = std::make_shared<DobbyRdkPluginUtils>(config, "hooktest");
+        return std::unique_ptr<DobbyRdkPluginManager>(
+            new DobbyRdkPluginManager(config, mRootfsPath, mPluginPath, utils));
+    }
+
+    // the commits made by the hook objects, each as the pid that made the
+    // commit followed by the plugins that added to the object
+    std::vector<std::string> commits() const
+    {
+        std::vector<std::string> lines;
+        std::ifstream file(mRootfsPath + "/commits");
+        std::string line;
+        while (std::getline(file, line))
+        {
+            lines.push_back(line);
+        }
+        return lines;
+    }
+
+    // the pid the plugin's hook last ran in
+    pid_t hookPid(const std::string &pluginName) const
+    {
+        std::ifstream file(mRootfsPath + "/" + pluginName + ".pid");
+        pid_t pid = -1;
+        file >> pid;
+        return pid;
+    }
+
+    static DobbyPluginMetrics::HookStats createRuntimeStats(const std::string &pluginName)
+    {
+        const DobbyPluginMetrics::Snapshot snapshot = DobbyPluginMetrics::snapshot();
+        auto it = snapshot.find(std::make_pair(pluginName, std::string("createRuntime")));
+        if (it == snapshot.end())
+        {
+            return DobbyPluginMetrics::HookStats{ 0, 0, std::chrono::microseconds::zero(),
+                                                  std::chrono::microseconds::zero(), { } };
+        }
+        return it->second;
+    }
+
+    static std::string ownPid(const std::string &names)
+    {
+        return std::to_string(getpid()) + " " + names;
+    }
+
+    static std::chrono::milliseconds elapsedSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    }
+
+    static std::string mPluginPath;
+    std::string mRootfsPath;
+};
+
+std::string DobbyRdkPluginManagerTest::mPluginPath;
+
+TEST_F(DobbyRdkPluginManagerTest, HookThatFinishesInTimeSucceeds)
+{
+    const DobbyPluginMetrics::HookStats before = createRuntimeStats("alpha");
+
+    std::unique_ptr<DobbyRdkPluginManager> manager = createManager({ { "alpha", true } });
+    ASSERT_EQ(manager->listLoadedPlugins(), std::vector<std::string>({ "alpha" }));
+
+    EXPECT_TRUE(manager->runPlugins(IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag, 1000));
+
+    // ran on a thread of this process, and its hook object was committed
+    EXPECT_EQ(hookPid("alpha"), getpid());
+    EXPECT_EQ(commits(), std::vector<std::string>({ ownPid("alpha") }));
+
+    const DobbyPluginMetrics::HookStats after = createRuntimeStats("alpha");
+    EXPECT_EQ(after.count, before.count + 1);
+    EXPECT_EQ(after.failures, before.failures);
+}
+
+TEST_F(DobbyRdkPluginManagerTest, HookThatTimesOutFailsWithoutWaitingForIt)
+{
+    const DobbyPluginMetrics::HookStats before = createRuntimeStats("slow");
+    const auto start = std::chrono::steady_clock::now();
+
+    std::unique_ptr<DobbyRdkPluginManager> manager = createManager({ { "slow", true } });
+    EXPECT_FALSE(manager->runPlugins(IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag, 100));
+    EXPECT_LT(elapsedSince(start).count(), 1000);
+
+    // the hook is still running, destroying the manager mustn't wait for it
+    manager.reset();
+    EXPECT_LT(elapsedSince(start).count(), 1000);
+
+    EXPECT_EQ(hookPid("slow"), getpid());
+    EXPECT_TRUE(commits().empty());
+
+    const DobbyPluginMetrics::HookStats after = createRuntimeStats("slow");
+    EXPECT_EQ(after.count, before.count + 1);
+    EXPECT_EQ(after.failures, before.failures + 1);
+}
+
+TEST_F(DobbyRdkPluginManagerTest, NonRequiredTimeoutDoesNotFailTheHookPoint)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    std::unique_ptr<DobbyRdkPluginManager> manager = createManager({ { "slow", false }, { "alpha", true } });
+    EXPECT_TRUE(manager->runPlugins(IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag, 100));
+    manager.reset();
+
+    EXPECT_LT(elapsedSince(start).count(), 1000);
+    EXPECT_EQ(commits(), std::vector<std::string>({ ownPid("alpha") }));
+}
+
+TEST_F(DobbyRdkPluginManagerTest, ThreadHooksShareOneCommit)
+{
+    std::unique_ptr<DobbyRdkPluginManager> manager = createManager({ { "alpha", true }, { "beta", true } });
+    EXPECT_TRUE(manager->runPlugins(IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag, 1000));
+
+    EXPECT_EQ(commits(), std::vector<std::string>({ ownPid("alpha beta") }));
+
+    // the objects are released once committed, the next hook point starts
+    // a new one
+    EXPECT_TRUE(manager->runPlugins(IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag, 1000));
+    EXPECT_EQ(commits(), std::vector<std::string>({ ownPid("alpha beta"), ownPid("alpha beta") }));
+}
+
+TEST_F(DobbyRdkPluginManagerTest, IsolatedHookCommitsInItsWorker)
+{
+    std::unique_ptr<DobbyRdkPluginManager> manager = createManager({ { "alpha", true }, { "isolated", true } });
+    EXPECT_TRUE(manager->runPlugins(IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag, 1000));
+
+    const pid_t workerPid = hookPid("isolated");
+    ASSERT_GT(workerPid, 0);
+    EXPECT_NE(workerPid, getpid());
+    EXPECT_EQ(hookPid("alpha"), getpid());
+
+    // the worker commits what its own hook added, this process commits the
+    // rest; the order depends on when the worker finished
+    const std::vector<std::string> lines = commits();
+    EXPECT_EQ(lines.size(), 2u);
+    EXPECT_EQ(std::count(lines.begin(), lines.end(), std::to_string(workerPid) + " isolated"), 1);
+    EXPECT_EQ(std::count(lines.begin(), lines.end(), ownPid("alpha")), 1);
+}
+
+TEST_F(DobbyRdkPluginManagerTest, IsolatedHookDoesNotCommitWhatItInherited)
+{
+    // alpha's object is still to be committed when the worker for later is
+    // forked, only this process may commit it
+    std::unique_ptr<DobbyRdkPluginManager> manager = createManager({ { "alpha", true }, { "later", true } });
+    EXPECT_TRUE(manager->runPlugins(IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag, 1000));
+
+    const pid_t workerPid = hookPid("later");
+    ASSERT_GT(workerPid, 0);
+    EXPECT_NE(workerPid, getpid());
+
+    EXPECT_EQ(commits(), std::vector<std::string>({ std::to_string(workerPid) + " later",
+                                                    ownPid("alpha") }));
+}
+
+TEST_F(DobbyRdkPluginManagerTest, StuckIsolatedHookIsKilled)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    std::unique_ptr<DobbyRdkPluginManager> manager = createManager({ { "stuck", true } });
+    EXPECT_FALSE(manager->runPlugins(IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag, 100));
+    EXPECT_LT(elapsedSince(start).count(), 1000);
+
+    // the worker was killed and reaped, so it's gone and never committed
+    const pid_t workerPid = hookPid("stuck");
+    ASSERT_GT(workerPid, 0);
+    EXPECT_NE(workerPid, getpid());
+    EXPECT_EQ(kill(workerPid, 0), -1);
+    EXPECT_EQ(errno, ESRCH);
+    EXPECT_TRUE(commits().empty());
+}
@@ -0,0 +1,120 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "DobbyRdkPluginUtils.h"
+
+// Tests the objects shared by the plugins of a hook point
+class DobbyRdkPluginUtilsHookObjectTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::shared_ptr<rt_dobby_schema> config(
+            static_cast<rt_dobby_schema *>(calloc(1, sizeof(rt_dobby_schema))), free);
+        mUtils = std::make_shared<DobbyRdkPluginUtils>(config, "hookobjects");
+    }
+
+    // gets the named object, which is a list of the values added to it,
+    // counting the creates and recording the commits
+    std::shared_ptr<std::vector<int>> object(const std::string &name, bool commitResult = true)
+    {
+        return std::static_pointer_cast<std::vector<int>>(
+            mUtils->hookObject(name,
+                               [this]()
+                               {
+                                   mCreates++;
+                                   return std::make_shared<std::vector<int>>();
+                               },
+                               [this, name, commitResult](const std::shared_ptr<void> &object)
+                               {
+                                   const auto values = std::static_pointer_cast<std::vector<int>>(object);
+                                   mCommits.emplace_back(name, *values);
+                                   return commitResult;
+                               }));
+    }
+
+    std::shared_ptr<DobbyRdkPluginUtils> mUtils;
+    int mCreates = 0;
+    std::vector<std::pair<std::string, std::vector<int>>> mCommits;
+};
+
+TEST_F(DobbyRdkPluginUtilsHookObjectTest, SameNameReturnsTheSameObject)
+{
+    object("netfilter")->push_back(1);
+    object("netfilter")->push_back(2);
+
+    EXPECT_EQ(mCreates, 1);
+    EXPECT_EQ(object("netfilter")->size(), 2u);
+    EXPECT_TRUE(mCommits.empty());
+}
+
+TEST_F(DobbyRdkPluginUtilsHookObjectTest, CommitRunsOnceAndReleasesTheObjects)
+{
+    object("netfilter")->push_back(1);
+    object("netfilter")->push_back(2);
+    object("other")->push_back(3);
+
+    std::weak_ptr<std::vector<int>> released = object("netfilter");
+
+    EXPECT_TRUE(mUtils->commitHookObjects());
+
+    const std::vector<std::pair<std::string, std::vector<int>>> expected =
+        { { "netfilter", { 1, 2 } }, { "other", { 3 } } };
+    EXPECT_EQ(mCommits, expected);
+    EXPECT_TRUE(released.expired());
+
+    // nothing left to commit, and the next hook point gets a new object
+    EXPECT_TRUE(mUtils->commitHookObjects());
+    EXPECT_EQ(mCommits.size(), 2u);
+
+    EXPECT_TRUE(object("netfilter")->empty());
+    EXPECT_EQ(mCreates, 3);
+}
+
+TEST_F(DobbyRdkPluginUtilsHookObjectTest, FailedCommitStillCommitsTheRest)
+{
+    object("failing", false)->push_back(1);
+    object("other")->push_back(2);
+
+    EXPECT_FALSE(mUtils->commitHookObjects());
+    EXPECT_EQ(mCommits.size(), 2u);
+
+    // the failed object isn't retried
+    EXPECT_TRUE(mUtils->commitHookObjects());
+    EXPECT_EQ(mCommits.size(), 2u);
+}
+
+TEST_F(DobbyRdkPluginUtilsHookObjectTest, ObjectThatCouldNotBeCreatedIsNotStored)
+{
+    int creates = 0;
+    int commits = 0;
+    auto create = [&creates]() { creates++; return std::shared_ptr<void>(); };
+    auto commit = [&commits](const std::shared_ptr<void> &) { commits++; return true; };
+
+    EXPECT_EQ(mUtils->hookObject("broken", create, commit), nullptr);
+    EXPECT_EQ(mUtils->hookObject("broken", create, commit), nullptr);
+    EXPECT_EQ(creates, 2);
+
+    EXPECT_TRUE(mUtils->commitHookObjects());
+    EXPECT_EQ(commits, 0);
+}
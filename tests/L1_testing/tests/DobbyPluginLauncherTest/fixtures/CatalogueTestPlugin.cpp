@@ -0,0 +1,67 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+// A do nothing plugin for the catalogue tests, built with TEST_PLUGIN_NAME
+// and TEST_PLUGIN_VERSION set so the tests can tell the libraries apart
+
+#include "IDobbyRdkPlugin.h"
+
+static int gInstancesCreated = 0;
+
+class CatalogueTestPlugin : public IDobbyRdkPlugin
+{
+public:
+    CatalogueTestPlugin(std::shared_ptr<rt_dobby_schema> &containerConfig,
+                        const std::shared_ptr<DobbyRdkPluginUtils> &utils,
+                        const std::string &rootfsPath)
+    {
+        gInstancesCreated++;
+    }
+
+    std::string name() const override { return TEST_PLUGIN_NAME; }
+    unsigned hookHints() const override { return 0; }
+
+    bool postInstallation() override { return true; }
+    bool preCreation() override { return true; }
+    bool createRuntime() override { return true; }
+    bool createContainer() override { return true; }
+#ifdef USE_STARTCONTAINER_HOOK
+    bool startContainer() override { return true; }
+#endif
+    bool postStart() override { return true; }
+    bool postHalt() override { return true; }
+    bool postStop() override { return true; }
+
+    std::vector<std::string> getDependencies() const override { return { }; }
+};
+
+REGISTER_RDK_PLUGIN(CatalogueTestPlugin);
+#if !defined(TEST_PLUGIN_NO_EXPORTED_NAME)
+REGISTER_RDK_PLUGIN_NAME(TEST_PLUGIN_NAME);
+#endif
+
+extern "C" PUBLIC_FN int catalogueTestPluginVersion()
+{
+    return TEST_PLUGIN_VERSION;
+}
+
+extern "C" PUBLIC_FN int catalogueTestPluginInstances()
+{
+    return gInstancesCreated;
+}
@@ -0,0 +1,121 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+// A plugin for the plugin manager tests, built with TEST_PLUGIN_NAME,
+// TEST_HOOK_DELAY_MS, TEST_PLUGIN_ISOLATED and optionally TEST_PLUGIN_DEPENDS
+// set.  Its createRuntime hook writes its pid to <rootfs>/<name>.pid, waits
+// for the delay and then adds its name to a hook object that appends
+// "<pid> <names...>" to <rootfs>/commits when it's committed.
+
+#include "IDobbyRdkPlugin.h"
+
+#include <unistd.h>
+#include <fstream>
+#include <mutex>
+#include <set>
+
+namespace
+{
+    struct CommitLog
+    {
+        std::mutex lock;
+        std::set<std::string> names;
+    };
+}
+
+class HookTestPlugin : public IDobbyRdkPlugin
+{
+public:
+    HookTestPlugin(std::shared_ptr<rt_dobby_schema> &containerConfig,
+                   const std::shared_ptr<DobbyRdkPluginUtils> &utils,
+                   const std::string &rootfsPath)
+        : mUtils(utils)
+        , mRootfsPath(rootfsPath)
+    {
+    }
+
+    std::string name() const override { return TEST_PLUGIN_NAME; }
+
+    unsigned hookHints() const override
+    {
+        return IDobbyRdkPlugin::HintFlags::CreateRuntimeFlag |
+               (TEST_PLUGIN_ISOLATED ? IDobbyRdkPlugin::HintFlags::IsolateHooksFlag : 0);
+    }
+
+    bool postInstallation() override { return true; }
+    bool preCreation() override { return true; }
+    bool createContainer() override { return true; }
+#ifdef USE_STARTCONTAINER_HOOK
+    bool startContainer() override { return true; }
+#endif
+    bool postStart() override { return true; }
+    bool postHalt() override { return true; }
+    bool postStop() override { return true; }
+
+    bool createRuntime() override
+    {
+        {
+            std::ofstream pidFile(mRootfsPath + "/" TEST_PLUGIN_NAME ".pid");
+            pidFile << getpid() << '\n';
+        }
+
+        usleep(TEST_HOOK_DELAY_MS * 1000);
+
+        const std::string logPath = mRootfsPath + "/commits";
+        std::shared_ptr<CommitLog> log = std::static_pointer_cast<CommitLog>(
+            mUtils->hookObject("hooktest",
+                               []() { return std::make_shared<CommitLog>(); },
+                               [logPath](const std::shared_ptr<void> &object)
+                               {
+                                   std::shared_ptr<CommitLog> log = std::static_pointer_cast<CommitLog>(object);
+
+                                   std::ofstream file(logPath, std::ios::app);
+                                   file << getpid();
+                                   for (const std::string &name : log->names)
+                                       file << ' ' << name;
+                                   file << '\n';
+
+                                   return file.good();
+                               }));
+        if (!log)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> locker(log->lock);
+        log->names.insert(TEST_PLUGIN_NAME);
+        return true;
+    }
+
+    std::vector<std::string> getDependencies() const override
+    {
+#if defined(TEST_PLUGIN_DEPENDS)
+        return { TEST_PLUGIN_DEPENDS };
+#else
+        return { };
+#endif
+    }
+
+private:
+    const std::shared_ptr<DobbyRdkPluginUtils> mUtils;
+    const std::string mRootfsPath;
+};
+
+REGISTER_RDK_PLUGIN(HookTestPlugin);
+REGISTER_RDK_PLUGIN_NAME(TEST_PLUGIN_NAME);
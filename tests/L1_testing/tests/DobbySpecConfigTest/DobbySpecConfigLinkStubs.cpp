@@ -19,9 +19,7 @@
 
 // Link-time stubs for symbols referenced by DobbySpecConfig.cpp that are
 // never called during unit testing.  The 4-arg DobbySpecConfig constructor
-// does not invoke convertToCompliant or rt_dobby_schema_parse_file, and
-// addGpuDevNodes / addVpuDevNodes are only reached when gpuAccessSettings()
-// returns non-null (our mock returns nullptr).
+// does not invoke convertToCompliant or rt_dobby_schema_parse_data.
 
 #include "IpcCommon.h"      // IAsyncReplySender / IAsyncReplySenderApiImpl
 #include "ContainerId.h"
@@ -35,22 +33,17 @@
 AI_IPC::IAsyncReplySenderApiImpl* AI_IPC::IAsyncReplySender::impl = nullptr;
 
 // ── DobbyConfig ───────────────────────────────────────────────────────────────
-// Weak stubs – never called because (a) we use the 4-arg constructor which
-// skips convertToCompliant, and (b) gpuAccessSettings() returns nullptr so
-// addGpuDevNodes / addVpuDevNodes are never entered.
+// Weak stubs – never called because we use the 4-arg constructor which
+// skips convertToCompliant.
 
 #include "DobbyConfig.h"
 
 bool DobbyConfig::convertToCompliant(
         const ContainerId& /*id*/,
         std::shared_ptr<rt_dobby_schema> /*cfg*/,
-        const std::string& /*rootfsPath*/)
+        const std::string& /*rootfsPath*/,
+        bool /*writeConfig*/)
 {
     return true;    // never called in these tests
 }
 
-std::list<DobbyConfig::DevNode> DobbyConfig::scanDevNodes(
-        const std::list<std::string>& /*devNodes*/)
-{
-    return {};      // never called in these tests
-}
@@ -29,11 +29,16 @@
 #include <cstring>
 #include <string>
 #include <memory>
+#include <fstream>
+#include <sstream>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 // DobbySettingsMock.h pulls in gmock which eventually includes <sstream>;
 // it must be included before #define private public.
 #include "DobbySettingsMock.h"
+#include "DobbyUtilsMock.h"
 
 // Open up private members of DobbySpecConfig so tests can access
 // mDictionary directly and call processSwapLimit.
@@ -46,6 +51,10 @@
 
 using ::testing::NiceMock;
 using ::testing::Return;
+using ::testing::Invoke;
+using ::testing::_;
+
+DobbyUtilsImpl* DobbyUtils::impl = nullptr;
 
 // ── Minimal valid Dobby spec strings ─────────────────────────────────────────
 
@@ -286,3 +295,355 @@ TEST_F(DobbySpecConfigTest, NoCapabilities_SetsNoNewPrivsTrue)
     EXPECT_TRUE(cfg->isValid());
     EXPECT_EQ(expandPrivsTemplate(*cfg), "NO_NEW_PRIVS=true");
 }
+
+// ── Compiled spec cache tests ─────────────────────────────────────────────────
+
+/**
+ * Fixture for the compiled spec cache, configs are created the way the daemon
+ * does for transient bundles so they go through getCompiledSpec.  The file
+ * utils used for the cache key and persisted entries are passed through to
+ * the real filesystem.
+ */
+class DobbySpecConfigCacheTest : public DobbySpecConfigTest
+{
+protected:
+    NiceMock<DobbyUtilsMock>* p_utilsMock = nullptr;
+    std::shared_ptr<IDobbyUtils> mUtils;
+    std::string mWorkspaceDir;
+
+    void SetUp() override
+    {
+        DobbySpecConfigTest::SetUp();
+
+        char workspace[] = "/tmp/dobby_specworkspace_XXXXXX";
+        ASSERT_NE(mkdtemp(workspace), nullptr) << "mkdtemp failed";
+        mWorkspaceDir = workspace;
+
+        p_utilsMock = new NiceMock<DobbyUtilsMock>();
+        DobbyUtils::setImpl(p_utilsMock);
+        mUtils = std::make_shared<DobbyUtils>();
+
+        ON_CALL(*p_utilsMock, readTextFile(_, _))
+            .WillByDefault(Invoke([](const std::string& path, size_t)
+            {
+                std::ifstream file(path);
+                std::stringstream contents;
+                contents << file.rdbuf();
+                return contents.str();
+            }));
+        ON_CALL(*p_utilsMock, writeTextFile(_, _, _, _))
+            .WillByDefault(Invoke([](const std::string& path, const std::string& str, int, mode_t)
+            {
+                std::ofstream file(path, std::ios::trunc);
+                file << str;
+                return file.good();
+            }));
+        ON_CALL(*p_utilsMock, mkdirRecursive(::testing::A<const std::string&>(), _))
+            .WillByDefault(Invoke([](const std::string& path, mode_t)
+            {
+                const std::string command = "mkdir -p " + path;
+                return (system(command.c_str()) == 0);
+            }));
+
+        setCacheSettings(true, false, 8);
+        ON_CALL(*p_settingsMock, workspaceDir())
+            .WillByDefault(Return(mWorkspaceDir));
+
+        DobbySpecConfig::clearCompiledSpecCache();
+    }
+
+    void TearDown() override
+    {
+        DobbySpecConfig::clearCompiledSpecCache();
+
+        const std::string command = "rm -rf " + mWorkspaceDir;
+        EXPECT_EQ(system(command.c_str()), 0);
+
+        DobbyUtils::setImpl(nullptr);
+        delete p_utilsMock;
+
+        DobbySpecConfigTest::TearDown();
+    }
+
+    void setCacheSettings(bool enabled, bool persist, int maxEntries)
+    {
+        IDobbySettings::SpecCacheSettings cacheSettings;
+        cacheSettings.enabled = enabled;
+        cacheSettings.persist = persist;
+        cacheSettings.maxEntries = maxEntries;
+
+        ON_CALL(*p_settingsMock, specCacheSettings())
+            .WillByDefault(Return(cacheSettings));
+    }
+
+    // Creates a config for a transient bundle, i.e. one started from a spec.
+    // The libocispec parse is stubbed out in these tests so the config itself
+    // is never valid, but the spec is compiled (or taken from the cache)
+    // before that point.
+    std::unique_ptr<DobbySpecConfig> makeTransientConfig(const std::string& specJson)
+    {
+        mBundle->setPersistence(false);
+        auto config = std::make_unique<DobbySpecConfig>(
+                        mUtils,
+                        mSettings,
+                        ContainerId::create("spec-cache-test"),
+                        mBundle,
+                        specJson);
+        mBundle->setPersistence(true);
+
+        return config;
+    }
+
+    std::unique_ptr<DobbySpecConfig> makeConfigWithUtils(const std::string& specJson)
+    {
+        return std::make_unique<DobbySpecConfig>(mUtils, mSettings, mBundle, specJson);
+    }
+
+    std::shared_ptr<const DobbySpecConfig::CompiledSpec> cachedSpec(const std::string& key)
+    {
+        auto it = DobbySpecConfig::mSpecCache.find(key);
+        return (it == DobbySpecConfig::mSpecCache.end()) ? nullptr : it->second;
+    }
+
+    static std::string specWithMemLimit(unsigned limit)
+    {
+        return "{ \"version\": \"1.0\", \"args\": [\"/bin/true\"], "
+               "\"user\": { \"uid\": 1000, \"gid\": 1000 }, "
+               "\"memLimit\": " + std::to_string(limit) + " }";
+    }
+
+    static std::string specWithBindMount(const std::string& source)
+    {
+        return "{ \"version\": \"1.0\", \"args\": [\"/bin/true\"], "
+               "\"user\": { \"uid\": 1000, \"gid\": 1000 }, "
+               "\"memLimit\": 2998272, "
+               "\"mounts\": [ { \"source\": \"" + source + "\", "
+               "\"destination\": \"/data\", \"type\": \"bind\", "
+               "\"options\": [ \"bind\", \"ro\" ] } ] }";
+    }
+};
+
+/**
+ * Starting the same spec twice must reuse the compiled spec, and the values
+ * restored from it must match the ones parsed from the spec the first time.
+ * Compiling the spec again from scratch must give the same OCI config.
+ */
+TEST_F(DobbySpecConfigCacheTest, HitGivesTheSameConfigAsAMiss)
+{
+    const std::string spec = specWithBindMount(mWorkspaceDir);
+
+    auto miss = makeTransientConfig(spec);
+    ASSERT_EQ(DobbySpecConfig::mSpecCache.size(), 1u);
+
+    const std::string key = miss->compiledSpecKey(mSettings, spec);
+    const auto compiled = cachedSpec(key);
+    ASSERT_NE(compiled, nullptr);
+    EXPECT_FALSE(compiled->configJson.empty());
+
+    auto hit = makeTransientConfig(spec);
+    ASSERT_EQ(DobbySpecConfig::mSpecCache.size(), 1u);
+    EXPECT_EQ(cachedSpec(key), compiled);
+
+    EXPECT_EQ(hit->mSpec, miss->mSpec);
+    EXPECT_EQ(hit->mUserId, miss->mUserId);
+    EXPECT_EQ(hit->mGroupId, miss->mGroupId);
+    EXPECT_EQ(hit->mRestartOnCrash, miss->mRestartOnCrash);
+    EXPECT_EQ(hit->mConsoleDisabled, miss->mConsoleDisabled);
+    EXPECT_EQ(hit->mRdkPlugins.size(), miss->mRdkPlugins.size());
+    ASSERT_EQ(hit->mMountPoints.size(), 1u);
+    ASSERT_EQ(miss->mMountPoints.size(), 1u);
+    EXPECT_EQ(hit->mMountPoints[0].destination, miss->mMountPoints[0].destination);
+    EXPECT_EQ(hit->mMountPoints[0].type, miss->mMountPoints[0].type);
+
+    // a fresh compile gives a new entry with identical contents
+    DobbySpecConfig::clearCompiledSpecCache();
+    auto again = makeTransientConfig(spec);
+    const auto recompiled = cachedSpec(key);
+    ASSERT_NE(recompiled, nullptr);
+    EXPECT_NE(recompiled, compiled);
+    EXPECT_EQ(recompiled->configJson, compiled->configJson);
+}
+
+/**
+ * The key must be stable for the same spec and settings, and change when any
+ * of the settings that feed into the generated config change.
+ */
+TEST_F(DobbySpecConfigCacheTest, KeyChangesWithEnvAndGpuSettings)
+{
+    const std::string spec(kSpecMemOnly);
+
+    auto config = makeConfigWithUtils(spec);
+    const std::string baseKey = config->compiledSpecKey(mSettings, spec);
+    EXPECT_EQ(baseKey.length(), 32u);
+    EXPECT_EQ(config->compiledSpecKey(mSettings, spec), baseKey);
+    EXPECT_NE(config->compiledSpecKey(mSettings, kSpecWithSwap), baseKey);
+
+    // extra env vars are read from the settings each time
+    ON_CALL(*p_settingsMock, extraEnvVariables())
+        .WillByDefault(Return(std::map<std::string, std::string>{ { "FOO", "1" } }));
+    const std::string envKey = config->compiledSpecKey(mSettings, spec);
+    EXPECT_NE(envKey, baseKey);
+
+    ON_CALL(*p_settingsMock, extraEnvVariables())
+        .WillByDefault(Return(std::map<std::string, std::string>{ { "FOO", "2" } }));
+    EXPECT_NE(config->compiledSpecKey(mSettings, spec), envKey);
+
+    ON_CALL(*p_settingsMock, extraEnvVariables())
+        .WillByDefault(Return(std::map<std::string, std::string>{}));
+    EXPECT_EQ(config->compiledSpecKey(mSettings, spec), baseKey);
+
+    // the GPU settings are taken when the config is created
+    auto gpuSettings = std::make_shared<IDobbySettings::HardwareAccessSettings>();
+    gpuSettings->groupIds = { 44 };
+    ON_CALL(*p_settingsMock, gpuAccessSettings())
+        .WillByDefault(Return(gpuSettings));
+
+    auto gpuConfig = makeConfigWithUtils(spec);
+    const std::string gpuKey = gpuConfig->compiledSpecKey(mSettings, spec);
+    EXPECT_NE(gpuKey, baseKey);
+
+    gpuSettings->groupIds = { 45 };
+    EXPECT_NE(gpuConfig->compiledSpecKey(mSettings, spec), gpuKey);
+
+    gpuSettings->groupIds = { 44 };
+    gpuSettings->extraEnvVariables = { { "GPU_DRIVER", "test" } };
+    EXPECT_NE(gpuConfig->compiledSpecKey(mSettings, spec), gpuKey);
+}
+
+/**
+ * Once maxEntries specs are cached the least recently used one is dropped.
+ */
+TEST_F(DobbySpecConfigCacheTest, EvictsLeastRecentlyUsedAtMaxEntries)
+{
+    setCacheSettings(true, false, 2);
+
+    const std::string specA = specWithMemLimit(2998272);
+    const std::string specB = specWithMemLimit(3998272);
+    const std::string specC = specWithMemLimit(4998272);
+    const std::string specD = specWithMemLimit(5998272);
+
+    auto config = makeTransientConfig(specA);
+    const std::string keyA = config->compiledSpecKey(mSettings, specA);
+    const std::string keyB = config->compiledSpecKey(mSettings, specB);
+    const std::string keyC = config->compiledSpecKey(mSettings, specC);
+    const std::string keyD = config->compiledSpecKey(mSettings, specD);
+
+    makeTransientConfig(specB);
+    EXPECT_EQ(DobbySpecConfig::mSpecCache.size(), 2u);
+    EXPECT_NE(cachedSpec(keyA), nullptr);
+
+    // A is the oldest so goes when C is added
+    makeTransientConfig(specC);
+    EXPECT_EQ(DobbySpecConfig::mSpecCache.size(), 2u);
+    EXPECT_EQ(cachedSpec(keyA), nullptr);
+    EXPECT_NE(cachedSpec(keyB), nullptr);
+    EXPECT_NE(cachedSpec(keyC), nullptr);
+
+    // using B again makes C the oldest
+    makeTransientConfig(specB);
+    makeTransientConfig(specD);
+    EXPECT_EQ(DobbySpecConfig::mSpecCache.size(), 2u);
+    EXPECT_NE(cachedSpec(keyB), nullptr);
+    EXPECT_EQ(cachedSpec(keyC), nullptr);
+    EXPECT_NE(cachedSpec(keyD), nullptr);
+    EXPECT_EQ(DobbySpecConfig::mSpecCacheOrder.front(), keyD);
+    EXPECT_EQ(DobbySpecConfig::mSpecCacheOrder.back(), keyB);
+}
+
+/**
+ * With persist set a spec compiled before a restart is loaded from the
+ * workspace, and a corrupt file there is ignored and replaced.
+ */
+TEST_F(DobbySpecConfigCacheTest, PersistedEntriesAreReloadedAndCorruptOnesReplaced)
+{
+    setCacheSettings(true, true, 8);
+
+    const std::string spec(kSpecMemOnly);
+    auto config = makeTransientConfig(spec);
+
+    const std::string key = config->compiledSpecKey(mSettings, spec);
+    const std::string filePath = mWorkspaceDir + "/dobby/spec-cache/" + key + ".json";
+    ASSERT_EQ(access(filePath.c_str(), R_OK), 0);
+
+    const auto compiled = cachedSpec(key);
+    ASSERT_NE(compiled, nullptr);
+
+    // as if the daemon restarted
+    DobbySpecConfig::clearCompiledSpecCache();
+    makeTransientConfig(spec);
+    ASSERT_NE(cachedSpec(key), nullptr);
+    EXPECT_EQ(cachedSpec(key)->configJson, compiled->configJson);
+    EXPECT_EQ(cachedSpec(key)->userId, 1000u);
+
+    // not json at all
+    DobbySpecConfig::clearCompiledSpecCache();
+    {
+        std::ofstream file(filePath, std::ios::trunc);
+        file << "{ \"config\": ";
+    }
+    EXPECT_EQ(config->loadCompiledSpec(filePath), nullptr);
+
+    makeTransientConfig(spec);
+    ASSERT_NE(cachedSpec(key), nullptr);
+    EXPECT_EQ(cachedSpec(key)->configJson, compiled->configJson);
+
+    // the corrupt file has been replaced with a good one
+    DobbySpecConfig::clearCompiledSpecCache();
+    const auto reloaded = config->loadCompiledSpec(filePath);
+    ASSERT_NE(reloaded, nullptr);
+    EXPECT_EQ(reloaded->configJson, compiled->configJson);
+
+    // valid json but with the wrong types
+    {
+        std::ofstream file(filePath, std::ios::trunc);
+        file << "{ \"config\": \"{}\", \"userId\": \"root\" }";
+    }
+    EXPECT_EQ(config->loadCompiledSpec(filePath), nullptr);
+
+    // valid json without a config
+    {
+        std::ofstream file(filePath, std::ios::trunc);
+        file << "{ \"userId\": 1000 }";
+    }
+    EXPECT_EQ(config->loadCompiledSpec(filePath), nullptr);
+}
+
+/**
+ * The type of a bind mount point is taken from its source on every start, not
+ * just when the spec was compiled.
+ */
+TEST_F(DobbySpecConfigCacheTest, BindMountTypeIsResolvedOnEveryHit)
+{
+    const std::string source = mWorkspaceDir + "/bind-source";
+    ASSERT_EQ(mkdir(source.c_str(), 0755), 0);
+
+    const std::string spec = specWithBindMount(source);
+
+    auto miss = makeTransientConfig(spec);
+    ASSERT_EQ(miss->mMountPoints.size(), 1u);
+    EXPECT_EQ(miss->mMountPoints[0].type, DobbySpecConfig::MountPoint::Directory);
+
+    // replace the directory with a file
+    ASSERT_EQ(rmdir(source.c_str()), 0);
+    const int fd = open(source.c_str(), O_CREAT | O_WRONLY, 0644);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    auto hit = makeTransientConfig(spec);
+    EXPECT_EQ(DobbySpecConfig::mSpecCache.size(), 1u);
+    ASSERT_EQ(hit->mMountPoints.size(), 1u);
+    EXPECT_EQ(hit->mMountPoints[0].type, DobbySpecConfig::MountPoint::File);
+    EXPECT_EQ(hit->mMountPoints[0].destination, "/data");
+
+    // and the source is kept in the persisted form too
+    setCacheSettings(true, true, 8);
+    DobbySpecConfig::clearCompiledSpecCache();
+    makeTransientConfig(spec);
+
+    const std::string filePath = mWorkspaceDir + "/dobby/spec-cache/" +
+                                 hit->compiledSpecKey(mSettings, spec) + ".json";
+    const auto loaded = hit->loadCompiledSpec(filePath);
+    ASSERT_NE(loaded, nullptr);
+    ASSERT_EQ(loaded->bindMountSources.size(), 1u);
+    EXPECT_EQ(loaded->bindMountSources[0], source);
+}
@@ -0,0 +1,572 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/net_namespace.h>
+#include <fstream>
+#include <vector>
+#include "ContainerId.h"
+#include "IDobbyEnv.h"
+#define private public
+#include "DobbyStats.h"
+#include "DobbyUtilsMock.h"
+
+using ::testing::NiceMock;
+using ::testing::Return;
+using ::testing::_;
+
+DobbyUtilsImpl* DobbyUtils::impl = nullptr;
+
+// Env that points every cgroup controller at the same (unified) directory
+class FakeDobbyEnv : public IDobbyEnv
+{
+public:
+    explicit FakeDobbyEnv(const std::string &cgroupPath)
+        : mCgroupPath(cgroupPath)
+    {
+    }
+
+    std::string workspaceMountPath() const override { return "/tmp"; }
+    std::string flashMountPath() const override { return "/tmp"; }
+    std::string pluginsWorkspacePath() const override { return "/tmp"; }
+    uint16_t platformIdent() const override { return 0; }
+
+    std::string cgroupMountPath(Cgroup cgroup) const override
+    {
+        return (cgroup == Cgroup::Gpu || cgroup == Cgroup::Ion) ? std::string() : mCgroupPath;
+    }
+
+    CgroupVersion cgroupVersion() const override { return CgroupVersion::V2; }
+
+private:
+    const std::string mCgroupPath;
+};
+
+class DobbyStatsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/dobbystats-XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        mCgroupPath = tmpl;
+
+        ASSERT_EQ(mkdir((mCgroupPath + "/" + mId.str()).c_str(), 0755), 0);
+    }
+
+    void TearDown() override
+    {
+        const std::string command = "rm -rf " + mCgroupPath;
+        EXPECT_EQ(system(command.c_str()), 0);
+    }
+
+    void writeFixture(const std::string &fileName, const std::string &contents)
+    {
+        std::ofstream file(mCgroupPath + "/" + mId.str() + "/" + fileName);
+        file << contents;
+    }
+
+    const ContainerId mId = ContainerId::create("stats-test");
+    std::string mCgroupPath;
+};
+
+TEST_F(DobbyStatsTest, KeyValuesParsesEveryLine)
+{
+    writeFixture("cpu.stat",
+                 "usage_usec 1234567\n"
+                 "user_usec 1000000\n"
+                 "system_usec 234567\n"
+                 "nr_periods 10\n"
+                 "nr_throttled 2\n"
+                 "throttled_usec 5000\n");
+
+    const Json::Value values = DobbyStats::readCgroupKeyValues(mId, mCgroupPath, "cpu.stat");
+
+    ASSERT_TRUE(values.isObject());
+    EXPECT_EQ(values.size(), 6u);
+    EXPECT_EQ(values["usage_usec"].asUInt64(), 1234567u);
+    EXPECT_EQ(values["system_usec"].asUInt64(), 234567u);
+    EXPECT_EQ(values["nr_throttled"].asUInt64(), 2u);
+}
+
+TEST_F(DobbyStatsTest, KeyValuesMapsUnlimitedToMinusOne)
+{
+    writeFixture("memory.events", "low 0\nhigh 18446744073709551615\nmax 3\noom 1\noom_kill 1\n");
+
+    const Json::Value values = DobbyStats::readCgroupKeyValues(mId, mCgroupPath, "memory.events");
+
+    ASSERT_TRUE(values.isObject());
+    EXPECT_EQ(values["high"].asInt(), -1);
+    EXPECT_EQ(values["max"].asUInt64(), 3u);
+    EXPECT_EQ(values["oom_kill"].asUInt64(), 1u);
+}
+
+TEST_F(DobbyStatsTest, KeyValuesMissingOrEmptyFileIsNull)
+{
+    EXPECT_TRUE(DobbyStats::readCgroupKeyValues(mId, mCgroupPath, "cpu.stat").isNull());
+
+    writeFixture("cpu.stat", "");
+    EXPECT_TRUE(DobbyStats::readCgroupKeyValues(mId, mCgroupPath, "cpu.stat").isNull());
+}
+
+TEST_F(DobbyStatsTest, IoStatParsesSeveralDevices)
+{
+    writeFixture("io.stat",
+                 "179:0 rbytes=1459200 wbytes=314773504 rios=192 wios=353 dbytes=0 dios=0\n"
+                 "8:16 rbytes=4096 wbytes=0 rios=1 wios=0 dbytes=0 dios=0\n"
+                 "253:2 rbytes=0 wbytes=8192 rios=0 wios=2 dbytes=512 dios=1\n");
+
+    const Json::Value devices = DobbyStats::readCgroupIoStat(mId, mCgroupPath);
+
+    ASSERT_TRUE(devices.isObject());
+    ASSERT_EQ(devices.size(), 3u);
+
+    EXPECT_EQ(devices["179:0"]["rbytes"].asUInt64(), 1459200u);
+    EXPECT_EQ(devices["179:0"]["wbytes"].asUInt64(), 314773504u);
+    EXPECT_EQ(devices["179:0"]["wios"].asUInt64(), 353u);
+    EXPECT_EQ(devices["8:16"]["rios"].asUInt64(), 1u);
+    EXPECT_EQ(devices["8:16"]["wbytes"].asUInt64(), 0u);
+    EXPECT_EQ(devices["253:2"]["dbytes"].asUInt64(), 512u);
+    EXPECT_EQ(devices["253:2"].size(), 6u);
+}
+
+TEST_F(DobbyStatsTest, IoStatMissingFileIsNullEmptyFileIsEmpty)
+{
+    EXPECT_TRUE(DobbyStats::readCgroupIoStat(mId, mCgroupPath).isNull());
+
+    // an empty io.stat just means the container hasn't done any io yet
+    writeFixture("io.stat", "");
+    const Json::Value devices = DobbyStats::readCgroupIoStat(mId, mCgroupPath);
+    ASSERT_TRUE(devices.isObject());
+    EXPECT_EQ(devices.size(), 0u);
+}
+
+TEST_F(DobbyStatsTest, PressureParsesSomeAndFull)
+{
+    writeFixture("memory.pressure",
+                 "some avg10=1.53 avg60=0.25 avg300=0.05 total=123456\n"
+                 "full avg10=0.50 avg60=0.10 avg300=0.00 total=4567\n");
+
+    const Json::Value pressure = DobbyStats::readCgroupPressure(mId, mCgroupPath, "memory.pressure");
+
+    ASSERT_TRUE(pressure.isObject());
+    ASSERT_TRUE(pressure.isMember("some"));
+    ASSERT_TRUE(pressure.isMember("full"));
+
+    EXPECT_TRUE(pressure["some"]["avg10"].isDouble());
+    EXPECT_DOUBLE_EQ(pressure["some"]["avg10"].asDouble(), 1.53);
+    EXPECT_DOUBLE_EQ(pressure["some"]["avg300"].asDouble(), 0.05);
+    EXPECT_TRUE(pressure["some"]["total"].isIntegral());
+    EXPECT_EQ(pressure["some"]["total"].asUInt64(), 123456u);
+
+    EXPECT_DOUBLE_EQ(pressure["full"]["avg10"].asDouble(), 0.50);
+    EXPECT_EQ(pressure["full"]["total"].asUInt64(), 4567u);
+}
+
+TEST_F(DobbyStatsTest, PressureWithOnlySomeLine)
+{
+    // cpu.pressure on older kernels only has the 'some' line
+    writeFixture("cpu.pressure", "some avg10=0.00 avg60=0.00 avg300=0.00 total=42\n");
+
+    const Json::Value pressure = DobbyStats::readCgroupPressure(mId, mCgroupPath, "cpu.pressure");
+
+    ASSERT_TRUE(pressure.isObject());
+    EXPECT_FALSE(pressure.isMember("full"));
+    EXPECT_EQ(pressure["some"]["total"].asUInt64(), 42u);
+}
+
+TEST_F(DobbyStatsTest, PressureMissingFileIsNull)
+{
+    // the files don't exist on kernels without CONFIG_PSI
+    EXPECT_TRUE(DobbyStats::readCgroupPressure(mId, mCgroupPath, "io.pressure").isNull());
+}
+
+TEST_F(DobbyStatsTest, NestedKeyValuesSkipsMalformedTokens)
+{
+    writeFixture("io.stat", "8:0 rbytes=10 =5 junk wios=3\n");
+
+    const Json::Value devices = DobbyStats::readCgroupIoStat(mId, mCgroupPath);
+
+    ASSERT_TRUE(devices.isObject());
+    EXPECT_EQ(devices["8:0"].size(), 2u);
+    EXPECT_EQ(devices["8:0"]["rbytes"].asUInt64(), 10u);
+    EXPECT_EQ(devices["8:0"]["wios"].asUInt64(), 3u);
+}
+
+TEST_F(DobbyStatsTest, GetStatsV2UsesTheFixtures)
+{
+    writeFixture("cgroup.procs", "");
+    writeFixture("cpu.stat", "usage_usec 2000\nuser_usec 1500\nsystem_usec 500\n"
+                             "nr_periods 4\nnr_throttled 1\nthrottled_usec 10\n");
+    writeFixture("memory.max", "max\n");
+    writeFixture("memory.current", "65536\n");
+    writeFixture("memory.events", "low 0\nhigh 0\nmax 7\noom 0\noom_kill 0\n");
+    writeFixture("memory.stat", "anon 4096\nfile 8192\nsock 0\n");
+    writeFixture("io.stat", "8:0 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=0 dios=0\n");
+
+    const std::shared_ptr<IDobbyEnv> env = std::make_shared<FakeDobbyEnv>(mCgroupPath);
+    const Json::Value stats = DobbyStats::getStats(mId, env, nullptr);
+
+    // cpu.stat values are converted from microseconds to nanoseconds
+    EXPECT_EQ(stats["cpu"]["usage"]["total"].asUInt64(), 2000000u);
+    EXPECT_EQ(stats["cpu"]["usage"]["user"].asUInt64(), 1500000u);
+    EXPECT_EQ(stats["cpu"]["throttling"]["throttledPeriods"].asUInt64(), 1u);
+    EXPECT_EQ(stats["cpu"]["throttling"]["throttledTime"].asUInt64(), 10000u);
+    EXPECT_TRUE(stats["cpu"]["pressure"].isNull());
+
+    EXPECT_EQ(stats["memory"]["user"]["limit"].asInt(), -1);
+    EXPECT_EQ(stats["memory"]["user"]["usage"].asUInt64(), 65536u);
+    EXPECT_TRUE(stats["memory"]["user"]["max"].isNull());
+    EXPECT_EQ(stats["memory"]["user"]["failcnt"].asUInt64(), 7u);
+    EXPECT_EQ(stats["memory"]["stat"]["anon"].asUInt64(), 4096u);
+    EXPECT_FALSE(stats["memory"]["stat"].isMember("sock"));
+
+    EXPECT_EQ(stats["io"]["devices"]["8:0"]["wios"].asUInt64(), 4u);
+    EXPECT_EQ(stats["pids"].size(), 0u);
+}
+
+// Builds route netlink messages as the kernel sends them, a header and the
+// family specific struct followed by the attributes
+class NetlinkMessage
+{
+public:
+    NetlinkMessage(uint16_t type, size_t familyLen)
+        : mBuffer(NLMSG_SPACE(familyLen), 0)
+    {
+        header()->nlmsg_type = type;
+        header()->nlmsg_len = NLMSG_LENGTH(familyLen);
+    }
+
+    NetlinkMessage &addAttr(uint16_t type, const void *data, size_t len)
+    {
+        const size_t offset = NLMSG_ALIGN(header()->nlmsg_len);
+        mBuffer.resize(offset + RTA_SPACE(len), 0);
+
+        struct rtattr *attr = reinterpret_cast<struct rtattr*>(mBuffer.data() + offset);
+        attr->rta_type = type;
+        attr->rta_len = RTA_LENGTH(len);
+        memcpy(RTA_DATA(attr), data, len);
+
+        header()->nlmsg_len = offset + RTA_LENGTH(len);
+        return *this;
+    }
+
+    NetlinkMessage &addAttr(uint16_t type, const std::string &value)
+    {
+        return addAttr(type, value.c_str(), value.size() + 1);
+    }
+
+    struct nlmsghdr *header()
+    {
+        return reinterpret_cast<struct nlmsghdr*>(mBuffer.data());
+    }
+
+private:
+    std::vector<uint8_t> mBuffer;
+};
+
+static struct rtnl_link_stats64 makeCounters()
+{
+    struct rtnl_link_stats64 counters;
+    memset(&counters, 0, sizeof(counters));
+    counters.rx_packets = 1;
+    counters.tx_packets = 2;
+    counters.rx_bytes = 3;
+    counters.tx_bytes = 4;
+    counters.rx_errors = 5;
+    counters.tx_errors = 6;
+    counters.rx_dropped = 7;
+    counters.tx_dropped = 8;
+    return counters;
+}
+
+TEST(DobbyStatsNetlinkTest, LinkMessageGivesNameCountersAndPeerNamespace)
+{
+    const struct rtnl_link_stats64 counters = makeCounters();
+    const int32_t nsId = 3;
+
+    NetlinkMessage message(RTM_NEWLINK, sizeof(struct ifinfomsg));
+    message.addAttr(IFLA_MTU, &nsId, sizeof(nsId))
+           .addAttr(IFLA_IFNAME, "veth0")
+           .addAttr(IFLA_STATS64, &counters, sizeof(counters))
+           .addAttr(IFLA_LINK_NETNSID, &nsId, sizeof(nsId));
+
+    std::string name;
+    DobbyStats::LinkStats link;
+    ASSERT_TRUE(DobbyStats::parseLinkMessage(message.header(), &name, &link));
+
+    EXPECT_EQ(name, "veth0");
+    EXPECT_EQ(link.peerNsId, 3);
+    EXPECT_EQ(memcmp(&link.counters, &counters, sizeof(counters)), 0);
+}
+
+TEST(DobbyStatsNetlinkTest, LinkWithoutPeerHasNoNamespaceId)
+{
+    const struct rtnl_link_stats64 counters = makeCounters();
+
+    NetlinkMessage message(RTM_NEWLINK, sizeof(struct ifinfomsg));
+    message.addAttr(IFLA_IFNAME, "lo")
+           .addAttr(IFLA_STATS64, &counters, sizeof(counters));
+
+    std::string name;
+    DobbyStats::LinkStats link;
+    link.peerNsId = 7;
+    ASSERT_TRUE(DobbyStats::parseLinkMessage(message.header(), &name, &link));
+    EXPECT_EQ(link.peerNsId, NETNSA_NSID_NOT_ASSIGNED);
+}
+
+TEST(DobbyStatsNetlinkTest, LinkWithoutNameOrFullCountersIsSkipped)
+{
+    const struct rtnl_link_stats64 counters = makeCounters();
+    std::string name;
+    DobbyStats::LinkStats link;
+
+    NetlinkMessage noCounters(RTM_NEWLINK, sizeof(struct ifinfomsg));
+    noCounters.addAttr(IFLA_IFNAME, "veth0");
+    EXPECT_FALSE(DobbyStats::parseLinkMessage(noCounters.header(), &name, &link));
+
+    // the 32-bit IFLA_STATS is smaller than the 64-bit counters
+    NetlinkMessage shortCounters(RTM_NEWLINK, sizeof(struct ifinfomsg));
+    shortCounters.addAttr(IFLA_IFNAME, "veth0")
+                 .addAttr(IFLA_STATS64, &counters, sizeof(struct rtnl_link_stats));
+    EXPECT_FALSE(DobbyStats::parseLinkMessage(shortCounters.header(), &name, &link));
+
+    NetlinkMessage noName(RTM_NEWLINK, sizeof(struct ifinfomsg));
+    noName.addAttr(IFLA_STATS64, &counters, sizeof(counters));
+    EXPECT_FALSE(DobbyStats::parseLinkMessage(noName.header(), &name, &link));
+}
+
+TEST(DobbyStatsNetlinkTest, OtherOrTruncatedMessagesAreSkipped)
+{
+    const struct rtnl_link_stats64 counters = makeCounters();
+    std::string name;
+    DobbyStats::LinkStats link;
+
+    NetlinkMessage address(RTM_NEWADDR, sizeof(struct ifinfomsg));
+    address.addAttr(IFLA_IFNAME, "veth0")
+           .addAttr(IFLA_STATS64, &counters, sizeof(counters));
+    EXPECT_FALSE(DobbyStats::parseLinkMessage(address.header(), &name, &link));
+
+    NetlinkMessage truncated(RTM_NEWLINK, sizeof(struct ifinfomsg));
+    truncated.header()->nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg) - 1);
+    EXPECT_FALSE(DobbyStats::parseLinkMessage(truncated.header(), &name, &link));
+
+    // an attribute running past the end of the message is ignored
+    NetlinkMessage overrun(RTM_NEWLINK, sizeof(struct ifinfomsg));
+    overrun.addAttr(IFLA_IFNAME, "veth0")
+           .addAttr(IFLA_STATS64, &counters, sizeof(counters));
+    overrun.header()->nlmsg_len -= 8;
+    EXPECT_FALSE(DobbyStats::parseLinkMessage(overrun.header(), &name, &link));
+}
+
+TEST(DobbyStatsNetlinkTest, NameIsBoundedByItsAttribute)
+{
+    const struct rtnl_link_stats64 counters = makeCounters();
+    const char unterminated[4] = { 'v', 'e', 't', 'h' };
+
+    NetlinkMessage message(RTM_NEWLINK, sizeof(struct ifinfomsg));
+    message.addAttr(IFLA_IFNAME, unterminated, sizeof(unterminated))
+           .addAttr(IFLA_STATS64, &counters, sizeof(counters));
+
+    std::string name;
+    DobbyStats::LinkStats link;
+    ASSERT_TRUE(DobbyStats::parseLinkMessage(message.header(), &name, &link));
+    EXPECT_EQ(name, "veth");
+}
+
+TEST(DobbyStatsNetlinkTest, NsIdReplyGivesTheId)
+{
+    const int32_t id = 12;
+    const uint32_t pid = 100;
+
+    NetlinkMessage message(RTM_NEWNSID, sizeof(struct rtgenmsg));
+    message.addAttr(NETNSA_PID, &pid, sizeof(pid))
+           .addAttr(NETNSA_NSID, &id, sizeof(id));
+
+    int32_t nsId = NETNSA_NSID_NOT_ASSIGNED;
+    EXPECT_TRUE(DobbyStats::parseNsIdMessage(message.header(), &nsId));
+    EXPECT_EQ(nsId, 12);
+}
+
+TEST(DobbyStatsNetlinkTest, NsIdReplyWithoutAnIdIsSkipped)
+{
+    const int16_t shortId = 12;
+    int32_t nsId = NETNSA_NSID_NOT_ASSIGNED;
+
+    NetlinkMessage noId(RTM_NEWNSID, sizeof(struct rtgenmsg));
+    EXPECT_FALSE(DobbyStats::parseNsIdMessage(noId.header(), &nsId));
+
+    NetlinkMessage shortAttr(RTM_NEWNSID, sizeof(struct rtgenmsg));
+    shortAttr.addAttr(NETNSA_NSID, &shortId, sizeof(shortId));
+    EXPECT_FALSE(DobbyStats::parseNsIdMessage(shortAttr.header(), &nsId));
+
+    NetlinkMessage link(RTM_NEWLINK, sizeof(struct rtgenmsg));
+    const int32_t id = 12;
+    link.addAttr(NETNSA_NSID, &id, sizeof(id));
+    EXPECT_FALSE(DobbyStats::parseNsIdMessage(link.header(), &nsId));
+
+    EXPECT_EQ(nsId, NETNSA_NSID_NOT_ASSIGNED);
+}
+
+TEST(DobbyStatsNetlinkTest, NetworkStatsAreFromTheContainerSide)
+{
+    const Json::Value network = DobbyStats::networkStatsJson("veth0", makeCounters());
+
+    EXPECT_EQ(network["interface"].asString(), "veth0");
+
+    // what the host end sent the container received
+    EXPECT_EQ(network["rx"]["packets"].asUInt64(), 2u);
+    EXPECT_EQ(network["rx"]["bytes"].asUInt64(), 4u);
+    EXPECT_EQ(network["rx"]["errors"].asUInt64(), 6u);
+    EXPECT_EQ(network["rx"]["dropped"].asUInt64(), 8u);
+
+    EXPECT_EQ(network["tx"]["packets"].asUInt64(), 1u);
+    EXPECT_EQ(network["tx"]["bytes"].asUInt64(), 3u);
+    EXPECT_EQ(network["tx"]["errors"].asUInt64(), 5u);
+    EXPECT_EQ(network["tx"]["dropped"].asUInt64(), 7u);
+}
+
+class DobbyStatsNetworkTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        p_utilsMock = new NiceMock<DobbyUtilsMock>;
+        DobbyUtils::setImpl(p_utilsMock);
+        mUtils = std::make_shared<DobbyUtils>();
+    }
+
+    void TearDown() override
+    {
+        if (mContainerPid > 0)
+        {
+            kill(mContainerPid, SIGKILL);
+            waitpid(mContainerPid, nullptr, 0);
+        }
+
+        DobbyUtils::setImpl(nullptr);
+        delete p_utilsMock;
+    }
+
+    // starts a child in a network namespace of its own, returns false if
+    // that's not possible (not root)
+    bool startContainer()
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+            return false;
+
+        mContainerPid = fork();
+        if (mContainerPid == 0)
+        {
+            close(fds[0]);
+            char ready = (unshare(CLONE_NEWNET) == 0) ? 1 : 0;
+            if (write(fds[1], &ready, 1) != 1)
+                _exit(EXIT_FAILURE);
+            while (true)
+                pause();
+        }
+
+        close(fds[1]);
+        char ready = 0;
+        const bool started = (mContainerPid > 0) && (read(fds[0], &ready, 1) == 1) && ready;
+        close(fds[0]);
+        return started;
+    }
+
+    const ContainerId mId = ContainerId::create("stats-net-test");
+    NiceMock<DobbyUtilsMock> *p_utilsMock = nullptr;
+    std::shared_ptr<IDobbyUtils> mUtils;
+    pid_t mContainerPid = -1;
+};
+
+TEST_F(DobbyStatsNetworkTest, NoUtilsMeansNoNetworkStats)
+{
+    EXPECT_TRUE(DobbyStats::getNetworkStats(mId, getpid(), nullptr).isNull());
+}
+
+TEST_F(DobbyStatsNetworkTest, StoredVethNameIsUsedWithoutLookup)
+{
+    EXPECT_CALL(*p_utilsMock, getStringMetaData(mId, "network.veth", _))
+        .WillRepeatedly(Return(std::string("lo")));
+    EXPECT_CALL(*p_utilsMock, setStringMetaData(_, _, _)).Times(0);
+
+    // no pid, so the name can only have come from the metadata
+    const Json::Value network = DobbyStats::getNetworkStats(mId, -1, mUtils);
+    ASSERT_TRUE(network.isObject());
+    EXPECT_EQ(network["interface"].asString(), "lo");
+    EXPECT_TRUE(network["rx"]["bytes"].isUInt64());
+    EXPECT_TRUE(network["tx"]["packets"].isUInt64());
+}
+
+TEST_F(DobbyStatsNetworkTest, UnknownStoredVethIsNull)
+{
+    ON_CALL(*p_utilsMock, getStringMetaData(mId, "network.veth", _))
+        .WillByDefault(Return(std::string("nosuchveth0")));
+
+    EXPECT_TRUE(DobbyStats::getNetworkStats(mId, -1, mUtils).isNull());
+}
+
+TEST_F(DobbyStatsNetworkTest, ContainerInDaemonNamespaceHasNoVeth)
+{
+    ON_CALL(*p_utilsMock, getStringMetaData(_, _, _))
+        .WillByDefault(Return(std::string()));
+    EXPECT_CALL(*p_utilsMock, setStringMetaData(_, _, _)).Times(0);
+
+    EXPECT_TRUE(DobbyStats::getNetworkStats(mId, getpid(), mUtils).isNull());
+}
+
+TEST_F(DobbyStatsNetworkTest, FindsVethCreatedSinceLastDumpAndStoresIt)
+{
+    if ((geteuid() != 0) || (system("ip link help > /dev/null 2>&1") == 127) ||
+        !startContainer())
+    {
+        GTEST_SKIP() << "needs root and the ip tool to create a veth";
+    }
+
+    // prime the link dump cache so the veth below isn't in it
+    ON_CALL(*p_utilsMock, getStringMetaData(_, _, _))
+        .WillByDefault(Return(std::string("lo")));
+    ASSERT_FALSE(DobbyStats::getNetworkStats(mId, -1, mUtils).isNull());
+
+    const std::string command = "ip link add dstats0 type veth peer name eth0 netns " +
+                                std::to_string(mContainerPid);
+    ASSERT_EQ(system(command.c_str()), 0);
+
+    ON_CALL(*p_utilsMock, getStringMetaData(_, _, _))
+        .WillByDefault(Return(std::string()));
+    EXPECT_CALL(*p_utilsMock, setStringMetaData(mId, "network.veth", "dstats0")).Times(1);
+
+    const Json::Value network = DobbyStats::getNetworkStats(mId, mContainerPid, mUtils);
+
+    // deleting the host end takes the container end with it
+    EXPECT_EQ(system("ip link del dstats0"), 0);
+
+    ASSERT_TRUE(network.isObject());
+    EXPECT_EQ(network["interface"].asString(), "dstats0");
+}
@@ -37,6 +37,8 @@
 #include "ContainerIdMock.h"
 #include "DobbyProtocol.h"
 
+#include <json/json.h>
+
 #include <cstdlib>
 #include <fcntl.h>
 
@@ -3848,3 +3850,92 @@ TEST_F(DaemonDobbyTest, removeMountFailure_invalidArg)
 
     dobby_test->removeMount((std::shared_ptr<AI_IPC::IAsyncReplySender>)p_iasyncReplySender);
 }
+
+/**
+ * @brief Test getPluginMetrics with successful postWork.
+ * Check if getPluginMetrics replies with the metrics returned by the
+ * manager, which include those of the hook server, as json.
+ *
+ * @return None.
+ */
+TEST_F(DaemonDobbyTest, getPluginMetricsSuccess_postWorkSuccess)
+{
+    DobbyPluginMetrics::HookStats stats = { 3, 1, std::chrono::microseconds(4500),
+                                            std::chrono::microseconds(2100), { } };
+    stats.buckets[4] = 3;
+
+    DobbyPluginMetrics::Snapshot metrics;
+    metrics[std::make_pair(std::string("Networking"), std::string("createRuntime"))] = stats;
+
+    EXPECT_CALL(*p_dobbyManagerMock, pluginMetrics())
+        .Times(1)
+        .WillOnce(::testing::Return(metrics));
+
+    EXPECT_CALL(*p_workQueueMock, postWork(::testing::_))
+        .Times(1)
+            .WillOnce(::testing::Invoke(
+            [](const WorkFunc &work) {
+                work();
+                return true;
+            }));
+
+    EXPECT_CALL(*p_asyncReplySenderMock, sendReply(::testing::_))
+        .Times(1)
+        .WillOnce(::testing::Invoke(
+            [](const AI_IPC::VariantList& replyArgs) {
+                std::string actualResult;
+                EXPECT_TRUE(AI_IPC::parseVariantList <std::string>
+                                (replyArgs, &actualResult));
+
+                Json::CharReaderBuilder builder;
+                std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+                Json::Value json;
+                std::string errors;
+                EXPECT_TRUE(reader->parse(actualResult.data(),
+                                          actualResult.data() + actualResult.size(),
+                                          &json, &errors));
+
+                const Json::Value &hook = json["Networking"]["createRuntime"];
+                EXPECT_EQ(hook["count"].asUInt64(), 3u);
+                EXPECT_EQ(hook["failures"].asUInt64(), 1u);
+                EXPECT_EQ(hook["total_us"].asInt64(), 4500);
+                EXPECT_EQ(hook["max_us"].asInt64(), 2100);
+                EXPECT_EQ(hook["histogram"].size(), DobbyPluginMetrics::BUCKET_COUNT);
+                EXPECT_EQ(hook["histogram"][4]["le_ms"].asUInt(), DobbyPluginMetrics::BUCKET_LIMITS_MS[4]);
+                EXPECT_EQ(hook["histogram"][4]["count"].asUInt64(), 3u);
+                return true;
+            }));
+
+    dobby_test->getPluginMetrics((std::shared_ptr<AI_IPC::IAsyncReplySender>)p_iasyncReplySender);
+}
+
+/**
+ * @brief Test getPluginMetrics with failed postWork.
+ * Check if getPluginMetrics sends back an empty reply without asking the
+ * manager for the metrics.
+ *
+ * @return None.
+ */
+TEST_F(DaemonDobbyTest, getPluginMetricsFailure_postWorkFailed)
+{
+    EXPECT_CALL(*p_dobbyManagerMock, pluginMetrics()).Times(0);
+
+    EXPECT_CALL(*p_workQueueMock, postWork(::testing::_))
+        .Times(1)
+        .WillOnce(::testing::Return(false));
+
+    EXPECT_CALL(*p_asyncReplySenderMock, sendReply(::testing::_))
+        .Times(1)
+        .WillOnce(::testing::Invoke(
+            [](const AI_IPC::VariantList& replyArgs) {
+                std::string actualResult = "not empty";
+                if (AI_IPC::parseVariantList <std::string>
+                         (replyArgs, &actualResult))
+                {
+                    EXPECT_EQ(actualResult, "");
+                }
+                return true;
+            }));
+
+    dobby_test->getPluginMetrics((std::shared_ptr<AI_IPC::IAsyncReplySender>)p_iasyncReplySender);
+}
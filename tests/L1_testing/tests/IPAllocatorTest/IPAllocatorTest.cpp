@@ -0,0 +1,386 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <set>
+#include <sstream>
+#define private public
+#include "IPAllocator.h"
+#include "DobbyRdkPluginUtilsMock.h"
+
+DobbyRdkPluginUtilsImpl* DobbyRdkPluginUtils::impl = nullptr;
+
+using ::testing::NiceMock;
+
+// The allocation table and address files are kept under IP_ALLOCATOR_TEST_DIR
+// (see CMakeLists.txt), which is emptied before each test.  The utils mock
+// reads and writes the address files for real.
+class IPAllocatorTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        removeTestDir();
+        ASSERT_EQ(mkdir(IP_ALLOCATOR_TEST_DIR, 0755), 0);
+
+        mUtilsMock = new NiceMock<DobbyRdkPluginUtilsMock>;
+        DobbyRdkPluginUtils::setImpl(mUtilsMock);
+        mUtils = std::make_shared<DobbyRdkPluginUtils>();
+
+        ON_CALL(*mUtilsMock, getContainerId())
+            .WillByDefault(::testing::Return(std::string("container")));
+
+        ON_CALL(*mUtilsMock, mkdirRecursive(::testing::_, ::testing::_))
+            .WillByDefault(::testing::Invoke(
+                [](const std::string &path, mode_t mode)
+                {
+                    return (mkdir(path.c_str(), mode | S_IXUSR) == 0) || (errno == EEXIST);
+                }));
+
+        ON_CALL(*mUtilsMock, writeTextFile(::testing::_, ::testing::_, ::testing::_, ::testing::_))
+            .WillByDefault(::testing::Invoke(
+                [](const std::string &path, const std::string &str, int, mode_t)
+                {
+                    std::ofstream file(path, std::ios::trunc);
+                    file << str;
+                    return file.good();
+                }));
+
+        ON_CALL(*mUtilsMock, readTextFile(::testing::_))
+            .WillByDefault(::testing::Invoke(
+                [](const std::string &path)
+                {
+                    std::ifstream file(path);
+                    std::stringstream contents;
+                    contents << file.rdbuf();
+                    return contents.str();
+                }));
+    }
+
+    void TearDown() override
+    {
+        mUtils.reset();
+        DobbyRdkPluginUtils::setImpl(nullptr);
+        delete mUtilsMock;
+
+        removeTestDir();
+    }
+
+    static void removeTestDir()
+    {
+        const std::string command = std::string("rm -rf ") + IP_ALLOCATOR_TEST_DIR;
+        ASSERT_EQ(system(command.c_str()), 0);
+    }
+
+    std::unique_ptr<IPAllocator> createAllocator()
+    {
+        std::unique_ptr<IPAllocator> allocator(new IPAllocator(mUtils));
+        EXPECT_NE(allocator->mStore, nullptr);
+        return allocator;
+    }
+
+    // the address of the slot in the pool
+    static in_addr_t address(int slot)
+    {
+        return INADDR_BRIDGE + 1 + slot;
+    }
+
+    // writes an address file as if by a plugin from before the table existed
+    static void writeAddressFile(const std::string &containerId, const std::string &contents)
+    {
+        mkdir(ADDRESS_FILE_DIR, 0755);
+        std::ofstream file(ADDRESS_FILE_DIR + containerId);
+        file << contents;
+    }
+
+    static std::string readAddressFile(const std::string &containerId)
+    {
+        std::ifstream file(ADDRESS_FILE_DIR + containerId);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    static bool hasAddress(const IPAllocator &allocator, const std::string &containerId,
+                           in_addr_t ipAddress, const std::string &vethName)
+    {
+        ContainerNetworkInfo networkInfo;
+        return allocator.getContainerNetworkInfo(containerId, networkInfo) &&
+               (networkInfo.ipAddressRaw == ipAddress) &&
+               (networkInfo.vethName == vethName);
+    }
+
+    // runs the function in a child process and returns its wait status
+    static int runInChild(const std::function<int()> &func)
+    {
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            _exit(func());
+        }
+
+        int status = -1;
+        EXPECT_EQ(waitpid(pid, &status, 0), pid);
+        return status;
+    }
+
+    NiceMock<DobbyRdkPluginUtilsMock> *mUtilsMock = nullptr;
+    std::shared_ptr<DobbyRdkPluginUtils> mUtils;
+};
+
+TEST_F(IPAllocatorTest, AllocatesLowestFreeAddressAndWritesAddressFile)
+{
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+
+    EXPECT_EQ(allocator->allocateIpAddress("first", "veth0"), address(0));
+    EXPECT_EQ(allocator->allocateIpAddress("second", "veth1"), address(1));
+
+    EXPECT_TRUE(hasAddress(*allocator, "first", address(0), "veth0"));
+    EXPECT_TRUE(hasAddress(*allocator, "second", address(1), "veth1"));
+    EXPECT_EQ(readAddressFile("second"), std::to_string(address(1)) + "/veth1");
+
+    // the container id comes from the utils if not given
+    EXPECT_EQ(allocator->allocateIpAddress("veth2"), address(2));
+    EXPECT_TRUE(hasAddress(*allocator, "container", address(2), "veth2"));
+}
+
+TEST_F(IPAllocatorTest, DeallocatedAddressIsReused)
+{
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+
+    allocator->allocateIpAddress("first", "veth0");
+    allocator->allocateIpAddress("second", "veth1");
+    allocator->allocateIpAddress("third", "veth2");
+
+    EXPECT_TRUE(allocator->deallocateIpAddress("second"));
+    EXPECT_FALSE(hasAddress(*allocator, "second", address(1), "veth1"));
+    EXPECT_EQ(access((ADDRESS_FILE_DIR + std::string("second")).c_str(), F_OK), -1);
+
+    EXPECT_EQ(allocator->allocateIpAddress("fourth", "veth3"), address(1));
+
+    // nothing to do for a container without an address
+    EXPECT_TRUE(allocator->deallocateIpAddress("second"));
+}
+
+TEST_F(IPAllocatorTest, ContainerOnlyHasOneAddress)
+{
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+
+    allocator->allocateIpAddress("first", "veth0");
+    EXPECT_EQ(allocator->allocateIpAddress("first", "veth5"), address(0));
+    EXPECT_TRUE(hasAddress(*allocator, "first", address(0), "veth5"));
+
+    EXPECT_EQ(allocator->allocateIpAddress("second", "veth1"), address(1));
+}
+
+TEST_F(IPAllocatorTest, ExhaustedPoolFailsUntilAnAddressIsFreed)
+{
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+
+    for (int i = 0; i < TOTAL_ADDRESS_POOL_SIZE; i++)
+    {
+        ASSERT_EQ(allocator->allocateIpAddress("c" + std::to_string(i), "veth" + std::to_string(i)),
+                  address(i));
+    }
+
+    EXPECT_EQ(allocator->allocateIpAddress("extra", "veth"), 0u);
+
+    EXPECT_TRUE(allocator->deallocateIpAddress("c100"));
+    EXPECT_EQ(allocator->allocateIpAddress("extra", "veth"), address(100));
+}
+
+TEST_F(IPAllocatorTest, InvalidNamesAreRejected)
+{
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+
+    EXPECT_EQ(allocator->allocateIpAddress(std::string(200, 'c'), "veth0"), 0u);
+    EXPECT_EQ(allocator->allocateIpAddress("first", "veth-name-too-long"), 0u);
+    EXPECT_EQ(allocator->allocateIpAddress("first", "veth0"), address(0));
+}
+
+TEST_F(IPAllocatorTest, AllocationsAreSharedBetweenInstances)
+{
+    std::unique_ptr<IPAllocator> first = createAllocator();
+    std::unique_ptr<IPAllocator> second = createAllocator();
+
+    first->allocateIpAddress("first", "veth0");
+
+    EXPECT_TRUE(hasAddress(*second, "first", address(0), "veth0"));
+    EXPECT_EQ(second->allocateIpAddress("second", "veth1"), address(1));
+    EXPECT_TRUE(hasAddress(*first, "second", address(1), "veth1"));
+}
+
+TEST_F(IPAllocatorTest, AllocationsAreSharedBetweenProcesses)
+{
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+    allocator->allocateIpAddress("parent", "veth0");
+
+    const int status = runInChild(
+        [this]()
+        {
+            std::unique_ptr<IPAllocator> childAllocator(new IPAllocator(mUtils));
+            return (childAllocator->allocateIpAddress("child", "veth1") == address(1)) ? 0 : 1;
+        });
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    EXPECT_TRUE(hasAddress(*allocator, "child", address(1), "veth1"));
+}
+
+TEST_F(IPAllocatorTest, LockOfProcessThatDiedIsReleased)
+{
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+
+    // the hook process is killed part way through changing the table
+    const int status = runInChild(
+        [this]()
+        {
+            std::unique_ptr<IPAllocator> childAllocator(new IPAllocator(mUtils));
+            if (!childAllocator->lockStore(F_WRLCK))
+                return 1;
+
+            childAllocator->mStore->records[3].ipAddress = address(3);
+            raise(SIGKILL);
+            return 2;
+        });
+    ASSERT_TRUE(WIFSIGNALED(status));
+
+    // the kernel dropped its lock, and the half written slot is still free
+    EXPECT_EQ(allocator->allocateIpAddress("first", "veth0"), address(0));
+}
+
+TEST_F(IPAllocatorTest, RecordIsIgnoredUntilItsBitIsSet)
+{
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+
+    // a process died after writing the record but before setting the bit
+    IPAllocator::StoreRecord &record = allocator->mStore->records[0];
+    strcpy(record.containerId, "ghost");
+    strcpy(record.vethName, "veth9");
+    record.ipAddress = address(0);
+
+    EXPECT_FALSE(hasAddress(*allocator, "ghost", address(0), "veth9"));
+    EXPECT_EQ(allocator->allocateIpAddress("first", "veth0"), address(0));
+    EXPECT_TRUE(hasAddress(*allocator, "first", address(0), "veth0"));
+}
+
+TEST_F(IPAllocatorTest, RecordIsFreeOnceItsBitIsCleared)
+{
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+    allocator->allocateIpAddress("first", "veth0");
+
+    // a process died after clearing the bit but before wiping the record
+    allocator->mStore->bitmap[0] &= ~1ULL;
+
+    EXPECT_FALSE(hasAddress(*allocator, "first", address(0), "veth0"));
+    EXPECT_EQ(allocator->allocateIpAddress("second", "veth1"), address(0));
+    EXPECT_TRUE(hasAddress(*allocator, "second", address(0), "veth1"));
+}
+
+TEST_F(IPAllocatorTest, ImportsAddressFilesWhenTableIsCreated)
+{
+    writeAddressFile("first", std::to_string(address(5)) + "/veth5");
+    writeAddressFile("second", std::to_string(address(7)) + "/veth7");
+
+    // out of the pool, no veth name and not a number
+    writeAddressFile("outside", std::to_string(INADDR_BRIDGE) + "/veth1");
+    writeAddressFile("noveth", std::to_string(address(1)));
+    writeAddressFile("empty", "");
+
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+
+    EXPECT_TRUE(hasAddress(*allocator, "first", address(5), "veth5"));
+    EXPECT_TRUE(hasAddress(*allocator, "second", address(7), "veth7"));
+
+    ContainerNetworkInfo networkInfo;
+    EXPECT_FALSE(allocator->getContainerNetworkInfo("outside", networkInfo));
+    EXPECT_FALSE(allocator->getContainerNetworkInfo("noveth", networkInfo));
+    EXPECT_FALSE(allocator->getContainerNetworkInfo("empty", networkInfo));
+
+    // the imported addresses aren't handed out again
+    std::set<in_addr_t> allocated;
+    for (int i = 0; i < 8; i++)
+    {
+        allocated.insert(allocator->allocateIpAddress("new" + std::to_string(i), "vethn" + std::to_string(i)));
+    }
+    EXPECT_EQ(allocated.size(), 8u);
+    EXPECT_EQ(allocated.count(address(5)), 0u);
+    EXPECT_EQ(allocated.count(address(7)), 0u);
+    EXPECT_EQ(allocated.count(0), 0u);
+}
+
+TEST_F(IPAllocatorTest, AddressFilesAreOnlyImportedOnce)
+{
+    createAllocator();
+
+    writeAddressFile("late", std::to_string(address(3)) + "/veth3");
+
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+    ContainerNetworkInfo networkInfo;
+    EXPECT_FALSE(allocator->getContainerNetworkInfo("late", networkInfo));
+}
+
+TEST_F(IPAllocatorTest, UnfinishedTableIsRebuiltFromAddressFiles)
+{
+    {
+        std::unique_ptr<IPAllocator> allocator = createAllocator();
+        allocator->allocateIpAddress("first", "veth0");
+        allocator->allocateIpAddress("second", "veth1");
+
+        // a process died while it was creating the table, leaving a bit set
+        // that doesn't match any address file
+        allocator->mStore->magic = 0;
+        allocator->mStore->bitmap[0] |= (1ULL << 4);
+    }
+
+    writeAddressFile("third", std::to_string(address(2)) + "/veth2");
+
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+    EXPECT_TRUE(hasAddress(*allocator, "first", address(0), "veth0"));
+    EXPECT_TRUE(hasAddress(*allocator, "second", address(1), "veth1"));
+    EXPECT_TRUE(hasAddress(*allocator, "third", address(2), "veth2"));
+
+    EXPECT_EQ(allocator->allocateIpAddress("fourth", "veth3"), address(3));
+    EXPECT_EQ(allocator->allocateIpAddress("fifth", "veth4"), address(4));
+}
+
+TEST_F(IPAllocatorTest, TableWithDifferentPoolSizeIsRebuilt)
+{
+    {
+        std::unique_ptr<IPAllocator> allocator = createAllocator();
+        allocator->allocateIpAddress("first", "veth0");
+        allocator->mStore->poolSize = TOTAL_ADDRESS_POOL_SIZE + 1;
+        allocator->mStore->bitmap[0] |= (1ULL << 1);
+    }
+
+    std::unique_ptr<IPAllocator> allocator = createAllocator();
+    EXPECT_EQ(allocator->mStore->poolSize, static_cast<uint32_t>(TOTAL_ADDRESS_POOL_SIZE));
+    EXPECT_TRUE(hasAddress(*allocator, "first", address(0), "veth0"));
+    EXPECT_EQ(allocator->allocateIpAddress("second", "veth1"), address(1));
+}
@@ -0,0 +1,310 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#define private public
+#include "Netfilter.h"
+#include "PortForwarding.h"
+#include "InterContainerRouting.h"
+#include "NetworkingPluginCommon.h"
+#include "DobbyRdkPluginUtilsMock.h"
+
+#include <vector>
+
+typedef std::list<std::string> RuleList;
+
+// The test build points IPSET_PATH at a tool that always succeeds, so the
+// port forwarding and inter-container code use the ipset sets and applying
+// the set changes doesn't touch the host.  Rules are only checked in the
+// cache, never applied.
+class NetfilterSetsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        mUtilsMock = new ::testing::NiceMock<DobbyRdkPluginUtilsMock>;
+        DobbyRdkPluginUtils::setImpl(mUtilsMock);
+        mUtils = std::make_shared<DobbyRdkPluginUtils>();
+
+        ON_CALL(*mUtilsMock, getContainerId())
+            .WillByDefault(::testing::Return(std::string("container")));
+
+        ASSERT_TRUE(Netfilter::setsAvailable());
+    }
+
+    void TearDown() override
+    {
+        mUtils.reset();
+        DobbyRdkPluginUtils::setImpl(nullptr);
+        delete mUtilsMock;
+    }
+
+    // a helper for a container at the first address in the pool
+    static std::shared_ptr<NetworkingHelper> createHelper(bool ipv4, bool ipv6,
+                                                          in_addr_t address = INADDR_BRIDGE + 1,
+                                                          const std::string &vethName = "veth3")
+    {
+        auto helper = std::make_shared<NetworkingHelper>(ipv4, ipv6);
+        EXPECT_TRUE(helper->storeContainerInterface(address, vethName));
+        return helper;
+    }
+
+    // port forwarding config of tcp 80 and udp 53 from the host and tcp 8080
+    // to the host
+    struct PortsConfig
+    {
+        PortsConfig()
+        {
+            hostToContainer[0].port = 80;
+            hostToContainer[0].protocol = const_cast<char *>("tcp");
+            hostToContainer[1].port = 53;
+            hostToContainer[1].protocol = const_cast<char *>("UDP");
+            containerToHost[0].port = 8080;
+            containerToHost[0].protocol = nullptr;
+
+            hostToContainerPtrs = { &hostToContainer[0], &hostToContainer[1] };
+            containerToHostPtrs = { &containerToHost[0] };
+
+            config.host_to_container = hostToContainerPtrs.data();
+            config.host_to_container_len = hostToContainerPtrs.size();
+            config.container_to_host = containerToHostPtrs.data();
+            config.container_to_host_len = containerToHostPtrs.size();
+        }
+
+        rt_defs_plugins_networking_data_port_forwarding_host_to_container_element hostToContainer[2] = { };
+        rt_defs_plugins_networking_data_port_forwarding_container_to_host_element containerToHost[1] = { };
+        std::vector<rt_defs_plugins_networking_data_port_forwarding_host_to_container_element *> hostToContainerPtrs;
+        std::vector<rt_defs_plugins_networking_data_port_forwarding_container_to_host_element *> containerToHostPtrs;
+        rt_defs_plugins_networking_data_port_forwarding config = { };
+    };
+
+    // inter-container config of a tcp 80 server and a udp 9000 client
+    struct InterContainerConfig
+    {
+        InterContainerConfig()
+        {
+            ports[0].direction = const_cast<char *>("in");
+            ports[0].port = 80;
+            ports[0].protocol = const_cast<char *>("tcp");
+            ports[1].direction = const_cast<char *>("out");
+            ports[1].port = 9000;
+            ports[1].protocol = const_cast<char *>("udp");
+
+            portPtrs = { &ports[0], &ports[1] };
+        }
+
+        rt_defs_plugins_networking_data_inter_container_element ports[2] = { };
+        std::vector<rt_defs_plugins_networking_data_inter_container_element *> portPtrs;
+    };
+
+    ::testing::NiceMock<DobbyRdkPluginUtilsMock> *mUtilsMock = nullptr;
+    std::shared_ptr<DobbyRdkPluginUtils> mUtils;
+};
+
+TEST_F(NetfilterSetsTest, SetCommandsCreateTheSetsAndDeleteBeforeAdding)
+{
+    Netfilter netfilter(Netfilter::Backend::Iptables);
+
+    EXPECT_TRUE(netfilter.addSetEntries("DobbyHostToCtr", "hash:ip,port", { "100.64.11.2,tcp:80" },
+                                        AF_INET, Netfilter::Operation::Insert));
+    EXPECT_TRUE(netfilter.addSetEntries("DobbyHostToCtr", "hash:ip,port", { "100.64.11.3,udp:53" },
+                                        AF_INET, Netfilter::Operation::Delete));
+    EXPECT_TRUE(netfilter.addSetEntries("DobbyVeths", "hash:net,iface", { "100.64.11.2,physdev:veth3" },
+                                        AF_INET, Netfilter::Operation::Append));
+    EXPECT_TRUE(netfilter.addSetEntries("DobbyVeths6", "hash:net,iface", { "2080:d0bb:1e::6440:b02,physdev:veth3" },
+                                        AF_INET6, Netfilter::Operation::Insert));
+
+    EXPECT_EQ(Netfilter::setCommands(netfilter.mIpv4RuleCache.setEntries, AF_INET),
+              "create DobbyHostToCtr hash:ip,port family inet\n"
+              "del DobbyHostToCtr 100.64.11.3,udp:53\n"
+              "add DobbyHostToCtr 100.64.11.2,tcp:80\n"
+              "create DobbyVeths hash:net,iface family inet\n"
+              "add DobbyVeths 100.64.11.2,physdev:veth3\n");
+
+    EXPECT_EQ(Netfilter::setCommands(netfilter.mIpv6RuleCache.setEntries, AF_INET6),
+              "create DobbyVeths6 hash:net,iface family inet6\n"
+              "add DobbyVeths6 2080:d0bb:1e::6440:b02,physdev:veth3\n");
+}
+
+TEST_F(NetfilterSetsTest, InvalidSetEntriesAreRejected)
+{
+    Netfilter netfilter(Netfilter::Backend::Iptables);
+
+    EXPECT_FALSE(netfilter.addSetEntries("DobbyVeths", "hash:net,iface", { "100.64.11.2,physdev:veth3" },
+                                         AF_INET, Netfilter::Operation::Unchanged));
+    EXPECT_FALSE(netfilter.addSetEntries("DobbyVeths", "hash:net,iface", { "100.64.11.2,physdev:veth3" },
+                                         AF_UNIX, Netfilter::Operation::Insert));
+    EXPECT_TRUE(netfilter.mIpv4RuleCache.setEntries.empty());
+}
+
+TEST_F(NetfilterSetsTest, ApplyWithOnlySetChangesClearsTheCache)
+{
+    Netfilter netfilter(Netfilter::Backend::Iptables);
+
+    EXPECT_TRUE(netfilter.addSetEntries("DobbyVeths", "hash:net,iface", { "100.64.11.2,physdev:veth3" },
+                                        AF_INET, Netfilter::Operation::Insert));
+
+    EXPECT_TRUE(netfilter.applyRules(AF_INET));
+    EXPECT_TRUE(netfilter.mIpv4RuleCache.setEntries.empty());
+}
+
+TEST_F(NetfilterSetsTest, SetNameHasSuffixForIpv6)
+{
+    EXPECT_EQ(Netfilter::setName(CONTAINER_VETH_SET, AF_INET), "DobbyVeths");
+    EXPECT_EQ(Netfilter::setName(CONTAINER_VETH_SET, AF_INET6), "DobbyVeths6");
+}
+
+TEST_F(NetfilterSetsTest, PortForwardsAddSetEntriesAndSharedRules)
+{
+    const std::shared_ptr<Netfilter> netfilter = std::make_shared<Netfilter>(Netfilter::Backend::Iptables);
+    PortsConfig ports;
+
+    ASSERT_TRUE(PortForwarding::addPortForwards(netfilter, createHelper(true, false),
+                                                "container", &ports.config));
+
+    std::map<std::string, Netfilter::SetEntries> &sets = netfilter->mIpv4RuleCache.setEntries;
+    ASSERT_EQ(sets.size(), 3u);
+    EXPECT_EQ(sets[HOST_TO_CONTAINER_SET].type, "hash:ip,port");
+    EXPECT_EQ(sets[HOST_TO_CONTAINER_SET].addEntries, RuleList({ "100.64.11.2,tcp:80", "100.64.11.2,udp:53" }));
+    EXPECT_EQ(sets[CONTAINER_TO_HOST_SET].addEntries, RuleList({ "100.64.11.2,tcp:8080" }));
+    EXPECT_EQ(sets[CONTAINER_VETH_SET].type, "hash:net,iface");
+    EXPECT_EQ(sets[CONTAINER_VETH_SET].addEntries, RuleList({ "100.64.11.2,physdev:veth3" }));
+
+    Netfilter::RuleSet &insertRules = netfilter->mIpv4RuleCache.insertRuleSet;
+    EXPECT_EQ(insertRules[Netfilter::TableType::Filter],
+              RuleList({ "FORWARD ! -i dobby0 -o dobby0 -m set --match-set DobbyHostToCtr dst,dst -j ACCEPT",
+                         "DobbyInputChain -d 127.0.0.1/32 -i dobby0 -m set --match-set DobbyCtrToHost src,dst "
+                         "-m set --match-set DobbyVeths src,src -j ACCEPT" }));
+    EXPECT_EQ(insertRules[Netfilter::TableType::Nat],
+              RuleList({ "PREROUTING -d 100.64.11.1/32 -i dobby0 -m set --match-set DobbyCtrToHost src,dst "
+                         "-j DNAT --to-destination 127.0.0.1" }));
+
+    // a DNAT rule can't take its destination from a set, so those are still
+    // added for each port
+    const PortForward http = { "tcp", "80" };
+    const PortForward dns = { "udp", "53" };
+    Netfilter::RuleSet &appendRules = netfilter->mIpv4RuleCache.appendRuleSet;
+    EXPECT_EQ(appendRules[Netfilter::TableType::Nat],
+              RuleList({ createPreroutingRule(http, "container", "100.64.11.2", AF_INET),
+                         createPreroutingRule(dns, "container", "100.64.11.2", AF_INET) }));
+    EXPECT_TRUE(appendRules[Netfilter::TableType::Filter].empty());
+
+    EXPECT_TRUE(netfilter->mIpv6RuleCache.setEntries.empty());
+}
+
+TEST_F(NetfilterSetsTest, SharedRulesAreTheSameForEveryContainer)
+{
+    const std::shared_ptr<Netfilter> first = std::make_shared<Netfilter>(Netfilter::Backend::Iptables);
+    const std::shared_ptr<Netfilter> second = std::make_shared<Netfilter>(Netfilter::Backend::Iptables);
+    PortsConfig ports;
+
+    ASSERT_TRUE(PortForwarding::addPortForwards(first, createHelper(true, false, INADDR_BRIDGE + 1, "veth3"),
+                                                "first", &ports.config));
+    ASSERT_TRUE(PortForwarding::addPortForwards(second, createHelper(true, false, INADDR_BRIDGE + 2, "veth4"),
+                                                "second", &ports.config));
+
+    // the set entries differ, the rules don't, so the duplicates get dropped
+    // and the number of rules doesn't grow with the number of containers
+    EXPECT_EQ(second->mIpv4RuleCache.setEntries[CONTAINER_VETH_SET].addEntries,
+              RuleList({ "100.64.11.3,physdev:veth4" }));
+    EXPECT_EQ(first->mIpv4RuleCache.insertRuleSet, second->mIpv4RuleCache.insertRuleSet);
+}
+
+TEST_F(NetfilterSetsTest, RemovedPortForwardsOnlyDeleteEntriesAndDnatRules)
+{
+    const std::shared_ptr<Netfilter> netfilter = std::make_shared<Netfilter>(Netfilter::Backend::Iptables);
+    PortsConfig ports;
+
+    ASSERT_TRUE(PortForwarding::removePortForwards(netfilter, createHelper(true, false),
+                                                   "container", &ports.config));
+
+    std::map<std::string, Netfilter::SetEntries> &sets = netfilter->mIpv4RuleCache.setEntries;
+    EXPECT_TRUE(sets[HOST_TO_CONTAINER_SET].addEntries.empty());
+    EXPECT_EQ(sets[HOST_TO_CONTAINER_SET].deleteEntries, RuleList({ "100.64.11.2,tcp:80", "100.64.11.2,udp:53" }));
+    EXPECT_EQ(sets[CONTAINER_VETH_SET].deleteEntries, RuleList({ "100.64.11.2,physdev:veth3" }));
+
+    // the shared rules are left for the other containers
+    EXPECT_TRUE(netfilter->mIpv4RuleCache.insertRuleSet.empty());
+    EXPECT_TRUE(netfilter->mIpv4RuleCache.deleteRuleSet[Netfilter::TableType::Filter].empty());
+    EXPECT_EQ(netfilter->mIpv4RuleCache.deleteRuleSet[Netfilter::TableType::Nat].size(), 2u);
+}
+
+TEST_F(NetfilterSetsTest, Ipv6PortForwardsUseTheIpv6Sets)
+{
+    const std::shared_ptr<Netfilter> netfilter = std::make_shared<Netfilter>(Netfilter::Backend::Iptables);
+    const std::shared_ptr<NetworkingHelper> helper = createHelper(false, true);
+    PortsConfig ports;
+
+    ASSERT_TRUE(PortForwarding::addPortForwards(netfilter, helper, "container", &ports.config));
+
+    EXPECT_TRUE(netfilter->mIpv4RuleCache.setEntries.empty());
+
+    std::map<std::string, Netfilter::SetEntries> &sets = netfilter->mIpv6RuleCache.setEntries;
+    ASSERT_EQ(sets.size(), 3u);
+    EXPECT_EQ(sets["DobbyCtrToHost6"].addEntries, RuleList({ helper->ipv6AddrStr() + ",tcp:8080" }));
+
+    EXPECT_EQ(netfilter->mIpv6RuleCache.insertRuleSet[Netfilter::TableType::Nat],
+              RuleList({ "PREROUTING -d " BRIDGE_ADDRESS_IPV6 "/128 -i dobby0 -m set --match-set DobbyCtrToHost6 src,dst "
+                         "-j DNAT --to-destination ::1" }));
+}
+
+TEST_F(NetfilterSetsTest, InterContainerPortsAddSetEntriesAndSharedRules)
+{
+    const std::shared_ptr<Netfilter> netfilter = std::make_shared<Netfilter>(Netfilter::Backend::Iptables);
+    InterContainerConfig ports;
+
+    ASSERT_TRUE(InterContainerRouting::addRules(netfilter, createHelper(true, false), mUtils,
+                                                ports.portPtrs.data(), ports.portPtrs.size()));
+
+    std::map<std::string, Netfilter::SetEntries> &sets = netfilter->mIpv4RuleCache.setEntries;
+    ASSERT_EQ(sets.size(), 3u);
+    EXPECT_EQ(sets[INTER_CONTAINER_IN_SET].addEntries, RuleList({ "100.64.11.2,tcp:80" }));
+    EXPECT_EQ(sets[INTER_CONTAINER_OUT_SET].addEntries, RuleList({ "100.64.11.2,udp:9000" }));
+    EXPECT_EQ(sets[CONTAINER_VETH_SET].addEntries, RuleList({ "100.64.11.2,physdev:veth3" }));
+
+    // the per-port FORWARD rules are replaced by one for each direction, the
+    // DNAT rule to the server is still added for its port
+    Netfilter::RuleSet &insertRules = netfilter->mIpv4RuleCache.insertRuleSet;
+    EXPECT_EQ(insertRules[Netfilter::TableType::Filter],
+              RuleList({ "FORWARD -d 100.64.11.0/24 -i dobby0 -o dobby0 -m set --match-set DobbyInterIn src,src "
+                         "-m set --match-set DobbyVeths src,src -j ACCEPT",
+                         "FORWARD -d 100.64.11.0/24 -i dobby0 -o dobby0 -m set --match-set DobbyInterOut src,dst "
+                         "-m set --match-set DobbyVeths src,src -j ACCEPT" }));
+    ASSERT_EQ(insertRules[Netfilter::TableType::Nat].size(), 1u);
+    EXPECT_NE(insertRules[Netfilter::TableType::Nat].front().find("--to-destination 100.64.11.2:80"),
+              std::string::npos);
+}
+
+TEST_F(NetfilterSetsTest, RemovedInterContainerPortsLeaveTheSharedRules)
+{
+    const std::shared_ptr<Netfilter> netfilter = std::make_shared<Netfilter>(Netfilter::Backend::Iptables);
+    InterContainerConfig ports;
+
+    ASSERT_TRUE(InterContainerRouting::removeRules(netfilter, createHelper(true, false), mUtils,
+                                                   ports.portPtrs.data(), ports.portPtrs.size()));
+
+    std::map<std::string, Netfilter::SetEntries> &sets = netfilter->mIpv4RuleCache.setEntries;
+    EXPECT_EQ(sets[INTER_CONTAINER_IN_SET].deleteEntries, RuleList({ "100.64.11.2,tcp:80" }));
+    EXPECT_EQ(sets[INTER_CONTAINER_OUT_SET].deleteEntries, RuleList({ "100.64.11.2,udp:9000" }));
+
+    EXPECT_TRUE(netfilter->mIpv4RuleCache.insertRuleSet.empty());
+    EXPECT_TRUE(netfilter->mIpv4RuleCache.deleteRuleSet[Netfilter::TableType::Filter].empty());
+    EXPECT_EQ(netfilter->mIpv4RuleCache.deleteRuleSet[Netfilter::TableType::Nat].size(), 1u);
+}
@@ -0,0 +1,295 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#define private public
+#include "Netfilter.h"
+#include "DobbyRdkPluginUtilsMock.h"
+
+#include <map>
+
+DobbyRdkPluginUtilsImpl* DobbyRdkPluginUtils::impl = nullptr;
+
+typedef std::list<std::string> RuleList;
+
+// Tests the merge of an applied RuleSets into the process wide shadow rules.
+// The shadow is only merged into while it's valid, whether it stays valid
+// afterwards depends on the kernel fingerprint, so only the rules are checked
+// after a successful restore.
+class NetfilterShadowTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        Netfilter::mShadows.clear();
+    }
+
+    void TearDown() override
+    {
+        Netfilter::mShadows.clear();
+    }
+
+    Netfilter::Shadow &seedShadow(const RuleList &filterRules)
+    {
+        Netfilter::Shadow &shadow =
+            Netfilter::mShadows[std::make_pair(mNetfilter.mBackend, AF_INET)];
+        shadow.valid = true;
+        shadow.fingerprint = 0;
+        shadow.rules[Netfilter::TableType::Filter] = filterRules;
+        return shadow;
+    }
+
+    const RuleList &shadowFilterRules()
+    {
+        return Netfilter::mShadows[std::make_pair(mNetfilter.mBackend, AF_INET)]
+            .rules[Netfilter::TableType::Filter];
+    }
+
+    Netfilter mNetfilter{ Netfilter::Backend::Iptables };
+};
+
+TEST_F(NetfilterShadowTest, ChainDeclarationFlushesOnlyThatChain)
+{
+    seedShadow({ "DobbyA -i veth0 -j ACCEPT",
+                 "DobbyA -i veth1 -j ACCEPT",
+                 "DobbyAB -j DROP",
+                 "FORWARD -j DobbyA" });
+
+    Netfilter::RuleSets applied;
+    applied.unchangedRuleSet[Netfilter::TableType::Filter] = { ":DobbyA - [0:0]" };
+
+    mNetfilter.updateShadow(applied, AF_INET, true);
+
+    // the declared chain is emptied, a chain sharing its prefix and a jump to
+    // it from another chain are left alone
+    const RuleList expected = { "DobbyAB -j DROP", "FORWARD -j DobbyA" };
+    EXPECT_EQ(shadowFilterRules(), expected);
+}
+
+TEST_F(NetfilterShadowTest, ChainDeclarationFlushesBeforeAddingRules)
+{
+    seedShadow({ "DobbyA -i veth0 -j ACCEPT" });
+
+    Netfilter::RuleSets applied;
+    applied.unchangedRuleSet[Netfilter::TableType::Filter] = { ":DobbyA - [0:0]" };
+    applied.appendRuleSet[Netfilter::TableType::Filter] = { "DobbyA -i veth2 -j ACCEPT" };
+    applied.insertRuleSet[Netfilter::TableType::Filter] = { "DobbyA -i veth3 -j DROP" };
+
+    mNetfilter.updateShadow(applied, AF_INET, true);
+
+    // iptables-restore flushes the chain before writing the new rules to it
+    const RuleList expected = { "DobbyA -i veth2 -j ACCEPT", "DobbyA -i veth3 -j DROP" };
+    EXPECT_EQ(shadowFilterRules(), expected);
+}
+
+TEST_F(NetfilterShadowTest, DeleteRemovesOneMatchingRule)
+{
+    seedShadow({ "FORWARD -i dobby0 -j ACCEPT",
+                 "INPUT -i dobby0 -j DROP",
+                 "FORWARD -i dobby0 -j ACCEPT" });
+
+    Netfilter::RuleSets applied;
+    applied.deleteRuleSet[Netfilter::TableType::Filter] = { "FORWARD -i dobby0 -j ACCEPT" };
+
+    mNetfilter.updateShadow(applied, AF_INET, true);
+
+    // like 'iptables -D' only the first of a duplicated rule is deleted
+    const RuleList expected = { "INPUT -i dobby0 -j DROP", "FORWARD -i dobby0 -j ACCEPT" };
+    EXPECT_EQ(shadowFilterRules(), expected);
+}
+
+TEST_F(NetfilterShadowTest, DeleteOfUnknownRuleIsIgnored)
+{
+    seedShadow({ "INPUT -i dobby0 -j DROP" });
+
+    Netfilter::RuleSets applied;
+    applied.deleteRuleSet[Netfilter::TableType::Filter] = { "INPUT -i dobby1 -j DROP" };
+    applied.deleteRuleSet[Netfilter::TableType::Nat] = { "POSTROUTING -j MASQUERADE" };
+
+    mNetfilter.updateShadow(applied, AF_INET, true);
+
+    const RuleList expected = { "INPUT -i dobby0 -j DROP" };
+    EXPECT_EQ(shadowFilterRules(), expected);
+    EXPECT_TRUE(Netfilter::mShadows[std::make_pair(mNetfilter.mBackend, AF_INET)]
+                    .rules[Netfilter::TableType::Nat].empty());
+}
+
+TEST_F(NetfilterShadowTest, FailedRestoreInvalidatesShadow)
+{
+    const RuleList rules = { "INPUT -i dobby0 -j DROP" };
+    Netfilter::Shadow &shadow = seedShadow(rules);
+
+    Netfilter::RuleSets applied;
+    applied.appendRuleSet[Netfilter::TableType::Filter] = { "INPUT -i dobby1 -j DROP" };
+    applied.deleteRuleSet[Netfilter::TableType::Filter] = { "INPUT -i dobby0 -j DROP" };
+
+    mNetfilter.updateShadow(applied, AF_INET, false);
+
+    // we can't tell which tables were committed, so nothing is merged and the
+    // rules have to be dumped again on the next apply
+    EXPECT_FALSE(shadow.valid);
+    EXPECT_EQ(shadowFilterRules(), rules);
+}
+
+TEST_F(NetfilterShadowTest, InvalidShadowIsNotUpdated)
+{
+    Netfilter::Shadow &shadow = seedShadow({ "INPUT -i dobby0 -j DROP" });
+    shadow.valid = false;
+
+    Netfilter::RuleSets applied;
+    applied.appendRuleSet[Netfilter::TableType::Filter] = { "INPUT -i dobby1 -j DROP" };
+
+    mNetfilter.updateShadow(applied, AF_INET, true);
+
+    const RuleList expected = { "INPUT -i dobby0 -j DROP" };
+    EXPECT_FALSE(shadow.valid);
+    EXPECT_EQ(shadowFilterRules(), expected);
+}
+
+TEST_F(NetfilterShadowTest, ShadowsAreKeptPerIpVersion)
+{
+    seedShadow({ "INPUT -i dobby0 -j DROP" });
+
+    Netfilter::Shadow &ipv6Shadow =
+        Netfilter::mShadows[std::make_pair(mNetfilter.mBackend, AF_INET6)];
+    ipv6Shadow.valid = true;
+
+    Netfilter::RuleSets applied;
+    applied.appendRuleSet[Netfilter::TableType::Filter] = { "INPUT -i dobby1 -j DROP" };
+
+    mNetfilter.updateShadow(applied, AF_INET6, true);
+
+    const RuleList expectedIpv4 = { "INPUT -i dobby0 -j DROP" };
+    const RuleList expectedIpv6 = { "INPUT -i dobby1 -j DROP" };
+    EXPECT_EQ(shadowFilterRules(), expectedIpv4);
+    EXPECT_EQ(ipv6Shadow.rules[Netfilter::TableType::Filter], expectedIpv6);
+}
+
+// Tests the Netfilter shared by the plugins of a hook point.  The utils mock
+// keeps the hook objects like the real DobbyRdkPluginUtils does.  Rules are
+// never committed here, that would run iptables-restore against the host.
+class NetfilterHookTransactionTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        mUtilsMock = new ::testing::NiceMock<DobbyRdkPluginUtilsMock>;
+        DobbyRdkPluginUtils::setImpl(mUtilsMock);
+        mUtils = std::make_shared<DobbyRdkPluginUtils>();
+
+        ON_CALL(*mUtilsMock, hookObject(::testing::_, ::testing::_, ::testing::_))
+            .WillByDefault(::testing::Invoke(
+                [this](const std::string &name,
+                       const std::function<std::shared_ptr<void>()> &create,
+                       const DobbyRdkPluginUtils::HookObjectCommit &commit)
+                {
+                    auto it = mObjects.find(name);
+                    if (it == mObjects.end())
+                    {
+                        std::shared_ptr<void> object = create();
+                        if (!object)
+                            return object;
+                        it = mObjects.emplace(name, std::make_pair(object, commit)).first;
+                    }
+                    return it->second.first;
+                }));
+    }
+
+    void TearDown() override
+    {
+        mObjects.clear();
+        mUtils.reset();
+        DobbyRdkPluginUtils::setImpl(nullptr);
+        delete mUtilsMock;
+    }
+
+    // commits and releases the hook objects, as the plugin manager does at
+    // the end of a hook point
+    bool commitHookObjects()
+    {
+        bool success = true;
+        for (const auto &object : mObjects)
+        {
+            success = object.second.second(object.second.first) && success;
+        }
+        mObjects.clear();
+        return success;
+    }
+
+    DobbyRdkPluginUtilsMock *mUtilsMock = nullptr;
+    std::shared_ptr<DobbyRdkPluginUtils> mUtils;
+    std::map<std::string, std::pair<std::shared_ptr<void>, DobbyRdkPluginUtils::HookObjectCommit>> mObjects;
+};
+
+TEST_F(NetfilterHookTransactionTest, PluginsShareOneInstance)
+{
+    EXPECT_CALL(*mUtilsMock, hookObject("netfilter", ::testing::_, ::testing::_))
+        .Times(2);
+
+    const std::shared_ptr<Netfilter> first = Netfilter::hookTransaction(mUtils);
+    const std::shared_ptr<Netfilter> second = Netfilter::hookTransaction(mUtils);
+
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(mObjects.size(), 1u);
+}
+
+TEST_F(NetfilterHookTransactionTest, RulesOfAllPluginsAreCachedTogether)
+{
+    Netfilter::RuleSet networkingRules = {
+        { Netfilter::TableType::Filter, { "FORWARD -i dobby0 -j ACCEPT" } } };
+    Netfilter::RuleSet thunderRules = {
+        { Netfilter::TableType::Filter, { "INPUT -p tcp --dport 9998 -j ACCEPT" } },
+        { Netfilter::TableType::Nat, { "PREROUTING -p tcp --dport 9998 -j DNAT" } } };
+    Netfilter::RuleSet ipv6Rules = {
+        { Netfilter::TableType::Filter, { "FORWARD -i dobby0 -j DROP" } } };
+
+    EXPECT_TRUE(Netfilter::hookTransaction(mUtils)->addRules(networkingRules, AF_INET, Netfilter::Operation::Append));
+    EXPECT_TRUE(Netfilter::hookTransaction(mUtils)->addRules(thunderRules, AF_INET, Netfilter::Operation::Append));
+    EXPECT_TRUE(Netfilter::hookTransaction(mUtils)->addRules(ipv6Rules, AF_INET6, Netfilter::Operation::Insert));
+
+    const std::shared_ptr<Netfilter> netfilter = Netfilter::hookTransaction(mUtils);
+
+    const std::list<std::string> expectedFilter = { "FORWARD -i dobby0 -j ACCEPT",
+                                                    "INPUT -p tcp --dport 9998 -j ACCEPT" };
+    EXPECT_EQ(netfilter->mIpv4RuleCache.appendRuleSet[Netfilter::TableType::Filter], expectedFilter);
+    EXPECT_EQ(netfilter->mIpv4RuleCache.appendRuleSet[Netfilter::TableType::Nat].size(), 1u);
+    EXPECT_EQ(netfilter->mIpv6RuleCache.insertRuleSet[Netfilter::TableType::Filter].size(), 1u);
+}
+
+TEST_F(NetfilterHookTransactionTest, CommitWithNoRulesSucceeds)
+{
+    std::weak_ptr<Netfilter> netfilter = Netfilter::hookTransaction(mUtils);
+    ASSERT_FALSE(netfilter.expired());
+
+    // nothing was added, so there's nothing to restore for either ip version
+    EXPECT_TRUE(commitHookObjects());
+    EXPECT_TRUE(netfilter.expired());
+}
+
+TEST_F(NetfilterHookTransactionTest, NextHookPointGetsANewInstance)
+{
+    const std::shared_ptr<Netfilter> first = Netfilter::hookTransaction(mUtils);
+    EXPECT_TRUE(commitHookObjects());
+
+    const std::shared_ptr<Netfilter> second = Netfilter::hookTransaction(mUtils);
+    ASSERT_NE(second, nullptr);
+    EXPECT_NE(first, second);
+}
@@ -0,0 +1,556 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <netlink/cache.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#define private public
+#include "Netlink.h"
+#include "NetworkingPluginCommon.h"
+#include "VethPool.h"
+#include "DobbyRdkPluginUtilsMock.h"
+
+DobbyRdkPluginUtilsImpl* DobbyRdkPluginUtils::impl = nullptr;
+
+// Moves the test process into a network namespace of its own the first time
+// it's called, so the tests only see the links they create.  Needs root.
+static bool isolateNetwork()
+{
+    static const bool isolated = (geteuid() == 0) && (unshare(CLONE_NEWNET) == 0);
+    return isolated;
+}
+
+TEST(NetlinkVethNameTest, OnlyVethNamesHaveANumber)
+{
+    unsigned number = 99;
+    EXPECT_TRUE(Netlink::vethNumber("veth0", &number));
+    EXPECT_EQ(number, 0u);
+    EXPECT_TRUE(Netlink::vethNumber("veth123", &number));
+    EXPECT_EQ(number, 123u);
+
+    EXPECT_FALSE(Netlink::vethNumber("veth", &number));
+    EXPECT_FALSE(Netlink::vethNumber("veth1a", &number));
+    EXPECT_FALSE(Netlink::vethNumber("vethx", &number));
+    EXPECT_FALSE(Netlink::vethNumber("eth0", &number));
+    EXPECT_FALSE(Netlink::vethNumber("dobby0", &number));
+}
+
+TEST(NetlinkVethNameTest, FirstFreeNameSkipsTakenNumbers)
+{
+    EXPECT_EQ(Netlink::firstFreeVethName({ }, 0), "veth0");
+    EXPECT_EQ(Netlink::firstFreeVethName({ 0, 1, 3 }, 0), "veth2");
+    EXPECT_EQ(Netlink::firstFreeVethName({ 0, 1, 3 }, 3), "veth4");
+    EXPECT_EQ(Netlink::firstFreeVethName({ 5 }, 2), "veth2");
+}
+
+TEST(NetlinkVethNameTest, NoFreeNameWhenAllAreTaken)
+{
+    std::set<unsigned> taken;
+    for (unsigned n = 0; n < 1024; n++)
+    {
+        taken.insert(n);
+    }
+
+    EXPECT_EQ(Netlink::firstFreeVethName(taken, 0), "");
+    EXPECT_EQ(Netlink::firstFreeVethName({ }, 1024), "");
+}
+
+// Tests the link cache of the shared instance against real links
+class NetlinkLinkCacheTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        if (!isolateNetwork())
+        {
+            GTEST_SKIP() << "needs root to create a network namespace";
+        }
+
+        mShared = Netlink::shared();
+        ASSERT_TRUE(mShared->isValid());
+    }
+
+    void TearDown() override
+    {
+        for (const std::string &name : mCreated)
+        {
+            if (mNetlink.ifaceExists(name))
+            {
+                EXPECT_TRUE(mNetlink.deleteIface(name));
+            }
+        }
+    }
+
+    // creates a link with a plain instance, so the shared one only learns of
+    // it from the link notifications
+    void createLink(const std::string &name)
+    {
+        ASSERT_TRUE(mNetlink.createBridge(name));
+        mCreated.push_back(name);
+    }
+
+    std::string availableVethName(int startIndex)
+    {
+        std::lock_guard<std::mutex> locker(mShared->mLock);
+        return mShared->getAvailableVethName(startIndex);
+    }
+
+    std::shared_ptr<Netlink> mShared;
+    Netlink mNetlink;
+    std::list<std::string> mCreated;
+};
+
+TEST_F(NetlinkLinkCacheTest, SharedInstanceHasALinkCache)
+{
+    EXPECT_EQ(Netlink::shared(), mShared);
+    EXPECT_NE(mShared->mLinkCache, nullptr);
+    EXPECT_EQ(mNetlink.mLinkCache, nullptr);
+
+    EXPECT_TRUE(mShared->ifaceExists("lo"));
+}
+
+TEST_F(NetlinkLinkCacheTest, CacheFollowsLinksAddedAndRemoved)
+{
+    EXPECT_FALSE(mShared->ifaceExists("dtest0"));
+
+    createLink("dtest0");
+    EXPECT_TRUE(mShared->ifaceExists("dtest0"));
+
+    EXPECT_TRUE(mNetlink.deleteIface("dtest0"));
+    EXPECT_FALSE(mShared->ifaceExists("dtest0"));
+}
+
+TEST_F(NetlinkLinkCacheTest, FreeVethNameSkipsLinksInTheCache)
+{
+    createLink("veth0");
+    createLink("veth1");
+    createLink("veth3");
+
+    EXPECT_EQ(availableVethName(0), "veth2");
+
+    EXPECT_TRUE(mNetlink.deleteIface("veth0"));
+    EXPECT_EQ(availableVethName(0), "veth0");
+    EXPECT_EQ(availableVethName(3), "veth4");
+}
+
+TEST_F(NetlinkLinkCacheTest, CacheIsRefilledAfterLostNotifications)
+{
+    // shrink the notification socket's buffer so the changes below overflow
+    // it, then the queued notifications must be dropped rather than bringing
+    // back links that are gone
+    const int fd = nl_cache_mngr_get_fd(mShared->mCacheManager);
+    ASSERT_GE(fd, 0);
+    const int bufferSize = 1;
+    ASSERT_EQ(setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize)), 0);
+
+    for (int i = 0; i < 40; i++)
+    {
+        createLink("dfill" + std::to_string(i));
+    }
+    for (int i = 0; i < 40; i += 2)
+    {
+        EXPECT_TRUE(mNetlink.deleteIface("dfill" + std::to_string(i)));
+    }
+
+    for (int i = 0; i < 40; i++)
+    {
+        EXPECT_EQ(mShared->ifaceExists("dfill" + std::to_string(i)), (i % 2) == 1) << i;
+    }
+}
+
+TEST_F(NetlinkLinkCacheTest, ThreadInAnotherNamespaceGetsItsOwnInstance)
+{
+    createLink("dtest1");
+
+    std::shared_ptr<Netlink> other;
+    bool existsInOther = true;
+
+    std::thread thread([&]()
+    {
+        if (unshare(CLONE_NEWNET) == 0)
+        {
+            other = Netlink::shared();
+            existsInOther = other->ifaceExists("dtest1");
+        }
+    });
+    thread.join();
+
+    ASSERT_NE(other, nullptr);
+    EXPECT_NE(other, mShared);
+    EXPECT_EQ(other->mLinkCache, nullptr);
+    EXPECT_FALSE(existsInOther);
+
+    EXPECT_TRUE(mShared->ifaceExists("dtest1"));
+}
+
+// Tests creating veth pairs into another namespace and batching the requests
+// made in it.  A child process holds the namespace the veths are created in.
+class NetlinkVethTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        if (!isolateNetwork())
+        {
+            GTEST_SKIP() << "needs root to create a network namespace";
+        }
+
+        int fds[2];
+        ASSERT_EQ(pipe(fds), 0);
+
+        mChild = fork();
+        ASSERT_GE(mChild, 0);
+        if (mChild == 0)
+        {
+            close(fds[0]);
+            const char ready = (unshare(CLONE_NEWNET) == 0) ? 1 : 0;
+            if (write(fds[1], &ready, 1) == 1)
+            {
+                pause();
+            }
+            _exit(EXIT_FAILURE);
+        }
+
+        close(fds[1]);
+        char ready = 0;
+        ASSERT_EQ(read(fds[0], &ready, 1), 1);
+        close(fds[0]);
+        ASSERT_EQ(ready, 1);
+    }
+
+    void TearDown() override
+    {
+        // the container end and its peer go with the namespace
+        if (mChild > 0)
+        {
+            kill(mChild, SIGKILL);
+            waitpid(mChild, nullptr, 0);
+        }
+    }
+
+    // runs the function on a thread in the child's namespace
+    bool inChildNetns(const std::function<bool()> &func)
+    {
+        bool result = false;
+
+        std::thread thread([&]()
+        {
+            const std::string nsPath = "/proc/" + std::to_string(mChild) + "/ns/net";
+            int nsFd = open(nsPath.c_str(), O_RDONLY | O_CLOEXEC);
+            if (nsFd < 0)
+            {
+                return;
+            }
+            if (setns(nsFd, CLONE_NEWNET) == 0)
+            {
+                result = func();
+            }
+            close(nsFd);
+        });
+        thread.join();
+
+        return result;
+    }
+
+    // creates a veth into the child's namespace and brings the host end up,
+    // the name isn't checked as the kernel may still be removing the veths
+    // of the previous test's namespace
+    std::string createUpVeth()
+    {
+        std::vector<std::string> takenVeths;
+        const std::string vethName = mNetlink.createVeth("eth0", mChild, takenVeths);
+        if (vethName.empty() || !mNetlink.ifaceUp(vethName))
+        {
+            return std::string();
+        }
+        return vethName;
+    }
+
+    pid_t mChild = -1;
+    Netlink mNetlink;
+};
+
+TEST_F(NetlinkVethTest, PeerIsCreatedInTheOtherNamespace)
+{
+    std::vector<std::string> takenVeths;
+    const std::string vethName = mNetlink.createVeth("eth0", mChild, takenVeths);
+    ASSERT_EQ(vethName, "veth0");
+
+    EXPECT_TRUE(mNetlink.ifaceExists(vethName));
+    EXPECT_FALSE(mNetlink.ifaceExists("eth0"));
+
+    EXPECT_TRUE(inChildNetns([]()
+    {
+        Netlink netlink;
+        return netlink.ifaceExists("eth0") && !netlink.ifaceExists("veth0");
+    }));
+}
+
+TEST_F(NetlinkVethTest, TakenAndExistingNamesAreSkipped)
+{
+    std::vector<std::string> takenVeths = { "veth0", "veth1" };
+    ASSERT_TRUE(mNetlink.createBridge("veth2"));
+
+    EXPECT_EQ(mNetlink.createVeth("eth0", mChild, takenVeths), "veth3");
+    EXPECT_TRUE(mNetlink.deleteIface("veth2"));
+}
+
+TEST_F(NetlinkVethTest, InvalidPeerIsRejected)
+{
+    std::vector<std::string> takenVeths;
+    EXPECT_EQ(mNetlink.createVeth("", mChild, takenVeths), "");
+    EXPECT_EQ(mNetlink.createVeth("a_name_too_long_for_a_link", mChild, takenVeths), "");
+
+    // the namespace can't be opened once the process has gone
+    TearDown();
+    const pid_t child = mChild;
+    mChild = -1;
+    EXPECT_EQ(mNetlink.createVeth("eth0", child, takenVeths), "");
+}
+
+TEST_F(NetlinkVethTest, BatchedRequestsAreApplied)
+{
+    // the host end has to be up for the gateway to be reachable
+    const std::string vethName = createUpVeth();
+    ASSERT_FALSE(vethName.empty());
+
+    EXPECT_TRUE(inChildNetns([]()
+    {
+        Netlink netlink;
+        if (!netlink.beginBatch())
+        {
+            return false;
+        }
+
+        netlink.setIfaceAddress("eth0", INADDR_CREATE(100, 64, 0, 2), INADDR_CREATE(255, 255, 255, 0));
+        netlink.ifaceUp("eth0");
+        netlink.ifaceUp("lo");
+        netlink.addRoute("eth0", INADDR_CREATE(0, 0, 0, 0), INADDR_CREATE(0, 0, 0, 0), INADDR_CREATE(100, 64, 0, 1));
+
+        // the address and route are already there, which isn't an error
+        netlink.setIfaceAddress("eth0", INADDR_CREATE(100, 64, 0, 2), INADDR_CREATE(255, 255, 255, 0));
+        netlink.addRoute("eth0", INADDR_CREATE(0, 0, 0, 0), INADDR_CREATE(0, 0, 0, 0), INADDR_CREATE(100, 64, 0, 1));
+
+        if (netlink.mBatchPending != 6)
+        {
+            return false;
+        }
+
+        return netlink.commitBatch() && netlink.ifaceIsUp("eth0") && netlink.ifaceIsUp("lo");
+    }));
+}
+
+TEST_F(NetlinkVethTest, FailedBatchedRequestDoesNotStopTheRest)
+{
+    // the host end has to be up for the gateway to be reachable
+    const std::string vethName = createUpVeth();
+    ASSERT_FALSE(vethName.empty());
+
+    EXPECT_TRUE(inChildNetns([]()
+    {
+        Netlink netlink;
+        if (!netlink.beginBatch())
+        {
+            return false;
+        }
+
+        // the gateway isn't reachable until the address is set
+        netlink.addRoute("eth0", INADDR_CREATE(0, 0, 0, 0), INADDR_CREATE(0, 0, 0, 0), INADDR_CREATE(100, 64, 0, 1));
+        netlink.ifaceUp("eth0");
+
+        if (netlink.commitBatch())
+        {
+            return false;
+        }
+
+        // all the replies were read, so the socket can still be used
+        return netlink.ifaceIsUp("eth0") &&
+               netlink.setIfaceAddress("eth0", INADDR_CREATE(100, 64, 0, 2), INADDR_CREATE(255, 255, 255, 0)) &&
+               netlink.addRoute("eth0", INADDR_CREATE(0, 0, 0, 0), INADDR_CREATE(0, 0, 0, 0), INADDR_CREATE(100, 64, 0, 1));
+    }));
+}
+
+TEST_F(NetlinkVethTest, BatchMustBeStartedOnce)
+{
+    EXPECT_FALSE(mNetlink.commitBatch());
+
+    EXPECT_TRUE(mNetlink.beginBatch());
+    EXPECT_FALSE(mNetlink.beginBatch());
+    EXPECT_TRUE(mNetlink.commitBatch());
+
+    EXPECT_FALSE(mNetlink.commitBatch());
+    EXPECT_EQ(mNetlink.mBatchLinkCache, nullptr);
+}
+
+// Tests the pool of veth pairs, with a pool size of 2 set in the settings
+// file at DOBBY_SETTINGS_PATH (see CMakeLists.txt).  The pool's bridge is
+// created in the test's namespace and the child's namespace is the container.
+class VethPoolTest : public NetlinkVethTest
+{
+protected:
+    void SetUp() override
+    {
+        NetlinkVethTest::SetUp();
+        if (IsSkipped() || HasFatalFailure())
+        {
+            return;
+        }
+
+        ASSERT_TRUE((mkdir(NETLINK_TEST_DIR, 0755) == 0) || (errno == EEXIST));
+        std::ofstream settings(DOBBY_SETTINGS_PATH, std::ios::trunc);
+        settings << "{ \"network\": { \"vethPoolSize\": 2 } }";
+        settings.close();
+
+        mUtilsMock = new ::testing::NiceMock<DobbyRdkPluginUtilsMock>;
+        DobbyRdkPluginUtils::setImpl(mUtilsMock);
+        mUtils = std::make_shared<DobbyRdkPluginUtils>();
+
+        ON_CALL(*mUtilsMock, getTakenVeths(::testing::_))
+            .WillByDefault(::testing::Return(true));
+
+        mPoolNetlink = std::make_shared<Netlink>();
+        ASSERT_TRUE(mPoolNetlink->createBridge(BRIDGE_NAME));
+        ASSERT_TRUE(mPoolNetlink->ifaceUp(BRIDGE_NAME));
+    }
+
+    void TearDown() override
+    {
+        if (mPoolNetlink)
+        {
+            EXPECT_TRUE(VethPool::drain(mPoolNetlink));
+            EXPECT_TRUE(mPoolNetlink->destroyBridge(BRIDGE_NAME));
+        }
+
+        if (mUtilsMock)
+        {
+            mUtils.reset();
+            DobbyRdkPluginUtils::setImpl(nullptr);
+            delete mUtilsMock;
+        }
+
+        NetlinkVethTest::TearDown();
+    }
+
+    ::testing::NiceMock<DobbyRdkPluginUtilsMock> *mUtilsMock = nullptr;
+    std::shared_ptr<DobbyRdkPluginUtils> mUtils;
+    std::shared_ptr<Netlink> mPoolNetlink;
+};
+
+TEST_F(VethPoolTest, SizeIsReadFromTheSettings)
+{
+    EXPECT_EQ(VethPool::size(), 2u);
+}
+
+TEST_F(VethPoolTest, RefillCreatesBridgedPairs)
+{
+    EXPECT_TRUE(VethPool::vethNames(mPoolNetlink).empty());
+
+    ASSERT_TRUE(VethPool::refill(mUtils, mPoolNetlink));
+
+    const std::list<Netlink::VethPeerDetails> pairs =
+        mPoolNetlink->getVethPeers(VETH_POOL_PEER_PREFIX);
+    ASSERT_EQ(pairs.size(), 2u);
+    for (const Netlink::VethPeerDetails &pair : pairs)
+    {
+        EXPECT_TRUE(pair.bridged);
+        EXPECT_EQ(pair.vethName.compare(0, 4, "veth"), 0);
+        EXPECT_TRUE(mPoolNetlink->ifaceIsUp(pair.vethName));
+    }
+
+    // a full pool is left as is
+    const std::set<std::string> names = VethPool::vethNames(mPoolNetlink);
+    ASSERT_TRUE(VethPool::refill(mUtils, mPoolNetlink));
+    EXPECT_EQ(VethPool::vethNames(mPoolNetlink), names);
+}
+
+TEST_F(VethPoolTest, TakeMovesThePeerIntoTheContainer)
+{
+    ASSERT_TRUE(VethPool::refill(mUtils, mPoolNetlink));
+    const std::set<std::string> names = VethPool::vethNames(mPoolNetlink);
+
+    const std::string vethName = VethPool::take(mPoolNetlink, mChild, { });
+    ASSERT_EQ(names.count(vethName), 1u);
+
+    // the host end stays on the bridge but is no longer in the pool
+    EXPECT_TRUE(mPoolNetlink->ifaceExists(vethName));
+    EXPECT_EQ(VethPool::vethNames(mPoolNetlink).count(vethName), 0u);
+
+    EXPECT_TRUE(inChildNetns([]()
+    {
+        Netlink netlink;
+        return netlink.ifaceExists(PEER_NAME);
+    }));
+
+    // the refill replaces the pair that was taken
+    ASSERT_TRUE(VethPool::refill(mUtils, mPoolNetlink));
+    const std::set<std::string> refilled = VethPool::vethNames(mPoolNetlink);
+    EXPECT_EQ(refilled.size(), 2u);
+    EXPECT_EQ(refilled.count(vethName), 0u);
+
+    EXPECT_TRUE(mPoolNetlink->deleteIface(vethName));
+}
+
+TEST_F(VethPoolTest, TakeSkipsTakenAndIncompletePairs)
+{
+    ASSERT_TRUE(VethPool::refill(mUtils, mPoolNetlink));
+    const std::set<std::string> names = VethPool::vethNames(mPoolNetlink);
+
+    // a pair left by a refill that didn't get as far as the bridge
+    std::vector<std::string> takenVeths(names.begin(), names.end());
+    const std::string incomplete =
+        mPoolNetlink->createVeth(VETH_POOL_PEER_PREFIX "%d", 0, takenVeths);
+    ASSERT_FALSE(incomplete.empty());
+
+    EXPECT_EQ(VethPool::take(mPoolNetlink, mChild, takenVeths), "");
+    EXPECT_TRUE(inChildNetns([]()
+    {
+        Netlink netlink;
+        return !netlink.ifaceExists(PEER_NAME);
+    }));
+
+    // and the next refill deletes it
+    ASSERT_TRUE(VethPool::refill(mUtils, mPoolNetlink));
+    EXPECT_FALSE(mPoolNetlink->ifaceExists(incomplete));
+    EXPECT_EQ(VethPool::vethNames(mPoolNetlink), names);
+}
+
+TEST_F(VethPoolTest, DrainRemovesAllThePairs)
+{
+    ASSERT_TRUE(VethPool::refill(mUtils, mPoolNetlink));
+    const std::set<std::string> names = VethPool::vethNames(mPoolNetlink);
+    ASSERT_EQ(names.size(), 2u);
+
+    EXPECT_TRUE(VethPool::drain(mPoolNetlink));
+
+    EXPECT_TRUE(VethPool::vethNames(mPoolNetlink).empty());
+    for (const std::string &name : names)
+    {
+        EXPECT_FALSE(mPoolNetlink->ifaceExists(name));
+    }
+}
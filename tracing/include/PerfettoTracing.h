@@ -21,6 +21,7 @@
 
 #include <perfetto.h>
 #include <string>
+#include <stdint.h>
 
 
 class PerfettoTracing
@@ -41,6 +42,13 @@ public:
     static bool startInProcessTracing(int fd,
                                       const std::string &categoryFilter = std::string());
     static void stopInProcessTracing();
+
+    static uint64_t traceTime();
+    static void pluginSlice(const std::string &pluginName,
+                            const std::string &hookName,
+                            const std::string &containerId,
+                            uint64_t startNs, uint64_t endNs,
+                            bool success);
 };
 
 #endif
\ No newline at end of file
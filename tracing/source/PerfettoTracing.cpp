@@ -32,6 +32,9 @@
 #include <errno.h>
 #include <unistd.h>
 
+#include <mutex>
+#include <functional>
+
 // reserves internal static storage for our tracing categories.
 PERFETTO_TRACK_EVENT_STATIC_STORAGE();
 
@@ -92,3 +95,48 @@ void PerfettoTracing::stopInProcessTracing()
     PerfettoTracingSingleton::instance()->stopInProcessTracing();
 }
 
+
+uint64_t PerfettoTracing::traceTime()
+{
+    return perfetto::TrackEvent::GetTraceTimeNs();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Emits a completed plugin hook as a slice on the 'plugins' track.
+ *
+ *  Each plugin / container pair gets its own child track under 'plugins' so
+ *  hooks running in parallel for different plugins don't overlap.  The slice
+ *  is written after the hook has finished using the recorded timestamps.
+ */
+void PerfettoTracing::pluginSlice(const std::string &pluginName,
+                                  const std::string &hookName,
+                                  const std::string &containerId,
+                                  uint64_t startNs, uint64_t endNs,
+                                  bool success)
+{
+    // nothing to do unless a trace is running with the category enabled,
+    // this also covers processes that never initialised tracing
+    if (!TRACE_EVENT_CATEGORY_ENABLED("Plugins"))
+        return;
+
+    static const perfetto::Track pluginsTrack(std::hash<std::string>()("plugins"));
+    static std::once_flag pluginsTrackFlag;
+    std::call_once(pluginsTrackFlag, []()
+    {
+        perfetto::protos::gen::TrackDescriptor desc = pluginsTrack.Serialize();
+        desc.set_name("plugins");
+        perfetto::TrackEvent::SetTrackDescriptor(pluginsTrack, desc);
+    });
+
+    const std::string trackName = pluginName + ":" + containerId;
+    const perfetto::Track track(std::hash<std::string>()(trackName), pluginsTrack);
+
+    perfetto::protos::gen::TrackDescriptor desc = track.Serialize();
+    desc.set_name(trackName);
+    perfetto::TrackEvent::SetTrackDescriptor(track, desc);
+
+    TRACE_EVENT_BEGIN("Plugins", perfetto::DynamicString(hookName), track, startNs,
+                      "container", containerId, "success", success);
+    TRACE_EVENT_END("Plugins", track, endNs);
+}
@@ -0,0 +1,1006 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   BridgeFilter.cpp
+ *
+ */
+#include "BridgeFilter.h"
+
+#include <Logging.h>
+
+#include <map>
+#include <set>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <endian.h>
+#include <limits.h>
+#include <libgen.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_ether.h>
+#include <linux/netlink.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter_bridge.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+
+// the table and chain priority used by ebtables-nft, so the rules end up in
+// the same place as if they'd been added with the tool
+#define BRIDGE_FILTER_TABLE         "filter"
+#define BRIDGE_FILTER_PRIORITY      NF_BR_PRI_FILTER_BRIDGED
+
+// prefix of the comment the rules are tagged with
+#define BRIDGE_FILTER_COMMENT       "dobby:"
+
+// userdata type for a rule comment, as understood by nft and ebtables-nft
+#define BRIDGE_FILTER_UDATA_COMMENT 0
+
+// how long to wait for the kernel to reply to a request
+#define BRIDGE_FILTER_TIMEOUT_SECS  5
+
+
+namespace
+{
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Helpers for building nf_tables netlink messages in a buffer.
+ *
+ *  Attributes are always padded to NLA_ALIGNTO, which is the same as
+ *  NLMSG_ALIGNTO, so messages can be packed back to back for a batch.
+ */
+void putAttr(std::vector<uint8_t> *buf, uint16_t type, const void *data, size_t len)
+{
+    struct nlattr attr;
+    attr.nla_type = type;
+    attr.nla_len = static_cast<uint16_t>(NLA_HDRLEN + len);
+
+    const size_t offset = buf->size();
+    buf->resize(offset + NLA_ALIGN(attr.nla_len), 0);
+    memcpy(buf->data() + offset, &attr, sizeof(attr));
+    if (len > 0)
+    {
+        memcpy(buf->data() + offset + NLA_HDRLEN, data, len);
+    }
+}
+
+void putString(std::vector<uint8_t> *buf, uint16_t type, const std::string &value)
+{
+    putAttr(buf, type, value.c_str(), value.size() + 1);
+}
+
+void putU32(std::vector<uint8_t> *buf, uint16_t type, uint32_t value)
+{
+    value = htonl(value);
+    putAttr(buf, type, &value, sizeof(value));
+}
+
+void putU64(std::vector<uint8_t> *buf, uint16_t type, uint64_t value)
+{
+    value = htobe64(value);
+    putAttr(buf, type, &value, sizeof(value));
+}
+
+size_t beginNested(std::vector<uint8_t> *buf, uint16_t type)
+{
+    const size_t offset = buf->size();
+    putAttr(buf, type | NLA_F_NESTED, nullptr, 0);
+    return offset;
+}
+
+void endNested(std::vector<uint8_t> *buf, size_t offset)
+{
+    const uint16_t len = static_cast<uint16_t>(buf->size() - offset);
+    memcpy(buf->data() + offset + offsetof(struct nlattr, nla_len), &len, sizeof(len));
+}
+
+size_t beginMessage(std::vector<uint8_t> *buf, uint16_t type, uint16_t flags,
+                    uint8_t family, uint32_t seq, uint16_t resId = 0)
+{
+    const size_t offset = buf->size();
+    buf->resize(offset + NLMSG_LENGTH(sizeof(struct nfgenmsg)), 0);
+
+    struct nlmsghdr header;
+    memset(&header, 0, sizeof(header));
+    header.nlmsg_type = type;
+    header.nlmsg_flags = NLM_F_REQUEST | flags;
+    header.nlmsg_seq = seq;
+    memcpy(buf->data() + offset, &header, sizeof(header));
+
+    struct nfgenmsg message;
+    memset(&message, 0, sizeof(message));
+    message.nfgen_family = family;
+    message.version = NFNETLINK_V0;
+    message.res_id = htons(resId);
+    memcpy(buf->data() + offset + NLMSG_HDRLEN, &message, sizeof(message));
+
+    return offset;
+}
+
+void endMessage(std::vector<uint8_t> *buf, size_t offset)
+{
+    const uint32_t len = static_cast<uint32_t>(buf->size() - offset);
+    memcpy(buf->data() + offset + offsetof(struct nlmsghdr, nlmsg_len), &len, sizeof(len));
+}
+
+uint16_t nftType(uint16_t msgType)
+{
+    return (NFNL_SUBSYS_NFTABLES << 8) | msgType;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Helpers for adding the expressions that make up a rule.
+ *
+ *  All matches load into NFT_REG_1 and compare against it, the verdict is
+ *  the last expression.
+ */
+void putMetaExpr(std::vector<uint8_t> *buf, uint32_t key)
+{
+    const size_t elem = beginNested(buf, NFTA_LIST_ELEM);
+    putString(buf, NFTA_EXPR_NAME, "meta");
+    const size_t data = beginNested(buf, NFTA_EXPR_DATA);
+    putU32(buf, NFTA_META_KEY, key);
+    putU32(buf, NFTA_META_DREG, NFT_REG_1);
+    endNested(buf, data);
+    endNested(buf, elem);
+}
+
+void putPayloadExpr(std::vector<uint8_t> *buf, uint32_t base, uint32_t offset, uint32_t len)
+{
+    const size_t elem = beginNested(buf, NFTA_LIST_ELEM);
+    putString(buf, NFTA_EXPR_NAME, "payload");
+    const size_t data = beginNested(buf, NFTA_EXPR_DATA);
+    putU32(buf, NFTA_PAYLOAD_DREG, NFT_REG_1);
+    putU32(buf, NFTA_PAYLOAD_BASE, base);
+    putU32(buf, NFTA_PAYLOAD_OFFSET, offset);
+    putU32(buf, NFTA_PAYLOAD_LEN, len);
+    endNested(buf, data);
+    endNested(buf, elem);
+}
+
+void putCmpExpr(std::vector<uint8_t> *buf, const void *value, size_t len)
+{
+    const size_t elem = beginNested(buf, NFTA_LIST_ELEM);
+    putString(buf, NFTA_EXPR_NAME, "cmp");
+    const size_t data = beginNested(buf, NFTA_EXPR_DATA);
+    putU32(buf, NFTA_CMP_SREG, NFT_REG_1);
+    putU32(buf, NFTA_CMP_OP, NFT_CMP_EQ);
+    const size_t cmpData = beginNested(buf, NFTA_CMP_DATA);
+    putAttr(buf, NFTA_DATA_VALUE, value, len);
+    endNested(buf, cmpData);
+    endNested(buf, data);
+    endNested(buf, elem);
+}
+
+void putVerdictExpr(std::vector<uint8_t> *buf, uint32_t verdict)
+{
+    const size_t elem = beginNested(buf, NFTA_LIST_ELEM);
+    putString(buf, NFTA_EXPR_NAME, "immediate");
+    const size_t data = beginNested(buf, NFTA_EXPR_DATA);
+    putU32(buf, NFTA_IMMEDIATE_DREG, NFT_REG_VERDICT);
+    const size_t immData = beginNested(buf, NFTA_IMMEDIATE_DATA);
+    const size_t verdictData = beginNested(buf, NFTA_DATA_VERDICT);
+    putU32(buf, NFTA_VERDICT_CODE, verdict);
+    endNested(buf, verdictData);
+    endNested(buf, immData);
+    endNested(buf, data);
+    endNested(buf, elem);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Calls @a handler with the type, data and length of each attribute
+ *  in the given range.
+ */
+template <typename Handler>
+void forEachAttr(const uint8_t *attrs, size_t remaining, Handler handler)
+{
+    while (remaining >= sizeof(struct nlattr))
+    {
+        struct nlattr attr;
+        memcpy(&attr, attrs, sizeof(attr));
+        if ((attr.nla_len < sizeof(struct nlattr)) || (attr.nla_len > remaining))
+            break;
+
+        handler(attr.nla_type & NLA_TYPE_MASK, attrs + NLA_HDRLEN,
+                attr.nla_len - NLA_HDRLEN);
+
+        attrs += NLA_ALIGN(attr.nla_len);
+        remaining -= std::min<size_t>(remaining, NLA_ALIGN(attr.nla_len));
+    }
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the comment stored in the userdata of a rule, or an empty
+ *  string if it doesn't have one.
+ *
+ *  The userdata is a list of one byte type, one byte length records.
+ */
+std::string userdataComment(const uint8_t *data, size_t len)
+{
+    size_t offset = 0;
+    while ((offset + 2) <= len)
+    {
+        const uint8_t type = data[offset];
+        const uint8_t valueLen = data[offset + 1];
+        if ((offset + 2 + valueLen) > len)
+            break;
+
+        if (type == BRIDGE_FILTER_UDATA_COMMENT)
+        {
+            const char *value = reinterpret_cast<const char*>(data + offset + 2);
+            return std::string(value, strnlen(value, valueLen));
+        }
+
+        offset += 2 + valueLen;
+    }
+
+    return std::string();
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Opens a netfilter netlink socket with a receive timeout, so a
+ *  missing reply can't hang the caller.
+ *
+ *  @return the socket fd or -1 on failure.
+ */
+int openSocket()
+{
+    int sockFd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_NETFILTER);
+    if (sockFd < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to create netfilter netlink socket");
+        return -1;
+    }
+
+    struct timeval timeout = { BRIDGE_FILTER_TIMEOUT_SECS, 0 };
+    if (setsockopt(sockFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+    {
+        AI_LOG_SYS_WARN(errno, "failed to set netlink receive timeout");
+    }
+
+    return sockFd;
+}
+
+bool sendBuffer(int sockFd, const std::vector<uint8_t> &buf)
+{
+    ssize_t sent = TEMP_FAILURE_RETRY(send(sockFd, buf.data(), buf.size(), 0));
+    if (sent != static_cast<ssize_t>(buf.size()))
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to send nf_tables request");
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Reads replies from the socket, calling @a handler for each one
+ *  until it returns false.
+ *
+ *  @return false if the socket couldn't be read.
+ */
+template <typename Handler>
+bool readReplies(int sockFd, Handler handler)
+{
+    std::vector<uint8_t> buf(65536);
+
+    while (true)
+    {
+        ssize_t length = TEMP_FAILURE_RETRY(recv(sockFd, buf.data(), buf.size(), 0));
+        if (length <= 0)
+        {
+            AI_LOG_SYS_ERROR(errno, "failed to read nf_tables reply");
+            return false;
+        }
+
+        size_t remaining = static_cast<size_t>(length);
+        const struct nlmsghdr *header = reinterpret_cast<const struct nlmsghdr*>(buf.data());
+        while (NLMSG_OK(header, remaining))
+        {
+            if (!handler(header))
+                return true;
+
+            header = NLMSG_NEXT(header, remaining);
+        }
+    }
+}
+
+int errorCode(const struct nlmsghdr *header)
+{
+    struct nlmsgerr error;
+    if (header->nlmsg_len < NLMSG_LENGTH(sizeof(error)))
+        return -EBADMSG;
+
+    memcpy(&error, NLMSG_DATA(header), sizeof(error));
+    return error.error;
+}
+
+const uint8_t* messageAttrs(const struct nlmsghdr *header, size_t *len)
+{
+    const size_t attrsOffset = NLMSG_LENGTH(NLMSG_ALIGN(sizeof(struct nfgenmsg)));
+    *len = (header->nlmsg_len > attrsOffset) ? (header->nlmsg_len - attrsOffset) : 0;
+    return reinterpret_cast<const uint8_t*>(header) + attrsOffset;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Checks if the given chain exists in the bridge filter table.
+ *
+ *  @return false if the kernel couldn't be asked.
+ */
+bool chainExists(int sockFd, const std::string &chain, uint32_t seq, bool *exists)
+{
+    std::vector<uint8_t> buf;
+    const size_t msg = beginMessage(&buf, nftType(NFT_MSG_GETCHAIN), 0, NFPROTO_BRIDGE, seq);
+    putString(&buf, NFTA_CHAIN_TABLE, BRIDGE_FILTER_TABLE);
+    putString(&buf, NFTA_CHAIN_NAME, chain);
+    endMessage(&buf, msg);
+
+    if (!sendBuffer(sockFd, buf))
+        return false;
+
+    bool success = false;
+    bool read = readReplies(sockFd, [&](const struct nlmsghdr *header)
+    {
+        if (header->nlmsg_seq != seq)
+            return true;
+
+        if (header->nlmsg_type == nftType(NFT_MSG_NEWCHAIN))
+        {
+            *exists = true;
+            success = true;
+        }
+        else if (header->nlmsg_type == NLMSG_ERROR)
+        {
+            const int error = errorCode(header);
+            if (error == -ENOENT)
+            {
+                *exists = false;
+                success = true;
+            }
+            else
+            {
+                AI_LOG_SYS_ERROR(-error, "failed to get bridge chain '%s'", chain.c_str());
+            }
+        }
+
+        return false;
+    });
+
+    return read && success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Gets the handles of the rules in the given chain, keyed by their
+ *  comment and in the order they appear in the chain.
+ *
+ *  @return false if the rules couldn't be read.
+ */
+bool ruleHandles(int sockFd, const std::string &chain, uint32_t seq,
+                 std::map<std::string, std::list<uint64_t>> *handles)
+{
+    std::vector<uint8_t> buf;
+    const size_t msg = beginMessage(&buf, nftType(NFT_MSG_GETRULE), NLM_F_DUMP,
+                                    NFPROTO_BRIDGE, seq);
+    putString(&buf, NFTA_RULE_TABLE, BRIDGE_FILTER_TABLE);
+    putString(&buf, NFTA_RULE_CHAIN, chain);
+    endMessage(&buf, msg);
+
+    if (!sendBuffer(sockFd, buf))
+        return false;
+
+    bool success = false;
+    bool read = readReplies(sockFd, [&](const struct nlmsghdr *header)
+    {
+        if (header->nlmsg_seq != seq)
+            return true;
+
+        if (header->nlmsg_type == NLMSG_DONE)
+        {
+            success = true;
+            return false;
+        }
+        else if (header->nlmsg_type == NLMSG_ERROR)
+        {
+            // a missing table or chain just means there are no rules
+            const int error = errorCode(header);
+            success = (error == -ENOENT);
+            if (!success)
+            {
+                AI_LOG_SYS_ERROR(-error, "failed to dump bridge chain '%s'", chain.c_str());
+            }
+            return false;
+        }
+        else if (header->nlmsg_type == nftType(NFT_MSG_NEWRULE))
+        {
+            uint64_t handle = 0;
+            std::string comment;
+
+            size_t len;
+            const uint8_t *attrs = messageAttrs(header, &len);
+            forEachAttr(attrs, len, [&](uint16_t type, const uint8_t *data, size_t dataLen)
+            {
+                if ((type == NFTA_RULE_HANDLE) && (dataLen >= sizeof(handle)))
+                {
+                    memcpy(&handle, data, sizeof(handle));
+                    handle = be64toh(handle);
+                }
+                else if (type == NFTA_RULE_USERDATA)
+                {
+                    comment = userdataComment(data, dataLen);
+                }
+            });
+
+            if ((handle != 0) && !comment.empty())
+            {
+                (*handles)[comment].push_back(handle);
+            }
+        }
+
+        return true;
+    });
+
+    return read && success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns the bridge hook number of the given ebtables chain, or -1
+ *  if it's not one of the built-in filter chains.
+ */
+int chainHook(const std::string &chain)
+{
+    if (chain == "INPUT")
+        return NF_BR_LOCAL_IN;
+    else if (chain == "FORWARD")
+        return NF_BR_FORWARD;
+    else if (chain == "OUTPUT")
+        return NF_BR_LOCAL_OUT;
+    else
+        return -1;
+}
+
+} // namespace
+
+
+BridgeFilter::BridgeFilter(const std::string &ebtablesPath)
+    : mEbtablesPath(ebtablesPath)
+    , mNativeSupported(nativeSupported())
+{
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns true if rules can be written directly to nf_tables.
+ *
+ *  The result is worked out once per process, see the overload below.
+ */
+bool BridgeFilter::nativeSupported()
+{
+    static const bool supported = nativeSupported(
+    {
+        "/sbin/ebtables", "/usr/sbin/ebtables", "/bin/ebtables", "/usr/bin/ebtables"
+    });
+
+    return supported;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Returns true if the first ebtables found in @a ebtablesPaths is
+ *  ebtables-nft, or if there's none at all.
+ *
+ *  If the installed ebtables is the legacy tool then the rules the platform
+ *  relies on live in the legacy ebtables tables, which nf_tables rules would
+ *  have no effect on, so everything has to go through the tool.  ebtables-nft
+ *  is a link to xtables-nft-multi (or called ebtables-nft), so it's spotted by
+ *  the name of the real file.  If there's no ebtables at all then nothing else
+ *  could be using the legacy tables.
+ */
+bool BridgeFilter::nativeSupported(const std::list<std::string> &ebtablesPaths)
+{
+    for (const std::string &path : ebtablesPaths)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved) == nullptr)
+            continue;
+
+        if (strstr(basename(resolved), "nft") == nullptr)
+        {
+            AI_LOG_INFO("'%s' is the legacy ebtables tool, bridge rules will "
+                        "be applied with it", path.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Queues the given rule to be inserted at the start of its chain.
+ *
+ *  @param[in]  args    The args that would be passed to 'ebtables -I'.
+ */
+void BridgeFilter::insertRule(const std::string &args)
+{
+    queueRule(Operation::Insert, args);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Queues the given rule to be deleted.
+ *
+ *  A rule inserted natively is found by its comment, so @a args should be
+ *  the same as when the rule was inserted.  If no such rule is found, for
+ *  example because it was added by the ebtables tool, then the delete is
+ *  passed on to the tool.
+ *
+ *  @param[in]  args    The args that would be passed to 'ebtables -D'.
+ */
+void BridgeFilter::deleteRule(const std::string &args)
+{
+    queueRule(Operation::Delete, args);
+}
+
+void BridgeFilter::queueRule(Operation operation, const std::string &args)
+{
+    Rule rule;
+    rule.operation = operation;
+    rule.args = args;
+    rule.native = mNativeSupported && parseRule(args, &rule);
+
+    if (!rule.native)
+    {
+        AI_LOG_DEBUG("using ebtables tool for rule '%s'", args.c_str());
+    }
+
+    mRules.emplace_back(std::move(rule));
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Applies all the queued rules.
+ *
+ *  The rules that can be done natively are sent as one nf_tables batch, the
+ *  rest are run through the ebtables tool.  If the batch is rejected then
+ *  nothing from it has been applied, so those rules are retried with the
+ *  tool as well.
+ *
+ *  The queue is emptied whether or not the rules were applied.
+ *
+ *  @return true if all the rules were applied, otherwise false.
+ */
+bool BridgeFilter::commit()
+{
+    std::list<Rule> nativeRules;
+    std::list<Rule> toolRules;
+
+    for (Rule &rule : mRules)
+    {
+        if (rule.native)
+            nativeRules.emplace_back(std::move(rule));
+        else
+            toolRules.emplace_back(std::move(rule));
+    }
+    mRules.clear();
+
+    if (!nativeRules.empty() && !commitNative(nativeRules, &toolRules))
+    {
+        AI_LOG_WARN("failed to apply bridge rules via nf_tables, falling back "
+                    "to the ebtables tool");
+        toolRules.splice(toolRules.end(), nativeRules);
+    }
+
+    bool success = true;
+    for (const Rule &rule : toolRules)
+    {
+        if (!runTool(rule))
+            success = false;
+    }
+
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Parses the args of an ebtables rule into @a rule.
+ *
+ *  @return false if the rule uses anything that can't be done natively.
+ */
+bool BridgeFilter::parseRule(const std::string &args, Rule *rule)
+{
+    std::istringstream stream(args);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (stream >> token)
+    {
+        tokens.push_back(token);
+    }
+
+    if (tokens.empty() || (chainHook(tokens[0]) < 0))
+        return false;
+
+    rule->chain = tokens[0];
+    rule->protocol = 0;
+    rule->verdict = NF_ACCEPT;
+    bool haveVerdict = false;
+
+    // the address options need the matching protocol, as they do in ebtables
+    int addrFamily = AF_UNSPEC;
+
+    for (size_t i = 1; i < tokens.size(); i += 2)
+    {
+        const std::string &option = tokens[i];
+        if ((i + 1) >= tokens.size())
+            return false;
+        const std::string &value = tokens[i + 1];
+
+        // negation, masks and wildcards aren't supported
+        if ((value == "!") || (value.find_first_of("/+") != std::string::npos))
+            return false;
+
+        if ((option == "-i") || (option == "--in-interface") || (option == "--in-if"))
+        {
+            if (value.size() >= IFNAMSIZ)
+                return false;
+            rule->inIface = value;
+        }
+        else if ((option == "-o") || (option == "--out-interface") || (option == "--out-if"))
+        {
+            if (value.size() >= IFNAMSIZ)
+                return false;
+            rule->outIface = value;
+        }
+        else if ((option == "-p") || (option == "--protocol"))
+        {
+            if (value == "IPv4")
+                rule->protocol = ETH_P_IP;
+            else if (value == "IPv6")
+                rule->protocol = ETH_P_IPV6;
+            else if (value == "ARP")
+                rule->protocol = ETH_P_ARP;
+            else
+                return false;
+        }
+        else if ((option == "--ip-src") || (option == "--ip-source") ||
+                 (option == "--ip-dst") || (option == "--ip-destination") ||
+                 (option == "--ip6-src") || (option == "--ip6-source") ||
+                 (option == "--ip6-dst") || (option == "--ip6-destination"))
+        {
+            const bool ipv6 = (option.compare(0, 5, "--ip6") == 0);
+            if (rule->protocol != (ipv6 ? ETH_P_IPV6 : ETH_P_IP))
+                return false;
+
+            addrFamily = ipv6 ? AF_INET6 : AF_INET;
+
+            uint8_t address[16];
+            if (inet_pton(addrFamily, value.c_str(), address) != 1)
+                return false;
+
+            const size_t len = ipv6 ? 16 : 4;
+            const bool isSource = (option.find("-src") != std::string::npos) ||
+                                  (option.find("-source") != std::string::npos);
+            std::vector<uint8_t> &dest = isSource ? rule->srcAddress : rule->dstAddress;
+            dest.assign(address, address + len);
+        }
+        else if ((option == "-j") || (option == "--jump"))
+        {
+            if (value == "ACCEPT")
+                rule->verdict = NF_ACCEPT;
+            else if (value == "DROP")
+                rule->verdict = NF_DROP;
+            else
+                return false;
+
+            haveVerdict = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (!haveVerdict)
+        return false;
+
+    // the comment is the args with the whitespace normalised, it has to fit
+    // in a single userdata record
+    std::string normalised;
+    for (const std::string &part : tokens)
+    {
+        normalised += (normalised.empty() ? "" : " ") + part;
+    }
+
+    rule->comment = BRIDGE_FILTER_COMMENT + normalised;
+    if ((rule->comment.size() + 1) > UINT8_MAX)
+        return false;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Sends the given rules to the kernel as a single nf_tables batch.
+ *
+ *  Any of the built-in chains that don't exist yet are created first, the
+ *  same way ebtables-nft would create them.  Deletes are done by handle,
+ *  found by dumping the chain, and deletes for rules that can't be found
+ *  are added to @a toolRules rather than the batch.
+ *
+ *  The socket is opened in the calling thread's network namespace.
+ *
+ *  @return false if the batch couldn't be built or was rejected.
+ */
+bool BridgeFilter::commitNative(const std::list<Rule> &rules,
+                                std::list<Rule> *toolRules) const
+{
+    int sockFd = openSocket();
+    if (sockFd < 0)
+        return false;
+
+    uint32_t seq = static_cast<uint32_t>(time(nullptr));
+
+    // find the chains that need to be created and the handles of the rules
+    // that are to be deleted
+    std::set<std::string> insertChains;
+    std::set<std::string> deleteChains;
+    for (const Rule &rule : rules)
+    {
+        if (rule.operation == Operation::Insert)
+            insertChains.insert(rule.chain);
+        else
+            deleteChains.insert(rule.chain);
+    }
+
+    std::set<std::string> missingChains;
+    for (const std::string &chain : insertChains)
+    {
+        bool exists = false;
+        if (!chainExists(sockFd, chain, ++seq, &exists))
+        {
+            close(sockFd);
+            return false;
+        }
+        if (!exists)
+            missingChains.insert(chain);
+    }
+
+    std::map<std::string, std::map<std::string, std::list<uint64_t>>> handles;
+    for (const std::string &chain : deleteChains)
+    {
+        if (!ruleHandles(sockFd, chain, ++seq, &handles[chain]))
+        {
+            close(sockFd);
+            return false;
+        }
+    }
+
+    // build the batch
+    std::list<Rule> notFound;
+    std::vector<uint8_t> buf;
+    buf.reserve(4096);
+    unsigned expectedAcks = 0;
+
+    size_t msg = beginMessage(&buf, NFNL_MSG_BATCH_BEGIN, 0, AF_UNSPEC, ++seq,
+                              NFNL_SUBSYS_NFTABLES);
+    endMessage(&buf, msg);
+
+    if (!missingChains.empty())
+    {
+        msg = beginMessage(&buf, nftType(NFT_MSG_NEWTABLE), NLM_F_CREATE | NLM_F_ACK,
+                           NFPROTO_BRIDGE, ++seq);
+        putString(&buf, NFTA_TABLE_NAME, BRIDGE_FILTER_TABLE);
+        endMessage(&buf, msg);
+        expectedAcks++;
+    }
+
+    for (const std::string &chain : missingChains)
+    {
+        msg = beginMessage(&buf, nftType(NFT_MSG_NEWCHAIN), NLM_F_CREATE | NLM_F_ACK,
+                           NFPROTO_BRIDGE, ++seq);
+        putString(&buf, NFTA_CHAIN_TABLE, BRIDGE_FILTER_TABLE);
+        putString(&buf, NFTA_CHAIN_NAME, chain);
+        const size_t hook = beginNested(&buf, NFTA_CHAIN_HOOK);
+        putU32(&buf, NFTA_HOOK_HOOKNUM, chainHook(chain));
+        putU32(&buf, NFTA_HOOK_PRIORITY, static_cast<uint32_t>(BRIDGE_FILTER_PRIORITY));
+        endNested(&buf, hook);
+        putString(&buf, NFTA_CHAIN_TYPE, "filter");
+        putU32(&buf, NFTA_CHAIN_POLICY, NF_ACCEPT);
+        endMessage(&buf, msg);
+        expectedAcks++;
+    }
+
+    for (const Rule &rule : rules)
+    {
+        if (rule.operation == Operation::Delete)
+        {
+            std::list<uint64_t> &matches = handles[rule.chain][rule.comment];
+            if (matches.empty())
+            {
+                notFound.push_back(rule);
+                continue;
+            }
+
+            msg = beginMessage(&buf, nftType(NFT_MSG_DELRULE), NLM_F_ACK,
+                               NFPROTO_BRIDGE, ++seq);
+            putString(&buf, NFTA_RULE_TABLE, BRIDGE_FILTER_TABLE);
+            putString(&buf, NFTA_RULE_CHAIN, rule.chain);
+            putU64(&buf, NFTA_RULE_HANDLE, matches.front());
+            endMessage(&buf, msg);
+
+            matches.pop_front();
+            expectedAcks++;
+            continue;
+        }
+
+        encodeRule(rule, ++seq, &buf);
+        expectedAcks++;
+    }
+
+    msg = beginMessage(&buf, NFNL_MSG_BATCH_END, 0, AF_UNSPEC, ++seq,
+                       NFNL_SUBSYS_NFTABLES);
+    endMessage(&buf, msg);
+
+    // send it and wait for an ack for every message, if any fail then the
+    // kernel aborts the whole batch
+    bool success = true;
+    if ((expectedAcks > 0) && (success = sendBuffer(sockFd, buf)))
+    {
+        unsigned acks = 0;
+        success = readReplies(sockFd, [&](const struct nlmsghdr *header)
+        {
+            if (header->nlmsg_type == NLMSG_ERROR)
+            {
+                const int error = errorCode(header);
+                if (error != 0)
+                {
+                    AI_LOG_SYS_ERROR(-error, "nf_tables rejected bridge rule "
+                                     "message %u", header->nlmsg_seq);
+                    success = false;
+                    return false;
+                }
+                acks++;
+            }
+
+            return (acks < expectedAcks);
+        }) && success;
+    }
+
+    close(sockFd);
+
+    if (success)
+    {
+        toolRules->splice(toolRules->end(), notFound);
+    }
+
+    return success;
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Appends an nf_tables NEWRULE message for @a rule to @a buf.
+ *
+ *  The matches are built from the same expressions ebtables-nft uses, so the
+ *  rule lists the same with either tool, and the rule is tagged with its
+ *  comment for deleting it again.
+ */
+void BridgeFilter::encodeRule(const Rule &rule, uint32_t seq, std::vector<uint8_t> *buf)
+{
+    // without NLM_F_APPEND the rule goes at the start of the chain, as
+    // with 'ebtables -I'
+    const size_t msg = beginMessage(buf, nftType(NFT_MSG_NEWRULE),
+                                    NLM_F_CREATE | NLM_F_ACK, NFPROTO_BRIDGE, seq);
+    putString(buf, NFTA_RULE_TABLE, BRIDGE_FILTER_TABLE);
+    putString(buf, NFTA_RULE_CHAIN, rule.chain);
+
+    const size_t exprs = beginNested(buf, NFTA_RULE_EXPRESSIONS);
+    if (!rule.inIface.empty())
+    {
+        putMetaExpr(buf, NFT_META_IIFNAME);
+        putCmpExpr(buf, rule.inIface.c_str(), rule.inIface.size() + 1);
+    }
+    if (!rule.outIface.empty())
+    {
+        putMetaExpr(buf, NFT_META_OIFNAME);
+        putCmpExpr(buf, rule.outIface.c_str(), rule.outIface.size() + 1);
+    }
+    if (rule.protocol != 0)
+    {
+        // the ethertype field of the ethernet header
+        const uint16_t protocol = htons(rule.protocol);
+        putPayloadExpr(buf, NFT_PAYLOAD_LL_HEADER, 12, sizeof(protocol));
+        putCmpExpr(buf, &protocol, sizeof(protocol));
+    }
+    if (!rule.srcAddress.empty())
+    {
+        const uint32_t offset = (rule.srcAddress.size() == 4) ? 12 : 8;
+        putPayloadExpr(buf, NFT_PAYLOAD_NETWORK_HEADER, offset, rule.srcAddress.size());
+        putCmpExpr(buf, rule.srcAddress.data(), rule.srcAddress.size());
+    }
+    if (!rule.dstAddress.empty())
+    {
+        const uint32_t offset = (rule.dstAddress.size() == 4) ? 16 : 24;
+        putPayloadExpr(buf, NFT_PAYLOAD_NETWORK_HEADER, offset, rule.dstAddress.size());
+        putCmpExpr(buf, rule.dstAddress.data(), rule.dstAddress.size());
+    }
+    putVerdictExpr(buf, rule.verdict);
+    endNested(buf, exprs);
+
+    std::vector<uint8_t> userdata = { BRIDGE_FILTER_UDATA_COMMENT,
+                                      static_cast<uint8_t>(rule.comment.size() + 1) };
+    userdata.insert(userdata.end(), rule.comment.begin(), rule.comment.end());
+    userdata.push_back('\0');
+    putAttr(buf, NFTA_RULE_USERDATA, userdata.data(), userdata.size());
+
+    endMessage(buf, msg);
+}
+
+// -----------------------------------------------------------------------------
+/**
+ *  @brief Applies the rule by running the ebtables tool.
+ *
+ *  @return true if the tool succeeded.
+ */
+bool BridgeFilter::runTool(const Rule &rule) const
+{
+    const std::string command = mEbtablesPath +
+                                ((rule.operation == Operation::Insert) ? " -I " : " -D ") +
+                                rule.args + " > /dev/null 2>&1";
+
+    FILE* pipe = popen(command.c_str(), "re");
+    if (!pipe)
+    {
+        AI_LOG_SYS_ERROR(errno, "popen failed");
+        return false;
+    }
+
+    int returnCode = pclose(pipe);
+    if (returnCode < 0)
+    {
+        AI_LOG_SYS_ERROR(errno, "failed to exec command `%s`", command.c_str());
+        return false;
+    }
+    else if (returnCode > 0)
+    {
+        AI_LOG_ERROR("failed to exec command `%s`, command returned code %d",
+                     command.c_str(), returnCode);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,107 @@
+/*
+* If not stated otherwise in this file or this component's LICENSE file the
+* following copyright and licenses apply:
+*
+* Copyright 2024 Sky UK
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+/*
+ * File:   BridgeFilter.h
+ *
+ */
+#ifndef BRIDGEFILTER_H
+#define BRIDGEFILTER_H
+
+#include <stdint.h>
+
+#include <list>
+#include <string>
+#include <vector>
+
+
+// -----------------------------------------------------------------------------
+/**
+ *  @class BridgeFilter
+ *  @brief Inserts and deletes ebtables rules over nf_tables netlink rather
+ *  than by running the ebtables tool for each one.
+ *
+ *  Rules are given as the args that would be passed to 'ebtables -I' or
+ *  'ebtables -D', for example "OUTPUT -o veth0 -p IPv4 --ip-dst 239.0.0.1
+ *  -j ACCEPT", and are queued until commit() is called.  All the queued
+ *  rules are then sent to the kernel in a single nf_tables batch, so they're
+ *  applied atomically and cost one netlink round trip rather than a fork and
+ *  exec each.
+ *
+ *  The rules are written to the 'filter' table of the bridge family, which is
+ *  where ebtables-nft keeps its rules, and are tagged with a comment holding
+ *  the args so the same args can be used to delete them again.
+ *
+ *  Only the ebtables options Dobby uses are understood (-i, -o, -p, --ip-src,
+ *  --ip-dst, --ip6-src, --ip6-dst and -j ACCEPT or DROP).  Any other rule, or
+ *  any rule on a box where ebtables is the legacy tool, is passed to the
+ *  ebtables tool instead.
+ */
+class BridgeFilter
+{
+public:
+    explicit BridgeFilter(const std::string &ebtablesPath = "ebtables");
+    ~BridgeFilter() = default;
+
+    BridgeFilter(const BridgeFilter&) = delete;
+    BridgeFilter& operator=(const BridgeFilter&) = delete;
+
+public:
+    static bool nativeSupported();
+
+    void insertRule(const std::string &args);
+    void deleteRule(const std::string &args);
+
+    bool commit();
+
+private:
+    enum class Operation { Insert, Delete };
+
+    struct Rule
+    {
+        Operation operation;
+        std::string args;
+        bool native;
+
+        std::string chain;
+        std::string comment;
+        std::string inIface;
+        std::string outIface;
+        uint16_t protocol;
+        std::vector<uint8_t> srcAddress;
+        std::vector<uint8_t> dstAddress;
+        uint32_t verdict;
+    };
+
+    static bool nativeSupported(const std::list<std::string> &ebtablesPaths);
+
+    void queueRule(Operation operation, const std::string &args);
+    static bool parseRule(const std::string &args, Rule *rule);
+
+    bool commitNative(const std::list<Rule> &rules, std::list<Rule> *toolRules) const;
+    static void encodeRule(const Rule &rule, uint32_t seq, std::vector<uint8_t> *buf);
+    bool runTool(const Rule &rule) const;
+
+private:
+    const std::string mEbtablesPath;
+    bool mNativeSupported;
+    std::list<Rule> mRules;
+};
+
+
+#endif // !defined(BRIDGEFILTER_H)
@@ -22,6 +22,7 @@
  */
 #include "DobbyUtils.h"
 #include "DobbyTimer.h"
+#include "BridgeFilter.h"
 
 #include <Logging.h>
 #include <FileUtilities.h>
@@ -1622,7 +1623,8 @@ void DobbyUtils::clearContainerMetaData(const ContainerId &id)
  *  @brief Inserts the given ebtables rule to the existing set.
  *
  *  This doesn't flush out any old rules, it just adds the new one at
- *  the beginning of the table.
+ *  the beginning of the table.  The rule is written over nf_tables netlink
+ *  where possible, see BridgeFilter, otherwise the ebtables tool is used.
  *
  *  @param[in]  args  The args of one rule to add.
  *
@@ -1630,8 +1632,9 @@ void DobbyUtils::clearContainerMetaData(const ContainerId &id)
  */
 bool DobbyUtils::insertEbtablesRule(const std::string &args) const
 {
-    // TODO: replace with library call rather than using ebtables tool
-    return executeCommand("ebtables -I " + args);
+    BridgeFilter bridgeFilter;
+    bridgeFilter.insertRule(args);
+    return bridgeFilter.commit();
 }
 
 // -------------------------------------------------------------------------
@@ -1647,8 +1650,9 @@ bool DobbyUtils::insertEbtablesRule(const std::string &args) const
  */
 bool DobbyUtils::deleteEbtablesRule(const std::string &args) const
 {
-    // TODO: replace with library call rather than using ebtables tool
-    return executeCommand("ebtables -D " + args);
+    BridgeFilter bridgeFilter;
+    bridgeFilter.deleteRule(args);
+    return bridgeFilter.commit();
 }
 
 bool DobbyUtils::executeCommand(const std::string &command) const